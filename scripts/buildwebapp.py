@@ -1,8 +1,12 @@
 import subprocess
-import shutil
 import os
+import zipfile
 from pathlib import Path
 
+# Formats that are already compressed. They are stored as-is, so the plugin
+# can serve them straight out of the embedded archive without inflating.
+STORED_EXTENSIONS = {'.png', '.jpg', '.jpeg', '.gif', '.webp', '.ico', '.woff', '.woff2', '.mp3', '.ogg'}
+
 def build_and_zip():
     # Create tmp directory if it doesn't exist
     tmp_dir = Path('./tmp')
@@ -16,9 +20,16 @@ def build_and_zip():
     print("Creating zip archive...")
     if os.path.exists('./tmp/app.zip'):
         os.remove('./tmp/app.zip')
-    
-    shutil.make_archive('./tmp/app', 'zip', './dist')
+
+    dist_dir = Path('./dist')
+    with zipfile.ZipFile('./tmp/app.zip', 'w') as archive:
+        for path in sorted(dist_dir.rglob('*')):
+            if not path.is_file():
+                continue
+            compression = zipfile.ZIP_STORED if path.suffix.lower() in STORED_EXTENSIONS else zipfile.ZIP_DEFLATED
+            archive.write(path, path.relative_to(dist_dir).as_posix(), compress_type=compression)
+
     print("Build and zip completed: ./tmp/app.zip")
 
 if __name__ == '__main__':
-    build_and_zip()
\ No newline at end of file
+    build_and_zip()
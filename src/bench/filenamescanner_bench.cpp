@@ -0,0 +1,133 @@
+// Times FilenameScanner against the regex parsing it replaced, over a
+// synthetic sample library. Build with -DOPENSAMPLER_BENCHMARKS=ON and run
+// FilenameScannerBench [numFiles].
+
+#include "core/sampler/filenamescanner.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct RegexInfo {
+    int rootNote = -1;
+    int velocity = -1;
+};
+
+// SampleParser::parseRootNoteFromFilename and parseFilenameMetadata as they
+// were, minus the JSON result
+RegexInfo parseWithRegex(const std::string& filename) {
+    static const std::array<std::string, 12> noteNames = {
+        "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"
+    };
+
+    RegexInfo info;
+
+    std::regex notePattern("([A-G]#?)(-?[0-9])");
+    std::smatch match;
+    if (std::regex_search(filename, match, notePattern) && match.size() > 2) {
+        const auto noteIt = std::find(noteNames.begin(), noteNames.end(), match[1].str());
+        if (noteIt != noteNames.end())
+            info.rootNote = (std::stoi(match[2].str()) + 1) * 12 + static_cast<int>(noteIt - noteNames.begin());
+    }
+
+    std::regex velocityPattern("v(?:el)?([0-9]{1,3})");
+    std::smatch velMatch;
+    if (std::regex_search(filename, velMatch, velocityPattern) && velMatch.size() > 1) {
+        const int velocity = std::stoi(velMatch[1].str());
+        if (velocity >= 0 && velocity <= 127)
+            info.velocity = velocity;
+    }
+
+    return info;
+}
+
+// Names in the styles sample libraries use, with directories and extensions
+std::vector<std::string> makeFilenames(int count) {
+    static const char* const stems[] = {
+        "Piano_%s_v%d_rr%d.wav",
+        "Strings Legato %s vel%d.aif",
+        "Kit/Snare_rimshot_v%d-%d_rr%d.wav",
+        "Brass/Trumpet-stac-%s-vel%d.flac",
+        "808 Kick Long.wav",
+    };
+    static const char* const notes[] = { "C3", "F#2", "Bb-1", "A4", "Eb5", "G1" };
+
+    std::vector<std::string> filenames;
+    filenames.reserve(static_cast<size_t>(count));
+    char buffer[128];
+    for (int i = 0; i < count; ++i) {
+        const char* note = notes[i % 6];
+        const int velocity = 1 + (i * 37) % 127;
+        switch (i % 5) {
+        case 0: std::snprintf(buffer, sizeof(buffer), stems[0], note, velocity, i % 4 + 1); break;
+        case 1: std::snprintf(buffer, sizeof(buffer), stems[1], note, velocity); break;
+        case 2: std::snprintf(buffer, sizeof(buffer), stems[2], velocity / 2, velocity, i % 4 + 1); break;
+        case 3: std::snprintf(buffer, sizeof(buffer), stems[3], note, velocity); break;
+        default: std::snprintf(buffer, sizeof(buffer), "%s", stems[4]); break;
+        }
+        filenames.emplace_back(std::string("Library/Instrument ") + std::to_string(i / 500) + "/" + buffer);
+    }
+    return filenames;
+}
+
+// Best of a few runs, in nanoseconds per filename
+template <typename Function>
+double timePerFile(const std::vector<std::string>& filenames, Function&& function) {
+    double best = 0.0;
+    for (int run = 0; run < 5; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        const double perFile = elapsed / static_cast<double>(filenames.size());
+        best = run == 0 ? perFile : std::min(best, perFile);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int count = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20000;
+    const auto filenames = makeFilenames(count);
+
+    // Checksums keep the optimizer from dropping the work. They differ between the
+    // two, as the scanner also reads flats and ranges and skips notes inside words.
+    long regexSum = 0;
+    const double regexTime = timePerFile(filenames, [&] {
+        regexSum = 0;
+        for (const auto& filename : filenames) {
+            const auto info = parseWithRegex(filename);
+            regexSum += info.rootNote + info.velocity;
+        }
+    });
+
+    long scanSum = 0;
+    const double scanTime = timePerFile(filenames, [&] {
+        scanSum = 0;
+        for (const auto& filename : filenames) {
+            const auto info = Aika::FilenameScanner::scan(filename);
+            scanSum += info.rootNote + info.velocity;
+        }
+    });
+
+    std::vector<Aika::FilenameInfo> results;
+    long batchSum = 0;
+    const double batchTime = timePerFile(filenames, [&] {
+        Aika::FilenameScanner::scanBatch(filenames, results);
+        batchSum = 0;
+        for (const auto& info : results)
+            batchSum += info.rootNote + info.velocity;
+    });
+
+    std::printf("%d filenames\n", count);
+    std::printf("  regex         %9.1f ns/file  (checksum %ld)\n", regexTime, regexSum);
+    std::printf("  scan          %9.1f ns/file  (checksum %ld)  %.1fx\n", scanTime, scanSum, regexTime / scanTime);
+    std::printf("  scanBatch     %9.1f ns/file  (checksum %ld)  %.1fx\n", batchTime, batchSum, regexTime / batchTime);
+    return 0;
+}
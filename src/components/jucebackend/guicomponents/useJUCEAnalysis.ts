@@ -1,4 +1,4 @@
-import { useEffect, useState, useRef } from 'react';
+import { useEffect, useState } from 'react';
 import { useJUCEBridge } from '@/hooks/useJUCEBridge';
 
 interface AnalysisData {
@@ -7,62 +7,51 @@ interface AnalysisData {
   timestamp: number;
 }
 
+// Frames arrive as base64 bytes: spectrum bands are 0..255 for -100..0 dB,
+// waveform points are signed bytes for -1..1
+function decodeFrame(encoding: string, data: string): Float32Array {
+  const binary = atob(data);
+  const values = new Float32Array(binary.length);
+
+  for (let i = 0; i < binary.length; i++) {
+    const byte = binary.charCodeAt(i);
+    values[i] = encoding === 'u8db'
+      ? (byte / 255) * 100 - 100
+      : (byte > 127 ? byte - 256 : byte) / 127;
+  }
+
+  return values;
+}
+
+// padId null analyses the master output
 export function useJUCEAnalysis(padId: number | null, analysisType: 'spectrum' | 'waveform' | 'both' = 'both') {
   const { bridge, isAvailable, isReady } = useJUCEBridge();
   const [analysisData, setAnalysisData] = useState<AnalysisData>({
-    spectrum: new Float32Array(1024),
-    waveform: new Float32Array(1024),
+    spectrum: new Float32Array(256),
+    waveform: new Float32Array(512),
     timestamp: 0
   });
-  const frameRef = useRef<number | null>(null);
-  const analysisIntervalRef = useRef<NodeJS.Timeout | null>(null);
 
   useEffect(() => {
     if (!isReady || !isAvailable) return;
 
-    // Setup event listener for analysis data from JUCE
+    // Setup event listener for analysis frames pushed by JUCE
     const removeListener = bridge.on('analysis', (message) => {
-      const { data, analysisType } = message;
-      
-      // Only update if it's for the current pad
-      if (padId === null || padId === message.padId) {
-        setAnalysisData(prev => ({
-          ...prev,
-          [analysisType]: new Float32Array(data),
-          timestamp: Date.now()
-        }));
-      }
+      if ((message.padId ?? null) !== padId) return;
+      if (analysisType !== 'both' && message.analysisType !== analysisType) return;
+
+      setAnalysisData(prev => ({
+        ...prev,
+        [message.analysisType]: decodeFrame(message.encoding, message.data),
+        timestamp: Date.now()
+      }));
     });
 
-    // Request analysis data periodically
-    if (padId !== null) {
-      if (analysisType === 'spectrum' || analysisType === 'both') {
-        bridge.requestAnalysis('spectrum', padId);
-      }
-      
-      if (analysisType === 'waveform' || analysisType === 'both') {
-        bridge.requestAnalysis('waveform', padId);
-      }
-      
-      analysisIntervalRef.current = setInterval(() => {
-        if (analysisType === 'spectrum' || analysisType === 'both') {
-          bridge.requestAnalysis('spectrum', padId);
-        }
-        
-        if (analysisType === 'waveform' || analysisType === 'both') {
-          bridge.requestAnalysis('waveform', padId);
-        }
-      }, 50); // Request every 50ms
-    }
+    bridge.subscribeAnalysis(padId);
 
     return () => {
       removeListener();
-      if (frameRef.current) {
-        cancelAnimationFrame(frameRef.current);
-      }
-      if (analysisIntervalRef.current) {
-        clearInterval(analysisIntervalRef.current);
-      }
+      bridge.unsubscribeAnalysis(padId);
     };
   }, [isReady, isAvailable, padId, analysisType, bridge]);
 
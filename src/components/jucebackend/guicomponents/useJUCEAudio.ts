@@ -45,14 +45,6 @@ export function useJUCEAudio() {
     return true;
   };
 
-  // Stop a sample using JUCE
-  const stopSample = (padId: number) => {
-    if (!isReady || !isAvailable) return false;
-    
-    bridge.stopSample(padId);
-    return true;
-  };
-
   // Update sample parameters in JUCE
   const updateParameter = (padId: number, parameter: keyof Sample, value: any) => {
     if (!isReady || !isAvailable || !loadedSamples.current.has(padId)) return false;
@@ -105,7 +97,6 @@ export function useJUCEAudio() {
     isJUCEAvailable: isAvailable && isReady,
     loadSample,
     playSample,
-    stopSample,
     updateParameter,
     clearPad
   };
@@ -0,0 +1,25 @@
+import { useEffect, useState } from 'react';
+import { useJUCEBridge } from '@/hooks/useJUCEBridge';
+
+// Pads whose samples are still streaming in after a project or preset was
+// restored. Their settings are already in place; only the audio is missing.
+export function useJUCEKitLoading() {
+  const { bridge, isAvailable, isReady } = useJUCEBridge();
+  const [loadingPads, setLoadingPads] = useState<number[]>([]);
+
+  useEffect(() => {
+    if (!isReady || !isAvailable) return;
+
+    const removeListener = bridge.on('kitLoading', (message) => {
+      setLoadingPads(message.data.pads);
+    });
+
+    return removeListener;
+  }, [isReady, isAvailable, bridge]);
+
+  return {
+    loadingPads,
+    isPadLoading: (padId: number) => loadingPads.includes(padId),
+    isKitLoading: loadingPads.length > 0
+  };
+}
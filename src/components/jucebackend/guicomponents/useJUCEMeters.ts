@@ -0,0 +1,45 @@
+import { useEffect, useState } from 'react';
+import { useJUCEBridge } from '@/hooks/useJUCEBridge';
+
+// Levels are linear gain; peaks are the highest since the previous update
+export interface MeterLevel {
+  peak: [number, number];
+  rms: [number, number];
+  truePeak: number;
+}
+
+export interface MeterLevels {
+  master: MeterLevel;
+  pads: MeterLevel[];
+}
+
+const silent: MeterLevel = { peak: [0, 0], rms: [0, 0], truePeak: 0 };
+
+export function gainToDecibels(gain: number, minusInfinityDb: number = -100): number {
+  return gain > 0 ? Math.max(minusInfinityDb, 20 * Math.log10(gain)) : minusInfinityDb;
+}
+
+export function useJUCEMeters() {
+  const { bridge, isAvailable, isReady } = useJUCEBridge();
+  const [levels, setLevels] = useState<MeterLevels>({ master: silent, pads: [] });
+
+  useEffect(() => {
+    if (!isReady || !isAvailable) return;
+
+    const removeListener = bridge.on('meters', (message) => {
+      setLevels(message.data);
+    });
+
+    bridge.subscribeMeters();
+
+    return () => {
+      removeListener();
+      bridge.unsubscribeMeters();
+    };
+  }, [isReady, isAvailable, bridge]);
+
+  return {
+    levels,
+    isMeteringAvailable: isReady && isAvailable
+  };
+}
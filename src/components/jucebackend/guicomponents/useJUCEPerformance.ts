@@ -0,0 +1,53 @@
+import { useEffect, useState } from 'react';
+import { useJUCEBridge } from '@/hooks/useJUCEBridge';
+import type { SampleStoreStats } from '@/lib/juce-bridge';
+
+// Load is render time over block time, so 1 means the audio callback only
+// just kept up; xruns counts the blocks that didn't since playback started
+export interface PerformanceSummary {
+  load: number;
+  peakLoad: number;
+  xruns: number;
+  tracing: boolean;
+  samples: SampleStoreStats;
+}
+
+const emptySummary: PerformanceSummary = {
+  load: 0,
+  peakLoad: 0,
+  xruns: 0,
+  tracing: false,
+  samples: { budgetBytes: 0, residentBytes: 0, derivedBytes: 0, resident: 0, evicted: 0, reloadMisses: 0 }
+};
+
+export function useJUCEPerformance() {
+  const { bridge, isAvailable, isReady } = useJUCEBridge();
+  const [summary, setSummary] = useState<PerformanceSummary>(emptySummary);
+  const [lastTracePath, setLastTracePath] = useState<string | null>(null);
+
+  useEffect(() => {
+    if (!isReady || !isAvailable) return;
+
+    const removePerformanceListener = bridge.on('performance', (message) => {
+      setSummary(message.data);
+    });
+    const removeTraceListener = bridge.on('traceSaved', (message) => {
+      setLastTracePath(message.data.saved ? message.data.path : null);
+    });
+
+    return () => {
+      removePerformanceListener();
+      removeTraceListener();
+    };
+  }, [isReady, isAvailable, bridge]);
+
+  return {
+    ...summary,
+    lastTracePath,
+    startTrace: () => bridge.startTrace(),
+    stopTrace: () => bridge.stopTrace(),
+    saveTrace: () => bridge.saveTrace(),
+    setSampleBudget: (megabytes: number) => bridge.setSampleBudget(megabytes),
+    purgeUnusedSamples: () => bridge.purgeUnusedSamples()
+  };
+}
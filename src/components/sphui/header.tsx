@@ -17,10 +17,23 @@ import { menuItems } from "@/data/menu";
 import { useViewContext } from "../../contexts/ViewContext";
 import { useState } from "react";
 import { Settings } from "@/components/settings";
+import { useJUCEPerformance } from "@/components/jucebackend/guicomponents/useJUCEPerformance";
+import { useJUCEBridge } from "@/hooks/useJUCEBridge";
+import LevelMeter from "./levelmeter";
 import {
     Dialog,
     DialogContent,
 } from "@/components/ui/dialog";
+import {
+    Popover,
+    PopoverContent,
+    PopoverTrigger,
+} from "@/components/ui/popover";
+
+// Sample memory budgets offered in the memory popover, in megabytes; 0 for none
+const sampleBudgets = [0, 256, 512, 1024, 2048];
+
+const formatMegabytes = (bytes: number) => `${Math.round(bytes / (1024 * 1024))} MB`;
 
 declare global {
     interface Window {
@@ -34,6 +47,8 @@ declare global {
 function Header() {
     const { isRackView, isDrumMachine, setIsRackView, setIsDrumMachine } = useViewContext();
     const [isSettingsOpen, setIsSettingsOpen] = useState(false);
+    const performance = useJUCEPerformance();
+    const { bridge } = useJUCEBridge();
 
     const handleMenuAction = (item: any) => {
         if (item.title === "Settings") {
@@ -43,6 +58,16 @@ function Header() {
 
         // Handle file operations
         switch (item.action) {
+            case 'openKit':
+                // The plugin asks for the file with a native chooser
+                bridge.openKit();
+                break;
+            case 'saveKit':
+                bridge.saveKit();
+                break;
+            case 'openInstrument':
+                bridge.loadInstrument();
+                break;
             case 'openOSMP':
             case 'openSF2':
             case 'openXML':
@@ -171,15 +196,84 @@ function Header() {
                         </button>
                     </div>
                     <div className="flex space-x-3 items-center">
-                        <div className="flex items-center space-x-1">
-                            <Cpu size={14} />
-                            <span>0%</span>
-                        </div>
+                        <LevelMeter />
+                        <Separator orientation="vertical" className="h-4 bg-zinc-800" />
+                        <Popover>
+                            <PopoverTrigger asChild>
+                                <button
+                                    className={`flex items-center space-x-1 uppercase ${performance.peakLoad > 1 ? 'text-red-500' : ''}`}
+                                    title={`Peak ${Math.round(performance.peakLoad * 100)}%, ${performance.xruns} xruns`}
+                                >
+                                    <Cpu size={14} />
+                                    <span>{Math.round(performance.load * 100)}%</span>
+                                    {performance.tracing && <span className="h-1.5 w-1.5 rounded-full bg-red-500" />}
+                                </button>
+                            </PopoverTrigger>
+                            <PopoverContent align="end" className="w-64 text-xs space-y-3">
+                                <div className="space-y-1">
+                                    <div className="flex justify-between"><span>Load</span><span>{Math.round(performance.load * 100)}%</span></div>
+                                    <div className="flex justify-between"><span>Peak load</span><span>{Math.round(performance.peakLoad * 100)}%</span></div>
+                                    <div className="flex justify-between"><span>Xruns</span><span>{performance.xruns}</span></div>
+                                </div>
+                                <div className="flex space-x-1">
+                                    <button
+                                        className="px-1 rounded hover:bg-white hover:text-black"
+                                        onClick={performance.tracing ? performance.stopTrace : performance.startTrace}
+                                    >
+                                        {performance.tracing ? 'Stop trace' : 'Start trace'}
+                                    </button>
+                                    <button className="px-1 rounded hover:bg-white hover:text-black" onClick={performance.saveTrace}>
+                                        Save trace
+                                    </button>
+                                </div>
+                                {performance.lastTracePath && (
+                                    <div className="break-all text-zinc-500" title="Open in Perfetto or chrome://tracing">
+                                        Saved to {performance.lastTracePath}
+                                    </div>
+                                )}
+                            </PopoverContent>
+                        </Popover>
                         <Separator orientation="vertical" className="h-4 bg-zinc-800" />
-                        <div className="flex items-center space-x-1">
-                            <MemoryStick size={14} />
-                            <span>0%</span>
-                        </div>
+                        <Popover>
+                            <PopoverTrigger asChild>
+                                <button
+                                    className={`flex items-center space-x-1 uppercase ${performance.samples.reloadMisses > 0 ? 'text-amber-500' : ''}`}
+                                    title={`${performance.samples.resident} samples in memory, ${performance.samples.evicted} evicted`}
+                                >
+                                    <MemoryStick size={14} />
+                                    <span>
+                                        {performance.samples.budgetBytes > 0
+                                            ? `${Math.round(performance.samples.residentBytes / performance.samples.budgetBytes * 100)}%`
+                                            : formatMegabytes(performance.samples.residentBytes)}
+                                    </span>
+                                </button>
+                            </PopoverTrigger>
+                            <PopoverContent align="end" className="w-64 text-xs space-y-3">
+                                <div className="space-y-1">
+                                    <div className="flex justify-between"><span>In memory</span><span>{formatMegabytes(performance.samples.residentBytes)}</span></div>
+                                    <div className="flex justify-between"><span>Rendered pads</span><span>{formatMegabytes(performance.samples.derivedBytes)}</span></div>
+                                    <div className="flex justify-between"><span>Samples evicted</span><span>{performance.samples.evicted} of {performance.samples.resident + performance.samples.evicted}</span></div>
+                                    <div className="flex justify-between"><span>Reload misses</span><span>{performance.samples.reloadMisses}</span></div>
+                                </div>
+                                <div className="space-y-1">
+                                    <div>Budget</div>
+                                    <div className="flex space-x-1">
+                                        {sampleBudgets.map((megabytes) => (
+                                            <button
+                                                key={megabytes}
+                                                className={`px-1 rounded ${performance.samples.budgetBytes === megabytes * 1024 * 1024 ? 'bg-white text-black' : 'hover:bg-white hover:text-black'}`}
+                                                onClick={() => performance.setSampleBudget(megabytes)}
+                                            >
+                                                {megabytes === 0 ? 'None' : megabytes >= 1024 ? `${megabytes / 1024} GB` : `${megabytes} MB`}
+                                            </button>
+                                        ))}
+                                    </div>
+                                </div>
+                                <button className="px-1 rounded hover:bg-white hover:text-black" onClick={performance.purgeUnusedSamples}>
+                                    Evict unplayed samples
+                                </button>
+                            </PopoverContent>
+                        </Popover>
                     </div>
                     <button className="flex items-center space-x-1 h-8">
                         <User size={14} />
@@ -0,0 +1,49 @@
+import React from 'react';
+import { useJUCEMeters, gainToDecibels, MeterLevel } from '@/components/jucebackend/guicomponents/useJUCEMeters';
+
+interface LevelMeterProps {
+  padId?: number;        // Omit for the master output
+  width?: number;
+  minDecibels?: number;
+}
+
+const LevelMeter: React.FC<LevelMeterProps> = ({
+  padId,
+  width = 64,
+  minDecibels = -60
+}) => {
+  const { levels, isMeteringAvailable } = useJUCEMeters();
+  const level: MeterLevel | undefined = padId === undefined ? levels.master : levels.pads[padId];
+
+  if (!isMeteringAvailable || !level) return null;
+
+  // Position on a dB scale, 0 - 100%
+  const toPercent = (gain: number) =>
+    Math.min(100, Math.max(0, (1 - gainToDecibels(gain, minDecibels) / minDecibels) * 100));
+
+  const truePeakDb = gainToDecibels(level.truePeak, minDecibels);
+  const clipping = level.truePeak > 1;
+
+  return (
+    <div
+      className="flex flex-col justify-center space-y-0.5"
+      style={{ width }}
+      title={`True peak ${truePeakDb <= minDecibels ? '-inf' : truePeakDb.toFixed(1)} dBTP`}
+    >
+      {[0, 1].map((channel) => (
+        <div key={channel} className="relative h-1 bg-zinc-800 rounded-sm overflow-hidden">
+          <div
+            className="absolute inset-y-0 left-0 bg-zinc-500"
+            style={{ width: `${toPercent(level.rms[channel])}%` }}
+          />
+          <div
+            className={`absolute inset-y-0 w-px ${clipping ? 'bg-red-500' : 'bg-zinc-200'}`}
+            style={{ left: `calc(${toPercent(level.peak[channel])}% - 1px)` }}
+          />
+        </div>
+      ))}
+    </div>
+  );
+};
+
+export default LevelMeter;
@@ -0,0 +1,238 @@
+#include "analyser.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+namespace {
+    constexpr float minDecibels = -100.0f;
+    constexpr float falloffPerFrame = 3.0f;   // dB a band may fall per frame, so bars decay smoothly
+    constexpr float lowestBandHz = 20.0f;
+}
+
+AnalysisTap::AnalysisTap(int capacity)
+    : fifo(capacity), ring(static_cast<size_t>(capacity), 0.0f) {
+}
+
+void AnalysisTap::push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept {
+    const int numChannels = std::min(2, buffer.getNumChannels());
+    if (numChannels == 0 || numSamples <= 0)
+        return;
+
+    if (fifo.getFreeSpace() < numSamples) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    const auto copySegment = [&](int ringStart, int size, int offset) {
+        if (size <= 0)
+            return;
+
+        float* dest = ring.data() + ringStart;
+        const float* left = buffer.getReadPointer(0, startSample + offset);
+        if (numChannels > 1) {
+            juce::FloatVectorOperations::copyWithMultiply(dest, left, 0.5f, size);
+            juce::FloatVectorOperations::addWithMultiply(dest, buffer.getReadPointer(1, startSample + offset), 0.5f, size);
+        } else {
+            juce::FloatVectorOperations::copy(dest, left, size);
+        }
+    };
+
+    copySegment(start1, size1, 0);
+    copySegment(start2, size2, size1);
+    fifo.finishedWrite(size1 + size2);
+}
+
+int AnalysisTap::pull(float* dest, int maxSamples) noexcept {
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(std::min(maxSamples, fifo.getNumReady()), start1, size1, start2, size2);
+
+    if (size1 > 0)
+        std::copy(ring.data() + start1, ring.data() + start1 + size1, dest);
+    if (size2 > 0)
+        std::copy(ring.data() + start2, ring.data() + start2 + size2, dest + size1);
+
+    fifo.finishedRead(size1 + size2);
+    return size1 + size2;
+}
+
+Analyser::Analyser()
+    : juce::Thread("Analyser"),
+      window(static_cast<size_t>(fftSize)),
+      pulled(static_cast<size_t>(fftSize) * 8) {
+    float windowSum = 0.0f;
+    for (int i = 0; i < fftSize; ++i) {
+        window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * static_cast<float>(i) / fftSize);
+        windowSum += window[static_cast<size_t>(i)];
+    }
+    magnitudeScale = 2.0f / windowSum;
+
+    for (auto& source : sources)
+        source.smoothedBands.fill(minDecibels);
+
+    prepare(44100.0);
+    startThread();
+}
+
+Analyser::~Analyser() {
+    stopThread(1000);
+}
+
+void Analyser::prepare(double sampleRate) {
+    const juce::ScopedLock lock(analysisLock);
+
+    // Log-spaced band edges from 20 Hz to Nyquist, in FFT bins
+    const double nyquist = sampleRate * 0.5;
+    const int lastBin = fft.getNumBins() - 1;
+    for (int band = 0; band <= numBands; ++band) {
+        const double frequency = lowestBandHz * std::pow(nyquist / lowestBandHz, static_cast<double>(band) / numBands);
+        bandEdges[static_cast<size_t>(band)] = juce::jlimit(1, lastBin, static_cast<int>(std::lround(frequency * fftSize / sampleRate)));
+    }
+}
+
+void Analyser::pushMaster(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept {
+    auto& source = sources[static_cast<size_t>(getIndex(masterTap))];
+    if (source.subscribers.load(std::memory_order_relaxed) > 0)
+        source.tap.push(buffer, startSample, numSamples);
+}
+
+void Analyser::pushPad(int padId, const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept {
+    if (isPadSubscribed(padId))
+        sources[static_cast<size_t>(getIndex(padId))].tap.push(buffer, startSample, numSamples);
+}
+
+bool Analyser::isPadSubscribed(int padId) const noexcept {
+    return padId >= 0 && padId < Kit::numPads
+        && (subscribedPads.load(std::memory_order_relaxed) & (1u << padId)) != 0;
+}
+
+void Analyser::setSubscribed(int tap, bool subscribe) {
+    const int index = getIndex(tap);
+    if (index < 0 || index >= numTaps)
+        return;
+
+    auto& subscribers = sources[static_cast<size_t>(index)].subscribers;
+    const int count = std::max(0, subscribers.load() + (subscribe ? 1 : -1));
+    subscribers.store(count);
+
+    if (tap != masterTap) {
+        if (count > 0)
+            subscribedPads.fetch_or(1u << tap);
+        else
+            subscribedPads.fetch_and(~(1u << tap));
+    }
+
+    // Wake the analysis thread, which sleeps while nothing is subscribed
+    if (count > 0)
+        notify();
+}
+
+void Analyser::clearSubscriptions() {
+    for (auto& source : sources)
+        source.subscribers.store(0);
+    subscribedPads.store(0);
+}
+
+bool Analyser::getLatestFrame(int tap, juce::uint32 lastSequence, Frame& frame) const {
+    const int index = getIndex(tap);
+    if (index < 0 || index >= numTaps)
+        return false;
+
+    const juce::ScopedLock lock(frameLock);
+    const auto& latest = sources[static_cast<size_t>(index)].frame;
+    if (latest.sequence == 0 || latest.sequence == lastSequence)
+        return false;
+
+    frame = latest;
+    return true;
+}
+
+void Analyser::run() {
+    const int frameIntervalMs = 1000 / frameRateHz;
+
+    while (!threadShouldExit()) {
+        if (!hasSubscribers()) {
+            wait(-1);
+            continue;
+        }
+
+        const auto started = juce::Time::getMillisecondCounter();
+
+        {
+            const juce::ScopedLock lock(analysisLock);
+            for (auto& source : sources) {
+                if (source.subscribers.load(std::memory_order_relaxed) > 0)
+                    analyse(source);
+            }
+        }
+
+        const auto elapsed = static_cast<int>(juce::Time::getMillisecondCounter() - started);
+        wait(std::max(1, frameIntervalMs - elapsed));
+    }
+}
+
+bool Analyser::hasSubscribers() const noexcept {
+    return std::any_of(sources.begin(), sources.end(), [](const Source& source) {
+        return source.subscribers.load(std::memory_order_relaxed) > 0;
+    });
+}
+
+void Analyser::analyse(Source& source) {
+    // Drain the tap, keeping the newest fftSize samples
+    auto& history = source.history;
+    int received = 0;
+    for (int count; (count = source.tap.pull(pulled.data(), static_cast<int>(pulled.size()))) > 0; received += count) {
+        if (count >= fftSize) {
+            std::copy(pulled.begin() + (count - fftSize), pulled.begin() + count, history.begin());
+        } else {
+            std::copy(history.begin() + count, history.end(), history.begin());
+            std::copy(pulled.begin(), pulled.begin() + count, history.end() - count);
+        }
+    }
+
+    if (received == 0)
+        return;
+
+    Frame frame;
+
+    // Spectrum: peak magnitude per band, with a falloff so bars decay smoothly
+    float* timeData = fft.getTimeData();
+    for (int i = 0; i < fftSize; ++i)
+        timeData[i] = history[static_cast<size_t>(i)] * window[static_cast<size_t>(i)];
+    fft.forward();
+
+    const auto* spectrum = fft.getSpectrum();
+    for (int band = 0; band < numBands; ++band) {
+        const int first = bandEdges[static_cast<size_t>(band)];
+        const int last = std::max(first + 1, bandEdges[static_cast<size_t>(band) + 1]);
+
+        float peak = 0.0f;
+        for (int bin = first; bin < last; ++bin)
+            peak = std::max(peak, std::norm(spectrum[bin]));
+
+        const float decibels = juce::Decibels::gainToDecibels(std::sqrt(peak) * magnitudeScale, minDecibels);
+        auto& smoothed = source.smoothedBands[static_cast<size_t>(band)];
+        smoothed = std::max(decibels, smoothed - falloffPerFrame);
+
+        // Levels above 0 dBFS (output gain, stacked voices) pin at the top rather than wrapping
+        frame.spectrum[static_cast<size_t>(band)] = static_cast<juce::uint8>(juce::jlimit(0L, 255L, std::lround((smoothed - minDecibels) / -minDecibels * 255.0f)));
+    }
+
+    // Waveform: the newest 2 * waveformPoints samples, keeping the larger peak of each pair
+    const float* recent = history.data() + fftSize - 2 * waveformPoints;
+    for (int point = 0; point < waveformPoints; ++point) {
+        const float a = recent[2 * point];
+        const float b = recent[2 * point + 1];
+        const float value = std::abs(a) >= std::abs(b) ? a : b;
+        frame.waveform[static_cast<size_t>(point)] = static_cast<juce::int8>(std::lround(juce::jlimit(-1.0f, 1.0f, value) * 127.0f));
+    }
+
+    const juce::ScopedLock lock(frameLock);
+    frame.sequence = source.frame.sequence + 1;
+    source.frame = frame;
+}
+
+} // namespace Aika
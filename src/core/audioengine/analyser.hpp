@@ -0,0 +1,161 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "core/dsp/fft/fft.hpp"
+#include "core/sampler/kit.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Single-producer, single-consumer ring of mono audio, written by the audio
+ * thread and read by the analysis thread. Lock and allocation free.
+ */
+class AnalysisTap {
+public:
+    explicit AnalysisTap(int capacity);
+
+    /**
+     * Mix a block down to mono and append it. If the reader has fallen
+     * behind, the block is dropped rather than blocking the audio thread.
+     *
+     * @param buffer Source buffer
+     * @param startSample First sample to copy
+     * @param numSamples Number of samples
+     */
+    void push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    /**
+     * Read up to maxSamples of the oldest queued audio
+     *
+     * @param dest Destination
+     * @param maxSamples Capacity of dest
+     * @return Number of samples read
+     */
+    int pull(float* dest, int maxSamples) noexcept;
+
+    juce::uint32 getNumOverruns() const noexcept { return overruns.load(std::memory_order_relaxed); }
+
+private:
+    juce::AbstractFifo fifo;
+    std::vector<float> ring;
+    std::atomic<juce::uint32> overruns { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(AnalysisTap)
+};
+
+/**
+ * Spectrum and waveform analysis of the master output and of each pad.
+ *
+ * The audio thread only copies into the taps of subscribed sources. A
+ * background thread computes frames at a fixed rate with fftw and keeps
+ * the latest one per source, and sleeps while nothing is subscribed; the UI picks those up without ever asking
+ * the audio thread for anything.
+ *
+ * Frames are compact: the spectrum is numBands log-spaced bands of
+ * 0 - 255 (-100 dB to 0 dB), the waveform is waveformPoints peak-preserving
+ * points of -127 - 127.
+ */
+class Analyser : private juce::Thread {
+public:
+    static constexpr int masterTap = -1;
+    static constexpr int numTaps = Kit::numPads + 1;
+    static constexpr int fftSize = 2048;
+    static constexpr int numBands = 256;
+    static constexpr int waveformPoints = 512;
+    static constexpr int frameRateHz = 30;
+
+    struct Frame {
+        juce::uint32 sequence = 0;   // Increments with each new frame, 0 before the first
+        std::array<juce::uint8, numBands> spectrum {};
+        std::array<juce::int8, waveformPoints> waveform {};
+    };
+
+    Analyser();
+    ~Analyser() override;
+
+    /**
+     * Set the sample rate used to place the spectrum bands. Not for the audio thread.
+     */
+    void prepare(double sampleRate);
+
+    /**
+     * Copy master output into the master tap, if anyone is subscribed. Audio thread.
+     */
+    void pushMaster(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    /**
+     * Copy one pad's output into its tap. Audio thread.
+     */
+    void pushPad(int padId, const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    /**
+     * @return True if the pad's tap has subscribers, so its voices should be rendered separately
+     */
+    bool isPadSubscribed(int padId) const noexcept;
+
+    /**
+     * @return True if any pad tap has subscribers
+     */
+    bool hasPadSubscribers() const noexcept { return subscribedPads.load(std::memory_order_relaxed) != 0; }
+
+    /**
+     * Start or stop analysing a source. Subscriptions are counted, so several
+     * views can watch the same source.
+     *
+     * @param tap A pad id, or masterTap
+     * @param subscribe True to add a subscriber, false to remove one
+     */
+    void setSubscribed(int tap, bool subscribe);
+
+    /**
+     * Remove every subscription, e.g. when the editor closes
+     */
+    void clearSubscriptions();
+
+    /**
+     * Copy the latest frame of a source if it is newer than one already seen
+     *
+     * @param tap A pad id, or masterTap
+     * @param lastSequence Sequence number of the frame the caller already has
+     * @param frame Receives the frame
+     * @return True if a newer frame was copied
+     */
+    bool getLatestFrame(int tap, juce::uint32 lastSequence, Frame& frame) const;
+
+private:
+    struct Source {
+        Source() : tap(fftSize * 8) {}
+
+        AnalysisTap tap;
+        std::atomic<int> subscribers { 0 };
+        std::vector<float> history = std::vector<float>(fftSize, 0.0f);  // Most recent fftSize samples
+        std::array<float, numBands> smoothedBands {};
+        Frame frame;
+    };
+
+    void run() override;
+    bool hasSubscribers() const noexcept;
+    void analyse(Source& source);
+    static int getIndex(int tap) noexcept { return tap + 1; }
+
+    std::array<Source, numTaps> sources;
+    std::atomic<juce::uint32> subscribedPads { 0 };  // Bit per pad
+
+    // Analysis-thread state, guarded by analysisLock against prepare()
+    DSP::RealFFT fft { fftSize };
+    std::vector<float> window;
+    std::vector<float> pulled;
+    std::array<int, numBands + 1> bandEdges {};
+    float magnitudeScale = 1.0f;
+    juce::CriticalSection analysisLock;
+
+    mutable juce::CriticalSection frameLock;
+
+    JUCE_DECLARE_NON_COPYABLE(Analyser)
+};
+
+} // namespace Aika
@@ -0,0 +1,533 @@
+#include "engine.hpp"
+#include "core/platform/tracer.hpp"
+#include <algorithm>
+
+namespace Aika {
+
+namespace {
+
+Region makePadRegion(const Pad& pad, const std::shared_ptr<const Sample>& sample) {
+    const auto& settings = pad.settings;
+    const double sourceRate = sample->getSampleRate();
+
+    Region region;
+    region.sample = sample;
+    region.id = pad.id;
+    region.padId = pad.id;
+    region.pitchKeycenter = settings.midiNote;
+    region.gain = settings.volume;
+    region.offset = static_cast<int>(settings.start * sourceRate);
+    region.end = settings.end > 0.0 ? std::max(1, static_cast<int>(settings.end * sourceRate)) : 0;
+    region.attack = settings.attack;
+    region.release = settings.release;
+    region.group = settings.chokeGroup;
+    region.offBy = settings.chokeGroup;
+    return region;
+}
+
+// A derived sample holds just the region, already edited, at the host tempo and output rate
+Region makeDerivedRegion(const Pad& pad, const std::shared_ptr<const Sample>& derived) {
+    auto region = makePadRegion(pad, derived);
+    region.offset = 0;
+    region.end = 0;
+    return region;
+}
+
+// A sample evicted to its preload head still has the same audio
+bool isSameAudio(const std::shared_ptr<const Sample>& a, const std::shared_ptr<const Sample>& b) {
+    return a == b || (a != nullptr && b != nullptr && a->getAudioId() == b->getAudioId());
+}
+
+bool hasSameSamples(const Pad& a, const Pad& b) {
+    return isSameAudio(a.sample, b.sample) && std::equal(a.layers.begin(), a.layers.end(), b.layers.begin(), b.layers.end(),
+                                                         [](const PadLayer& x, const PadLayer& y) { return isSameAudio(x.sample, y.sample); });
+}
+
+// Whether two pads' regions render to the same derived samples at any one tempo and rate
+bool rendersAlike(const Pad& a, const Pad& b) {
+    const auto& x = a.settings;
+    const auto& y = b.settings;
+    return hasSameSamples(a, b)
+        && x.start == y.start && x.end == y.end && x.syncBeats == y.syncBeats
+        && x.reverse == y.reverse && x.normalize == y.normalize && x.fadeIn == y.fadeIn && x.fadeOut == y.fadeOut;
+}
+
+} // namespace
+
+SamplerEngine::SamplerEngine() {
+    for (auto& program : programStates)
+        program.store(nullptr);
+    for (auto& epoch : voiceEpochs)
+        epoch.store(0);
+
+    const juce::ScopedLock lock(writerLock);
+    currentState.store(createState(std::make_shared<Kit>(), nullptr));
+}
+
+SamplerEngine::~SamplerEngine() {
+}
+
+void SamplerEngine::prepare(double newSampleRate, int maximumBlockSize) {
+    sampleRate = newSampleRate;
+    padBuffer.setSize(2, maximumBlockSize);
+    for (auto& meter : padMeters)
+        meter.prepare(sampleRate);
+    for (auto& gains : padGains) {
+        for (auto& gain : gains)
+            gain.prepare(sampleRate);
+    }
+    reset();
+}
+
+const SamplerEngine::State* SamplerEngine::createState(std::shared_ptr<const Kit> newKit, std::shared_ptr<const Instrument> newInstrument,
+                                                      DerivedSamples derivedSamples) {
+    auto state = std::make_unique<State>();
+    state->kit = std::move(newKit);
+    state->instrument = std::move(newInstrument);
+    state->derivedSamples = std::move(derivedSamples);
+    for (const auto& pad : state->kit->pads) {
+        if (!pad.layers.empty())
+            state->padLayers[static_cast<size_t>(pad.id)] = PadLayerMap(pad);
+    }
+    state->epoch = nextEpoch++;
+
+    states.push_back(std::move(state));
+    return states.back().get();
+}
+
+void SamplerEngine::setKit(std::shared_ptr<const Kit> newKit) {
+    jassert(newKit != nullptr);
+
+    const juce::ScopedLock lock(writerLock);
+
+    // The audio thread may switch programs while the state is built; the kit is
+    // then set over the program's state instead, the same as if it came later
+    const State* current = currentState.load();
+    for (;;) {
+        // Renders stay valid for pads still playing the same sample with the same edits
+        DerivedSamples derived;
+        for (size_t i = 0; i < derived.size(); ++i) {
+            if (current->derivedSamples[i] != DerivedPad {} && rendersAlike(current->kit->pads[i], newKit->pads[i]))
+                derived[i] = current->derivedSamples[i];
+        }
+
+        const State* replacement = createState(newKit, current->instrument, std::move(derived));
+        if (currentState.compare_exchange_strong(current, replacement))
+            break;
+    }
+    collectGarbageLocked();
+}
+
+std::shared_ptr<const Kit> SamplerEngine::getKit() const {
+    // States are only freed with writerLock held, so the current one stays valid here
+    // even if the audio thread switches programs meanwhile
+    const juce::ScopedLock lock(writerLock);
+    return currentState.load()->kit;
+}
+
+void SamplerEngine::setInstrument(std::shared_ptr<const Instrument> newInstrument) {
+    const juce::ScopedLock lock(writerLock);
+
+    // The instrument is layered over every kit, including those waiting for a program change
+    for (auto& program : programStates) {
+        if (const State* programState = program.load())
+            program.store(createState(programState->kit, newInstrument));
+    }
+
+    // As in setKit, a program the audio thread switches to meanwhile gets the instrument too
+    const State* current = currentState.load();
+    for (;;) {
+        const State* replacement = createState(current->kit, newInstrument, current->derivedSamples);
+        if (currentState.compare_exchange_strong(current, replacement))
+            break;
+    }
+    collectGarbageLocked();
+}
+
+size_t SamplerEngine::getDerivedBytes() const {
+    const juce::ScopedLock lock(writerLock);
+    std::vector<const Sample*> counted;
+    size_t bytes = 0;
+    const auto count = [&](const std::shared_ptr<const Sample>& sample) {
+        if (sample != nullptr && std::find(counted.begin(), counted.end(), sample.get()) == counted.end()) {
+            counted.push_back(sample.get());
+            bytes += sample->getSizeInBytes();
+        }
+    };
+
+    for (const auto& derived : currentState.load()->derivedSamples) {
+        count(derived.sample);
+        for (const auto& layer : derived.layers)
+            count(layer);
+    }
+    return bytes;
+}
+
+std::shared_ptr<const Instrument> SamplerEngine::getInstrument() const {
+    const juce::ScopedLock lock(writerLock);
+    return currentState.load()->instrument;
+}
+
+void SamplerEngine::setProgramKit(int program, std::shared_ptr<const Kit> programKit) {
+    jassert(program >= 0 && program < numPrograms);
+
+    const juce::ScopedLock lock(writerLock);
+    auto& slot = programStates[static_cast<size_t>(program)];
+    slot.store(programKit != nullptr ? createState(std::move(programKit), currentState.load()->instrument) : nullptr);
+    collectGarbageLocked();
+}
+
+bool SamplerEngine::setDerivedSamples(const std::shared_ptr<const Kit>& kit, DerivedSamples samples) {
+    const juce::ScopedLock lock(writerLock);
+    const State* current = currentState.load();
+    if (current->kit != kit)
+        return false;
+    if (current->derivedSamples == samples)
+        return true;
+
+    // A program change on the audio thread meanwhile wins; the new state is then collected unused
+    const State* derived = createState(current->kit, current->instrument, std::move(samples));
+    const bool replaced = currentState.compare_exchange_strong(current, derived);
+    collectGarbageLocked();
+    return replaced;
+}
+
+void SamplerEngine::collectGarbage() {
+    const juce::ScopedLock lock(writerLock);
+    collectGarbageLocked();
+}
+
+void SamplerEngine::collectGarbageLocked() {
+    // Reachable states first, then the hazard pointer, then the voices. The audio
+    // thread publishes in the opposite order (voice epochs before it moves the
+    // hazard pointer on), so anything it was still reading shows up in one of them.
+    std::vector<const State*> inUse;
+    inUse.reserve(numPrograms + 2);
+    inUse.push_back(currentState.load());
+    for (const auto& program : programStates) {
+        if (const State* programState = program.load())
+            inUse.push_back(programState);
+    }
+    inUse.push_back(hazard.load());
+
+    std::array<juce::uint64, maxVoices> epochs;
+    for (size_t i = 0; i < epochs.size(); ++i)
+        epochs[i] = voiceEpochs[i].load();
+
+    states.erase(std::remove_if(states.begin(), states.end(), [&](const std::unique_ptr<State>& state) {
+        return std::find(inUse.begin(), inUse.end(), state.get()) == inUse.end()
+            && std::find(epochs.begin(), epochs.end(), state->epoch) == epochs.end();
+    }), states.end());
+}
+
+const SamplerEngine::State* SamplerEngine::acquireState(const std::atomic<const State*>& source) noexcept {
+    // Publish the pointer, then check it is still the one in source: if it is, a
+    // writer that replaced it afterwards is guaranteed to see the hazard pointer
+    const State* state = source.load();
+    for (;;) {
+        hazard.store(state);
+        const State* check = source.load();
+        if (check == state)
+            return state;
+        state = check;
+    }
+}
+
+void SamplerEngine::setPadGains(int padId, float leftGain, float rightGain) noexcept {
+    auto& gains = padGains[static_cast<size_t>(padId)];
+    gains[0].setTarget(leftGain);
+    gains[1].setTarget(rightGain);
+}
+
+void SamplerEngine::getPadNotes(std::array<int, Kit::numPads>& notes) noexcept {
+    const State* state = acquireState(currentState);
+    for (size_t i = 0; i < notes.size(); ++i)
+        notes[i] = state->kit->pads[i].settings.midiNote;
+    hazard.store(nullptr);
+}
+
+void SamplerEngine::addNoteEvent(const NoteEvent& event) noexcept {
+    if (numNoteEvents < maxNoteEvents)
+        noteEvents[static_cast<size_t>(numNoteEvents++)] = event;
+}
+
+void SamplerEngine::reset() {
+    for (auto& voice : voices)
+        voice.reset();
+    for (auto& epoch : voiceEpochs)
+        epoch.store(0);
+}
+
+void SamplerEngine::process(juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midiMessages) {
+    AIKA_TRACE_SCOPE("engine");
+    const State* state = acquireState(currentState);
+    const int numSamples = buffer.getNumSamples();
+    int renderedUpTo = 0;
+
+    // Render up to each event, then apply it, so timing is sample accurate.
+    // Queued note events merge with the MIDI, after MIDI at the same position.
+    int nextNoteEvent = 0;
+    const auto applyNoteEventsBefore = [&](int position) {
+        for (; nextNoteEvent < numNoteEvents; ++nextNoteEvent) {
+            const auto& event = noteEvents[static_cast<size_t>(nextNoteEvent)];
+            const int eventPosition = juce::jlimit(renderedUpTo, numSamples, event.sampleOffset);
+            if (eventPosition >= position)
+                break;
+
+            renderVoices(buffer, renderedUpTo, eventPosition - renderedUpTo);
+            renderedUpTo = eventPosition;
+            handleNoteEvent(*state, event);
+        }
+    };
+
+    for (const auto metadata : midiMessages) {
+        const int eventPosition = juce::jlimit(0, numSamples, metadata.samplePosition);
+        applyNoteEventsBefore(eventPosition);
+        renderVoices(buffer, renderedUpTo, eventPosition - renderedUpTo);
+        renderedUpTo = eventPosition;
+
+        handleMidiEvent(state, metadata.getMessage());
+    }
+
+    applyNoteEventsBefore(numSamples + 1);
+    numNoteEvents = 0;
+
+    renderVoices(buffer, renderedUpTo, numSamples - renderedUpTo);
+
+    // Voices that ended no longer hold their state, which can be freed once
+    // the hazard pointer has moved on as well
+    for (size_t i = 0; i < voices.size(); ++i) {
+        if (!voices[i].isActive() && voiceEpochs[i].load(std::memory_order_relaxed) != 0)
+            voiceEpochs[i].store(0);
+    }
+    hazard.store(nullptr);
+}
+
+void SamplerEngine::handleMidiEvent(const State*& state, const juce::MidiMessage& message) {
+    if (message.isProgramChange()) {
+        // Preloaded kits switch instantly; programs without one are ignored
+        const auto& program = programStates[static_cast<size_t>(message.getProgramChangeNumber())];
+        if (program.load() == nullptr)
+            return;
+
+        const State* programState = acquireState(program);
+        if (programState == nullptr) {
+            // Cleared in the meantime; keep playing the current state
+            state = acquireState(currentState);
+            return;
+        }
+
+        currentState.store(programState);
+        state = programState;
+    } else if (message.isNoteOn()) {
+        noteOn(*state, message.getNoteNumber(), message.getFloatVelocity(), -1);
+    } else if (message.isNoteOff()) {
+        noteOff(message.getNoteNumber());
+    } else if (message.isAllNotesOff() || message.isAllSoundOff()) {
+        for (auto& voice : voices)
+            voice.choke();
+    }
+}
+
+void SamplerEngine::handleNoteEvent(const State& state, const NoteEvent& event) {
+    using Type = NoteEvent::Type;
+
+    if (event.type == Type::NoteOn) {
+        if (event.key >= 0 && event.key < Instrument::numNotes)
+            noteOn(state, event.key, event.velocity, event.noteId);
+        return;
+    }
+
+    for (auto& voice : voices) {
+        if (!voice.isActive()
+            || (event.noteId >= 0 && voice.getNoteId() != event.noteId)
+            || (event.key >= 0 && voice.getMidiNote() != event.key))
+            continue;
+
+        if (event.type == Type::NoteOff) {
+            voice.release();
+        } else if (event.type == Type::Choke) {
+            voice.choke();
+        } else {
+            float volume = voice.getVolumeExpression();
+            float pan = voice.getPanExpression();
+            float semitones = voice.getTuningExpression();
+
+            if (event.expression == NoteEvent::Expression::Volume)
+                volume = juce::jlimit(0.0f, 4.0f, event.value);
+            else if (event.expression == NoteEvent::Expression::Pan)
+                pan = juce::jlimit(-1.0f, 1.0f, event.value * 2.0f - 1.0f);
+            else
+                semitones = event.value;
+
+            voice.setExpression(volume, pan, semitones);
+        }
+    }
+}
+
+void SamplerEngine::noteOn(const State& state, int note, float velocity, int noteId) {
+    const Kit& currentKit = *state.kit;
+    const Instrument* currentInstrument = state.instrument.get();
+    const auto layers = currentInstrument != nullptr
+                      ? currentInstrument->findRegions(note, juce::jlimit(1, 127, juce::roundToInt(velocity * 127.0f)),
+                                                       roundRobinCounters[static_cast<size_t>(note)]++)
+                      : Instrument::Layers {};
+
+    // Choke first, so layers started by the same note-on don't cut each other off
+    for (const auto& pad : currentKit.pads) {
+        if (pad.sample != nullptr && pad.settings.midiNote == note)
+            chokeGroup(pad.settings.chokeGroup);
+    }
+    for (const auto index : layers)
+        chokeGroup(currentInstrument->getRegion(index).group);
+
+    for (const auto& pad : currentKit.pads) {
+        if (pad.sample != nullptr && pad.settings.midiNote == note)
+            startPad(state, pad, note, velocity, noteId);
+    }
+    for (const auto index : layers)
+        startVoice(state, currentInstrument->getRegion(index), note, velocity, noteId);
+}
+
+void SamplerEngine::startPad(const State& state, const Pad& pad, int midiNote, float velocity, int noteId) {
+    const auto& layerMap = state.padLayers[static_cast<size_t>(pad.id)];
+    const auto& derived = state.derivedSamples[static_cast<size_t>(pad.id)];
+    if (pad.layers.empty() || layerMap.isEmpty()) {
+        // A derived voice plays a render; the kit's sample is what the sample store keeps
+        if (derived.sample != nullptr)
+            pad.sample->markPlayed();
+        startVoice(state, derived.sample != nullptr ? makeDerivedRegion(pad, derived.sample) : makePadRegion(pad, pad.sample),
+                   midiNote, velocity, noteId);
+        return;
+    }
+
+    // Each velocity range of the cell plays its next round-robin sample, crossfaded with its neighbour
+    auto& counters = padRoundRobinCounters[static_cast<size_t>(pad.id)];
+    const auto& cell = layerMap.getCell(juce::jlimit(1, 127, juce::roundToInt(velocity * 127.0f)));
+    for (int i = 0; i < cell.count; ++i) {
+        const int group = cell.groups[static_cast<size_t>(i)];
+        const auto index = static_cast<size_t>(layerMap.getLayer(group, counters[static_cast<size_t>(group)]++));
+        const bool hasDerived = index < derived.layers.size() && derived.layers[index] != nullptr;
+        if (hasDerived)
+            pad.layers[index].sample->markPlayed();
+
+        auto region = hasDerived ? makeDerivedRegion(pad, derived.layers[index]) : makePadRegion(pad, pad.layers[index].sample);
+        region.gain *= cell.gains[static_cast<size_t>(i)];
+        startVoice(state, region, midiNote, velocity, noteId);
+    }
+}
+
+void SamplerEngine::startVoice(const State& state, const Region& region, int midiNote, float velocity, int noteId) {
+    // A stolen voice drops its old sample while its old epoch is still recorded,
+    // so the audio thread never releases the last reference to anything
+    auto& voice = findFreeVoice();
+    region.sample->markPlayed();
+    voice.start(region, midiNote, velocity, sampleRate, ++voiceCounter, noteId);
+    voiceEpochs[static_cast<size_t>(&voice - voices.data())].store(state.epoch);
+}
+
+void SamplerEngine::chokeGroup(int group) {
+    // Starting a region in a group silences every voice that is "off by" that group;
+    // pads use their choke group for both, so a pad silences the rest of its group
+    if (group <= 0)
+        return;
+
+    for (auto& voice : voices) {
+        if (voice.isActive() && voice.getOffBy() == group)
+            voice.choke();
+    }
+}
+
+void SamplerEngine::noteOff(int midiNote) {
+    for (auto& voice : voices) {
+        if (voice.isActive() && voice.getMidiNote() == midiNote)
+            voice.release();
+    }
+}
+
+SamplerVoice& SamplerEngine::findFreeVoice() {
+    SamplerVoice* oldest = &voices.front();
+
+    for (auto& voice : voices) {
+        if (!voice.isActive())
+            return voice;
+
+        // Prefer stealing voices that are already fading out
+        const bool better = voice.isReleasing() != oldest->isReleasing()
+                          ? voice.isReleasing()
+                          : voice.getOrder() < oldest->getOrder();
+        if (better)
+            oldest = &voice;
+    }
+
+    return *oldest;
+}
+
+void SamplerEngine::renderVoices(juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+    if (numSamples <= 0)
+        return;
+
+    // Blocks longer than prepare() promised are rendered in pieces that fit padBuffer
+    const int maxChunk = padBuffer.getNumSamples();
+    if (maxChunk > 0 && numSamples > maxChunk) {
+        for (int offset = 0; offset < numSamples; offset += maxChunk)
+            renderVoices(buffer, startSample + offset, std::min(maxChunk, numSamples - offset));
+        return;
+    }
+
+    float* const* scratchChannels = scratch.getArrayOfWritePointers();
+
+    // Pads render one at a time through padBuffer, so each can have its own
+    // gain and be metered and analysed on its own. Silent pads cost nothing.
+    const bool isolatePads = maxChunk > 0;
+    if (isolatePads) {
+        const int numOutputChannels = buffer.getNumChannels();
+
+        juce::uint32 activePads = 0;
+        for (const auto& voice : voices) {
+            if (voice.isActive() && voice.getPadId() >= 0)
+                activePads |= 1u << voice.getPadId();
+        }
+
+        for (int padId = 0; padId < Kit::numPads; ++padId) {
+            auto& meter = padMeters[static_cast<size_t>(padId)];
+            const bool isActive = (activePads & (1u << padId)) != 0;
+            const bool isAnalysed = analyser != nullptr && analyser->isPadSubscribed(padId);
+
+            auto& gains = padGains[static_cast<size_t>(padId)];
+
+            if (!isActive && !isAnalysed) {
+                meter.processSilence(numSamples);
+                gains[0].skip(numSamples);
+                gains[1].skip(numSamples);
+                continue;
+            }
+
+            AIKA_TRACE_SCOPE("pad");
+            padBuffer.clear(0, numSamples);
+            for (auto& voice : voices) {
+                if (voice.isActive() && voice.getPadId() == padId)
+                    voice.render(padBuffer, 0, numSamples, scratchChannels, scratchFrames);
+            }
+
+            float* const* padChannels = padBuffer.getArrayOfWritePointers();
+            gains[0].process(padChannels, 1, numSamples);
+            gains[1].process(padChannels + 1, 1, numSamples);
+
+            meter.process(padBuffer, 0, numSamples);
+            if (isAnalysed)
+                analyser->pushPad(padId, padBuffer, 0, numSamples);
+
+            // A mono output takes the left channel only, as a voice rendering into it directly does
+            for (int channel = 0; channel < std::min(padBuffer.getNumChannels(), numOutputChannels); ++channel)
+                buffer.addFrom(channel, startSample, padBuffer, channel, 0, numSamples);
+        }
+    }
+
+    for (auto& voice : voices) {
+        if (voice.isActive() && !(isolatePads && voice.getPadId() >= 0))
+            voice.render(buffer, startSample, numSamples, scratchChannels, scratchFrames);
+    }
+}
+
+} // namespace Aika
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "core/sampler/kit.hpp"
+#include "core/sampler/instrument.hpp"
+#include "voice.hpp"
+#include "analyser.hpp"
+#include "meter.hpp"
+#include "core/dsp/mixer/mixer.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Polyphonic sampler: maps MIDI notes to kit pads and to the regions of an
+ * optional multi-sampled instrument, and mixes a fixed pool of voices.
+ * MIDI events, and note events from hosts that address voices by note id,
+ * are applied at their exact sample position.
+ *
+ * The kit and instrument are published to the audio thread as one immutable
+ * state behind an atomic pointer, so swapping kits never blocks or allocates
+ * there. Replaced states are freed off the audio thread, once the audio
+ * thread is no longer reading them and every voice started from them has
+ * ended: the audio thread announces the state it is reading (a hazard
+ * pointer) and the state each voice plays from (its epoch).
+ */
+class SamplerEngine {
+public:
+    static constexpr int maxVoices = 32;
+    static constexpr int numPrograms = 128;
+
+    /**
+     * A pad's regions rendered with its edits, tempo sync and conversion to
+     * the output rate. Null entries play from the pad's own samples.
+     */
+    struct DerivedPad {
+        std::shared_ptr<const Sample> sample;                // For a pad without layers
+        std::vector<std::shared_ptr<const Sample>> layers;   // One per layer of a layered pad
+
+        bool operator==(const DerivedPad& other) const noexcept { return sample == other.sample && layers == other.layers; }
+        bool operator!=(const DerivedPad& other) const noexcept { return !(*this == other); }
+    };
+    using DerivedSamples = std::array<DerivedPad, Kit::numPads>;
+
+    /**
+     * A note event addressed by note id, as CLAP hosts send them. An id or
+     * key of -1 matches every voice.
+     */
+    struct NoteEvent {
+        enum class Type { NoteOn, NoteOff, Choke, Expression };
+        enum class Expression {
+            Volume,   // Linear gain, 0 - 4
+            Pan,      // 0 (left) - 1 (right), 0.5 for centre
+            Tuning    // Semitones
+        };
+
+        Type type = Type::NoteOn;
+        int sampleOffset = 0;    // Position in the next block
+        int noteId = -1;
+        int key = -1;            // MIDI note
+        float velocity = 0.0f;   // 0.0 - 1.0, for note-ons
+        Expression expression = Expression::Volume;
+        float value = 0.0f;      // For expressions
+    };
+    static constexpr int maxNoteEvents = 512;
+
+    SamplerEngine();
+    ~SamplerEngine();
+
+    /**
+     * Allocate render buffers. Call before process(), off the audio thread.
+     *
+     * @param sampleRate Output sample rate in Hz
+     * @param maximumBlockSize Largest block process() will receive
+     */
+    void prepare(double sampleRate, int maximumBlockSize);
+
+    /**
+     * Replace the kit. The audio thread picks it up at its next block; voices
+     * already playing finish on the old kit. Derived samples are kept for
+     * pads whose audio and edits are unchanged, as when a sample is only
+     * evicted to its preload head.
+     *
+     * @param newKit The kit to play
+     */
+    void setKit(std::shared_ptr<const Kit> newKit);
+
+    /**
+     * @return The kit currently being played
+     */
+    std::shared_ptr<const Kit> getKit() const;
+
+    /**
+     * Replace the instrument layered over the kit
+     *
+     * @param newInstrument The instrument to play, or nullptr for none
+     */
+    void setInstrument(std::shared_ptr<const Instrument> newInstrument);
+
+    /**
+     * @return The instrument currently being played, or nullptr
+     */
+    std::shared_ptr<const Instrument> getInstrument() const;
+
+    /**
+     * Preload a kit for a MIDI program change. The switch itself happens on
+     * the audio thread as a pointer swap, with nothing loaded or allocated there.
+     *
+     * @param program MIDI program number, 0 - numPrograms - 1
+     * @param programKit The kit to switch to, or nullptr to clear the program
+     */
+    void setProgramKit(int program, std::shared_ptr<const Kit> programKit);
+
+    /**
+     * Play edited, tempo-synced and rate-converted pads from renders of their
+     * regions (see DerivedSampleCache), at the cost of a plain voice. Replacing the kit
+     * drops those of changed pads until they are set again for the new kit.
+     *
+     * @param kit The kit the samples were rendered for
+     * @param samples Renders of the kit's pad regions
+     * @return False if kit is no longer the one playing, and nothing was changed
+     */
+    bool setDerivedSamples(const std::shared_ptr<const Kit>& kit, DerivedSamples samples);
+
+    /**
+     * @return Memory held by the derived samples of the kit playing, each counted once
+     */
+    size_t getDerivedBytes() const;
+
+    /**
+     * Free replaced kits and instruments the audio thread is done with. Runs
+     * on every change; also call it periodically off the audio thread, since
+     * a replaced kit lives on until its last voice ends.
+     */
+    void collectGarbage();
+
+    /**
+     * Feed per-pad output to an analyser
+     *
+     * @param newAnalyser Analyser to feed, or nullptr; must outlive the engine
+     */
+    void setAnalyser(Analyser* newAnalyser) noexcept { analyser = newAnalyser; }
+
+    /**
+     * @param padId Pad to meter, 0 - Kit::numPads - 1
+     * @return The pad's level meter, for reading from the UI
+     */
+    LevelMeter& getPadMeter(int padId) noexcept { return padMeters[static_cast<size_t>(padId)]; }
+
+    /**
+     * Set a pad's mixer gains, which ramp from their previous values. Audio thread.
+     *
+     * @param padId Pad, 0 - Kit::numPads - 1
+     * @param leftGain Linear gain of the left channel, including pan
+     * @param rightGain Linear gain of the right channel, including pan
+     */
+    void setPadGains(int padId, float leftGain, float rightGain) noexcept;
+
+    /**
+     * Copy the MIDI note of each pad of the kit playing now. Audio thread,
+     * outside process().
+     *
+     * @param notes Receives one note per pad
+     */
+    void getPadNotes(std::array<int, Kit::numPads>& notes) noexcept;
+
+    /**
+     * Queue a note event for the next process() call, alongside its MIDI.
+     * Events must come in time order; beyond maxNoteEvents a block's events
+     * are dropped. Audio thread.
+     *
+     * @param event The event
+     */
+    void addNoteEvent(const NoteEvent& event) noexcept;
+
+    /**
+     * Render one block, adding voices into the buffer
+     *
+     * @param buffer Output buffer
+     * @param midiMessages MIDI events for this block; queued note events are applied with them
+     */
+    void process(juce::AudioBuffer<float>& buffer, const juce::MidiBuffer& midiMessages);
+
+    /**
+     * Stop all voices immediately
+     */
+    void reset();
+
+private:
+    /**
+     * Everything the audio thread plays from. Immutable once published.
+     */
+    struct State {
+        std::shared_ptr<const Kit> kit;
+        std::shared_ptr<const Instrument> instrument;
+        std::array<PadLayerMap, Kit::numPads> padLayers;   // Velocity and round-robin lookup of layered pads
+        DerivedSamples derivedSamples;
+        juce::uint64 epoch = 0;   // Unique per state, recorded by the voices started from it
+    };
+
+    // Writer side, with writerLock held
+    const State* createState(std::shared_ptr<const Kit> newKit, std::shared_ptr<const Instrument> newInstrument,
+                             DerivedSamples derivedSamples = {});
+    void collectGarbageLocked();
+
+    // Audio thread: read a published state and protect it with the hazard pointer
+    const State* acquireState(const std::atomic<const State*>& source) noexcept;
+
+    void handleMidiEvent(const State*& state, const juce::MidiMessage& message);
+    void handleNoteEvent(const State& state, const NoteEvent& event);
+    void noteOn(const State& state, int midiNote, float velocity, int noteId);
+    void startPad(const State& state, const Pad& pad, int midiNote, float velocity, int noteId);
+    void startVoice(const State& state, const Region& region, int midiNote, float velocity, int noteId);
+    void chokeGroup(int group);
+    void noteOff(int midiNote);
+    SamplerVoice& findFreeVoice();
+    void renderVoices(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    std::array<SamplerVoice, maxVoices> voices;
+    juce::uint32 voiceCounter = 0;
+    double sampleRate = 44100.0;
+
+    // Decoded source frames for the voice currently rendering
+    static constexpr int scratchFrames = 2048;
+    juce::AudioBuffer<float> scratch { 2, scratchFrames };
+
+    // Output of one pad, gain-staged, metered and analysed before it is mixed into the block
+    juce::AudioBuffer<float> padBuffer;
+    std::array<LevelMeter, Kit::numPads> padMeters;
+    std::array<std::array<DSP::SmoothedGain, 2>, Kit::numPads> padGains;
+    Analyser* analyser = nullptr;
+    static_assert(Kit::numPads <= 32, "Active pads are tracked in a 32-bit mask");
+
+    // Note events queued for the next block
+    std::array<NoteEvent, maxNoteEvents> noteEvents;
+    int numNoteEvents = 0;
+
+    // Note-ons per note, selects the round-robin step
+    std::array<juce::uint32, Instrument::numNotes> roundRobinCounters {};
+
+    // Note-ons per velocity range of each layered pad
+    std::array<std::array<juce::uint32, PadLayerMap::maxGroups>, Kit::numPads> padRoundRobinCounters {};
+
+    // Owned states, including replaced ones not yet freed. Never touched by the audio thread.
+    juce::CriticalSection writerLock;
+    std::vector<std::unique_ptr<State>> states;
+    juce::uint64 nextEpoch = 1;
+
+    // Shared with the audio thread
+    std::atomic<const State*> currentState { nullptr };
+    std::array<std::atomic<const State*>, numPrograms> programStates;
+    std::atomic<const State*> hazard { nullptr };                 // State the audio thread is reading
+    std::array<std::atomic<juce::uint64>, maxVoices> voiceEpochs;  // State each voice plays from, 0 if idle
+
+    JUCE_DECLARE_NON_COPYABLE(SamplerEngine)
+};
+
+} // namespace Aika
@@ -0,0 +1,45 @@
+#include "loadmonitor.hpp"
+#include "core/platform/tracer.hpp"
+#include <cmath>
+
+namespace Aika {
+
+void LoadMonitor::prepare(double newSampleRate) {
+    sampleRate = newSampleRate;
+    averageLoad = 0.0f;
+    load.store(0.0f);
+    peakLoad.store(0.0f);
+    xruns.store(0);
+}
+
+void LoadMonitor::addBlock(int numSamples, juce::int64 elapsedTicks) noexcept {
+    if (numSamples <= 0)
+        return;
+
+    const double blockSeconds = numSamples / sampleRate;
+    const float blockLoad = static_cast<float>(static_cast<double>(elapsedTicks) * secondsPerTick / blockSeconds);
+
+    // Time-based average, so it means the same at any block size
+    const float decay = static_cast<float>(std::exp(-blockSeconds / averagingSeconds));
+    averageLoad = blockLoad + (averageLoad - blockLoad) * decay;
+    load.store(averageLoad, std::memory_order_relaxed);
+
+    float current = peakLoad.load(std::memory_order_relaxed);
+    while (blockLoad > current && !peakLoad.compare_exchange_weak(current, blockLoad))
+        ;
+
+    if (blockLoad > 1.0f) {
+        xruns.store(xruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        AIKA_TRACE_INSTANT("xrun");
+    }
+}
+
+LoadMonitor::Reading LoadMonitor::read() noexcept {
+    Reading reading;
+    reading.load = load.load(std::memory_order_relaxed);
+    reading.peakLoad = peakLoad.exchange(0.0f);
+    reading.xruns = xruns.load(std::memory_order_relaxed);
+    return reading;
+}
+
+} // namespace Aika
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+namespace Aika {
+
+/**
+ * Rolling CPU load of the audio callback.
+ *
+ * Load is the time spent rendering a block divided by the time the block
+ * lasts, so 1.0 means the callback only just kept up. A block above 1.0 is
+ * counted as an xrun: the device will have run dry unless the host buffers
+ * ahead. Readings are published through atomics, like LevelMeter, so the UI
+ * reads them at its own rate.
+ */
+class LoadMonitor {
+public:
+    struct Reading {
+        float load = 0.0f;       // Average over roughly averagingSeconds
+        float peakLoad = 0.0f;   // Highest single block since the last read
+        juce::uint32 xruns = 0;  // Blocks over budget since prepare()
+    };
+
+    static constexpr double averagingSeconds = 1.0;
+
+    /**
+     * Times one block, from construction to destruction. Audio thread.
+     */
+    class ScopedBlock {
+    public:
+        ScopedBlock(LoadMonitor& monitorToUse, int numSamples) noexcept
+            : monitor(monitorToUse), blockSamples(numSamples), startTicks(juce::Time::getHighResolutionTicks()) {}
+
+        ~ScopedBlock() noexcept { monitor.addBlock(blockSamples, juce::Time::getHighResolutionTicks() - startTicks); }
+
+    private:
+        LoadMonitor& monitor;
+        const int blockSamples;
+        const juce::int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedBlock)
+    };
+
+    LoadMonitor() = default;
+
+    /**
+     * Set the sample rate blocks are measured against, and clear the readings. Not for the audio thread.
+     */
+    void prepare(double sampleRate);
+
+    /**
+     * Account for a rendered block. Audio thread.
+     *
+     * @param numSamples Length of the block
+     * @param elapsedTicks juce::Time high-resolution ticks spent rendering it
+     */
+    void addBlock(int numSamples, juce::int64 elapsedTicks) noexcept;
+
+    /**
+     * Read the current load and start a new peak-hold period. Meant for a single reader.
+     */
+    Reading read() noexcept;
+
+private:
+    double sampleRate = 44100.0;
+    double secondsPerTick = 1.0 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+
+    // Audio-thread state
+    float averageLoad = 0.0f;
+
+    // Published readings
+    std::atomic<float> load { 0.0f };
+    std::atomic<float> peakLoad { 0.0f };
+    std::atomic<juce::uint32> xruns { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(LoadMonitor)
+};
+
+} // namespace Aika
@@ -0,0 +1,168 @@
+#include "meter.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+namespace {
+
+float sumOfSquares(const float* samples, int numSamples) noexcept {
+    // Independent accumulators, so the loop vectorizes without reassociating one sum
+    float sums[4] = {};
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        for (int lane = 0; lane < 4; ++lane)
+            sums[lane] += samples[i + lane] * samples[i + lane];
+    }
+    for (; i < numSamples; ++i)
+        sums[0] += samples[i] * samples[i];
+
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+} // namespace
+
+LevelMeter::LevelMeter() {
+    // Windowed-sinc interpolator in the spirit of ITU-R BS.1770 Annex 2: 48 taps at 4x,
+    // split into four branches that each land between two input samples
+    constexpr int numTaps = oversampling * tapsPerPhase;
+    constexpr double centre = (numTaps - 1) * 0.5;
+
+    for (int phase = 0; phase < oversampling; ++phase) {
+        float sum = 0.0f;
+        for (int tap = 0; tap < tapsPerPhase; ++tap) {
+            const int n = phase + tap * oversampling;
+            const double x = (n - centre) / oversampling;
+            const double sinc = std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+            const double window = 0.5 - 0.5 * std::cos(juce::MathConstants<double>::twoPi * (n + 0.5) / numTaps);
+            phaseCoefficients[static_cast<size_t>(phase)][static_cast<size_t>(tap)] = static_cast<float>(sinc * window);
+            sum += phaseCoefficients[static_cast<size_t>(phase)][static_cast<size_t>(tap)];
+        }
+
+        // Unity gain at DC for every branch
+        for (auto& coefficient : phaseCoefficients[static_cast<size_t>(phase)])
+            coefficient /= sum;
+    }
+
+    reset();
+}
+
+void LevelMeter::prepare(double newSampleRate) {
+    sampleRate = newSampleRate;
+    reset();
+}
+
+void LevelMeter::reset() {
+    meanSquares.fill(0.0f);
+    for (auto& history : histories)
+        history.fill(0.0f);
+    historyPositions.fill(0);
+    measuringTruePeaks = false;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        peaks[static_cast<size_t>(channel)].store(0.0f);
+        rmsLevels[static_cast<size_t>(channel)].store(0.0f);
+    }
+    truePeak.store(0.0f);
+}
+
+void LevelMeter::process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept {
+    const int numBufferChannels = buffer.getNumChannels();
+    if (numSamples <= 0 || numBufferChannels == 0)
+        return;
+
+    // Start the interpolator from silence rather than from where it stopped
+    const bool measureTruePeaks = truePeakEnabled.load(std::memory_order_relaxed);
+    if (measureTruePeaks != measuringTruePeaks) {
+        for (auto& history : histories)
+            history.fill(0.0f);
+        measuringTruePeaks = measureTruePeaks;
+    }
+
+    const float decay = static_cast<float>(std::exp(-numSamples / (rmsWindowSeconds * sampleRate)));
+    float blockTruePeak = 0.0f;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        const auto index = static_cast<size_t>(channel);
+        const float* samples = buffer.getReadPointer(std::min(channel, numBufferChannels - 1), startSample);
+
+        const auto range = juce::FloatVectorOperations::findMinAndMax(samples, numSamples);
+        const float peak = std::max(-range.getStart(), range.getEnd());
+        publishMax(peaks[index], peak);
+
+        // Block-rate exponential average of the mean square
+        const float blockMeanSquare = sumOfSquares(samples, numSamples) / static_cast<float>(numSamples);
+        meanSquares[index] = blockMeanSquare + (meanSquares[index] - blockMeanSquare) * decay;
+        rmsLevels[index].store(std::sqrt(meanSquares[index]), std::memory_order_relaxed);
+
+        blockTruePeak = std::max(blockTruePeak, peak);
+        if (measureTruePeaks)
+            blockTruePeak = std::max(blockTruePeak, measureTruePeak(channel, samples, numSamples));
+    }
+
+    publishMax(truePeak, blockTruePeak);
+}
+
+void LevelMeter::processSilence(int numSamples) noexcept {
+    if (numSamples <= 0 || (meanSquares[0] == 0.0f && meanSquares[1] == 0.0f))
+        return;
+
+    const float decay = static_cast<float>(std::exp(-numSamples / (rmsWindowSeconds * sampleRate)));
+    for (int channel = 0; channel < numChannels; ++channel) {
+        const auto index = static_cast<size_t>(channel);
+        meanSquares[index] *= decay;
+        if (meanSquares[index] < 1.0e-12f)
+            meanSquares[index] = 0.0f;
+        rmsLevels[index].store(std::sqrt(meanSquares[index]), std::memory_order_relaxed);
+    }
+
+    // Flush the interpolator so the next sound doesn't ring against stale samples
+    for (auto& history : histories)
+        history.fill(0.0f);
+}
+
+float LevelMeter::measureTruePeak(int channel, const float* samples, int numSamples) noexcept {
+    auto& history = histories[static_cast<size_t>(channel)];
+    int position = historyPositions[static_cast<size_t>(channel)];
+    float maximum = 0.0f;
+
+    for (int i = 0; i < numSamples; ++i) {
+        history[static_cast<size_t>(position)] = samples[i];
+        history[static_cast<size_t>(position + tapsPerPhase)] = samples[i];
+
+        // Newest sample last: history[position + 1 .. position + tapsPerPhase]
+        const float* window = history.data() + position + 1;
+        for (const auto& coefficients : phaseCoefficients) {
+            float value = 0.0f;
+            for (int tap = 0; tap < tapsPerPhase; ++tap)
+                value += coefficients[static_cast<size_t>(tap)] * window[tapsPerPhase - 1 - tap];
+            maximum = std::max(maximum, std::abs(value));
+        }
+
+        position = position + 1 == tapsPerPhase ? 0 : position + 1;
+    }
+
+    historyPositions[static_cast<size_t>(channel)] = position;
+    return maximum;
+}
+
+LevelMeter::Reading LevelMeter::read() noexcept {
+    Reading reading;
+    for (int channel = 0; channel < numChannels; ++channel) {
+        const auto index = static_cast<size_t>(channel);
+        reading.peak[index] = peaks[index].exchange(0.0f);
+        reading.rms[index] = rmsLevels[index].load(std::memory_order_relaxed);
+    }
+    reading.truePeak = truePeak.exchange(0.0f);
+    return reading;
+}
+
+void LevelMeter::publishMax(std::atomic<float>& target, float value) noexcept {
+    // Only the audio thread raises the value and the reader only resets it,
+    // so this rarely loops more than once
+    float current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value))
+        ;
+}
+
+} // namespace Aika
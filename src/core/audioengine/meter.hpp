@@ -0,0 +1,94 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+namespace Aika {
+
+/**
+ * Peak, RMS and true-peak meter for a stereo signal.
+ *
+ * The audio thread feeds it whole blocks; levels are published through
+ * atomics, so the UI can read at its own rate without ever blocking the
+ * audio thread. Peaks are held until the next read, so nothing between
+ * two reads is missed.
+ *
+ * The true-peak interpolator is the costly part, so it only runs while
+ * enabled, i.e. while something shows the levels.
+ */
+class LevelMeter {
+public:
+    static constexpr int numChannels = 2;
+
+    struct Reading {
+        std::array<float, numChannels> peak {};   // Highest sample magnitude since the last read
+        std::array<float, numChannels> rms {};    // RMS over roughly the last rmsWindowSeconds
+        float truePeak = 0.0f;                    // Highest inter-sample peak since the last read (4x oversampled); the sample peak while disabled
+    };
+
+    static constexpr double rmsWindowSeconds = 0.3;
+
+    LevelMeter();
+
+    /**
+     * Set the sample rate used for RMS averaging, and clear the meter. Not for the audio thread.
+     */
+    void prepare(double sampleRate);
+
+    /**
+     * Measure a block. Audio thread; a mono buffer is metered on both channels.
+     *
+     * @param buffer Signal to measure
+     * @param startSample First sample
+     * @param numSamples Number of samples
+     */
+    void process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept;
+
+    /**
+     * Start or stop measuring true peaks, from the next block. Any thread.
+     */
+    void setTruePeakEnabled(bool enabled) noexcept { truePeakEnabled.store(enabled, std::memory_order_relaxed); }
+
+    /**
+     * Account for a block of silence without reading any samples. Audio thread.
+     */
+    void processSilence(int numSamples) noexcept;
+
+    /**
+     * Read the current levels and start a new peak-hold period. Meant for a single reader.
+     */
+    Reading read() noexcept;
+
+    /**
+     * Clear all levels. Not for the audio thread.
+     */
+    void reset();
+
+private:
+    // Taps per polyphase branch of the 4x true-peak interpolator
+    static constexpr int oversampling = 4;
+    static constexpr int tapsPerPhase = 12;
+
+    float measureTruePeak(int channel, const float* samples, int numSamples) noexcept;
+    static void publishMax(std::atomic<float>& target, float value) noexcept;
+
+    double sampleRate = 44100.0;
+    std::array<std::array<float, tapsPerPhase>, oversampling> phaseCoefficients {};
+
+    // Audio-thread state
+    std::array<float, numChannels> meanSquares {};
+    std::array<std::array<float, tapsPerPhase * 2>, numChannels> histories {};  // Doubled so each window is contiguous
+    std::array<int, numChannels> historyPositions {};
+    bool measuringTruePeaks = false;
+
+    // Published levels
+    std::array<std::atomic<float>, numChannels> peaks;
+    std::array<std::atomic<float>, numChannels> rmsLevels;
+    std::atomic<float> truePeak { 0.0f };
+    std::atomic<bool> truePeakEnabled { false };
+
+    JUCE_DECLARE_NON_COPYABLE(LevelMeter)
+};
+
+} // namespace Aika
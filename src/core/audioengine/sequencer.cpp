@@ -0,0 +1,354 @@
+#include "sequencer.hpp"
+#include "core/platform/tracer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+namespace {
+
+const juce::Identifier patternType("PATTERN");
+const juce::Identifier stepType("STEP");
+
+namespace Ids {
+const juce::Identifier selected("selected");
+const juce::Identifier index("index");
+const juce::Identifier numSteps("numSteps");
+const juce::Identifier stepBeats("stepBeats");
+const juce::Identifier swing("swing");
+const juce::Identifier track("track");
+const juce::Identifier step("step");
+const juce::Identifier velocity("velocity");
+const juce::Identifier probability("probability");
+} // namespace Ids
+
+// Step lengths from 128th notes to whole notes
+constexpr double minStepBeats = 1.0 / 32.0;
+constexpr double maxStepBeats = 4.0;
+
+bool isValidPattern(int pattern) {
+    return pattern >= 0 && pattern < StepSequencer::numPatterns;
+}
+
+int wrapStep(juce::int64 step, int numSteps) noexcept {
+    const auto wrapped = static_cast<int>(step % numSteps);
+    return wrapped < 0 ? wrapped + numSteps : wrapped;
+}
+
+} // namespace
+
+const juce::Identifier StepSequencer::sequencerType("SEQUENCER");
+
+StepSequencer::StepSequencer() {
+    backlog.reserve(static_cast<size_t>(queueSize));
+}
+
+bool StepSequencer::setStep(int pattern, int track, int step, int velocity, int probability) {
+    if (!isValidPattern(pattern) || track < 0 || track >= numTracks || step < 0 || step >= maxSteps)
+        return false;
+
+    Command command;
+    command.type = Command::Type::setStep;
+    command.pattern = pattern;
+    command.track = track;
+    command.step = step;
+    command.value.velocity = static_cast<juce::uint8>(juce::jlimit(0, 127, velocity));
+    command.value.probability = static_cast<juce::uint8>(juce::jlimit(0, 100, probability));
+    push(command);
+    return true;
+}
+
+bool StepSequencer::setLength(int pattern, int numSteps) {
+    if (!isValidPattern(pattern))
+        return false;
+
+    Command command;
+    command.type = Command::Type::setLength;
+    command.pattern = pattern;
+    command.amount = juce::jlimit(1, maxSteps, numSteps);
+    push(command);
+    return true;
+}
+
+bool StepSequencer::setStepBeats(int pattern, double beats) {
+    if (!isValidPattern(pattern) || !std::isfinite(beats))
+        return false;
+
+    Command command;
+    command.type = Command::Type::setStepBeats;
+    command.pattern = pattern;
+    command.amount = juce::jlimit(minStepBeats, maxStepBeats, beats);
+    push(command);
+    return true;
+}
+
+bool StepSequencer::setSwing(int pattern, float swing) {
+    if (!isValidPattern(pattern) || !std::isfinite(swing))
+        return false;
+
+    Command command;
+    command.type = Command::Type::setSwing;
+    command.pattern = pattern;
+    command.amount = juce::jlimit(0.0f, maxSwing, swing);
+    push(command);
+    return true;
+}
+
+bool StepSequencer::clearPattern(int pattern) {
+    if (!isValidPattern(pattern))
+        return false;
+
+    Command command;
+    command.type = Command::Type::clearPattern;
+    command.pattern = pattern;
+    push(command);
+    return true;
+}
+
+bool StepSequencer::selectPattern(int pattern) {
+    if (!isValidPattern(pattern))
+        return false;
+
+    Command command;
+    command.type = Command::Type::selectPattern;
+    command.pattern = pattern;
+    push(command);
+    return true;
+}
+
+StepSequencer::Pattern StepSequencer::getPattern(int pattern) const {
+    juce::ScopedLock lock(editLock);
+    return editPatterns[static_cast<size_t>(juce::jlimit(0, numPatterns - 1, pattern))];
+}
+
+int StepSequencer::getSelectedPattern() const {
+    juce::ScopedLock lock(editLock);
+    return selectedPattern;
+}
+
+void StepSequencer::push(const Command& command) {
+    juce::ScopedLock lock(editLock);
+    if (command.type == Command::Type::selectPattern)
+        selectedPattern = command.pattern;
+    else
+        apply(editPatterns, command);
+
+    // Queued behind any backlog, so the audio thread sees edits in order
+    backlog.push_back(command);
+    flushLocked();
+}
+
+void StepSequencer::flush() {
+    juce::ScopedLock lock(editLock);
+    flushLocked();
+}
+
+void StepSequencer::flushLocked() {
+    const int count = std::min(static_cast<int>(backlog.size()), fifo.getFreeSpace());
+    if (count <= 0)
+        return;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(count, start1, size1, start2, size2);
+    std::copy(backlog.begin(), backlog.begin() + size1, queue.begin() + start1);
+    std::copy(backlog.begin() + size1, backlog.begin() + size1 + size2, queue.begin() + start2);
+    fifo.finishedWrite(size1 + size2);
+
+    backlog.erase(backlog.begin(), backlog.begin() + size1 + size2);
+}
+
+void StepSequencer::apply(std::array<Pattern, numPatterns>& target, const Command& command) noexcept {
+    auto& pattern = target[static_cast<size_t>(command.pattern)];
+    switch (command.type) {
+    case Command::Type::setStep:
+        pattern.tracks[static_cast<size_t>(command.track)][static_cast<size_t>(command.step)] = command.value;
+        break;
+    case Command::Type::setLength:
+        pattern.numSteps = static_cast<int>(command.amount);
+        break;
+    case Command::Type::setStepBeats:
+        pattern.stepBeats = command.amount;
+        break;
+    case Command::Type::setSwing:
+        pattern.swing = static_cast<float>(command.amount);
+        break;
+    case Command::Type::clearPattern:
+        for (auto& track : pattern.tracks)
+            track.fill(Step {});
+        break;
+    case Command::Type::selectPattern:
+        break;
+    }
+}
+
+juce::ValueTree StepSequencer::save() const {
+    juce::ScopedLock lock(editLock);
+    juce::ValueTree tree(sequencerType);
+    tree.setProperty(Ids::selected, selectedPattern, nullptr);
+
+    for (int index = 0; index < numPatterns; ++index) {
+        const auto& pattern = editPatterns[static_cast<size_t>(index)];
+        juce::ValueTree patternTree(patternType);
+        patternTree.setProperty(Ids::index, index, nullptr);
+        patternTree.setProperty(Ids::numSteps, pattern.numSteps, nullptr);
+        patternTree.setProperty(Ids::stepBeats, pattern.stepBeats, nullptr);
+        patternTree.setProperty(Ids::swing, pattern.swing, nullptr);
+
+        // Only steps that are on; most of a pattern usually isn't
+        for (int track = 0; track < numTracks; ++track) {
+            for (int step = 0; step < maxSteps; ++step) {
+                const auto& value = pattern.tracks[static_cast<size_t>(track)][static_cast<size_t>(step)];
+                if (value.velocity == 0)
+                    continue;
+
+                juce::ValueTree stepTree(stepType);
+                stepTree.setProperty(Ids::track, track, nullptr);
+                stepTree.setProperty(Ids::step, step, nullptr);
+                stepTree.setProperty(Ids::velocity, value.velocity, nullptr);
+                stepTree.setProperty(Ids::probability, value.probability, nullptr);
+                patternTree.appendChild(stepTree, nullptr);
+            }
+        }
+        tree.appendChild(patternTree, nullptr);
+    }
+    return tree;
+}
+
+void StepSequencer::load(const juce::ValueTree& tree) {
+    juce::ScopedLock lock(editLock);
+
+    // Patterns missing from the tree are left empty
+    const Pattern defaults;
+    for (int index = 0; index < numPatterns; ++index) {
+        clearPattern(index);
+        setLength(index, defaults.numSteps);
+        setStepBeats(index, defaults.stepBeats);
+        setSwing(index, defaults.swing);
+    }
+
+    for (const auto& patternTree : tree) {
+        if (!patternTree.hasType(patternType))
+            continue;
+
+        const int index = patternTree.getProperty(Ids::index, -1);
+        if (!isValidPattern(index))
+            continue;
+
+        setLength(index, patternTree.getProperty(Ids::numSteps, defaults.numSteps));
+        setStepBeats(index, patternTree.getProperty(Ids::stepBeats, defaults.stepBeats));
+        setSwing(index, patternTree.getProperty(Ids::swing, defaults.swing));
+
+        for (const auto& stepTree : patternTree) {
+            if (stepTree.hasType(stepType))
+                setStep(index, stepTree.getProperty(Ids::track, -1), stepTree.getProperty(Ids::step, -1),
+                        stepTree.getProperty(Ids::velocity, 0), stepTree.getProperty(Ids::probability, 100));
+        }
+    }
+
+    selectPattern(juce::jlimit(0, numPatterns - 1, static_cast<int>(tree.getProperty(Ids::selected, 0))));
+}
+
+void StepSequencer::applyCommands() noexcept {
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+    const auto applyRange = [this](int start, int size) {
+        for (int i = start; i < start + size; ++i) {
+            const auto& command = queue[static_cast<size_t>(i)];
+            if (command.type == Command::Type::selectPattern)
+                pendingPattern = command.pattern;
+            else
+                apply(patterns, command);
+        }
+    };
+    applyRange(start1, size1);
+    applyRange(start2, size2);
+
+    fifo.finishedRead(size1 + size2);
+}
+
+juce::uint32 StepSequencer::nextRandom() noexcept {
+    // xorshift32: plenty for dice rolls, and nothing to lock or allocate
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+void StepSequencer::process(const Transport& transport, int numSamples, double sampleRate,
+                            const std::array<int, numTracks>& padNotes, juce::MidiBuffer& midiMessages) noexcept {
+    AIKA_TRACE_SCOPE("sequencer");
+    applyCommands();
+
+    if (!transport.isPlaying || transport.bpm <= 0.0 || sampleRate <= 0.0 || numSamples <= 0) {
+        // Stopped: a newly selected pattern takes over at once
+        currentPattern = pendingPattern;
+        wasPlaying = false;
+        playingStep.store(-1, std::memory_order_relaxed);
+        playingPattern.store(currentPattern, std::memory_order_relaxed);
+        return;
+    }
+
+    const double beatsPerSample = transport.bpm / (60.0 * sampleRate);
+    double start = transport.ppqPosition;
+    if (!wasPlaying) {
+        // Starting the transport lines the pattern up with the host's timeline again
+        patternStart = 0.0;
+    } else if (std::abs(start - nextPosition) < beatsPerSample) {
+        // Running on: continue from where the last block ended, so rounding in the
+        // reported position can't repeat or drop a step that lands on a block edge
+        start = nextPosition;
+    }
+
+    const double end = start + numSamples * beatsPerSample;
+    nextPosition = end;
+    wasPlaying = true;
+
+    const Pattern* pattern = &patterns[static_cast<size_t>(currentPattern)];
+
+    // Steps belong to the block their nearest sample falls in. Blocks that run
+    // on share their edge exactly, so each step lands in exactly one of them.
+    const auto toSample = [start, beatsPerSample](double position) {
+        return std::floor((position - start) / beatsPerSample + 0.5);
+    };
+
+    // Start a step early: its swing may push it into this block
+    auto step = static_cast<juce::int64>(std::floor((start - patternStart) / pattern->stepBeats)) - 1;
+    for (;; ++step) {
+        double position = patternStart + static_cast<double>(step) * pattern->stepBeats;
+        if (toSample(position) >= numSamples)
+            break;
+
+        int index = wrapStep(step, pattern->numSteps);
+        if ((index & 1) != 0)
+            position += pattern->swing * pattern->stepBeats;
+
+        const double sample = toSample(position);
+        if (sample < 0.0 || sample >= numSamples)
+            continue;
+
+        // A selected pattern takes over where the playing one would start over
+        if (index == 0 && pendingPattern != currentPattern) {
+            currentPattern = pendingPattern;
+            pattern = &patterns[static_cast<size_t>(currentPattern)];
+            patternStart = position;
+            step = 0;
+        }
+
+        const int offset = static_cast<int>(sample);
+        for (size_t track = 0; track < pattern->tracks.size(); ++track) {
+            const auto& value = pattern->tracks[track][static_cast<size_t>(index)];
+            if (value.velocity == 0 || (value.probability < 100 && nextRandom() % 100 >= value.probability))
+                continue;
+
+            const int note = padNotes[track];
+            if (note >= 0 && note < 128)
+                midiMessages.addEvent(juce::MidiMessage::noteOn(1, note, value.velocity), offset);
+        }
+        playingStep.store(index, std::memory_order_relaxed);
+    }
+
+    playingPattern.store(currentPattern, std::memory_order_relaxed);
+}
+
+} // namespace Aika
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "core/sampler/kit.hpp"
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Step sequencer of the kit's pads, following the host transport.
+ *
+ * Every block, the steps falling inside the block's span of quarter notes
+ * are turned into note-ons at the sample they land on, computed from the
+ * play head's PPQ position rather than counted from block to block, so there
+ * is no drift or jitter and host loops and locates are followed exactly.
+ * Steps trigger pads as one-shots: no note-offs are sent.
+ *
+ * Patterns are preallocated. Edits are applied to a copy owned by the
+ * editing side and passed to the audio thread as commands through a
+ * lock-free queue, so the audio thread never waits on an edit.
+ */
+class StepSequencer {
+public:
+    static constexpr int numTracks = Kit::numPads;   // One track per pad
+    static constexpr int maxSteps = 64;
+    static constexpr int numPatterns = 16;
+    static constexpr float maxSwing = 0.5f;
+    static constexpr int queueSize = 1024;
+
+    struct Step {
+        juce::uint8 velocity = 0;       // 1 - 127, 0 if the step is off
+        juce::uint8 probability = 100;  // Chance of the step playing, percent
+    };
+
+    struct Pattern {
+        int numSteps = 16;
+        double stepBeats = 0.25;   // Length of a step in quarter notes
+        float swing = 0.0f;        // Delay of every second step, as a fraction of a step; 1/3 swings in triplets
+        std::array<std::array<Step, maxSteps>, numTracks> tracks {};
+    };
+
+    struct Transport {
+        bool isPlaying = false;
+        double ppqPosition = 0.0;  // Quarter notes at the first sample of the block
+        double bpm = 0.0;
+    };
+
+    StepSequencer();
+
+    /**
+     * Set one step. The edits below may be made from any thread but the audio
+     * thread; they show in getPattern() at once and reach the audio thread at
+     * its next block.
+     *
+     * @param pattern Pattern, 0 - numPatterns - 1
+     * @param track Track, i.e. pad id, 0 - numTracks - 1
+     * @param step Step, 0 - maxSteps - 1
+     * @param velocity MIDI velocity 1 - 127, or 0 to turn the step off
+     * @param probability Chance of the step playing, 0 - 100 percent
+     * @return False if an index is out of range
+     */
+    bool setStep(int pattern, int track, int step, int velocity, int probability = 100);
+
+    /**
+     * @param numSteps Pattern length, 1 - maxSteps
+     */
+    bool setLength(int pattern, int numSteps);
+
+    /**
+     * @param beats Length of a step in quarter notes, e.g. 0.25 for sixteenths
+     */
+    bool setStepBeats(int pattern, double beats);
+
+    /**
+     * @param swing Delay of every second step, 0 - maxSwing of a step
+     */
+    bool setSwing(int pattern, float swing);
+
+    /**
+     * Turn every step of a pattern off, keeping its length, rate and swing
+     */
+    bool clearPattern(int pattern);
+
+    /**
+     * Choose the pattern to play. While the transport runs, the switch
+     * happens when the playing pattern next starts over.
+     */
+    bool selectPattern(int pattern);
+
+    /**
+     * @return A copy of a pattern with every edit made so far
+     */
+    Pattern getPattern(int pattern) const;
+
+    /**
+     * @return The pattern last chosen with selectPattern()
+     */
+    int getSelectedPattern() const;
+
+    /**
+     * @return The step last played, in the pattern being played, or -1 if stopped
+     */
+    int getPlayingStep() const noexcept { return playingStep.load(std::memory_order_relaxed); }
+    int getPlayingPattern() const noexcept { return playingPattern.load(std::memory_order_relaxed); }
+
+    /**
+     * Pass on edits that did not fit in the queue. Call periodically off the
+     * audio thread; only bursts such as load() ever fill it.
+     */
+    void flush();
+
+    /**
+     * @return Every pattern, for a plugin state
+     */
+    juce::ValueTree save() const;
+
+    /**
+     * Replace every pattern with ones from save()
+     */
+    void load(const juce::ValueTree& tree);
+
+    /**
+     * Add the note-ons of the steps inside this block. Audio thread.
+     *
+     * @param transport Host transport at the start of the block
+     * @param numSamples Length of the block
+     * @param sampleRate Sample rate in Hz
+     * @param padNotes MIDI note of each pad
+     * @param midiMessages Receives the note-ons, at their sample positions
+     */
+    void process(const Transport& transport, int numSamples, double sampleRate,
+                 const std::array<int, numTracks>& padNotes, juce::MidiBuffer& midiMessages) noexcept;
+
+    static const juce::Identifier sequencerType;
+
+private:
+    struct Command {
+        enum class Type : juce::uint8 { setStep, setLength, setStepBeats, setSwing, clearPattern, selectPattern };
+
+        Type type = Type::setStep;
+        int pattern = 0;
+        int track = 0;
+        int step = 0;
+        Step value;
+        double amount = 0.0;
+    };
+
+    // Editing side, with editLock held
+    void push(const Command& command);
+    void flushLocked();
+
+    // Changes to a pattern, made the same way on both sides
+    static void apply(std::array<Pattern, numPatterns>& target, const Command& command) noexcept;
+
+    // Audio thread
+    void applyCommands() noexcept;
+    juce::uint32 nextRandom() noexcept;
+
+    // Editing side
+    mutable juce::CriticalSection editLock;
+    std::array<Pattern, numPatterns> editPatterns;
+    int selectedPattern = 0;
+    std::vector<Command> backlog;   // Edits waiting for room in the queue
+
+    // Commands from the editing side to the audio thread
+    juce::AbstractFifo fifo { queueSize };
+    std::array<Command, queueSize> queue;
+
+    // Audio-thread state
+    std::array<Pattern, numPatterns> patterns;
+    int currentPattern = 0;
+    int pendingPattern = 0;
+    double patternStart = 0.0;   // Quarter note where the current pattern's step 0 falls
+    double nextPosition = 0.0;   // Where the next block starts if the transport runs on uninterrupted
+    bool wasPlaying = false;
+    juce::uint32 randomState = 0x9e3779b9;
+
+    // Published for the UI
+    std::atomic<int> playingStep { -1 };
+    std::atomic<int> playingPattern { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(StepSequencer)
+};
+
+} // namespace Aika
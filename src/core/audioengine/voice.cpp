@@ -0,0 +1,169 @@
+#include "voice.hpp"
+#include "core/platform/tracer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+namespace {
+    constexpr double chokeSeconds = 0.005;
+}
+
+SamplerVoice::SamplerVoice() {
+}
+
+void SamplerVoice::start(const Region& region, int note, float velocity, double sampleRate, juce::uint32 voiceOrder, int id) {
+    jassert(region.sample != nullptr);
+
+    sample = region.sample;
+    regionId = region.id;
+    padId = region.padId;
+    offBy = region.offBy;
+    midiNote = note;
+    noteId = id;
+    order = voiceOrder;
+    outputSampleRate = sampleRate;
+
+    const int numFrames = sample->getNumFrames();
+    const int startFrame = juce::jlimit(0, numFrames, region.offset);
+    const int endFrame = region.end > 0 ? region.end : numFrames;
+
+    position = startFrame;
+    regionEnd = juce::jlimit(startFrame, numFrames, endFrame);
+
+    loopMode = region.loopMode;
+    loopStart = juce::jlimit(0, regionEnd, region.loopStart);
+    loopEnd = juce::jlimit(loopStart, regionEnd, region.loopEnd);
+    looping = region.isLooped() && loopEnd > startFrame;
+
+    const float cents = static_cast<float>(note - region.pitchKeycenter) * region.pitchKeytrack + region.tune;
+    baseIncrement = sample->getSampleRate() / outputSampleRate * std::exp2(cents / 1200.0f);
+    level = region.gain * velocity;
+    regionPan = region.pan;
+    setExpression(1.0f, 0.0f, 0.0f);
+
+    envelope.start(region.attack * outputSampleRate, region.release * outputSampleRate,
+                   region.exponentialRelease ? DSP::Envelope::Curve::Exponential : DSP::Envelope::Curve::Linear);
+}
+
+void SamplerVoice::setExpression(float volume, float pan, float semitones) noexcept {
+    volumeExpression = volume;
+    panExpression = pan;
+    tuningExpression = semitones;
+
+    // Without tuning the increment stays exact, so unpitched voices keep their direct path
+    increment = semitones != 0.0f ? baseIncrement * std::exp2(semitones / 12.0f) : baseIncrement;
+
+    const float gain = level * volume;
+    const float voicePan = juce::jlimit(-1.0f, 1.0f, regionPan + pan);
+    leftGain = gain * std::min(1.0f, 1.0f - voicePan);
+    rightGain = gain * std::min(1.0f, 1.0f + voicePan);
+}
+
+void SamplerVoice::release() {
+    if (!isActive() || loopMode == Region::LoopMode::OneShot)
+        return;
+
+    envelope.release();
+
+    // A sustain loop lets go of the loop and plays through to the end
+    if (loopMode == Region::LoopMode::Sustain)
+        looping = false;
+}
+
+void SamplerVoice::choke() {
+    if (!isActive())
+        return;
+
+    envelope.releaseWithin(chokeSeconds * outputSampleRate);
+}
+
+void SamplerVoice::reset() {
+    sample = nullptr;
+    regionId = -1;
+    padId = -1;
+    midiNote = -1;
+    noteId = -1;
+    envelope.reset();
+}
+
+void SamplerVoice::render(juce::AudioBuffer<float>& output, int startSample, int numSamples, float* const* scratch, int scratchFrames) noexcept {
+    AIKA_TRACE_SCOPE("voice");
+    float levels[envelopeBlockSize];
+    const int numOutputChannels = output.getNumChannels();
+    const int numSampleChannels = std::min(sample != nullptr ? sample->getNumChannels() : 0, numOutputChannels);
+
+    while (numSamples > 0 && isActive()) {
+        // How many output samples fit before the loop or region ends, and in the scratch buffer
+        const int boundary = looping ? loopEnd : regionEnd;
+        const int remaining = static_cast<int>(std::ceil((boundary - position) / increment));
+        const int fitsInScratch = static_cast<int>((scratchFrames - 4) / increment);
+        const int chunkLimit = std::min({ numSamples, remaining, fitsInScratch, envelopeBlockSize });
+
+        // The envelope ends the voice at its exact sample
+        const int chunk = chunkLimit > 0 ? envelope.process(levels, chunkLimit) : 0;
+
+        if (chunk <= 0) {
+            reset();
+            break;
+        }
+
+        // Decode every source frame the chunk touches, plus one for interpolation
+        const int firstFrame = static_cast<int>(position);
+        const int lastFrame = std::min(boundary - 1, static_cast<int>(position + (chunk - 1) * increment) + 1);
+        const int framesToRead = lastFrame - firstFrame + 1;
+
+        for (int channel = 0; channel < numSampleChannels; ++channel) {
+            sample->readFrames(channel, firstFrame, framesToRead, scratch[channel]);
+
+            // Interpolating past the boundary wraps to the loop start, or fades to silence
+            if (looping)
+                sample->readFrames(channel, loopStart, 1, scratch[channel] + framesToRead);
+            else
+                scratch[channel][framesToRead] = 0.0f;
+        }
+
+        float* outputs[2] = { output.getWritePointer(0, startSample),
+                              output.getWritePointer(std::min(1, numOutputChannels - 1), startSample) };
+
+        if (increment == 1.0 && position == firstFrame) {
+            // Unpitched and already at the output rate: every output sample is a source frame
+            for (int channel = 0; channel < numSampleChannels; ++channel)
+                juce::FloatVectorOperations::multiply(scratch[channel], levels, chunk);
+
+            juce::FloatVectorOperations::addWithMultiply(outputs[0], scratch[0], leftGain, chunk);
+            if (numOutputChannels > 1)
+                juce::FloatVectorOperations::addWithMultiply(outputs[1], scratch[numSampleChannels > 1 ? 1 : 0], rightGain, chunk);
+        } else {
+            for (int i = 0; i < chunk; ++i) {
+                const double framePosition = position + i * increment - firstFrame;
+                const int index = static_cast<int>(framePosition);
+                const float fraction = static_cast<float>(framePosition - index);
+                const float level = levels[i];
+
+                const float left = scratch[0][index] + fraction * (scratch[0][index + 1] - scratch[0][index]);
+                const float right = numSampleChannels > 1
+                                  ? scratch[1][index] + fraction * (scratch[1][index + 1] - scratch[1][index])
+                                  : left;
+
+                outputs[0][i] += left * level * leftGain;
+                if (numOutputChannels > 1)
+                    outputs[1][i] += right * level * rightGain;
+            }
+        }
+
+        position += chunk * increment;
+        startSample += chunk;
+        numSamples -= chunk;
+
+        if (looping) {
+            while (position >= loopEnd)
+                position -= loopEnd - loopStart;
+        }
+
+        if (!envelope.isActive())
+            reset();
+    }
+}
+
+} // namespace Aika
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "core/sampler/instrument.hpp"
+#include "core/dsp/envelope/envelope.hpp"
+#include <memory>
+
+namespace Aika {
+
+/**
+ * Plays one region of a sample. Stored samples are converted to float a
+ * chunk at a time into a scratch buffer shared by all voices, then
+ * resampled with linear interpolation into the output. Unpitched samples at
+ * the output rate, e.g. pads converted when loaded, are mixed in directly.
+ */
+class SamplerVoice {
+public:
+    SamplerVoice();
+
+    /**
+     * Start playing a region
+     *
+     * @param region The region to play; must have a sample
+     * @param midiNote The note that triggered it, used for pitch and note-off
+     * @param velocity Note velocity, 0.0 - 1.0
+     * @param outputSampleRate Sample rate of the output in Hz
+     * @param order Monotonic counter used to find the oldest voice when stealing
+     * @param noteId Host note id that note events and expressions address the voice by, or -1
+     */
+    void start(const Region& region, int midiNote, float velocity, double outputSampleRate, juce::uint32 order, int noteId = -1);
+
+    /**
+     * Modulate this voice alone, on top of its region's settings. Takes
+     * effect from the next rendered sample.
+     *
+     * @param volume Linear gain
+     * @param pan Offset added to the region's pan, -1 - 1
+     * @param semitones Transposition
+     */
+    void setExpression(float volume, float pan, float semitones) noexcept;
+
+    /**
+     * Begin the release phase, in response to a note-off. One-shot regions ignore it.
+     */
+    void release();
+
+    /**
+     * Fade out over a few milliseconds, for choke groups and voice stealing
+     */
+    void choke();
+
+    /**
+     * Stop immediately
+     */
+    void reset();
+
+    /**
+     * Add this voice's output into a buffer
+     *
+     * @param output Output buffer
+     * @param startSample First output sample to write
+     * @param numSamples Number of output samples
+     * @param scratch Scratch channels, each with at least scratchFrames floats
+     * @param scratchFrames Capacity of each scratch channel
+     */
+    void render(juce::AudioBuffer<float>& output, int startSample, int numSamples, float* const* scratch, int scratchFrames) noexcept;
+
+    bool isActive() const noexcept { return sample != nullptr; }
+    bool isReleasing() const noexcept { return envelope.isReleasing(); }
+    int getRegionId() const noexcept { return regionId; }
+    int getPadId() const noexcept { return padId; }
+    int getOffBy() const noexcept { return offBy; }
+    int getMidiNote() const noexcept { return midiNote; }
+    int getNoteId() const noexcept { return noteId; }
+    float getVolumeExpression() const noexcept { return volumeExpression; }
+    float getPanExpression() const noexcept { return panExpression; }
+    float getTuningExpression() const noexcept { return tuningExpression; }
+    juce::uint32 getOrder() const noexcept { return order; }
+
+private:
+    // Envelope levels are rendered this many samples at a time, on the stack
+    static constexpr int envelopeBlockSize = 256;
+
+    std::shared_ptr<const Sample> sample;
+    int regionId = -1;
+    int padId = -1;
+    int offBy = 0;
+    int midiNote = -1;
+    int noteId = -1;
+    juce::uint32 order = 0;
+
+    double position = 0.0;    // Read position in sample frames
+    double increment = 1.0;   // Sample frames per output sample
+    int regionEnd = 0;        // One past the last frame to play
+    int loopStart = 0;
+    int loopEnd = 0;
+    Region::LoopMode loopMode = Region::LoopMode::NoLoop;
+    bool looping = false;     // Still inside the loop; cleared when a sustain loop is released
+    float leftGain = 1.0f;
+    float rightGain = 1.0f;
+
+    // Region settings the expressions apply to, and the expressions
+    double baseIncrement = 1.0;
+    float level = 1.0f;
+    float regionPan = 0.0f;
+    float volumeExpression = 1.0f;
+    float panExpression = 0.0f;
+    float tuningExpression = 0.0f;
+
+    DSP::Envelope envelope;
+    double outputSampleRate = 44100.0;
+};
+
+} // namespace Aika
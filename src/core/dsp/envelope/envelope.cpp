@@ -0,0 +1,143 @@
+#include "envelope.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Aika {
+namespace DSP {
+
+namespace {
+
+// Samples until a ramp finishes, limited to the block; at least one
+int getSegmentLength(double remainingSamples, int numSamples) noexcept {
+    return static_cast<int>(std::min(static_cast<double>(numSamples), std::max(1.0, std::ceil(remainingSamples))));
+}
+
+} // namespace
+
+void Envelope::start(double attackSamples, double releaseSamples, Curve releaseCurve) noexcept {
+    const double releaseLength = std::max(1.0, releaseSamples);
+
+    attackStep = attackSamples > 1.0 ? static_cast<float>(1.0 / attackSamples) : 1.0f;
+    releaseStep = static_cast<float>(1.0 / releaseLength);
+    releaseCoefficient = std::min(static_cast<float>(std::pow(static_cast<double>(silenceLevel), 1.0 / releaseLength)),
+                                  1.0f - std::numeric_limits<float>::epsilon());
+    curve = releaseCurve;
+
+    level = 0.0f;
+    stage = Stage::Attack;
+}
+
+void Envelope::release() noexcept {
+    if (stage == Stage::Attack || stage == Stage::Sustain)
+        stage = Stage::Release;
+}
+
+void Envelope::releaseWithin(double maxSamples) noexcept {
+    if (stage == Stage::Idle)
+        return;
+
+    const float step = static_cast<float>(1.0 / std::max(1.0, maxSamples));
+
+    // An exponential release that ends sooner anyway is left alone
+    const bool isSoonerAlready = stage == Stage::Release && curve == Curve::Exponential
+        && (level <= silenceLevel || std::log(silenceLevel / level) / std::log(releaseCoefficient) <= level / step);
+
+    if (!isSoonerAlready) {
+        releaseStep = curve == Curve::Linear ? std::max(releaseStep, step) : step;
+        curve = Curve::Linear;
+    }
+
+    stage = Stage::Release;
+}
+
+void Envelope::reset() noexcept {
+    level = 0.0f;
+    stage = Stage::Idle;
+}
+
+int Envelope::process(float* levels, int numSamples) noexcept {
+    int done = 0;
+
+    while (done < numSamples) {
+        switch (stage) {
+            case Stage::Idle:
+                juce::FloatVectorOperations::clear(levels + done, numSamples - done);
+                return done;
+            case Stage::Attack:
+                done += processAttack(levels + done, numSamples - done);
+                break;
+            case Stage::Sustain:
+                juce::FloatVectorOperations::fill(levels + done, level, numSamples - done);
+                return numSamples;
+            case Stage::Release:
+                done += processRelease(levels + done, numSamples - done);
+                break;
+        }
+    }
+
+    return numSamples;
+}
+
+int Envelope::processAttack(float* levels, int numSamples) noexcept {
+    const double remaining = std::ceil((1.0 - level) / attackStep);
+    const int length = getSegmentLength(remaining, numSamples);
+    const float startLevel = level;
+
+    // Computed from the index rather than accumulated, so the loop vectorizes
+    for (int i = 0; i < length; ++i)
+        levels[i] = std::min(1.0f, startLevel + attackStep * static_cast<float>(i + 1));
+
+    if (length >= remaining) {
+        levels[length - 1] = 1.0f;
+        stage = Stage::Sustain;
+    }
+
+    level = levels[length - 1];
+    return length;
+}
+
+int Envelope::processRelease(float* levels, int numSamples) noexcept {
+    const float startLevel = level;
+    double remaining = 1.0;
+    int length = 0;
+
+    if (curve == Curve::Linear) {
+        remaining = std::ceil(startLevel / releaseStep);
+        length = getSegmentLength(remaining, numSamples);
+
+        for (int i = 0; i < length; ++i)
+            levels[i] = std::max(0.0f, startLevel - releaseStep * static_cast<float>(i + 1));
+    } else {
+        if (startLevel > silenceLevel)
+            remaining = std::ceil(std::log(silenceLevel / startLevel) / std::log(static_cast<double>(releaseCoefficient)));
+        length = getSegmentLength(remaining, numSamples);
+
+        // level * r^(i + 1), four samples apart per lane, so each lane is one
+        // multiply per step and the lanes map onto a SIMD register
+        const float r = releaseCoefficient;
+        const float r4 = (r * r) * (r * r);
+        float lanes[4] = { startLevel * r, startLevel * r * r, startLevel * r * r * r, startLevel * r4 };
+
+        int i = 0;
+        for (; i + 4 <= length; i += 4) {
+            for (int lane = 0; lane < 4; ++lane) {
+                levels[i + lane] = lanes[lane];
+                lanes[lane] *= r4;
+            }
+        }
+        for (int lane = 0; i < length; ++i, ++lane)
+            levels[i] = lanes[lane];
+    }
+
+    if (length >= remaining) {
+        levels[length - 1] = 0.0f;
+        stage = Stage::Idle;
+    }
+
+    level = levels[length - 1];
+    return length;
+}
+
+} // namespace DSP
+} // namespace Aika
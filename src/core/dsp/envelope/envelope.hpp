@@ -0,0 +1,82 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Aika {
+namespace DSP {
+
+/**
+ * Attack-sustain-release amplitude envelope, rendered a block at a time.
+ *
+ * Rather than stepping a state machine every sample, process() works out
+ * where the current segment ends, splits the block at that exact sample
+ * and fills each piece in closed form: linear ramps from the sample index,
+ * exponential ramps as a four-lane recurrence, sustain as a constant. Both
+ * loops vectorize, so the envelope costs little next to the resampling.
+ */
+class Envelope {
+public:
+    enum class Stage { Idle, Attack, Sustain, Release };
+
+    enum class Curve {
+        Linear,       // Straight line to silence
+        Exponential   // Straight line in dB, down to silenceLevel, then off
+    };
+
+    // Where an exponential release ends (-80 dB)
+    static constexpr float silenceLevel = 1.0e-4f;
+
+    /**
+     * Start the attack from silence
+     *
+     * @param attackSamples Samples to reach full level; 1 or less starts at full level
+     * @param releaseSamples Samples for a release from full level to fall silent
+     * @param releaseCurve Shape of the release
+     */
+    void start(double attackSamples, double releaseSamples, Curve releaseCurve) noexcept;
+
+    /**
+     * Begin the release from the current level
+     */
+    void release() noexcept;
+
+    /**
+     * Release, linearly, reaching silence from full level within a number of
+     * samples at most. Shortens a release already under way; never lengthens it.
+     */
+    void releaseWithin(double maxSamples) noexcept;
+
+    /**
+     * Fall silent immediately
+     */
+    void reset() noexcept;
+
+    /**
+     * Render the next block of levels
+     *
+     * @param levels Receives one level per sample
+     * @param numSamples Number of samples
+     * @return Samples before the envelope ended; the rest of levels is zero
+     */
+    int process(float* levels, int numSamples) noexcept;
+
+    Stage getStage() const noexcept { return stage; }
+    bool isActive() const noexcept { return stage != Stage::Idle; }
+    bool isReleasing() const noexcept { return stage == Stage::Release; }
+    float getLevel() const noexcept { return level; }
+
+private:
+    int processAttack(float* levels, int numSamples) noexcept;
+    int processRelease(float* levels, int numSamples) noexcept;
+
+    Stage stage = Stage::Idle;
+    float level = 0.0f;
+    float attackStep = 1.0f;
+
+    Curve curve = Curve::Linear;
+    float releaseStep = 1.0f;          // Per sample, linear
+    float releaseCoefficient = 0.0f;   // Per sample, exponential
+};
+
+} // namespace DSP
+} // namespace Aika
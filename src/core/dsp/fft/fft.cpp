@@ -0,0 +1,44 @@
+#include "fft.hpp"
+#include <mutex>
+
+namespace Aika {
+namespace DSP {
+
+namespace {
+    // fftw's planner is not thread safe, only execution is
+    std::mutex& getPlannerLock() {
+        static std::mutex plannerLock;
+        return plannerLock;
+    }
+}
+
+RealFFT::RealFFT(int fftSize) : size(fftSize) {
+    std::lock_guard<std::mutex> lock(getPlannerLock());
+    
+    timeData = fftwf_alloc_real(static_cast<size_t>(size));
+    spectrum = fftwf_alloc_complex(static_cast<size_t>(size / 2 + 1));
+    
+    // FFTW_ESTIMATE keeps construction cheap and leaves the buffers untouched
+    forwardPlan = fftwf_plan_dft_r2c_1d(size, timeData, spectrum, FFTW_ESTIMATE);
+    inversePlan = fftwf_plan_dft_c2r_1d(size, spectrum, timeData, FFTW_ESTIMATE);
+}
+
+RealFFT::~RealFFT() {
+    std::lock_guard<std::mutex> lock(getPlannerLock());
+    
+    fftwf_destroy_plan(forwardPlan);
+    fftwf_destroy_plan(inversePlan);
+    fftwf_free(timeData);
+    fftwf_free(spectrum);
+}
+
+void RealFFT::forward() noexcept {
+    fftwf_execute(forwardPlan);
+}
+
+void RealFFT::inverse() noexcept {
+    fftwf_execute(inversePlan);
+}
+
+} // namespace DSP
+} // namespace Aika
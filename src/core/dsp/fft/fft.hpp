@@ -0,0 +1,72 @@
+#pragma once
+
+#include <complex>
+#include <fftw3.h>
+
+namespace Aika {
+namespace DSP {
+
+/**
+ * Fixed-size real FFT backed by fftw3 (single precision).
+ *
+ * Plans are created in the constructor, so forward() and inverse() never
+ * allocate. An instance must not be used by two threads at once, but
+ * separate instances can run in parallel.
+ */
+class RealFFT {
+public:
+    /**
+     * Constructor
+     * @param size Transform length in samples (any size, powers of two are fastest)
+     */
+    explicit RealFFT(int size);
+    
+    /**
+     * Destructor
+     */
+    ~RealFFT();
+
+    RealFFT(const RealFFT&) = delete;
+    RealFFT& operator=(const RealFFT&) = delete;
+
+    /**
+     * @return Transform length in samples
+     */
+    int getSize() const noexcept { return size; }
+
+    /**
+     * @return Number of complex bins produced by forward() (size / 2 + 1)
+     */
+    int getNumBins() const noexcept { return size / 2 + 1; }
+
+    /**
+     * @return Time-domain buffer of getSize() samples, read by forward() and written by inverse()
+     */
+    float* getTimeData() noexcept { return timeData; }
+
+    /**
+     * @return Spectrum buffer of getNumBins() bins, written by forward() and read by inverse()
+     */
+    std::complex<float>* getSpectrum() noexcept { return reinterpret_cast<std::complex<float>*>(spectrum); }
+
+    /**
+     * Transform the time-domain buffer into the spectrum buffer
+     */
+    void forward() noexcept;
+
+    /**
+     * Transform the spectrum buffer back into the time-domain buffer.
+     * The result is scaled by getSize(), and the spectrum buffer is overwritten.
+     */
+    void inverse() noexcept;
+
+private:
+    int size;
+    float* timeData;
+    fftwf_complex* spectrum;
+    fftwf_plan forwardPlan;
+    fftwf_plan inversePlan;
+};
+
+} // namespace DSP
+} // namespace Aika
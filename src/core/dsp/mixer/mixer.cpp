@@ -0,0 +1,114 @@
+#include "mixer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+namespace DSP {
+
+std::pair<float, float> getPanGains(PanRule rule, float pan) noexcept {
+    // 0 is hard left, 1 is hard right
+    const double position = juce::jlimit(0.0, 1.0, (static_cast<double>(pan) + 1.0) * 0.5);
+    const double halfPi = juce::MathConstants<double>::halfPi;
+
+    double left = 0.0;
+    double right = 0.0;
+    double boost = 1.0;
+
+    switch (rule) {
+        case PanRule::Linear:
+            left = 1.0 - position;
+            right = position;
+            boost = 2.0;
+            break;
+        case PanRule::Balanced:
+            left = std::min(0.5, 1.0 - position);
+            right = std::min(0.5, position);
+            boost = 2.0;
+            break;
+        case PanRule::Sin3dB:
+            left = std::sin(halfPi * (1.0 - position));
+            right = std::sin(halfPi * position);
+            boost = std::sqrt(2.0);
+            break;
+        case PanRule::Sin4p5dB:
+            left = std::pow(std::sin(halfPi * (1.0 - position)), 1.5);
+            right = std::pow(std::sin(halfPi * position), 1.5);
+            boost = std::pow(2.0, 0.75);
+            break;
+        case PanRule::Sin6dB:
+            left = std::pow(std::sin(halfPi * (1.0 - position)), 2.0);
+            right = std::pow(std::sin(halfPi * position), 2.0);
+            boost = 2.0;
+            break;
+        case PanRule::SquareRoot3dB:
+            left = std::sqrt(1.0 - position);
+            right = std::sqrt(position);
+            boost = std::sqrt(2.0);
+            break;
+        case PanRule::SquareRoot4p5dB:
+            left = std::pow(std::sqrt(1.0 - position), 1.5);
+            right = std::pow(std::sqrt(position), 1.5);
+            boost = std::pow(2.0, 0.75);
+            break;
+    }
+
+    return { static_cast<float>(left * boost), static_cast<float>(right * boost) };
+}
+
+void SmoothedGain::prepare(double sampleRate, double rampSeconds) noexcept {
+    rampSamples = std::max(1, static_cast<int>(sampleRate * rampSeconds));
+    reset(target);
+}
+
+void SmoothedGain::setTarget(float newTarget) noexcept {
+    if (newTarget == target)
+        return;
+
+    target = newTarget;
+    remainingSamples = rampSamples;
+    step = (target - current) / static_cast<float>(rampSamples);
+}
+
+void SmoothedGain::reset(float gain) noexcept {
+    current = target = gain;
+    step = 0.0f;
+    remainingSamples = 0;
+}
+
+void SmoothedGain::process(float* const* channels, int numChannels, int numSamples) noexcept {
+    int offset = 0;
+
+    if (remainingSamples > 0) {
+        const int rampLength = std::min(numSamples, remainingSamples);
+        const float start = current;
+
+        // Computed from the index rather than accumulated, so the loop vectorizes
+        for (int channel = 0; channel < numChannels; ++channel) {
+            float* samples = channels[channel];
+            for (int i = 0; i < rampLength; ++i)
+                samples[i] *= start + step * static_cast<float>(i + 1);
+        }
+
+        remainingSamples -= rampLength;
+        current = remainingSamples > 0 ? start + step * static_cast<float>(rampLength) : target;
+        offset = rampLength;
+    }
+
+    if (offset == numSamples || current == 1.0f)
+        return;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::multiply(channels[channel] + offset, current, numSamples - offset);
+}
+
+void SmoothedGain::skip(int numSamples) noexcept {
+    if (remainingSamples == 0)
+        return;
+
+    const int rampLength = std::min(numSamples, remainingSamples);
+    remainingSamples -= rampLength;
+    current = remainingSamples > 0 ? current + step * static_cast<float>(rampLength) : target;
+}
+
+} // namespace DSP
+} // namespace Aika
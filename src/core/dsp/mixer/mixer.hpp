@@ -0,0 +1,82 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <utility>
+
+namespace Aika {
+namespace DSP {
+
+/**
+ * Pan laws, in the order of the panRule parameter's choices.
+ * Same curves as juce::dsp::Panner.
+ */
+enum class PanRule {
+    Linear,           // Gains sum to 1 (-6 dB at centre)
+    Balanced,         // Centre is unity, the far side fades out
+    Sin3dB,           // Constant power
+    Sin4p5dB,
+    Sin6dB,
+    SquareRoot3dB,
+    SquareRoot4p5dB
+};
+
+/**
+ * @param rule Pan law
+ * @param pan -1 (left) to 1 (right)
+ * @return Left and right gains
+ */
+std::pair<float, float> getPanGains(PanRule rule, float pan) noexcept;
+
+/**
+ * A gain that ramps linearly to each new target.
+ *
+ * Ramps are applied a block at a time as a vectorizable multiply; once the
+ * target is reached, a unity gain costs nothing and any other gain is a
+ * single constant multiply. Retargeting every block, as dense automation
+ * does, costs the same as a ramp.
+ */
+class SmoothedGain {
+public:
+    /**
+     * @param sampleRate Sample rate in Hz
+     * @param rampSeconds Time to reach a new target
+     */
+    void prepare(double sampleRate, double rampSeconds = 0.02) noexcept;
+
+    /**
+     * Ramp to a new gain. Audio thread.
+     */
+    void setTarget(float newTarget) noexcept;
+
+    /**
+     * Jump to a gain without ramping
+     */
+    void reset(float gain) noexcept;
+
+    /**
+     * Multiply channels by the gain and advance the ramp by numSamples
+     *
+     * @param channels Channel pointers; all get the same gain curve
+     * @param numChannels Number of channels
+     * @param numSamples Samples per channel
+     */
+    void process(float* const* channels, int numChannels, int numSamples) noexcept;
+
+    /**
+     * Advance the ramp without touching any audio
+     */
+    void skip(int numSamples) noexcept;
+
+    bool isSmoothing() const noexcept { return remainingSamples > 0; }
+    float getTarget() const noexcept { return target; }
+
+private:
+    float current = 1.0f;
+    float target = 1.0f;
+    float step = 0.0f;
+    int remainingSamples = 0;
+    int rampSamples = 0;
+};
+
+} // namespace DSP
+} // namespace Aika
@@ -0,0 +1,87 @@
+#include "resampler.hpp"
+#include <cmath>
+#include <vector>
+
+namespace Aika {
+namespace DSP {
+
+namespace {
+
+// Modified Bessel function of the first kind, order 0, by its power series
+double besselI0(double x) noexcept {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1.0e-12)
+            break;
+    }
+    return sum;
+}
+
+} // namespace
+
+juce::AudioBuffer<float> Resampler::process(const juce::AudioBuffer<float>& source, double sourceRate, double targetRate) {
+    jassert(sourceRate > 0.0 && targetRate > 0.0);
+    const int numChannels = source.getNumChannels();
+    const int inputLength = source.getNumSamples();
+    const double ratio = targetRate / sourceRate;
+    const int outputLength = std::max(1, static_cast<int>(std::lround(inputLength * ratio)));
+
+    juce::AudioBuffer<float> output(numChannels, outputLength);
+    output.clear();
+    if (inputLength == 0)
+        return output;
+
+    // Downsampling lowers the cutoff, which widens the kernel in source frames by the same factor
+    const double cutoff = bandwidth * std::min(1.0, ratio);
+    const int halfTaps = static_cast<int>(std::ceil(zeroCrossings / std::min(1.0, ratio)));
+
+    // One side of the symmetric kernel, phasesPerTap entries per source frame, plus a guard entry
+    const int tableSize = halfTaps * phasesPerTap + 2;
+    std::vector<float> kernel(static_cast<size_t>(tableSize), 0.0f);
+    const double windowScale = 1.0 / besselI0(kaiserBeta);
+    for (int i = 0; i < tableSize - 1; ++i) {
+        const double x = static_cast<double>(i) / phasesPerTap;
+        const double t = x / halfTaps;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(juce::MathConstants<double>::pi * cutoff * x) / (juce::MathConstants<double>::pi * cutoff * x);
+        const double window = t < 1.0 ? besselI0(kaiserBeta * std::sqrt(1.0 - t * t)) * windowScale : 0.0;
+        kernel[static_cast<size_t>(i)] = static_cast<float>(cutoff * sinc * window);
+    }
+
+    const auto tap = [&kernel](double distance) noexcept {
+        const double position = std::abs(distance) * phasesPerTap;
+        const int index = static_cast<int>(position);
+        const float fraction = static_cast<float>(position - index);
+        return kernel[static_cast<size_t>(index)] + fraction * (kernel[static_cast<size_t>(index) + 1] - kernel[static_cast<size_t>(index)]);
+    };
+
+    // Weights depend only on the output frame's position, so they are shared by every channel
+    std::vector<float> weights(static_cast<size_t>(halfTaps) * 2);
+    for (int frame = 0; frame < outputLength; ++frame) {
+        const double centre = frame / ratio;
+        const int base = static_cast<int>(std::floor(centre));
+        const int first = std::max(0, base - halfTaps + 1);
+        const int last = std::min(inputLength - 1, base + halfTaps);
+        if (first > last)
+            continue;
+
+        const int count = last - first + 1;
+        for (int i = 0; i < count; ++i)
+            weights[static_cast<size_t>(i)] = tap(centre - (first + i));
+
+        for (int channel = 0; channel < numChannels; ++channel) {
+            const float* input = source.getReadPointer(channel, first);
+            float sum = 0.0f;
+            for (int i = 0; i < count; ++i)
+                sum += input[i] * weights[static_cast<size_t>(i)];
+            output.getWritePointer(channel)[frame] = sum;
+        }
+    }
+
+    return output;
+}
+
+} // namespace DSP
+} // namespace Aika
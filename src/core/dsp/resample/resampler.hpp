@@ -0,0 +1,41 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Aika {
+namespace DSP {
+
+/**
+ * Offline sample rate conversion with a polyphase windowed-sinc filter.
+ *
+ * The low-pass kernel (Kaiser-windowed sinc, cut off just below the lower
+ * of the two Nyquist frequencies) is tabulated at phasesPerTap phases
+ * between taps; each output frame takes the two phases around its exact
+ * position and blends them linearly, so any ratio is handled, not just
+ * small rational ones. Stopband rejection is around 90 dB.
+ *
+ * Meant for converting samples to the output rate once, in the
+ * background, so voices that play them unpitched read frames one to one
+ * instead of interpolating (see DerivedSampleCache).
+ */
+class Resampler {
+public:
+    static constexpr int zeroCrossings = 32;    // Kernel half-length in source frames, at the full bandwidth
+    static constexpr int phasesPerTap = 512;
+    static constexpr double bandwidth = 0.97;   // Passband edge as a fraction of the lower Nyquist frequency
+    static constexpr double kaiserBeta = 9.0;
+
+    /**
+     * Convert audio to another sample rate. Allocates, so never call this
+     * from the audio thread.
+     *
+     * @param source Audio to convert
+     * @param sourceRate Sample rate of the source in Hz
+     * @param targetRate Sample rate to convert to in Hz
+     * @return The converted audio, round(length * targetRate / sourceRate) frames long
+     */
+    static juce::AudioBuffer<float> process(const juce::AudioBuffer<float>& source, double sourceRate, double targetRate);
+};
+
+} // namespace DSP
+} // namespace Aika
@@ -0,0 +1,120 @@
+#include "timestretch.hpp"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace Aika {
+namespace DSP {
+
+namespace {
+
+// Search stride of the first pass; fine enough to land within one cycle up to several kHz
+constexpr int coarseStep = 4;
+
+// Dot product of two runs of the correlation signal; indices past the end read as silence
+float correlate(const std::vector<float>& signal, int a, int b, int length) noexcept {
+    const int size = static_cast<int>(signal.size());
+    const int count = std::max(0, std::min(length, std::min(size - a, size - b)));
+    const float* x = signal.data() + a;
+    const float* y = signal.data() + b;
+
+    float sum = 0.0f;
+    for (int i = 0; i < count; ++i)
+        sum += x[i] * y[i];
+    return sum;
+}
+
+} // namespace
+
+juce::AudioBuffer<float> TimeStretch::process(const juce::AudioBuffer<float>& source, double ratio, double sampleRate) {
+    ratio = juce::jlimit(minRatio, maxRatio, ratio);
+    const int numChannels = source.getNumChannels();
+    const int inputLength = source.getNumSamples();
+    const int outputLength = std::max(1, static_cast<int>(std::lround(inputLength * ratio)));
+
+    juce::AudioBuffer<float> output(numChannels, outputLength);
+    output.clear();
+    if (inputLength == 0)
+        return output;
+
+    const int frameLength = std::max(64, static_cast<int>(sampleRate * frameSeconds) & ~1);
+    const int hop = frameLength / 2;
+    const int tolerance = std::max(1, static_cast<int>(sampleRate * toleranceSeconds));
+
+    // Periodic Hann windows at half overlap sum to one
+    std::vector<float> window(static_cast<size_t>(frameLength));
+    for (int i = 0; i < frameLength; ++i)
+        window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * static_cast<float>(i) / static_cast<float>(frameLength));
+
+    // Frames are lined up on the channel average, with energies as prefix sums for normalising
+    std::vector<float> mono(static_cast<size_t>(inputLength), 0.0f);
+    for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::add(mono.data(), source.getReadPointer(channel), inputLength);
+
+    std::vector<double> energy(static_cast<size_t>(inputLength) + 1, 0.0);
+    for (int i = 0; i < inputLength; ++i)
+        energy[static_cast<size_t>(i) + 1] = energy[static_cast<size_t>(i)] + static_cast<double>(mono[static_cast<size_t>(i)]) * mono[static_cast<size_t>(i)];
+
+    const auto getEnergy = [&energy, inputLength](int start, int length) {
+        const int end = std::min(inputLength, start + length);
+        return start < end ? energy[static_cast<size_t>(end)] - energy[static_cast<size_t>(start)] : 0.0;
+    };
+
+    std::vector<float> weights(static_cast<size_t>(outputLength), 0.0f);
+    int previousPosition = 0;
+
+    for (int outputPosition = 0; outputPosition < outputLength; outputPosition += hop) {
+        int position = 0;
+
+        if (outputPosition > 0) {
+            // Best match for what would have followed the previous frame, near the nominal position
+            const int natural = previousPosition + hop;
+            const int nominal = static_cast<int>(std::lround(outputPosition / ratio));
+            const int first = std::max(0, nominal - tolerance);
+            const int last = std::min(inputLength - 1, nominal + tolerance);
+
+            position = juce::jlimit(0, inputLength - 1, nominal);
+            double bestScore = -std::numeric_limits<double>::infinity();
+            const auto consider = [&](int candidate) {
+                const double score = correlate(mono, candidate, natural, hop) / std::sqrt(getEnergy(candidate, hop) + 1.0e-9);
+                if (score > bestScore) {
+                    bestScore = score;
+                    position = candidate;
+                }
+            };
+
+            // Coarse pass, then every position around the best of it
+            for (int candidate = first; candidate <= last; candidate += coarseStep)
+                consider(candidate);
+
+            const int coarseBest = position;
+            for (int candidate = std::max(first, coarseBest - coarseStep + 1); candidate <= std::min(last, coarseBest + coarseStep - 1); ++candidate)
+                consider(candidate);
+        }
+
+        const int count = std::min(frameLength, std::min(inputLength - position, outputLength - outputPosition));
+        for (int channel = 0; channel < numChannels; ++channel) {
+            float* dest = output.getWritePointer(channel, outputPosition);
+            const float* src = source.getReadPointer(channel, position);
+            for (int i = 0; i < count; ++i)
+                dest[i] += window[static_cast<size_t>(i)] * src[i];
+        }
+        juce::FloatVectorOperations::add(weights.data() + outputPosition, window.data(), count);
+
+        previousPosition = position;
+    }
+
+    // Undo the window where frames don't overlap fully: the edges, and the tail past the input
+    for (int channel = 0; channel < numChannels; ++channel) {
+        float* data = output.getWritePointer(channel);
+        for (int i = 0; i < outputLength; ++i) {
+            if (weights[static_cast<size_t>(i)] > 1.0e-6f)
+                data[i] /= weights[static_cast<size_t>(i)];
+        }
+    }
+
+    return output;
+}
+
+} // namespace DSP
+} // namespace Aika
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Aika {
+namespace DSP {
+
+/**
+ * Offline time stretching by WSOLA (waveform similarity overlap-add).
+ *
+ * The output is built from Hann-windowed frames at a fixed hop. Each frame
+ * is read from near where the stretch ratio puts it in the input, shifted
+ * within a small tolerance to the position whose start best matches the
+ * natural continuation of the previous frame, so overlaps add in phase and
+ * pitch is kept. Channels share frame positions, keeping the stereo image.
+ *
+ * Suited to drum loops and other material with a clear pulse. Far too slow
+ * per sample for a voice, which is why stretched samples are rendered in
+ * the background and cached (see DerivedSampleCache).
+ */
+class TimeStretch {
+public:
+    static constexpr double frameSeconds = 0.04;       // Window length
+    static constexpr double toleranceSeconds = 0.01;   // How far a frame may move to line up
+    static constexpr double minRatio = 0.25;
+    static constexpr double maxRatio = 4.0;
+
+    /**
+     * Stretch audio to a new length without changing its pitch. Allocates,
+     * so never call this from the audio thread.
+     *
+     * @param source Audio to stretch
+     * @param ratio Output length over input length, minRatio - maxRatio
+     * @param sampleRate Sample rate of the source in Hz; sets frame and search sizes
+     * @return The stretched audio, round(length * ratio) frames long
+     */
+    static juce::AudioBuffer<float> process(const juce::AudioBuffer<float>& source, double ratio, double sampleRate);
+};
+
+} // namespace DSP
+} // namespace Aika
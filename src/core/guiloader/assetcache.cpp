@@ -0,0 +1,164 @@
+#include "assetcache.hpp"
+
+namespace Aika {
+
+namespace {
+
+// Zip record layouts (APPNOTE.TXT sections 4.3.7, 4.3.12 and 4.3.16)
+constexpr juce::uint32 localHeaderSignature = 0x04034b50;
+constexpr juce::uint32 centralHeaderSignature = 0x02014b50;
+constexpr juce::uint32 endOfCentralDirectorySignature = 0x06054b50;
+constexpr size_t localHeaderSize = 30;
+constexpr size_t centralHeaderSize = 46;
+constexpr size_t endOfCentralDirectorySize = 22;
+constexpr size_t maxCommentSize = 0xffff;
+
+constexpr juce::uint16 methodStored = 0;
+constexpr juce::uint16 methodDeflated = 8;
+
+juce::uint16 readU16(const juce::uint8* p) noexcept { return juce::ByteOrder::littleEndianShort(p); }
+juce::uint32 readU32(const juce::uint8* p) noexcept { return juce::ByteOrder::littleEndianInt(p); }
+
+} // namespace
+
+AssetCache::AssetCache(const void* zipData, size_t zipSize) {
+    if (zipData != nullptr)
+        index(static_cast<const juce::uint8*>(zipData), zipSize);
+}
+
+void AssetCache::index(const juce::uint8* zip, size_t zipSize) {
+    if (zipSize < endOfCentralDirectorySize)
+        return;
+
+    // The end-of-central-directory record sits at the end, before an optional comment
+    const size_t searchStart = zipSize - endOfCentralDirectorySize;
+    const size_t searchEnd = searchStart > maxCommentSize ? searchStart - maxCommentSize : 0;
+    const juce::uint8* end = nullptr;
+    for (size_t offset = searchStart + 1; offset-- > searchEnd;) {
+        if (readU32(zip + offset) == endOfCentralDirectorySignature) {
+            end = zip + offset;
+            break;
+        }
+    }
+    if (end == nullptr)
+        return;
+
+    const int numRecords = readU16(end + 10);
+    size_t offset = readU32(end + 16);
+
+    entries.reserve(static_cast<size_t>(numRecords));
+    for (int record = 0; record < numRecords; ++record) {
+        if (offset + centralHeaderSize > zipSize)
+            break;
+
+        const juce::uint8* header = zip + offset;
+        if (readU32(header) != centralHeaderSignature)
+            break;
+
+        const juce::uint16 method = readU16(header + 10);
+        const size_t compressedSize = readU32(header + 20);
+        const size_t size = readU32(header + 24);
+        const size_t nameLength = readU16(header + 28);
+        const size_t recordSize = centralHeaderSize + nameLength + readU16(header + 30) + readU16(header + 32);
+        const size_t localOffset = readU32(header + 42);
+
+        if (offset + recordSize > zipSize)
+            break;
+
+        const auto path = juce::String::fromUTF8(reinterpret_cast<const char*>(header + centralHeaderSize), static_cast<int>(nameLength));
+        offset += recordSize;
+
+        // Skip directories and anything we can't serve (other methods, zip64)
+        if (path.isEmpty() || path.endsWithChar('/') || (method != methodStored && method != methodDeflated))
+            continue;
+
+        // Data follows the local header, whose extra field may differ from the central one
+        if (localOffset + localHeaderSize > zipSize)
+            continue;
+
+        const juce::uint8* local = zip + localOffset;
+        const size_t dataOffset = localOffset + localHeaderSize + readU16(local + 26) + readU16(local + 28);
+        if (readU32(local) != localHeaderSignature || dataOffset > zipSize || compressedSize > zipSize - dataOffset)
+            continue;
+
+        Entry entry;
+        entry.compressed = reinterpret_cast<const std::byte*>(zip + dataOffset);
+        entry.compressedSize = compressedSize;
+        entry.size = size;
+        entry.isStored = method == methodStored && compressedSize == size;
+
+        if (method == methodStored && !entry.isStored)
+            continue;
+
+        numStored += entry.isStored ? 1 : 0;
+        entriesByPath[path] = entries.size();
+        entries.push_back(std::move(entry));
+    }
+}
+
+std::optional<AssetCache::Asset> AssetCache::find(const juce::String& path) {
+    const auto found = entriesByPath.find(path);
+    if (found == entriesByPath.end()) {
+        ++misses;
+        return std::nullopt;
+    }
+
+    auto& entry = entries[found->second];
+    if (entry.isStored) {
+        ++hits;
+        return Asset { entry.compressed, entry.size };
+    }
+
+    const juce::ScopedLock lock(inflateLock);
+    if (entry.inflated == nullptr) {
+        if (!inflate(entry)) {
+            ++misses;
+            return std::nullopt;
+        }
+        ++inflations;
+    } else {
+        ++hits;
+    }
+
+    return Asset { entry.inflated.get(), entry.size };
+}
+
+bool AssetCache::inflate(Entry& entry) {
+    const auto started = juce::Time::getMillisecondCounterHiRes();
+
+    juce::MemoryInputStream source(entry.compressed, entry.compressedSize, false);
+    juce::GZIPDecompressorInputStream decompressor(&source, false, juce::GZIPDecompressorInputStream::deflateFormat,
+                                                   static_cast<juce::int64>(entry.size));
+
+    auto data = std::make_unique<std::byte[]>(std::max<size_t>(entry.size, 1));
+    size_t total = 0;
+    while (total < entry.size) {
+        const int numRead = decompressor.read(data.get() + total, static_cast<int>(std::min<size_t>(entry.size - total, 1 << 20)));
+        if (numRead <= 0)
+            break;
+        total += static_cast<size_t>(numRead);
+    }
+
+    inflateMs += juce::Time::getMillisecondCounterHiRes() - started;
+
+    if (total != entry.size)
+        return false;
+
+    entry.inflated = std::move(data);
+    return true;
+}
+
+AssetCache::Stats AssetCache::getStats() const {
+    Stats stats;
+    stats.numEntries = static_cast<int>(entries.size());
+    stats.numStored = numStored;
+    stats.hits = hits.load();
+    stats.inflations = inflations.load();
+    stats.misses = misses.load();
+
+    const juce::ScopedLock lock(inflateLock);
+    stats.inflateMs = inflateMs;
+    return stats;
+}
+
+} // namespace Aika
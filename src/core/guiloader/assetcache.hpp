@@ -0,0 +1,81 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Read-only view of the web UI bundle (a zip archive embedded in the binary).
+ *
+ * The archive's central directory is indexed once at construction. Entries
+ * stored without compression are served straight out of the archive;
+ * deflated entries are inflated the first time they are asked for and kept.
+ * Returned views stay valid for the lifetime of the cache, so one instance
+ * can be shared by every editor in the process.
+ */
+class AssetCache {
+public:
+    struct Asset {
+        const std::byte* data = nullptr;
+        size_t size = 0;
+    };
+
+    struct Stats {
+        int numEntries = 0;          // Files in the archive
+        int numStored = 0;           // Of which served without inflating
+        juce::uint64 hits = 0;       // Lookups served from the archive or the cache
+        juce::uint64 inflations = 0; // Lookups that had to inflate first
+        juce::uint64 misses = 0;     // Lookups for paths not in the archive
+        double inflateMs = 0.0;      // Total time spent inflating
+    };
+
+    /**
+     * Index an archive. Malformed archives index as empty.
+     *
+     * @param zipData Archive bytes; must outlive the cache
+     * @param zipSize Size of the archive in bytes
+     */
+    AssetCache(const void* zipData, size_t zipSize);
+
+    /**
+     * Look up a file. Safe to call from several threads at once.
+     *
+     * @param path Path inside the archive, without a leading slash
+     * @return The file contents, or nothing if the path isn't in the archive
+     */
+    std::optional<Asset> find(const juce::String& path);
+
+    Stats getStats() const;
+
+private:
+    struct Entry {
+        const std::byte* compressed = nullptr;
+        size_t compressedSize = 0;
+        size_t size = 0;
+        bool isStored = false;
+        std::unique_ptr<std::byte[]> inflated;
+    };
+
+    void index(const juce::uint8* zip, size_t zipSize);
+    bool inflate(Entry& entry);
+
+    std::vector<Entry> entries;
+    std::unordered_map<juce::String, size_t> entriesByPath;
+    mutable juce::CriticalSection inflateLock;
+
+    int numStored = 0;
+    std::atomic<juce::uint64> hits { 0 };
+    std::atomic<juce::uint64> inflations { 0 };
+    std::atomic<juce::uint64> misses { 0 };
+    double inflateMs = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE(AssetCache)
+};
+
+} // namespace Aika
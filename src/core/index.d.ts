@@ -10,9 +10,15 @@ declare namespace Aika {
     sampleRate: SampleRate;
     channels: ChannelCount;
     rootNote: number;
+    rootNoteSource?: 'filename' | 'pitch' | 'default';
+    tuningCents?: number;
+    pitchConfidence?: number;
     loopStart?: number;
     loopEnd?: number;
     hasLoop: boolean;
+    loopSource?: 'metadata' | 'detected';
+    loopConfidence?: number;
+    loopAnalysisPending?: boolean;
   }
 
   export interface SampleRegion {
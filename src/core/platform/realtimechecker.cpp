@@ -0,0 +1,360 @@
+#include "realtimechecker.hpp"
+
+#if AIKA_REALTIME_CHECKS
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if JUCE_LINUX
+ #include <dlfcn.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <sys/select.h>
+ #include <sys/socket.h>
+ #include <time.h>
+ #include <unistd.h>
+#endif
+
+#if defined(__GNUC__)
+ #define AIKA_INITIAL_EXEC_TLS __attribute__((tls_model("initial-exec")))
+#else
+ #define AIKA_INITIAL_EXEC_TLS
+#endif
+
+namespace Aika {
+
+namespace {
+
+// Read from inside malloc, so thread-local access must never allocate itself
+thread_local int realtimeDepth AIKA_INITIAL_EXEC_TLS = 0;
+thread_local int suppressionDepth AIKA_INITIAL_EXEC_TLS = 0;
+
+std::atomic<int> numViolations { 0 };
+std::atomic<bool> abortOnViolation { false };
+std::atomic<bool> environmentRead { false };
+std::atomic<RealtimeChecker::Reporter> reporter { nullptr };
+
+// Call sites already reported, as hashes of their stack traces. Open
+// addressing in a fixed table; once it is full, everything is reported.
+constexpr int maxReportedSites = 256;
+std::atomic<juce::uint64> reportedSites[maxReportedSites];
+
+bool isFirstReport(juce::uint64 site) noexcept {
+    site = site != 0 ? site : 1;
+
+    for (int probe = 0; probe < maxReportedSites; ++probe) {
+        auto& slot = reportedSites[(site + static_cast<juce::uint64>(probe)) % maxReportedSites];
+        juce::uint64 expected = 0;
+        if (slot.compare_exchange_strong(expected, site))
+            return true;
+        if (expected == site)
+            return false;
+    }
+
+    return true;
+}
+
+void reportViolation(const char* violation) {
+    // Reporting allocates and writes, which must not recurse into the checks
+    ++suppressionDepth;
+    numViolations.fetch_add(1);
+
+    {
+        // Scoped so the trace is freed before checks resume
+        const auto stackTrace = juce::SystemStats::getStackBacktrace();
+        if (isFirstReport(static_cast<juce::uint64>(stackTrace.hashCode64()))) {
+            std::fprintf(stderr, "*** Real-time violation: %s on the audio thread\n%s\n", violation, stackTrace.toRawUTF8());
+            std::fflush(stderr);
+
+            if (const auto callback = reporter.load())
+                callback(violation, stackTrace.toRawUTF8());
+        }
+    }
+
+    if (abortOnViolation.load())
+        std::abort();
+
+    --suppressionDepth;
+}
+
+inline void check(const char* violation) {
+    if (realtimeDepth > 0 && suppressionDepth == 0)
+        reportViolation(violation);
+}
+
+} // namespace
+
+int RealtimeChecker::getNumViolations() noexcept {
+    return numViolations.load();
+}
+
+void RealtimeChecker::setAbortOnViolation(bool shouldAbort) noexcept {
+    abortOnViolation.store(shouldAbort);
+    environmentRead.store(true);
+}
+
+void RealtimeChecker::setReporter(Reporter newReporter) noexcept {
+    reporter.store(newReporter);
+}
+
+bool RealtimeChecker::isRealtimeThread() noexcept {
+    return realtimeDepth > 0;
+}
+
+ScopedRealtimeRegion::ScopedRealtimeRegion() noexcept {
+    // getenv doesn't allocate, so this is safe on the first audio callback
+    if (!environmentRead.exchange(true)) {
+        if (const char* value = std::getenv("AIKA_REALTIME_ABORT"))
+            abortOnViolation.store(value[0] == '1');
+    }
+
+    ++realtimeDepth;
+}
+
+ScopedRealtimeRegion::~ScopedRealtimeRegion() noexcept {
+    --realtimeDepth;
+}
+
+ScopedRealtimeSuppression::ScopedRealtimeSuppression() noexcept {
+    ++suppressionDepth;
+}
+
+ScopedRealtimeSuppression::~ScopedRealtimeSuppression() noexcept {
+    --suppressionDepth;
+}
+
+} // namespace Aika
+
+#if JUCE_LINUX
+
+//==============================================================================
+// Interposed C library and pthread functions. Allocation forwards to glibc's
+// own entry points; everything else to the next definition via dlsym.
+
+namespace {
+
+template <typename Function>
+Function findNext(std::atomic<void*>& cache, const char* name) noexcept {
+    void* function = cache.load(std::memory_order_acquire);
+    if (function == nullptr) {
+        function = dlsym(RTLD_NEXT, name);
+        cache.store(function, std::memory_order_release);
+    }
+    return reinterpret_cast<Function>(function);
+}
+
+} // namespace
+
+// Constant-initialized, so no static-init guard (which may itself lock) is involved
+#define AIKA_CALL_NEXT(name, ...)                                   \
+    static std::atomic<void*> next_##name { nullptr };              \
+    return findNext<decltype(&::name)>(next_##name, #name)(__VA_ARGS__)
+
+extern "C" {
+
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void __libc_free(void*);
+
+void* malloc(size_t size) {
+    Aika::check("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    Aika::check("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    Aika::check("realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) {
+    if (pointer != nullptr)
+        Aika::check("free");
+    __libc_free(pointer);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    Aika::check("posix_memalign");
+    *result = __libc_memalign(alignment, size);
+    return *result != nullptr ? 0 : ENOMEM;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    Aika::check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    Aika::check("pthread_mutex_lock");
+    AIKA_CALL_NEXT(pthread_mutex_lock, mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+    Aika::check("pthread_rwlock_rdlock");
+    AIKA_CALL_NEXT(pthread_rwlock_rdlock, lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+    Aika::check("pthread_rwlock_wrlock");
+    AIKA_CALL_NEXT(pthread_rwlock_wrlock, lock);
+}
+
+int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex) {
+    Aika::check("pthread_cond_wait");
+    AIKA_CALL_NEXT(pthread_cond_wait, condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time) {
+    Aika::check("pthread_cond_timedwait");
+    AIKA_CALL_NEXT(pthread_cond_timedwait, condition, mutex, time);
+}
+
+int pthread_join(pthread_t thread, void** result) {
+    Aika::check("pthread_join");
+    AIKA_CALL_NEXT(pthread_join, thread, result);
+}
+
+int sem_wait(sem_t* semaphore) {
+    Aika::check("sem_wait");
+    AIKA_CALL_NEXT(sem_wait, semaphore);
+}
+
+ssize_t read(int fd, void* buffer, size_t size) {
+    Aika::check("read");
+    AIKA_CALL_NEXT(read, fd, buffer, size);
+}
+
+ssize_t write(int fd, const void* buffer, size_t size) {
+    Aika::check("write");
+    AIKA_CALL_NEXT(write, fd, buffer, size);
+}
+
+ssize_t recv(int socket, void* buffer, size_t size, int flags) {
+    Aika::check("recv");
+    AIKA_CALL_NEXT(recv, socket, buffer, size, flags);
+}
+
+ssize_t send(int socket, const void* buffer, size_t size, int flags) {
+    Aika::check("send");
+    AIKA_CALL_NEXT(send, socket, buffer, size, flags);
+}
+
+int poll(struct pollfd* fds, nfds_t numFds, int timeout) {
+    Aika::check("poll");
+    AIKA_CALL_NEXT(poll, fds, numFds, timeout);
+}
+
+int select(int numFds, fd_set* readFds, fd_set* writeFds, fd_set* exceptFds, struct timeval* timeout) {
+    Aika::check("select");
+    AIKA_CALL_NEXT(select, numFds, readFds, writeFds, exceptFds, timeout);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+    Aika::check("nanosleep");
+    AIKA_CALL_NEXT(nanosleep, duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* duration, struct timespec* remaining) {
+    Aika::check("clock_nanosleep");
+    AIKA_CALL_NEXT(clock_nanosleep, clock, flags, duration, remaining);
+}
+
+int usleep(useconds_t microseconds) {
+    Aika::check("usleep");
+    AIKA_CALL_NEXT(usleep, microseconds);
+}
+
+unsigned int sleep(unsigned int seconds) {
+    Aika::check("sleep");
+    AIKA_CALL_NEXT(sleep, seconds);
+}
+
+} // extern "C"
+
+#undef AIKA_CALL_NEXT
+
+#else
+
+//==============================================================================
+// Elsewhere only the C++ allocation functions can be replaced portably
+
+void* operator new(std::size_t size) {
+    Aika::check("operator new");
+    if (void* pointer = std::malloc(size != 0 ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    Aika::check("operator new[]");
+    if (void* pointer = std::malloc(size != 0 ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    Aika::check("operator new");
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    Aika::check("operator new[]");
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer != nullptr)
+        Aika::check("operator delete");
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    if (pointer != nullptr)
+        Aika::check("operator delete[]");
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    operator delete[](pointer);
+}
+
+#endif
+
+#else
+
+namespace Aika {
+
+int RealtimeChecker::getNumViolations() noexcept {
+    return 0;
+}
+
+void RealtimeChecker::setAbortOnViolation(bool) noexcept {
+}
+
+void RealtimeChecker::setReporter(Reporter) noexcept {
+}
+
+bool RealtimeChecker::isRealtimeThread() noexcept {
+    return false;
+}
+
+} // namespace Aika
+
+#endif
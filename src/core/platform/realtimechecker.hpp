@@ -0,0 +1,100 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef AIKA_REALTIME_CHECKS
+ #define AIKA_REALTIME_CHECKS 0
+#endif
+
+namespace Aika {
+
+/**
+ * Debug/CI checker for real-time safety.
+ *
+ * Built with AIKA_REALTIME_CHECKS=1 (the OPENSAMPLER_REALTIME_CHECKS CMake
+ * option), calls that can block the audio thread are intercepted while a
+ * thread is inside a ScopedRealtimeRegion:
+ *   - heap allocation and deallocation (malloc family, operator new/delete)
+ *   - lock acquisition (pthread mutexes, rwlocks, condition variables, semaphores)
+ *   - blocking system calls (file and socket I/O, sleeps, polling, joins)
+ *
+ * Each violation is counted and written to stderr with a stack trace; a
+ * call site is reported once however often it repeats. Set the environment
+ * variable AIKA_REALTIME_ABORT=1, or call setAbortOnViolation, to abort on
+ * the first violation instead, so CI runs fail loudly.
+ *
+ * Interception works by symbol interposition, so it covers the whole process
+ * when the checker is linked into an executable (the standalone app or a
+ * headless harness), not when the plug-in is loaded into a host. C library
+ * and pthread calls are intercepted on Linux; other platforms only check
+ * operator new and delete.
+ *
+ * With checks disabled every type here compiles to nothing.
+ */
+class RealtimeChecker {
+public:
+    /**
+     * Receives each reported violation, after it has been written to stderr.
+     * Called with checks suspended, so it may allocate.
+     */
+    using Reporter = void (*)(const char* violation, const char* stackTrace);
+
+    /**
+     * @return True if checks are compiled in
+     */
+    static constexpr bool isEnabled() noexcept { return AIKA_REALTIME_CHECKS != 0; }
+
+    /**
+     * @return Violations seen since startup, including repeats of reported call sites
+     */
+    static int getNumViolations() noexcept;
+
+    static void setAbortOnViolation(bool shouldAbort) noexcept;
+    static void setReporter(Reporter reporter) noexcept;
+
+    /**
+     * @return True if the calling thread is inside a real-time region
+     */
+    static bool isRealtimeThread() noexcept;
+};
+
+#if AIKA_REALTIME_CHECKS
+
+/**
+ * Marks the calling thread as real-time for the lifetime of the object
+ */
+class ScopedRealtimeRegion {
+public:
+    ScopedRealtimeRegion() noexcept;
+    ~ScopedRealtimeRegion() noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeRegion)
+};
+
+/**
+ * Lets a real-time region make blocking calls it has vetted, such as a
+ * try-lock fallback. Use sparingly: what it hides still blocks.
+ */
+class ScopedRealtimeSuppression {
+public:
+    ScopedRealtimeSuppression() noexcept;
+    ~ScopedRealtimeSuppression() noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSuppression)
+};
+
+#else
+
+class ScopedRealtimeRegion {
+public:
+    ScopedRealtimeRegion() noexcept {}
+};
+
+class ScopedRealtimeSuppression {
+public:
+    ScopedRealtimeSuppression() noexcept {}
+};
+
+#endif
+
+} // namespace Aika
@@ -0,0 +1,246 @@
+#include "tracer.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <vector>
+
+namespace Aika {
+
+namespace {
+
+// Marks an instant in place of an end time
+constexpr juce::int64 instantEvent = -1;
+
+struct Event {
+    std::atomic<const char*> name { nullptr };
+    std::atomic<juce::int64> start { 0 };
+    std::atomic<juce::int64> end { 0 };
+};
+
+/**
+ * One thread's events. Written only by the thread that owns it; read by
+ * writeChromeTrace, which drops whatever may have been overwritten while it
+ * was copying. Never freed: each recording hands the rings out afresh,
+ * first to the threads that had them before.
+ */
+struct ThreadBuffer {
+    std::array<Event, Tracer::eventsPerThread> events;
+    std::atomic<juce::uint64> written { 0 };     // Events ever recorded
+    std::atomic<juce::uint64> clearedAt { 0 };   // Events before this one were cleared
+    std::atomic<const char*> name { nullptr };
+    std::atomic<bool> isOwned { false };
+    std::atomic<const void*> owner { nullptr };  // Token of the thread that last owned it
+    int index = 0;
+    ThreadBuffer* next = nullptr;
+};
+
+std::atomic<ThreadBuffer*> buffers { nullptr };
+std::atomic<int> numBuffers { 0 };
+
+// Bumped whenever recording starts, which frees every ring for claiming
+std::atomic<juce::uint32> recording { 0 };
+
+// Trivially initialized, so reading them costs no guard check, and nothing
+// has to run when the thread exits
+thread_local ThreadBuffer* currentBuffer = nullptr;
+thread_local juce::uint32 currentRecording = 0;
+thread_local char threadToken = 0;
+
+bool tryClaim(ThreadBuffer& buffer) noexcept {
+    bool owned = false;
+    return buffer.isOwned.compare_exchange_strong(owned, true);
+}
+
+ThreadBuffer* claimBuffer() noexcept {
+    // A thread takes back the ring it had, keeping its events, before taking a free one
+    const void* token = &threadToken;
+    for (auto* buffer = buffers.load(); buffer != nullptr; buffer = buffer->next) {
+        if (buffer->owner.load() == token && tryClaim(*buffer))
+            return buffer;
+    }
+
+    for (auto* buffer = buffers.load(); buffer != nullptr; buffer = buffer->next) {
+        if (tryClaim(*buffer)) {
+            buffer->owner.store(token);
+            buffer->name.store(nullptr);
+            buffer->clearedAt.store(buffer->written.load());
+            return buffer;
+        }
+    }
+
+    return nullptr;
+}
+
+ThreadBuffer* getThreadBuffer() noexcept {
+    const auto current = recording.load(std::memory_order_acquire);
+    if (currentRecording != current) {
+        currentRecording = current;
+        currentBuffer = claimBuffer();
+    }
+    return currentBuffer;
+}
+
+void record(const char* name, juce::int64 start, juce::int64 end) noexcept {
+    auto* threadBuffer = getThreadBuffer();
+    if (threadBuffer == nullptr)
+        return;
+
+    auto& buffer = *threadBuffer;
+    const auto position = buffer.written.load(std::memory_order_relaxed);
+
+    // Orders the slot writes after the previous publish, for the reader's overwrite check
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& event = buffer.events[static_cast<size_t>(position % Tracer::eventsPerThread)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+
+    buffer.written.store(position + 1, std::memory_order_release);
+}
+
+struct CopiedEvent {
+    const char* name;
+    juce::int64 start;
+    juce::int64 end;
+};
+
+std::vector<CopiedEvent> copyEvents(const ThreadBuffer& buffer) {
+    const auto capacity = static_cast<juce::uint64>(Tracer::eventsPerThread);
+    const auto written = buffer.written.load(std::memory_order_acquire);
+    auto first = std::max(buffer.clearedAt.load(), written > capacity ? written - capacity : 0);
+
+    std::vector<CopiedEvent> copied;
+    copied.reserve(static_cast<size_t>(written - first));
+    for (auto position = first; position < written; ++position) {
+        const auto& event = buffer.events[static_cast<size_t>(position % capacity)];
+        copied.push_back({ event.name.load(std::memory_order_relaxed),
+                           event.start.load(std::memory_order_relaxed),
+                           event.end.load(std::memory_order_relaxed) });
+    }
+
+    // The slot of the event being written now, and anything written since, may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto writtenAfter = buffer.written.load(std::memory_order_relaxed);
+    const auto firstIntact = writtenAfter >= capacity ? writtenAfter - capacity + 1 : 0;
+    if (firstIntact > first)
+        copied.erase(copied.begin(), copied.begin() + static_cast<std::ptrdiff_t>(std::min(firstIntact - first, static_cast<juce::uint64>(copied.size()))));
+
+    return copied;
+}
+
+juce::String quoted(const char* text) {
+    return juce::JSON::toString(juce::var(juce::String::fromUTF8(text)));
+}
+
+} // namespace
+
+void Tracer::setEnabled(bool shouldBeEnabled) {
+    if (shouldBeEnabled && !enabled.load()) {
+        // Nothing records while tracing is off, so the rings can be handed out again
+        while (numBuffers.load() < getMaxThreads()) {
+            auto* buffer = new ThreadBuffer();
+            buffer->index = ++numBuffers;
+            buffer->next = buffers.load();
+            while (!buffers.compare_exchange_weak(buffer->next, buffer)) {
+            }
+        }
+
+        for (auto* buffer = buffers.load(); buffer != nullptr; buffer = buffer->next)
+            buffer->isOwned.store(false);
+        ++recording;
+    }
+
+    enabled.store(shouldBeEnabled);
+}
+
+int Tracer::getMaxThreads() noexcept {
+    return juce::SystemStats::getNumCpus() + 4;
+}
+
+void Tracer::clear() noexcept {
+    for (auto* buffer = buffers.load(); buffer != nullptr; buffer = buffer->next)
+        buffer->clearedAt.store(buffer->written.load());
+}
+
+void Tracer::nameThread(const char* name) noexcept {
+    if (auto* buffer = getThreadBuffer())
+        buffer->name.store(name, std::memory_order_relaxed);
+}
+
+void Tracer::addSpan(const char* name, juce::int64 startTicks, juce::int64 endTicks) noexcept {
+    record(name, startTicks, endTicks);
+}
+
+void Tracer::addInstant(const char* name) noexcept {
+    record(name, juce::Time::getHighResolutionTicks(), instantEvent);
+}
+
+void Tracer::writeChromeTrace(juce::OutputStream& stream) {
+    struct ThreadEvents {
+        int index;
+        const char* name;
+        std::vector<CopiedEvent> events;
+    };
+
+    std::vector<ThreadEvents> threads;
+    juce::int64 origin = std::numeric_limits<juce::int64>::max();
+    for (auto* buffer = buffers.load(); buffer != nullptr; buffer = buffer->next) {
+        threads.push_back({ buffer->index, buffer->name.load(std::memory_order_relaxed), copyEvents(*buffer) });
+        for (const auto& event : threads.back().events)
+            origin = std::min(origin, event.start);
+    }
+
+    // Timestamps in microseconds from the first event
+    const double microsecondsPerTick = 1.0e6 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+    const auto toMicroseconds = [microsecondsPerTick](juce::int64 ticks) {
+        return juce::String(static_cast<double>(ticks) * microsecondsPerTick, 3);
+    };
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool isFirst = true;
+    const auto separator = [&stream, &isFirst] {
+        if (!isFirst)
+            stream << ",\n";
+        isFirst = false;
+    };
+
+    for (const auto& thread : threads) {
+        if (thread.events.empty())
+            continue;
+
+        const auto tid = juce::String(thread.index);
+        const auto threadName = thread.name != nullptr ? quoted(thread.name) : quoted(("Thread " + tid).toRawUTF8());
+
+        separator();
+        stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+               << ",\"args\":{\"name\":" << threadName << "}}";
+
+        for (const auto& event : thread.events) {
+            separator();
+            stream << "{\"name\":" << quoted(event.name) << ",\"cat\":\"aika\",\"pid\":1,\"tid\":" << tid
+                   << ",\"ts\":" << toMicroseconds(event.start - origin);
+
+            if (event.end == instantEvent)
+                stream << ",\"ph\":\"i\",\"s\":\"t\"}";
+            else
+                stream << ",\"ph\":\"X\",\"dur\":" << toMicroseconds(event.end - event.start) << "}";
+        }
+    }
+
+    stream << "]}\n";
+}
+
+bool Tracer::saveChromeTrace(const juce::File& file) {
+    juce::FileOutputStream stream(file);
+    if (!stream.openedOk())
+        return false;
+
+    stream.setPosition(0);
+    stream.truncate();
+    writeChromeTrace(stream);
+    stream.flush();
+    return stream.getStatus().wasOk();
+}
+
+} // namespace Aika
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+#ifndef AIKA_TRACING
+ #define AIKA_TRACING 1
+#endif
+
+namespace Aika {
+
+/**
+ * Scoped trace markers for the hot paths, exported as a Chrome trace.
+ *
+ * Each thread records into its own fixed ring of events, so recording never
+ * locks or allocates. Rings are allocated when recording starts, one per
+ * thread expected to record, and each thread claims one at its first event
+ * of the recording; threads beyond that are not traced. Rings keep the most
+ * recent eventsPerThread events; older ones are overwritten. While tracing
+ * is off a marker costs one relaxed load.
+ *
+ * The JSON written by writeChromeTrace loads in chrome://tracing and in
+ * Perfetto (ui.perfetto.dev).
+ *
+ * Building with AIKA_TRACING=0 removes the markers entirely.
+ */
+class Tracer {
+public:
+    static constexpr int eventsPerThread = 16384;
+
+    static bool isEnabled() noexcept { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Start or stop recording. Events already recorded are kept. Starting
+     * allocates the rings threads record into, so not for the audio thread.
+     */
+    static void setEnabled(bool shouldBeEnabled);
+
+    /**
+     * @return Number of threads a recording can trace: the audio and message
+     *         threads, background workers, and a few to spare
+     */
+    static int getMaxThreads() noexcept;
+
+    /**
+     * Forget every recorded event. Not for the audio thread.
+     */
+    static void clear() noexcept;
+
+    /**
+     * Name the calling thread in the trace
+     *
+     * @param name A string literal, or anything else that is never freed
+     */
+    static void nameThread(const char* name) noexcept;
+
+    /**
+     * Record a span. Names must be string literals, as only the pointer is stored.
+     *
+     * @param name What ran
+     * @param startTicks juce::Time::getHighResolutionTicks() when it started
+     * @param endTicks juce::Time::getHighResolutionTicks() when it ended
+     */
+    static void addSpan(const char* name, juce::int64 startTicks, juce::int64 endTicks) noexcept;
+
+    /**
+     * Record a point in time, such as an xrun
+     */
+    static void addInstant(const char* name) noexcept;
+
+    /**
+     * Write everything recorded so far in Chrome's trace event format.
+     * Safe while other threads keep recording. Not for the audio thread.
+     */
+    static void writeChromeTrace(juce::OutputStream& stream);
+
+    /**
+     * @return False if the file couldn't be written
+     */
+    static bool saveChromeTrace(const juce::File& file);
+
+private:
+    static inline std::atomic<bool> enabled { false };
+};
+
+/**
+ * Records the lifetime of the object as a span, if tracing is on when it is created
+ */
+class ScopedTrace {
+public:
+    explicit ScopedTrace(const char* traceName) noexcept
+        : name(Tracer::isEnabled() ? traceName : nullptr),
+          startTicks(name != nullptr ? juce::Time::getHighResolutionTicks() : 0) {}
+
+    ~ScopedTrace() noexcept {
+        if (name != nullptr)
+            Tracer::addSpan(name, startTicks, juce::Time::getHighResolutionTicks());
+    }
+
+private:
+    const char* const name;
+    const juce::int64 startTicks;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedTrace)
+};
+
+} // namespace Aika
+
+#if AIKA_TRACING
+ #define AIKA_TRACE_SCOPE(name) const Aika::ScopedTrace JUCE_JOIN_MACRO(aikaTrace, __LINE__) (name)
+ #define AIKA_TRACE_INSTANT(name) do { if (Aika::Tracer::isEnabled()) Aika::Tracer::addInstant(name); } while (false)
+ #define AIKA_TRACE_THREAD(name) do { if (Aika::Tracer::isEnabled()) Aika::Tracer::nameThread(name); } while (false)
+#else
+ #define AIKA_TRACE_SCOPE(name)
+ #define AIKA_TRACE_INSTANT(name) do {} while (false)
+ #define AIKA_TRACE_THREAD(name) do {} while (false)
+#endif
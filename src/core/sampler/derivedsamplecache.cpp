@@ -0,0 +1,187 @@
+#include "derivedsamplecache.hpp"
+#include "core/dsp/resample/resampler.hpp"
+#include "core/dsp/timestretch/timestretch.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+namespace {
+
+// Ratios and times closer than a millionth share a render; at a few seconds that is well under a sample
+juce::int64 quantize(double value) noexcept {
+    return std::llround(value * 1.0e6);
+}
+
+juce::uint64 getHash(const SampleTransform::Key& key) noexcept {
+    // FNV-1a over the key's values
+    juce::uint64 hash = 14695981039346656037ull;
+    for (const auto value : key) {
+        auto bits = static_cast<juce::uint64>(value);
+        for (int byte = 0; byte < 8; ++byte, bits >>= 8) {
+            hash ^= bits & 0xff;
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+} // namespace
+
+bool SampleTransform::isPlainRegion() const noexcept {
+    const auto key = getKey();
+    return !reverse && !normalize && key[4] == quantize(1.0) && key[5] == 0 && key[6] == 0 && key[7] == 0;
+}
+
+SampleTransform::Key SampleTransform::getKey() const noexcept {
+    return { startFrame, endFrame, reverse ? 1 : 0, normalize ? 1 : 0,
+             quantize(stretchRatio), quantize(std::max(0.0, fadeIn)), quantize(std::max(0.0, fadeOut)),
+             quantize(std::max(0.0, targetRate)) };
+}
+
+SampleTransform SampleTransform::forPad(const Pad& pad, const Sample& sample, double tempo, double outputRate) {
+    const auto& settings = pad.settings;
+    const double sourceRate = sample.getSampleRate();
+    const int numFrames = sample.getNumFrames();
+
+    SampleTransform transform;
+    transform.startFrame = juce::jlimit(0, numFrames, static_cast<int>(settings.start * sourceRate));
+    transform.endFrame = settings.end > 0.0 ? juce::jlimit(transform.startFrame, numFrames, static_cast<int>(settings.end * sourceRate)) : numFrames;
+    transform.reverse = settings.reverse;
+    transform.normalize = settings.normalize;
+    transform.fadeIn = settings.fadeIn;
+    transform.fadeOut = settings.fadeOut;
+
+    // Ratios beyond what the stretch handles well play at the sample's own speed, as do
+    // ratios too close to 1 to hear
+    const int regionFrames = transform.endFrame - transform.startFrame;
+    if (tempo > 0.0 && settings.syncBeats > 0.0 && regionFrames >= 2) {
+        const double ratio = (settings.syncBeats * 60.0 / tempo) / (regionFrames / sourceRate);
+        if (std::abs(ratio - 1.0) >= 1.0e-4 && ratio >= DSP::TimeStretch::minRatio && ratio <= DSP::TimeStretch::maxRatio)
+            transform.stretchRatio = ratio;
+    }
+
+    if (outputRate > 0.0 && outputRate != sourceRate)
+        transform.targetRate = outputRate;
+    return transform;
+}
+
+std::shared_ptr<Sample> DerivedSampleCache::render(const Sample& stored, const SampleTransform& transform) {
+    jassert(transform.startFrame >= 0 && transform.startFrame < transform.endFrame && transform.endFrame <= stored.getNumFrames());
+
+    // An evicted source is read back from disk, rather than rendered from its head
+    const Sample* full = stored.loadFull();
+    if (full == nullptr)
+        return nullptr;
+
+    const Sample& source = *full;
+    double sampleRate = source.getSampleRate();
+    const int regionFrames = transform.endFrame - transform.startFrame;
+
+    juce::AudioBuffer<float> audio(source.getNumChannels(), regionFrames);
+    for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        source.readFrames(channel, transform.startFrame, regionFrames, audio.getWritePointer(channel));
+
+    if (transform.reverse)
+        audio.reverse(0, regionFrames);
+
+    if (transform.normalize) {
+        const float peak = audio.getMagnitude(0, regionFrames);
+        if (peak > 0.0f)
+            audio.applyGain(1.0f / peak);
+    }
+
+    if (quantize(transform.stretchRatio) != quantize(1.0))
+        audio = DSP::TimeStretch::process(audio, transform.stretchRatio, sampleRate);
+
+    if (transform.targetRate > 0.0 && quantize(transform.targetRate) != quantize(sampleRate)) {
+        audio = DSP::Resampler::process(audio, sampleRate, transform.targetRate);
+        sampleRate = transform.targetRate;
+    }
+
+    // Fades longer than the render are cut short, fade-in first
+    const int numFrames = audio.getNumSamples();
+    const int fadeInFrames = std::min(numFrames, static_cast<int>(std::max(0.0, transform.fadeIn) * sampleRate));
+    const int fadeOutFrames = std::min(numFrames - fadeInFrames, static_cast<int>(std::max(0.0, transform.fadeOut) * sampleRate));
+    if (fadeInFrames > 0)
+        audio.applyGainRamp(0, fadeInFrames, 0.0f, 1.0f);
+    if (fadeOutFrames > 0)
+        audio.applyGainRamp(numFrames - fadeOutFrames, fadeOutFrames, 1.0f, 0.0f);
+
+    // The source's loop points don't survive cutting and reversing
+    auto sample = std::make_shared<Sample>(audio, sampleRate, source.getName());
+    auto metadata = source.getMetadata();
+    metadata.loopStart = -1;
+    metadata.loopEnd = -1;
+    sample->setMetadata(metadata);
+    return sample;
+}
+
+std::shared_ptr<const Sample> DerivedSampleCache::findLocked(const std::shared_ptr<const Sample>& source, juce::uint64 hash,
+                                                             const SampleTransform::Key& key) {
+    for (auto& entry : entries) {
+        if (entry.hash == hash && entry.key == key && entry.sourceId == source->getAudioId()) {
+            // The source may have been evicted to a head since, which has the same audio
+            entry.source = source;
+            entry.lastUsed = ++useCounter;
+            return entry.rendered;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const Sample> DerivedSampleCache::get(const std::shared_ptr<const Sample>& source, const SampleTransform& transform) {
+    jassert(source != nullptr);
+    const auto key = transform.getKey();
+    const auto hash = getHash(key);
+
+    {
+        const juce::ScopedLock scopedLock(lock);
+        if (auto rendered = findLocked(source, hash, key))
+            return rendered;
+    }
+
+    // Render without the lock, so lookups for other pads aren't held up
+    std::shared_ptr<const Sample> sample = render(*source, transform);
+    if (sample == nullptr)
+        return nullptr;
+
+    const juce::ScopedLock scopedLock(lock);
+    if (auto rendered = findLocked(source, hash, key))
+        return rendered;
+
+    entries.push_back({ source, source->getAudioId(), hash, key, sample, ++useCounter });
+    evictLocked();
+    return sample;
+}
+
+void DerivedSampleCache::evictLocked() {
+    // Renders only the cache holds are idle; anything else would stay in memory anyway.
+    // Those still played keep their entry even once their source is gone, in case it
+    // was only evicted to a head.
+    const auto isIdle = [](const Entry& entry) { return entry.rendered.use_count() == 1; };
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&isIdle](const Entry& entry) { return entry.source.expired() && isIdle(entry); }),
+                  entries.end());
+
+    size_t idleBytes = 0;
+    for (const auto& entry : entries)
+        if (isIdle(entry))
+            idleBytes += entry.rendered->getSizeInBytes();
+
+    while (idleBytes > maxIdleBytes) {
+        auto oldest = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+            if (isIdle(*it) && (oldest == entries.end() || it->lastUsed < oldest->lastUsed))
+                oldest = it;
+
+        idleBytes -= oldest->rendered->getSizeInBytes();
+        entries.erase(oldest);
+    }
+}
+
+void DerivedSampleCache::clear() {
+    const juce::ScopedLock scopedLock(lock);
+    entries.clear();
+}
+
+} // namespace Aika
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "kit.hpp"
+#include "sample.hpp"
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Edits rendered into a derived sample. They apply in this order: the
+ * region is cut out, reversed, normalized, stretched, converted to the
+ * target rate, then faded, so fades are heard at the length given whatever
+ * the stretch.
+ */
+struct SampleTransform {
+    int startFrame = 0;
+    int endFrame = 0;            // One past the last frame of the region
+    bool reverse = false;
+    bool normalize = false;      // Scale the peak to 0 dBFS
+    double stretchRatio = 1.0;   // Output length over input length
+    double fadeIn = 0.0;         // Seconds
+    double fadeOut = 0.0;        // Seconds
+    double targetRate = 0.0;     // Sample rate to convert to in Hz, 0 to keep the source's
+
+    /**
+     * @return True if the transform only cuts out the region, which a voice plays directly
+     */
+    bool isPlainRegion() const noexcept;
+
+    /**
+     * The transform with its values rounded to what can be heard: transforms
+     * with equal keys render the same
+     */
+    using Key = std::array<juce::int64, 8>;
+    Key getKey() const noexcept;
+
+    /**
+     * The transform a pad's region plays through: its trim and edits, a
+     * stretch to its length in beats if it is tempo synced, and a conversion
+     * to the output rate
+     *
+     * @param pad The pad
+     * @param sample The pad's sample, or one of its layers
+     * @param tempo Host tempo in BPM, or 0 if the host gives none, which leaves synced pads unstretched
+     * @param outputRate Sample rate to convert to, or 0 to play the sample at its own rate
+     */
+    static SampleTransform forPad(const Pad& pad, const Sample& sample, double tempo, double outputRate);
+};
+
+/**
+ * Samples derived from others by a SampleTransform, rendered once and shared.
+ *
+ * Renders are memoized by source sample and transform, so pads with the same
+ * edits of one sample share a buffer, and going back to an earlier tempo or
+ * edit costs a lookup. Playing a derived sample is a plain buffer read
+ * however many edits went into it.
+ *
+ * Renders still referenced elsewhere, e.g. by a kit the engine plays, are
+ * always kept. The rest are kept up to maxIdleBytes, least recently used
+ * going first, and those whose source sample is gone are dropped. Renders
+ * are matched to sources by audio id, so they outlive a source's eviction.
+ */
+class DerivedSampleCache {
+public:
+    static constexpr size_t maxIdleBytes = 128 * 1024 * 1024;
+
+    DerivedSampleCache() = default;
+
+    /**
+     * Find or render a derived sample. Rendering takes a while and
+     * allocates, so call this from a background thread. Thread safe.
+     *
+     * @param source Sample to derive from
+     * @param transform Edits to render; the region must lie within source
+     * @return The rendered region, as a sample of its own, or nullptr if an evicted source could not be read back
+     */
+    std::shared_ptr<const Sample> get(const std::shared_ptr<const Sample>& source, const SampleTransform& transform);
+
+    /**
+     * Forget every render
+     */
+    void clear();
+
+    /**
+     * Render a transform without caching it
+     *
+     * @param source Sample to derive from
+     * @param transform Edits to render; the region must lie within source
+     * @return The rendered region, or nullptr if an evicted source could not be read back
+     */
+    static std::shared_ptr<Sample> render(const Sample& source, const SampleTransform& transform);
+
+private:
+    struct Entry {
+        std::weak_ptr<const Sample> source;
+        juce::uint64 sourceId = 0;   // Audio id of the source, kept when it is evicted
+        juce::uint64 hash = 0;
+        SampleTransform::Key key {};
+        std::shared_ptr<const Sample> rendered;
+        juce::uint32 lastUsed = 0;
+    };
+
+    std::shared_ptr<const Sample> findLocked(const std::shared_ptr<const Sample>& source, juce::uint64 hash, const SampleTransform::Key& key);
+    void evictLocked();
+
+    juce::CriticalSection lock;
+    std::vector<Entry> entries;     // Guarded by lock
+    juce::uint32 useCounter = 0;    // Guarded by lock
+
+    JUCE_DECLARE_NON_COPYABLE(DerivedSampleCache)
+};
+
+} // namespace Aika
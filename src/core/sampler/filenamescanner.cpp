@@ -0,0 +1,247 @@
+#include "filenamescanner.hpp"
+
+namespace Aika {
+
+namespace {
+
+inline bool isAlpha(char c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+inline bool isDigit(char c) noexcept {
+    return c >= '0' && c <= '9';
+}
+
+inline char toLower(char c) noexcept {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool isDigitAt(std::string_view s, size_t i) noexcept {
+    return i < s.size() && isDigit(s[i]);
+}
+
+// Reads up to maxDigits decimal digits starting at i. Returns the number of
+// digits consumed (0 if none, or if more than maxDigits follow).
+size_t readNumber(std::string_view s, size_t i, size_t maxDigits, int& value) noexcept {
+    size_t n = 0;
+    int v = 0;
+    while (i + n < s.size() && isDigit(s[i + n])) {
+        if (n == maxDigits)
+            return 0;
+        v = v * 10 + (s[i + n] - '0');
+        ++n;
+    }
+    value = v;
+    return n;
+}
+
+// Case-insensitive prefix match of a lowercase literal
+bool matchesLower(std::string_view s, size_t i, std::string_view lowerLiteral) noexcept {
+    if (s.size() - i < lowerLiteral.size())
+        return false;
+    for (size_t k = 0; k < lowerLiteral.size(); ++k) {
+        if (toLower(s[i + k]) != lowerLiteral[k])
+            return false;
+    }
+    return true;
+}
+
+// Note names ("C3", "F#2", "Bb-1"). Uppercase letter only, as before.
+bool tryNote(std::string_view s, size_t i, int& note) noexcept {
+    static constexpr int letterOffsets[7] = { 9, 11, 0, 2, 4, 5, 7 }; // A..G
+
+    const char letter = s[i];
+    if (letter < 'A' || letter > 'G')
+        return false;
+
+    int semitone = letterOffsets[letter - 'A'];
+    size_t p = i + 1;
+
+    if (p < s.size() && s[p] == '#') {
+        ++semitone;
+        ++p;
+    } else if (p < s.size() && s[p] == 'b' && (isDigitAt(s, p + 1) || (p + 1 < s.size() && s[p + 1] == '-'))) {
+        --semitone;
+        ++p;
+    }
+
+    bool negative = false;
+    if (p < s.size() && s[p] == '-') {
+        negative = true;
+        ++p;
+    }
+
+    if (!isDigitAt(s, p) || isDigitAt(s, p + 1))
+        return false;
+
+    const int octave = negative ? -(s[p] - '0') : (s[p] - '0');
+    const int midiNote = (octave + 1) * 12 + semitone;
+    if (midiNote < 0 || midiNote > 127)
+        return false;
+
+    note = midiNote;
+    return true;
+}
+
+// Velocities ("v100", "vel127") and ranges ("v1-63", "vel64~127")
+bool tryVelocity(std::string_view s, size_t i, FilenameInfo& info) noexcept {
+    if (toLower(s[i]) != 'v')
+        return false;
+
+    size_t p = i + 1;
+    if (matchesLower(s, p, "el"))
+        p += 2;
+
+    int low = 0;
+    const size_t lowDigits = readNumber(s, p, 3, low);
+    if (lowDigits == 0 || low > 127)
+        return false;
+    p += lowDigits;
+
+    int high = low;
+    if (p < s.size() && (s[p] == '-' || s[p] == '~')) {
+        int rangeEnd = 0;
+        const size_t highDigits = readNumber(s, p + 1, 3, rangeEnd);
+        if (highDigits > 0 && rangeEnd <= 127 && rangeEnd >= low)
+            high = rangeEnd;
+    }
+
+    info.velocity = high;
+    info.velocityLow = low;
+    info.velocityHigh = high;
+    return true;
+}
+
+// Round-robin tags ("rr2", "RR03")
+bool tryRoundRobin(std::string_view s, size_t i, int& roundRobin) noexcept {
+    if (!matchesLower(s, i, "rr"))
+        return false;
+
+    int value = 0;
+    if (readNumber(s, i + 2, 3, value) == 0)
+        return false;
+
+    roundRobin = value;
+    return true;
+}
+
+struct ArticulationWord {
+    std::string_view word;
+    Articulation articulation;
+};
+
+constexpr ArticulationWord articulationWords[] = {
+    { "sus", Articulation::Sustain },     { "sustain", Articulation::Sustain },
+    { "stac", Articulation::Staccato },   { "stacc", Articulation::Staccato },
+    { "staccato", Articulation::Staccato },
+    { "leg", Articulation::Legato },      { "legato", Articulation::Legato },
+    { "pizz", Articulation::Pizzicato },  { "pizzicato", Articulation::Pizzicato },
+    { "trem", Articulation::Tremolo },    { "tremolo", Articulation::Tremolo },
+    { "mute", Articulation::Muted },      { "muted", Articulation::Muted },
+    { "damp", Articulation::Muted },
+    { "open", Articulation::Open },
+    { "close", Articulation::Closed },    { "closed", Articulation::Closed },
+    { "rim", Articulation::Rimshot },     { "rimshot", Articulation::Rimshot },
+    { "ghost", Articulation::Ghost },
+    { "flam", Articulation::Flam },
+    { "roll", Articulation::Roll },
+    { "acc", Articulation::Accent },      { "accent", Articulation::Accent },
+    { "rel", Articulation::Release },     { "release", Articulation::Release }
+};
+
+// Whole alphabetic words only, so "rimshot" never matches "rim"
+Articulation matchArticulation(std::string_view s, size_t i, size_t& wordLength) noexcept {
+    size_t end = i;
+    while (end < s.size() && isAlpha(s[end]))
+        ++end;
+    wordLength = end - i;
+
+    for (const auto& entry : articulationWords) {
+        if (entry.word.size() == wordLength && matchesLower(s, i, entry.word))
+            return entry.articulation;
+    }
+    return Articulation::None;
+}
+
+std::string_view getStem(std::string_view path) noexcept {
+    const size_t slash = path.find_last_of("/\\");
+    if (slash != std::string_view::npos)
+        path.remove_prefix(slash + 1);
+
+    const size_t dot = path.find_last_of('.');
+    if (dot != std::string_view::npos && dot > 0)
+        path = path.substr(0, dot);
+
+    return path;
+}
+
+} // namespace
+
+FilenameInfo FilenameScanner::scan(std::string_view filename) noexcept {
+    FilenameInfo info;
+    const std::string_view s = getStem(filename);
+
+    size_t i = 0;
+    while (i < s.size()) {
+        const bool atWordStart = (i == 0 || !isAlpha(s[i - 1])) && isAlpha(s[i]);
+        if (!atWordStart) {
+            ++i;
+            continue;
+        }
+
+        // First match of each kind wins, matching the previous regex behaviour
+        if (info.rootNote < 0 && tryNote(s, i, info.rootNote)) {
+            ++i;
+            continue;
+        }
+        if (info.velocity < 0 && tryVelocity(s, i, info)) {
+            ++i;
+            continue;
+        }
+        if (info.roundRobin < 0 && tryRoundRobin(s, i, info.roundRobin)) {
+            ++i;
+            continue;
+        }
+
+        size_t wordLength = 1;
+        if (info.articulation == Articulation::None)
+            info.articulation = matchArticulation(s, i, wordLength);
+        else
+            while (i + wordLength < s.size() && isAlpha(s[i + wordLength]))
+                ++wordLength;
+
+        i += wordLength;
+    }
+
+    return info;
+}
+
+void FilenameScanner::scanBatch(const std::vector<std::string>& filenames, std::vector<FilenameInfo>& results) {
+    results.resize(filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        results[i] = scan(filenames[i]);
+    }
+}
+
+const char* FilenameScanner::getArticulationName(Articulation articulation) noexcept {
+    switch (articulation) {
+        case Articulation::Sustain:   return "sustain";
+        case Articulation::Staccato:  return "staccato";
+        case Articulation::Legato:    return "legato";
+        case Articulation::Pizzicato: return "pizzicato";
+        case Articulation::Tremolo:   return "tremolo";
+        case Articulation::Muted:     return "muted";
+        case Articulation::Open:      return "open";
+        case Articulation::Closed:    return "closed";
+        case Articulation::Rimshot:   return "rimshot";
+        case Articulation::Ghost:     return "ghost";
+        case Articulation::Flam:      return "flam";
+        case Articulation::Roll:      return "roll";
+        case Articulation::Accent:    return "accent";
+        case Articulation::Release:   return "release";
+        case Articulation::None:      break;
+    }
+    return "";
+}
+
+} // namespace Aika
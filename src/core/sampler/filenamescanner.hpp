@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Playing-technique keywords recognised in sample filenames
+ */
+enum class Articulation : std::uint8_t {
+    None = 0,
+    Sustain,
+    Staccato,
+    Legato,
+    Pizzicato,
+    Tremolo,
+    Muted,
+    Open,
+    Closed,
+    Rimshot,
+    Ghost,
+    Flam,
+    Roll,
+    Accent,
+    Release
+};
+
+/**
+ * Metadata extracted from a sample filename. Plain data, never allocates.
+ */
+struct FilenameInfo {
+    int rootNote = -1;       // MIDI note number, -1 if absent
+    int velocity = -1;       // Velocity (upper bound for ranges), -1 if absent
+    int velocityLow = -1;    // Lower bound of a velocity range, -1 if absent
+    int velocityHigh = -1;   // Upper bound of a velocity range, -1 if absent
+    int roundRobin = -1;     // Round-robin index from "rr2" style tags, -1 if absent
+    Articulation articulation = Articulation::None;
+};
+
+/**
+ * Single-pass scanner for sample naming conventions.
+ *
+ * Recognises notes ("C3", "F#2", "Bb-1"), velocities ("v100", "vel127"),
+ * velocity ranges ("v1-63", "vel64~127"), round-robin tags ("rr2") and
+ * articulation words ("stac", "legato", "closed", ...). Tokens must start
+ * on a word boundary, so "BD1" is not read as the note D1.
+ */
+class FilenameScanner {
+public:
+    /**
+     * Scan a filename or path. Only the stem (no directory, no extension) is inspected.
+     *
+     * @param filename The filename or path to analyze
+     * @return Extracted metadata; fields not present are left at their defaults
+     */
+    static FilenameInfo scan(std::string_view filename) noexcept;
+
+    /**
+     * Scan a list of filenames in one go
+     *
+     * @param filenames Filenames or paths to analyze
+     * @param results Receives one entry per filename, in the same order
+     */
+    static void scanBatch(const std::vector<std::string>& filenames, std::vector<FilenameInfo>& results);
+
+    /**
+     * Get a stable lowercase name for an articulation
+     *
+     * @param articulation The articulation
+     * @return Name such as "staccato", or an empty string for Articulation::None
+     */
+    static const char* getArticulationName(Articulation articulation) noexcept;
+};
+
+} // namespace Aika
@@ -0,0 +1,96 @@
+#include "instrument.hpp"
+#include <map>
+#include <numeric>
+
+namespace Aika {
+
+Instrument::Instrument(const juce::String& instrumentName, std::vector<Region> instrumentRegions)
+    : name(instrumentName),
+      regions(std::move(instrumentRegions)) {
+    for (size_t i = 0; i < regions.size(); ++i)
+        regions[i].id = static_cast<int>(i);
+
+    compile();
+}
+
+void Instrument::compile() {
+    table.assign(static_cast<size_t>(numNotes * numVelocities), 0);
+    cells.assign(1, Cell {});
+    steps.assign(1, Step {});
+    regionIndices.clear();
+
+    // Cells are shared by every note/velocity pair that selects the same regions
+    std::map<std::vector<juce::uint32>, juce::uint32> cellIds;
+    std::vector<juce::uint32> noteRegions;
+    std::vector<juce::uint32> matching;
+
+    for (int note = 0; note < numNotes; ++note) {
+        noteRegions.clear();
+        for (size_t i = 0; i < regions.size(); ++i) {
+            if (regions[i].sample != nullptr && note >= regions[i].loKey && note <= regions[i].hiKey)
+                noteRegions.push_back(static_cast<juce::uint32>(i));
+        }
+
+        if (noteRegions.empty())
+            continue;
+
+        for (int velocity = 0; velocity < numVelocities; ++velocity) {
+            matching.clear();
+            for (const auto index : noteRegions) {
+                if (velocity >= regions[index].loVelocity && velocity <= regions[index].hiVelocity)
+                    matching.push_back(index);
+            }
+
+            if (matching.empty())
+                continue;
+
+            const auto [it, inserted] = cellIds.emplace(matching, static_cast<juce::uint32>(cells.size()));
+            if (inserted) {
+                // One step per slot of the combined round-robin cycle
+                juce::uint32 cycle = 1;
+                juce::uint32 longest = 1;
+                for (const auto index : matching) {
+                    const auto length = static_cast<juce::uint32>(std::max(1, regions[index].seqLength));
+                    cycle = std::lcm(cycle, length);
+                    longest = std::max(longest, length);
+                }
+                if (cycle > maxRoundRobinSteps)
+                    cycle = longest;
+
+                Cell cell;
+                cell.firstStep = static_cast<juce::uint32>(steps.size());
+                cell.numSteps = cycle;
+
+                for (juce::uint32 step = 0; step < cycle; ++step) {
+                    Step entry;
+                    entry.offset = static_cast<juce::uint32>(regionIndices.size());
+
+                    for (const auto index : matching) {
+                        const auto length = static_cast<juce::uint32>(std::max(1, regions[index].seqLength));
+                        const auto slot = static_cast<juce::uint32>(std::max(1, regions[index].seqPosition) - 1) % length;
+                        if (step % length == slot)
+                            regionIndices.push_back(index);
+                    }
+
+                    entry.count = static_cast<juce::uint32>(regionIndices.size()) - entry.offset;
+                    steps.push_back(entry);
+                }
+
+                cells.push_back(cell);
+            }
+
+            table[static_cast<size_t>(note * numVelocities + velocity)] = it->second;
+        }
+    }
+}
+
+Instrument::Layers Instrument::findRegions(int note, int velocity, juce::uint32 roundRobin) const noexcept {
+    const auto cellIndex = table[static_cast<size_t>(juce::jlimit(0, numNotes - 1, note) * numVelocities
+                                                   + juce::jlimit(0, numVelocities - 1, velocity))];
+    const auto& cell = cells[cellIndex];
+    const auto& step = steps[cell.firstStep + roundRobin % cell.numSteps];
+
+    return { regionIndices.data() + step.offset, static_cast<int>(step.count) };
+}
+
+} // namespace Aika
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "sample.hpp"
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Everything a voice needs to play one region, with every opcode or
+ * generator already resolved. Pads and imported instruments both end up
+ * as Regions, so the voice has a single playback path.
+ */
+struct Region {
+    enum class LoopMode : juce::uint8 {
+        NoLoop,       // Play once, release on note-off
+        OneShot,      // Play once, ignore note-off
+        Continuous,   // Loop until the release has faded out
+        Sustain       // Loop while the key is held, then play through to the end
+    };
+
+    std::shared_ptr<const Sample> sample;
+    int id = -1;                 // Pad id, or index in the instrument
+    int padId = -1;              // Pad that owns this region, -1 for instrument regions
+
+    int loKey = 0;
+    int hiKey = 127;
+    int loVelocity = 0;
+    int hiVelocity = 127;
+
+    int pitchKeycenter = 60;
+    float pitchKeytrack = 100.0f;  // Cents per key away from pitchKeycenter
+    float tune = 0.0f;             // Cents, including transpose
+
+    float gain = 1.0f;           // Linear
+    float pan = 0.0f;            // -1 (left) to 1 (right)
+
+    int offset = 0;              // First frame to play
+    int end = 0;                 // One past the last frame to play, 0 for the whole sample
+    LoopMode loopMode = LoopMode::NoLoop;
+    int loopStart = 0;
+    int loopEnd = 0;             // One past the last frame of the loop
+
+    float attack = 0.0f;         // Seconds
+    float release = 0.1f;        // Seconds
+    bool exponentialRelease = false;  // Release falls linearly in dB rather than in gain
+
+    int group = 0;               // Starting this region chokes voices whose offBy matches
+    int offBy = 0;
+
+    int seqLength = 1;           // Round-robin cycle length
+    int seqPosition = 1;         // 1-based slot in the cycle
+
+    bool isLooped() const noexcept {
+        return (loopMode == LoopMode::Continuous || loopMode == LoopMode::Sustain) && loopEnd > loopStart;
+    }
+};
+
+/**
+ * A multi-sampled instrument, such as an imported SFZ or SF2 patch.
+ *
+ * Regions are compiled at construction into a dense 128 x 128 table of
+ * note and velocity, whose cells list the regions to start for each step
+ * of the round-robin cycle. A note-on is then two array lookups, with no
+ * searching on the audio thread.
+ */
+class Instrument {
+public:
+    static constexpr int numNotes = 128;
+    static constexpr int numVelocities = 128;
+    static constexpr int maxRoundRobinSteps = 64;
+
+    /**
+     * Regions started by one note-on
+     */
+    struct Layers {
+        const juce::uint32* indices = nullptr;
+        int count = 0;
+
+        const juce::uint32* begin() const noexcept { return indices; }
+        const juce::uint32* end() const noexcept { return indices + count; }
+    };
+
+    /**
+     * Constructor; compiles the lookup table
+     * @param name Display name
+     * @param regions The instrument's regions
+     */
+    Instrument(const juce::String& name, std::vector<Region> regions);
+
+    /**
+     * Find the regions to start for a note-on. Constant time and allocation free.
+     *
+     * @param note MIDI note, 0 - 127
+     * @param velocity MIDI velocity, 0 - 127
+     * @param roundRobin Number of earlier note-ons on this note, selects the round-robin step
+     * @return Indices into getRegion()
+     */
+    Layers findRegions(int note, int velocity, juce::uint32 roundRobin) const noexcept;
+
+    const Region& getRegion(juce::uint32 index) const noexcept { return regions[index]; }
+    int getNumRegions() const noexcept { return static_cast<int>(regions.size()); }
+    const juce::String& getName() const noexcept { return name; }
+
+private:
+    struct Cell {
+        juce::uint32 firstStep = 0;
+        juce::uint32 numSteps = 1;
+    };
+
+    struct Step {
+        juce::uint32 offset = 0;
+        juce::uint32 count = 0;
+    };
+
+    void compile();
+
+    juce::String name;
+    std::vector<Region> regions;
+
+    std::vector<juce::uint32> table;          // numNotes * numVelocities cell indices
+    std::vector<Cell> cells;                  // Cell 0 is empty
+    std::vector<Step> steps;
+    std::vector<juce::uint32> regionIndices;
+
+    JUCE_DECLARE_NON_COPYABLE(Instrument)
+};
+
+} // namespace Aika
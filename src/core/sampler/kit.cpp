@@ -0,0 +1,227 @@
+#include "kit.hpp"
+#include "filenamescanner.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+namespace {
+
+bool isSeparator(juce::juce_wchar c) noexcept {
+    return !juce::CharacterFunctions::isLetterOrDigit(c) && c != '-' && c != '~';
+}
+
+// A whole word that is only a velocity ("v100", "vel1-63") or round-robin ("rr2") tag
+bool isLayerTag(const juce::String& word) {
+    const auto lower = word.toLowerCase();
+    juce::String digits;
+
+    if (lower.startsWith("rr"))
+        return lower.length() > 2 && lower.substring(2).containsOnly("0123456789");
+    if (lower.startsWith("vel"))
+        digits = lower.substring(3);
+    else if (lower.startsWith("v"))
+        digits = lower.substring(1);
+    else
+        return false;
+
+    const auto low = digits.upToFirstOccurrenceOf("-", false, false).upToFirstOccurrenceOf("~", false, false);
+    const auto high = digits.substring(low.length() + 1);
+    return low.isNotEmpty() && low.containsOnly("0123456789")
+        && (low.length() == digits.length() || (high.isNotEmpty() && high.containsOnly("0123456789")));
+}
+
+} // namespace
+
+void Pad::setLayers(std::vector<PadLayer> newLayers) {
+    layers = std::move(newLayers);
+    if (layers.empty())
+        return;
+
+    const PadLayer* loudest = nullptr;
+    for (const auto& layer : layers) {
+        if (layer.sample != nullptr
+            && (loudest == nullptr || layer.hiVelocity > loudest->hiVelocity
+                || (layer.hiVelocity == loudest->hiVelocity && layer.roundRobin < loudest->roundRobin)))
+            loudest = &layer;
+    }
+    sample = loudest != nullptr ? loudest->sample : nullptr;
+}
+
+PadLayerMap::PadLayerMap(const Pad& pad) {
+    std::vector<int> order;
+    for (size_t i = 0; i < pad.layers.size() && order.size() < 256; ++i) {
+        if (pad.layers[i].sample != nullptr)
+            order.push_back(static_cast<int>(i));
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&pad](int a, int b) {
+        const auto& first = pad.layers[static_cast<size_t>(a)];
+        const auto& second = pad.layers[static_cast<size_t>(b)];
+        if (first.loVelocity != second.loVelocity)
+            return first.loVelocity < second.loVelocity;
+        if (first.hiVelocity != second.hiVelocity)
+            return first.hiVelocity < second.hiVelocity;
+        return first.roundRobin < second.roundRobin;
+    });
+
+    // Layers sharing a velocity range take turns
+    for (const int index : order) {
+        const auto& layer = pad.layers[static_cast<size_t>(index)];
+        const int lo = juce::jlimit(1, 127, layer.loVelocity);
+        const int hi = juce::jlimit(lo, 127, layer.hiVelocity);
+
+        if (numGroups == 0 || groups[static_cast<size_t>(numGroups - 1)].loVelocity != lo
+            || groups[static_cast<size_t>(numGroups - 1)].hiVelocity != hi) {
+            if (numGroups == maxGroups)
+                break;
+            auto& group = groups[static_cast<size_t>(numGroups++)];
+            group.loVelocity = lo;
+            group.hiVelocity = hi;
+        }
+
+        auto& group = groups[static_cast<size_t>(numGroups - 1)];
+        if (group.count < maxRoundRobins)
+            group.layers[static_cast<size_t>(group.count++)] = static_cast<juce::uint8>(index);
+    }
+
+    // Overlapping ranges play together, two at most
+    for (int velocity = 1; velocity < 128; ++velocity) {
+        auto& cell = cells[static_cast<size_t>(velocity)];
+        for (int g = 0; g < numGroups && cell.count < 2; ++g) {
+            const auto& group = groups[static_cast<size_t>(g)];
+            if (velocity >= group.loVelocity && velocity <= group.hiVelocity) {
+                cell.groups[static_cast<size_t>(cell.count)] = static_cast<juce::uint8>(g);
+                cell.gains[static_cast<size_t>(cell.count++)] = 1.0f;
+            }
+        }
+    }
+
+    // Around each boundary between adjacent ranges, fade from one to the other at equal power
+    const int width = juce::jlimit(0, 126, pad.settings.velocityCrossfade);
+    if (width == 0)
+        return;
+
+    for (int g = 0; g + 1 < numGroups; ++g) {
+        const auto& lower = groups[static_cast<size_t>(g)];
+        for (int h = g + 1; h < numGroups; ++h) {
+            if (groups[static_cast<size_t>(h)].loVelocity != lower.hiVelocity + 1)
+                continue;
+
+            const double boundary = lower.hiVelocity + 0.5;
+            const double zoneStart = boundary - width * 0.5;
+            for (int velocity = std::max(1, static_cast<int>(std::ceil(zoneStart))); velocity < 128 && velocity < boundary + width * 0.5; ++velocity) {
+                auto& cell = cells[static_cast<size_t>(velocity)];
+                if (cell.count != 1 || (cell.groups[0] != g && cell.groups[0] != h))
+                    continue;
+
+                const double position = juce::jlimit(0.0, 1.0, (velocity - zoneStart) / width);
+                const double angle = position * juce::MathConstants<double>::halfPi;
+                cell.groups = { static_cast<juce::uint8>(g), static_cast<juce::uint8>(h) };
+                cell.gains = { static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)) };
+                cell.count = 2;
+            }
+            break;
+        }
+    }
+}
+
+std::vector<PadLayer> createPadLayers(const std::vector<std::shared_ptr<const Sample>>& samples) {
+    std::vector<FilenameInfo> infos;
+    std::vector<int> singleVelocities;
+    for (const auto& sample : samples) {
+        infos.push_back(FilenameScanner::scan(sample->getName().toStdString()));
+        if (infos.back().velocity >= 0 && infos.back().velocityLow == infos.back().velocityHigh)
+            singleVelocities.push_back(infos.back().velocity);
+    }
+
+    std::sort(singleVelocities.begin(), singleVelocities.end());
+    singleVelocities.erase(std::unique(singleVelocities.begin(), singleVelocities.end()), singleVelocities.end());
+
+    std::vector<PadLayer> layers;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const auto& info = infos[i];
+        PadLayer layer;
+        layer.sample = samples[i];
+        layer.roundRobin = std::max(0, info.roundRobin);
+
+        if (info.velocity < 0) {
+            // Untagged: every velocity
+        } else if (info.velocityLow != info.velocityHigh) {
+            layer.loVelocity = std::max(1, info.velocityLow);
+            layer.hiVelocity = info.velocityHigh;
+        } else {
+            // A single velocity is the top of its range; the loudest reaches 127
+            const auto it = std::lower_bound(singleVelocities.begin(), singleVelocities.end(), info.velocity);
+            layer.loVelocity = it == singleVelocities.begin() ? 1 : *(it - 1) + 1;
+            layer.hiVelocity = it + 1 == singleVelocities.end() ? 127 : std::max(1, info.velocity);
+        }
+
+        layers.push_back(std::move(layer));
+    }
+
+    std::stable_sort(layers.begin(), layers.end(), [](const PadLayer& a, const PadLayer& b) {
+        return a.loVelocity != b.loVelocity ? a.loVelocity < b.loVelocity : a.roundRobin < b.roundRobin;
+    });
+    return layers;
+}
+
+juce::String getLayerGroupName(const juce::String& sampleName) {
+    juce::StringArray words;
+    juce::String word;
+    for (auto c : sampleName + " ") {
+        if (isSeparator(c)) {
+            if (word.isNotEmpty() && !isLayerTag(word))
+                words.add(word);
+            word.clear();
+        } else {
+            word += c;
+        }
+    }
+
+    return words.joinIntoString(" ");
+}
+
+Kit::Kit() : pads(numPads) {
+    for (int i = 0; i < numPads; ++i) {
+        pads[static_cast<size_t>(i)].id = i;
+        pads[static_cast<size_t>(i)].settings.midiNote = 36 + i;
+    }
+}
+
+Json::Value Kit::toJson() const {
+    Json::Value result(Json::arrayValue);
+
+    for (const auto& pad : pads) {
+        Json::Value padJson;
+        padJson["id"] = pad.id;
+
+        if (pad.sample == nullptr) {
+            padJson["sample"] = Json::Value(Json::nullValue);
+        } else {
+            Json::Value sampleJson;
+            sampleJson["name"] = pad.sample->getName().toStdString();
+            sampleJson["midiNote"] = pad.settings.midiNote;
+            sampleJson["chokeGroup"] = pad.settings.chokeGroup;
+            sampleJson["volume"] = pad.settings.volume;
+            sampleJson["attack"] = pad.settings.attack;
+            sampleJson["release"] = pad.settings.release;
+            sampleJson["start"] = pad.settings.start;
+            sampleJson["end"] = pad.settings.end;
+            sampleJson["layers"] = static_cast<int>(pad.layers.size());
+            sampleJson["velocityCrossfade"] = pad.settings.velocityCrossfade;
+            sampleJson["syncBeats"] = pad.settings.syncBeats;
+            sampleJson["reverse"] = pad.settings.reverse;
+            sampleJson["normalize"] = pad.settings.normalize;
+            sampleJson["fadeIn"] = pad.settings.fadeIn;
+            sampleJson["fadeOut"] = pad.settings.fadeOut;
+            padJson["sample"] = sampleJson;
+        }
+
+        result.append(padJson);
+    }
+
+    return result;
+}
+
+} // namespace Aika
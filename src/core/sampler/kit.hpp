@@ -0,0 +1,156 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <json/json.h>
+#include "sample.hpp"
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Per-pad playback settings. Mirrors the web Sample type, so times are in
+ * seconds and an end of 0 means "play to the end of the sample".
+ */
+struct PadSettings {
+    int midiNote = 36;
+    int chokeGroup = 0;
+    float volume = 1.0f;
+    float attack = 0.0f;     // Seconds
+    float release = 0.1f;    // Seconds
+    double start = 0.0;      // Seconds into the sample
+    double end = 0.0;        // Seconds into the sample, 0 for the whole sample
+    int velocityCrossfade = 0;   // Velocity steps over which adjacent layers blend, 0 for hard switches
+    double syncBeats = 0.0;      // Length of the region in beats at the host tempo, 0 to play at its own speed
+    bool reverse = false;        // Play the region backwards
+    bool normalize = false;      // Scale the region's peak to 0 dBFS
+    double fadeIn = 0.0;         // Seconds
+    double fadeOut = 0.0;        // Seconds
+};
+
+/**
+ * One sample of a layered pad: the velocities it answers to and its turn
+ * among the samples sharing that velocity range
+ */
+struct PadLayer {
+    std::shared_ptr<const Sample> sample;
+    int loVelocity = 1;
+    int hiVelocity = 127;
+    int roundRobin = 0;      // Order within the cycle; equal values keep their list order
+};
+
+/**
+ * A pad: a reference to shared sample data plus the region of it to play.
+ * A pad with layers picks among them by velocity and round robin, and its
+ * sample is the one shown for it: the first of the loudest layer.
+ */
+struct Pad {
+    int id = 0;
+    std::shared_ptr<const Sample> sample;
+    PadSettings settings;
+    std::vector<PadLayer> layers;
+
+    /**
+     * Replace the layers, and the sample shown for the pad with them
+     *
+     * @param newLayers Layers to play, or empty to play sample at every velocity
+     */
+    void setLayers(std::vector<PadLayer> newLayers);
+};
+
+/**
+ * Velocity and round-robin lookup for a layered pad.
+ *
+ * Built off the audio thread from the pad's layers: samples sharing a
+ * velocity range form a round-robin group, and every velocity has a
+ * precomputed cell naming the groups to play, two with their crossfade
+ * gains where adjacent ranges blend. A note-on is a table lookup plus one
+ * counter per group, with no searching and no allocation.
+ */
+class PadLayerMap {
+public:
+    static constexpr int maxGroups = 16;        // Distinct velocity ranges per pad
+    static constexpr int maxRoundRobins = 16;   // Samples per range
+
+    struct Cell {
+        std::array<juce::uint8, 2> groups {};
+        std::array<float, 2> gains {};
+        int count = 0;
+    };
+
+    PadLayerMap() = default;
+
+    /**
+     * @param pad Pad whose layers to map; layers without a sample are left out
+     */
+    explicit PadLayerMap(const Pad& pad);
+
+    bool isEmpty() const noexcept { return numGroups == 0; }
+
+    /**
+     * @param velocity MIDI velocity, 1 - 127
+     * @return Groups to play at that velocity; none if no layer covers it
+     */
+    const Cell& getCell(int velocity) const noexcept { return cells[static_cast<size_t>(velocity & 127)]; }
+
+    /**
+     * @param group Group from a Cell
+     * @param step Round-robin step, taken modulo the group's size
+     * @return Index into the pad's layers
+     */
+    int getLayer(int group, juce::uint32 step) const noexcept {
+        const auto& entry = groups[static_cast<size_t>(group)];
+        return entry.layers[static_cast<size_t>(step % static_cast<juce::uint32>(entry.count))];
+    }
+
+private:
+    struct Group {
+        int loVelocity = 1;
+        int hiVelocity = 127;
+        std::array<juce::uint8, maxRoundRobins> layers {};
+        int count = 0;
+    };
+
+    std::array<Group, maxGroups> groups {};
+    int numGroups = 0;
+    std::array<Cell, 128> cells {};
+};
+
+/**
+ * Arrange samples as layers by the velocity and round-robin tags in their
+ * names ("v40", "vel64-127", "rr2"). Samples tagged with a single velocity
+ * cover everything above the next softer one; untagged samples cover every
+ * velocity.
+ *
+ * @param samples Samples for one pad
+ * @return The layers, for Pad::setLayers
+ */
+std::vector<PadLayer> createPadLayers(const std::vector<std::shared_ptr<const Sample>>& samples);
+
+/**
+ * @param sampleName A sample name
+ * @return The name with velocity and round-robin tags removed, so the layers of one sound share it
+ */
+juce::String getLayerGroupName(const juce::String& sampleName);
+
+/**
+ * A drum kit: a fixed grid of pads
+ */
+struct Kit {
+    static constexpr int numPads = 16;
+
+    Kit();
+
+    /**
+     * Convert the pad grid to the JSON shape of the web DrumPad type
+     *
+     * @return JSON array with one object per pad
+     */
+    Json::Value toJson() const;
+
+    juce::String name;
+    std::vector<Pad> pads;
+};
+
+} // namespace Aika
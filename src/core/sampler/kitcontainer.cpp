@@ -0,0 +1,508 @@
+#include "kitcontainer.hpp"
+#include "filenamescanner.hpp"
+#include <vector>
+
+#if JUCE_BIG_ENDIAN
+ #error "The kit container stores its tables in native byte order, which must be little endian"
+#endif
+
+namespace Aika {
+
+namespace {
+
+constexpr char containerMagic[4] = { 'O', 'S', 'K', 'T' };
+constexpr juce::uint32 containerVersion = 3;   // 2 added pad layers, 3 pad edits and tempo sync
+constexpr juce::uint32 oldestContainerVersion = 1;
+constexpr juce::uint64 pageSize = 4096;
+
+struct FileHeader {
+    char magic[4];
+    juce::uint32 version;
+    juce::uint32 pageSize;
+    juce::uint32 peakFrames;
+    juce::uint32 numSamples;
+    juce::uint32 numPads;
+    juce::uint32 kitNameOffset;
+    juce::uint32 kitNameLength;
+    juce::uint64 sampleTableOffset;
+    juce::uint64 padTableOffset;
+    juce::uint64 stringTableOffset;
+    juce::uint64 stringTableSize;
+    juce::uint64 fileSize;
+    juce::uint32 numLayers;         // LayerEntry table straight after the pad table; 0 in version 1
+    juce::uint32 numPadSettings;    // PadSettingsEntry table after the layer table; 0 before version 3
+};
+
+struct SampleEntry {
+    juce::uint64 dataOffset;        // Page aligned, channels stored back to back
+    juce::uint64 bytesPerChannel;
+    juce::uint64 peaksOffset;       // numPeaks min/max int16 pairs per channel
+    double sampleRate;
+    juce::uint32 nameOffset;
+    juce::uint32 nameLength;
+    juce::uint32 numFrames;
+    juce::uint32 numPeaks;
+    juce::int32 loopStart;
+    juce::int32 loopEnd;
+    juce::uint16 numChannels;
+    juce::uint8 format;
+    juce::int8 rootNote;
+    juce::uint32 reserved;
+};
+
+struct PadEntry {
+    juce::int32 sampleIndex;        // -1 for an empty pad
+    juce::int32 midiNote;
+    juce::int32 chokeGroup;
+    float volume;
+    float attack;
+    float release;
+    double start;
+    double end;
+};
+
+struct LayerEntry {
+    juce::int32 padIndex;           // Layers of one pad are stored together, in playing order
+    juce::int32 sampleIndex;
+    juce::uint8 loVelocity;
+    juce::uint8 hiVelocity;
+    juce::uint8 roundRobin;
+    juce::uint8 velocityCrossfade;  // The pad's, repeated on each of its layers
+};
+
+struct PadSettingsEntry {
+    double syncBeats;
+    double fadeIn;
+    double fadeOut;
+    juce::uint8 reverse;
+    juce::uint8 normalize;
+    juce::uint8 reserved[6];
+};
+
+static_assert(sizeof(FileHeader) == 80, "FileHeader layout is part of the file format");
+static_assert(sizeof(SampleEntry) == 64, "SampleEntry layout is part of the file format");
+static_assert(sizeof(PadEntry) == 40, "PadEntry layout is part of the file format");
+static_assert(sizeof(LayerEntry) == 12, "LayerEntry layout is part of the file format");
+static_assert(sizeof(PadSettingsEntry) == 32, "PadSettingsEntry layout is part of the file format");
+
+juce::uint64 alignUp(juce::uint64 value, juce::uint64 alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+juce::uint64 getLayerTableOffset(const FileHeader& header) {
+    return header.padTableOffset + sizeof(PadEntry) * static_cast<juce::uint64>(header.numPads);
+}
+
+juce::uint64 getPadSettingsTableOffset(const FileHeader& header) {
+    return alignUp(getLayerTableOffset(header) + sizeof(LayerEntry) * static_cast<juce::uint64>(header.numLayers), alignof(PadSettingsEntry));
+}
+
+bool writePadding(juce::OutputStream& out, juce::uint64 targetPosition) {
+    const auto position = static_cast<juce::uint64>(out.getPosition());
+    jassert(position <= targetPosition);
+    return position == targetPosition || out.writeRepeatedByte(0, static_cast<size_t>(targetPosition - position));
+}
+
+bool writePeaks(juce::OutputStream& out, const Sample& sample, juce::uint32 numPeaks) {
+    std::vector<float> block(static_cast<size_t>(KitContainer::peakFrames));
+    std::vector<juce::int16> peaks(static_cast<size_t>(numPeaks) * 2);
+
+    for (int channel = 0; channel < sample.getNumChannels(); ++channel) {
+        for (juce::uint32 peak = 0; peak < numPeaks; ++peak) {
+            const int start = static_cast<int>(peak) * KitContainer::peakFrames;
+            const int count = std::min(KitContainer::peakFrames, sample.getNumFrames() - start);
+            sample.readFrames(channel, start, count, block.data());
+
+            const auto range = juce::FloatVectorOperations::findMinAndMax(block.data(), count);
+            peaks[peak * 2] = static_cast<juce::int16>(juce::jlimit(-1.0f, 1.0f, range.getStart()) * 32767.0f);
+            peaks[peak * 2 + 1] = static_cast<juce::int16>(juce::jlimit(-1.0f, 1.0f, range.getEnd()) * 32767.0f);
+        }
+
+        if (!out.write(peaks.data(), peaks.size() * sizeof(juce::int16)))
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+KitContainer::~KitContainer() {
+}
+
+bool KitContainer::write(const Kit& kit, const juce::File& file) {
+    // Samples shared between pads (e.g. slices of one loop) are stored once
+    std::vector<const Sample*> samples;
+    std::vector<juce::int32> padSampleIndices;
+    std::vector<LayerEntry> layerEntries;
+
+    // Evicted samples are written from their full audio, read back from disk if need be
+    const auto addSample = [&samples](const Sample* stored) -> juce::int32 {
+        const Sample* sample = stored->loadFull();
+        if (sample == nullptr)
+            return -1;
+
+        const auto it = std::find(samples.begin(), samples.end(), sample);
+        const auto index = static_cast<juce::int32>(std::distance(samples.begin(), it));
+        if (it == samples.end())
+            samples.push_back(sample);
+        return index;
+    };
+
+    for (const auto& pad : kit.pads) {
+        padSampleIndices.push_back(pad.sample != nullptr ? addSample(pad.sample.get()) : -1);
+
+        for (const auto& layer : pad.layers) {
+            const auto sampleIndex = layer.sample != nullptr ? addSample(layer.sample.get()) : -1;
+            if (sampleIndex < 0)
+                continue;
+
+            layerEntries.push_back({ static_cast<juce::int32>(padSampleIndices.size() - 1), sampleIndex,
+                                     static_cast<juce::uint8>(juce::jlimit(1, 127, layer.loVelocity)),
+                                     static_cast<juce::uint8>(juce::jlimit(1, 127, layer.hiVelocity)),
+                                     static_cast<juce::uint8>(juce::jlimit(0, 255, layer.roundRobin)),
+                                     static_cast<juce::uint8>(juce::jlimit(0, 127, pad.settings.velocityCrossfade)) });
+        }
+    }
+
+    juce::MemoryOutputStream strings;
+    const auto addString = [&strings](const juce::String& text, juce::uint32& offset, juce::uint32& length) {
+        offset = static_cast<juce::uint32>(strings.getDataSize());
+        length = static_cast<juce::uint32>(text.getNumBytesAsUTF8());
+        strings.write(text.toRawUTF8(), length);
+    };
+
+    FileHeader header {};
+    std::memcpy(header.magic, containerMagic, sizeof(containerMagic));
+    header.version = containerVersion;
+    header.pageSize = static_cast<juce::uint32>(pageSize);
+    header.peakFrames = peakFrames;
+    header.numSamples = static_cast<juce::uint32>(samples.size());
+    header.numPads = static_cast<juce::uint32>(kit.pads.size());
+    header.numLayers = static_cast<juce::uint32>(layerEntries.size());
+    addString(kit.name, header.kitNameOffset, header.kitNameLength);
+
+    std::vector<SampleEntry> sampleEntries(samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const Sample& sample = *samples[i];
+        auto& entry = sampleEntries[i];
+        entry.sampleRate = sample.getSampleRate();
+        entry.numFrames = static_cast<juce::uint32>(sample.getNumFrames());
+        entry.numChannels = static_cast<juce::uint16>(sample.getNumChannels());
+        entry.format = static_cast<juce::uint8>(sample.getFormat());
+        entry.rootNote = static_cast<juce::int8>(juce::jlimit(0, 127, sample.getMetadata().rootNote));
+        entry.loopStart = sample.getMetadata().loopStart;
+        entry.loopEnd = sample.getMetadata().loopEnd;
+        entry.bytesPerChannel = getBytesPerSample(sample.getFormat()) * static_cast<juce::uint64>(sample.getNumFrames());
+        entry.numPeaks = static_cast<juce::uint32>((sample.getNumFrames() + peakFrames - 1) / peakFrames);
+        addString(sample.getName(), entry.nameOffset, entry.nameLength);
+    }
+
+    std::vector<PadEntry> padEntries(kit.pads.size());
+    std::vector<PadSettingsEntry> padSettingsEntries(kit.pads.size());
+    for (size_t i = 0; i < kit.pads.size(); ++i) {
+        const auto& settings = kit.pads[i].settings;
+        padEntries[i] = { padSampleIndices[i], settings.midiNote, settings.chokeGroup,
+                          settings.volume, settings.attack, settings.release, settings.start, settings.end };
+        padSettingsEntries[i] = { settings.syncBeats, settings.fadeIn, settings.fadeOut,
+                                  static_cast<juce::uint8>(settings.reverse), static_cast<juce::uint8>(settings.normalize), {} };
+    }
+    header.numPadSettings = static_cast<juce::uint32>(padSettingsEntries.size());
+
+    // Lay out the tables, then page-aligned sample payloads
+    juce::uint64 offset = sizeof(FileHeader);
+    header.sampleTableOffset = offset;
+    offset += sizeof(SampleEntry) * sampleEntries.size();
+    header.padTableOffset = offset;
+    offset += sizeof(PadEntry) * padEntries.size();
+    offset += sizeof(LayerEntry) * layerEntries.size();
+    offset = alignUp(offset, alignof(PadSettingsEntry));
+    jassert(offset == getPadSettingsTableOffset(header));
+    offset += sizeof(PadSettingsEntry) * padSettingsEntries.size();
+    header.stringTableOffset = offset;
+    header.stringTableSize = strings.getDataSize();
+    offset += header.stringTableSize;
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        auto& entry = sampleEntries[i];
+        offset = alignUp(offset, pageSize);
+        entry.dataOffset = offset;
+        offset += entry.bytesPerChannel * entry.numChannels;
+        offset = alignUp(offset, 8);
+        entry.peaksOffset = offset;
+        offset += static_cast<juce::uint64>(entry.numPeaks) * 2 * sizeof(juce::int16) * entry.numChannels;
+    }
+    header.fileSize = offset;
+
+    // Write to a temporary file so a failed export never leaves a truncated kit behind
+    juce::TemporaryFile temporaryFile(file);
+    {
+        juce::FileOutputStream out(temporaryFile.getFile());
+        if (!out.openedOk())
+            return false;
+
+        bool ok = out.write(&header, sizeof(header))
+               && out.write(sampleEntries.data(), sizeof(SampleEntry) * sampleEntries.size())
+               && out.write(padEntries.data(), sizeof(PadEntry) * padEntries.size())
+               && (layerEntries.empty() || out.write(layerEntries.data(), sizeof(LayerEntry) * layerEntries.size()))
+               && writePadding(out, getPadSettingsTableOffset(header))
+               && out.write(padSettingsEntries.data(), sizeof(PadSettingsEntry) * padSettingsEntries.size())
+               && out.write(strings.getData(), strings.getDataSize());
+
+        for (size_t i = 0; ok && i < samples.size(); ++i) {
+            const Sample& sample = *samples[i];
+            const auto& entry = sampleEntries[i];
+
+            ok = writePadding(out, entry.dataOffset);
+            for (int channel = 0; ok && channel < sample.getNumChannels(); ++channel)
+                ok = out.write(sample.getRawChannelData(channel), static_cast<size_t>(entry.bytesPerChannel));
+
+            ok = ok && writePadding(out, entry.peaksOffset) && writePeaks(out, sample, entry.numPeaks);
+        }
+
+        out.flush();
+        if (!ok || out.getStatus().failed())
+            return false;
+    }
+
+    return temporaryFile.overwriteTargetFileWithTemporary();
+}
+
+bool KitContainer::exportFolder(const juce::File& folder, juce::AudioFormatManager& formatManager, const juce::File& file) {
+    auto files = folder.findChildFiles(juce::File::findFiles, false, formatManager.getWildcardForAllFormats());
+    files.sort();
+
+    // Files whose names differ only in velocity or round-robin tags become layers of one pad
+    juce::StringArray groupNames;
+    std::vector<std::vector<std::shared_ptr<const Sample>>> groups;
+
+    for (const auto& audioFile : files) {
+        const auto groupName = getLayerGroupName(audioFile.getFileNameWithoutExtension());
+        int group = groupNames.indexOf(groupName);
+        if (group < 0 && groupNames.size() >= Kit::numPads)
+            continue;
+
+        auto sample = Sample::loadFromFile(formatManager, audioFile);
+        if (sample == nullptr)
+            continue;
+
+        const auto info = FilenameScanner::scan(audioFile.getFileName().toStdString());
+        if (info.rootNote >= 0) {
+            auto metadata = sample->getMetadata();
+            metadata.rootNote = info.rootNote;
+            sample->setMetadata(metadata);
+        }
+
+        if (group < 0) {
+            group = groupNames.size();
+            groupNames.add(groupName);
+            groups.emplace_back();
+        }
+        groups[static_cast<size_t>(group)].push_back(std::move(sample));
+    }
+
+    Kit kit;
+    kit.name = folder.getFileName();
+
+    for (size_t i = 0; i < groups.size(); ++i) {
+        auto& pad = kit.pads[i];
+        if (groups[i].size() == 1)
+            pad.sample = groups[i].front();
+        else
+            pad.setLayers(createPadLayers(groups[i]));
+    }
+
+    return !groups.empty() && write(kit, file);
+}
+
+std::shared_ptr<KitContainer> KitContainer::open(const juce::File& file) {
+    std::shared_ptr<KitContainer> container(new KitContainer());
+
+    container->mappedFile = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    if (container->mappedFile->getData() == nullptr)
+        return nullptr;
+
+    container->base = static_cast<const char*>(container->mappedFile->getData());
+    container->size = container->mappedFile->getSize();
+
+    if (!container->validate())
+        return nullptr;
+
+    return container;
+}
+
+bool KitContainer::validate() {
+    if (size < sizeof(FileHeader))
+        return false;
+
+    const auto& header = *reinterpret_cast<const FileHeader*>(base);
+    if (std::memcmp(header.magic, containerMagic, sizeof(containerMagic)) != 0
+        || header.version < oldestContainerVersion
+        || header.version > containerVersion
+        || (header.version < 2 && header.numLayers != 0)
+        || (header.version < 3 && header.numPadSettings != 0)
+        || header.numPadSettings > header.numPads
+        || header.peakFrames != peakFrames
+        || header.fileSize > size)
+        return false;
+
+    const auto fits = [this](juce::uint64 offset, juce::uint64 length) {
+        return offset <= size && length <= size - offset;
+    };
+
+    if (!fits(header.sampleTableOffset, sizeof(SampleEntry) * static_cast<juce::uint64>(header.numSamples))
+        || !fits(header.padTableOffset, sizeof(PadEntry) * static_cast<juce::uint64>(header.numPads))
+        || !fits(getLayerTableOffset(header), sizeof(LayerEntry) * static_cast<juce::uint64>(header.numLayers))
+        || !fits(getPadSettingsTableOffset(header), sizeof(PadSettingsEntry) * static_cast<juce::uint64>(header.numPadSettings))
+        || !fits(header.stringTableOffset, header.stringTableSize)
+        || header.sampleTableOffset % alignof(SampleEntry) != 0
+        || header.padTableOffset % alignof(PadEntry) != 0
+        || static_cast<juce::uint64>(header.kitNameOffset) + header.kitNameLength > header.stringTableSize)
+        return false;
+
+    const auto* sampleEntries = reinterpret_cast<const SampleEntry*>(base + header.sampleTableOffset);
+    for (juce::uint32 i = 0; i < header.numSamples; ++i) {
+        const auto& entry = sampleEntries[i];
+        const auto expectedBytes = getBytesPerSample(static_cast<SampleFormat>(entry.format)) * static_cast<juce::uint64>(entry.numFrames);
+
+        if (entry.format > static_cast<juce::uint8>(SampleFormat::Int24)
+            || entry.numChannels == 0
+            || entry.sampleRate <= 0.0
+            || entry.numFrames > static_cast<juce::uint32>(std::numeric_limits<int>::max())
+            || entry.bytesPerChannel != expectedBytes
+            || !fits(entry.dataOffset, entry.bytesPerChannel * entry.numChannels)
+            || entry.peaksOffset % alignof(juce::int16) != 0
+            || !fits(entry.peaksOffset, static_cast<juce::uint64>(entry.numPeaks) * 2 * sizeof(juce::int16) * entry.numChannels)
+            || static_cast<juce::uint64>(entry.nameOffset) + entry.nameLength > header.stringTableSize)
+            return false;
+    }
+
+    const auto* padEntries = reinterpret_cast<const PadEntry*>(base + header.padTableOffset);
+    for (juce::uint32 i = 0; i < header.numPads; ++i) {
+        if (padEntries[i].sampleIndex < -1 || padEntries[i].sampleIndex >= static_cast<juce::int32>(header.numSamples))
+            return false;
+    }
+
+    const auto* layerEntries = reinterpret_cast<const LayerEntry*>(base + getLayerTableOffset(header));
+    for (juce::uint32 i = 0; i < header.numLayers; ++i) {
+        const auto& entry = layerEntries[i];
+        if (entry.padIndex < 0 || entry.padIndex >= static_cast<juce::int32>(header.numPads)
+            || entry.sampleIndex < 0 || entry.sampleIndex >= static_cast<juce::int32>(header.numSamples)
+            || entry.loVelocity > entry.hiVelocity || entry.hiVelocity > 127)
+            return false;
+    }
+
+    const auto* padSettingsEntries = reinterpret_cast<const PadSettingsEntry*>(base + getPadSettingsTableOffset(header));
+    for (juce::uint32 i = 0; i < header.numPadSettings; ++i) {
+        const auto& entry = padSettingsEntries[i];
+        if (!(entry.syncBeats >= 0.0 && entry.fadeIn >= 0.0 && entry.fadeOut >= 0.0))
+            return false;
+    }
+
+    return true;
+}
+
+juce::String KitContainer::readString(juce::uint32 offset, juce::uint32 length) const {
+    const auto& header = *reinterpret_cast<const FileHeader*>(base);
+    return juce::String::fromUTF8(base + header.stringTableOffset + offset, static_cast<int>(length));
+}
+
+std::shared_ptr<Kit> KitContainer::createKit() const {
+    const auto& header = *reinterpret_cast<const FileHeader*>(base);
+    const auto* sampleEntries = reinterpret_cast<const SampleEntry*>(base + header.sampleTableOffset);
+    const auto* padEntries = reinterpret_cast<const PadEntry*>(base + header.padTableOffset);
+
+    // Every sample keeps the container, and therefore the mapping, alive
+    const std::shared_ptr<const void> owner = shared_from_this();
+
+    std::vector<std::shared_ptr<const Sample>> samples;
+    samples.reserve(header.numSamples);
+
+    for (juce::uint32 i = 0; i < header.numSamples; ++i) {
+        const auto& entry = sampleEntries[i];
+        auto sample = Sample::createForExternalData(static_cast<SampleFormat>(entry.format),
+                                                    entry.numChannels,
+                                                    static_cast<int>(entry.numFrames),
+                                                    entry.sampleRate,
+                                                    readString(entry.nameOffset, entry.nameLength),
+                                                    base + entry.dataOffset,
+                                                    owner, true);
+
+        SampleMetadata metadata;
+        metadata.rootNote = entry.rootNote;
+        metadata.loopStart = entry.loopStart;
+        metadata.loopEnd = entry.loopEnd;
+        sample->setMetadata(metadata);
+
+        samples.push_back(std::move(sample));
+    }
+
+    auto kit = std::make_shared<Kit>();
+    kit->name = readString(header.kitNameOffset, header.kitNameLength);
+
+    const auto numPads = std::min(static_cast<size_t>(header.numPads), kit->pads.size());
+    for (size_t i = 0; i < numPads; ++i) {
+        const auto& entry = padEntries[i];
+        auto& pad = kit->pads[i];
+
+        pad.sample = entry.sampleIndex >= 0 ? samples[static_cast<size_t>(entry.sampleIndex)] : nullptr;
+        pad.settings.midiNote = entry.midiNote;
+        pad.settings.chokeGroup = entry.chokeGroup;
+        pad.settings.volume = entry.volume;
+        pad.settings.attack = entry.attack;
+        pad.settings.release = entry.release;
+        pad.settings.start = entry.start;
+        pad.settings.end = entry.end;
+    }
+
+    const auto* padSettingsEntries = reinterpret_cast<const PadSettingsEntry*>(base + getPadSettingsTableOffset(header));
+    for (size_t i = 0; i < std::min(static_cast<size_t>(header.numPadSettings), numPads); ++i) {
+        const auto& entry = padSettingsEntries[i];
+        auto& settings = kit->pads[i].settings;
+        settings.syncBeats = entry.syncBeats;
+        settings.fadeIn = entry.fadeIn;
+        settings.fadeOut = entry.fadeOut;
+        settings.reverse = entry.reverse != 0;
+        settings.normalize = entry.normalize != 0;
+    }
+
+    const auto* layerEntries = reinterpret_cast<const LayerEntry*>(base + getLayerTableOffset(header));
+    for (juce::uint32 first = 0, last = 0; first < header.numLayers; first = last) {
+        const auto padIndex = static_cast<size_t>(layerEntries[first].padIndex);
+        std::vector<PadLayer> layers;
+        for (last = first; last < header.numLayers && static_cast<size_t>(layerEntries[last].padIndex) == padIndex; ++last) {
+            const auto& entry = layerEntries[last];
+            layers.push_back({ samples[static_cast<size_t>(entry.sampleIndex)], entry.loVelocity, entry.hiVelocity, entry.roundRobin });
+        }
+
+        if (padIndex < numPads) {
+            auto& pad = kit->pads[padIndex];
+            pad.settings.velocityCrossfade = layerEntries[first].velocityCrossfade;
+            pad.setLayers(std::move(layers));
+        }
+    }
+
+    return kit;
+}
+
+const juce::int16* KitContainer::getPeaks(int sampleIndex, int channel, int& numPeaks) const {
+    const auto& header = *reinterpret_cast<const FileHeader*>(base);
+    numPeaks = 0;
+
+    if (sampleIndex < 0 || static_cast<juce::uint32>(sampleIndex) >= header.numSamples)
+        return nullptr;
+
+    const auto& entry = reinterpret_cast<const SampleEntry*>(base + header.sampleTableOffset)[sampleIndex];
+    if (channel < 0 || channel >= entry.numChannels)
+        return nullptr;
+
+    numPeaks = static_cast<int>(entry.numPeaks);
+    const auto* peaks = reinterpret_cast<const juce::int16*>(base + entry.peaksOffset);
+    return peaks + static_cast<size_t>(channel) * entry.numPeaks * 2;
+}
+
+int KitContainer::getNumSamples() const noexcept {
+    return static_cast<int>(reinterpret_cast<const FileHeader*>(base)->numSamples);
+}
+
+} // namespace Aika
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "kit.hpp"
+#include <memory>
+
+namespace Aika {
+
+/**
+ * Single-file kit container (.oskit), laid out to be memory mapped.
+ *
+ * Layout, all little endian:
+ *   - FileHeader
+ *   - SampleEntry table (format, rate, length, root note, loop, offsets)
+ *   - PadEntry table (sample index plus PadSettings)
+ *   - LayerEntry table (velocity layers and round robins of layered pads)
+ *   - PadSettingsEntry table (tempo sync, reverse, normalize and fades per
+ *     pad), 8-byte aligned
+ *   - String table (kit and sample names, UTF-8)
+ *   - Per sample: planar channel data in its SampleFormat, starting on a
+ *     page boundary, followed by min/max peaks for waveform display
+ *
+ * Opening a container maps the file and validates the tables. Samples point
+ * straight into the mapping, so loading does no decoding and no copying;
+ * the cost is the page faults taken as voices first touch the data.
+ */
+class KitContainer : public std::enable_shared_from_this<KitContainer> {
+public:
+    static constexpr const char* fileExtension = ".oskit";
+    static constexpr int peakFrames = 256;   // Frames summarised by each min/max pair
+
+    ~KitContainer();
+
+    /**
+     * Write a kit to a container file. Samples shared by several pads are stored once.
+     *
+     * @param kit The kit to write
+     * @param file Destination file, replaced if it exists
+     * @return True on success
+     */
+    static bool write(const Kit& kit, const juce::File& file);
+
+    /**
+     * Build a kit from the audio files in a folder and write it to a container.
+     * Files are assigned to pads in name order; files whose names differ only
+     * in velocity or round-robin tags ("Snare_v40_rr1", "Snare_v127_rr2")
+     * share a pad as its layers. Root notes come from the filenames and loops
+     * from the files' loop metadata.
+     *
+     * @param folder Folder containing audio files
+     * @param formatManager Format manager with the required formats registered
+     * @param file Destination file, replaced if it exists
+     * @return True on success
+     */
+    static bool exportFolder(const juce::File& folder, juce::AudioFormatManager& formatManager, const juce::File& file);
+
+    /**
+     * Map a container file and validate its tables
+     *
+     * @param file The container file
+     * @return The opened container, or nullptr if the file is missing or malformed
+     */
+    static std::shared_ptr<KitContainer> open(const juce::File& file);
+
+    /**
+     * Create a kit whose samples reference the mapped file. The mapping stays
+     * open for as long as any of those samples is alive.
+     *
+     * @return The kit
+     */
+    std::shared_ptr<Kit> createKit() const;
+
+    /**
+     * Precomputed waveform peaks of one stored sample
+     *
+     * @param sampleIndex Index of the sample in the container
+     * @param channel Channel index
+     * @param numPeaks Receives the number of min/max pairs
+     * @return Interleaved min/max pairs scaled to int16, or nullptr if out of range
+     */
+    const juce::int16* getPeaks(int sampleIndex, int channel, int& numPeaks) const;
+
+    int getNumSamples() const noexcept;
+
+private:
+    KitContainer() = default;
+
+    bool validate();
+    juce::String readString(juce::uint32 offset, juce::uint32 length) const;
+
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    const char* base = nullptr;
+    size_t size = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(KitContainer)
+};
+
+} // namespace Aika
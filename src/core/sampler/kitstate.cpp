@@ -0,0 +1,373 @@
+#include "kitstate.hpp"
+#include <algorithm>
+
+namespace Aika {
+
+namespace {
+
+const juce::Identifier sampleType("SAMPLE");
+const juce::Identifier padType("PAD");
+const juce::Identifier layerType("LAYER");
+
+namespace Ids {
+const juce::Identifier version("version");
+const juce::Identifier name("name");
+const juce::Identifier id("id");
+const juce::Identifier sample("sample");
+const juce::Identifier sampleRate("sampleRate");
+const juce::Identifier numChannels("numChannels");
+const juce::Identifier numFrames("numFrames");
+const juce::Identifier format("format");
+const juce::Identifier rootNote("rootNote");
+const juce::Identifier loopStart("loopStart");
+const juce::Identifier loopEnd("loopEnd");
+const juce::Identifier encoding("encoding");
+const juce::Identifier data("data");
+const juce::Identifier midiNote("midiNote");
+const juce::Identifier chokeGroup("chokeGroup");
+const juce::Identifier volume("volume");
+const juce::Identifier attack("attack");
+const juce::Identifier release("release");
+const juce::Identifier start("start");
+const juce::Identifier end("end");
+const juce::Identifier velocityCrossfade("velocityCrossfade");
+const juce::Identifier syncBeats("syncBeats");
+const juce::Identifier reverse("reverse");
+const juce::Identifier normalize("normalize");
+const juce::Identifier fadeIn("fadeIn");
+const juce::Identifier fadeOut("fadeOut");
+const juce::Identifier loVelocity("loVelocity");
+const juce::Identifier hiVelocity("hiVelocity");
+const juce::Identifier roundRobin("roundRobin");
+} // namespace Ids
+
+constexpr int stateVersion = 2;
+constexpr const char* flacEncoding = "flac";
+constexpr const char* rawEncoding = "raw";
+
+static_assert(Kit::numPads <= 32, "Pending pads are tracked in a 32-bit mask");
+
+/**
+ * Widen stored Int16/Int24 data to the left-justified 32-bit integers
+ * AudioFormatWriter expects, without going through float
+ */
+void convertToInt32(SampleFormat format, const void* source, int* dest, int numSamples) noexcept {
+    const auto* bytes = static_cast<const juce::uint8*>(source);
+
+    if (format == SampleFormat::Int16) {
+        for (int i = 0; i < numSamples; ++i, bytes += 2)
+            dest[i] = static_cast<int>((static_cast<juce::uint32>(bytes[0]) | (static_cast<juce::uint32>(bytes[1]) << 8)) << 16);
+    } else {
+        for (int i = 0; i < numSamples; ++i, bytes += 3)
+            dest[i] = static_cast<int>((static_cast<juce::uint32>(bytes[0]) | (static_cast<juce::uint32>(bytes[1]) << 8)
+                                        | (static_cast<juce::uint32>(bytes[2]) << 16)) << 8);
+    }
+}
+
+bool encodeFlac(const Sample& sample, juce::MemoryBlock& dest) {
+   #if JUCE_USE_FLAC
+    const int channels = sample.getNumChannels();
+    const int bitsPerSample = sample.getFormat() == SampleFormat::Int16 ? 16 : 24;
+
+    auto stream = std::make_unique<juce::MemoryOutputStream>(dest, false);
+    juce::FlacAudioFormat flac;
+
+    // Fastest compression level, since saves run on the host's thread
+    std::unique_ptr<juce::AudioFormatWriter> writer(flac.createWriterFor(stream.get(), sample.getSampleRate(),
+                                                                         static_cast<unsigned int>(channels),
+                                                                         bitsPerSample, {}, 0));
+    if (writer == nullptr)
+        return false;
+    stream.release();
+
+    constexpr int chunkFrames = 16384;
+    juce::HeapBlock<int> chunk(static_cast<size_t>(channels) * chunkFrames);
+    juce::HeapBlock<const int*> channelPointers(static_cast<size_t>(channels) + 1, true);
+    for (int channel = 0; channel < channels; ++channel)
+        channelPointers[channel] = chunk.get() + static_cast<size_t>(channel) * chunkFrames;
+
+    const size_t bytesPerSample = getBytesPerSample(sample.getFormat());
+    for (int position = 0; position < sample.getNumFrames(); position += chunkFrames) {
+        const int numFrames = std::min(chunkFrames, sample.getNumFrames() - position);
+        for (int channel = 0; channel < channels; ++channel)
+            convertToInt32(sample.getFormat(),
+                           static_cast<const char*>(sample.getRawChannelData(channel)) + static_cast<size_t>(position) * bytesPerSample,
+                           chunk.get() + static_cast<size_t>(channel) * chunkFrames, numFrames);
+
+        if (!writer->write(channelPointers.get(), numFrames))
+            return false;
+    }
+
+    // Deleting the writer finishes the stream
+    writer.reset();
+    return true;
+   #else
+    juce::ignoreUnused(sample, dest);
+    return false;
+   #endif
+}
+
+void encodeRaw(const Sample& sample, juce::MemoryBlock& dest) {
+    dest.setSize(0);
+    dest.ensureSize(sample.getSizeInBytes());
+    for (int channel = 0; channel < sample.getNumChannels(); ++channel)
+        dest.append(sample.getRawChannelData(channel), sample.getSizeInBytes() / static_cast<size_t>(sample.getNumChannels()));
+}
+
+} // namespace
+
+const juce::Identifier KitState::kitType("KIT");
+
+const KitState::CachedSample* KitState::encodeSample(const std::shared_ptr<const Sample>& sample) {
+    const auto it = std::find_if(cache.begin(), cache.end(), [&sample](const CachedSample& cached) {
+        return cached.audioId == sample->getAudioId();
+    });
+    if (it != cache.end()) {
+        it->sample = sample;
+        return &*it;
+    }
+
+    // An evicted sample is encoded from its full audio, read back from disk
+    const Sample* full = sample->loadFull();
+    if (full == nullptr)
+        return nullptr;
+
+    CachedSample cached;
+    cached.sample = sample;
+    cached.audioId = sample->getAudioId();
+
+    juce::MemoryBlock data;
+    if (full->getFormat() != SampleFormat::Float32 && encodeFlac(*full, data)) {
+        cached.encoding = flacEncoding;
+    } else {
+        encodeRaw(*full, data);
+        cached.encoding = rawEncoding;
+    }
+    cached.data = std::move(data);
+
+    cache.push_back(std::move(cached));
+    return &cache.back();
+}
+
+juce::ValueTree KitState::save(const Kit& kit, const std::vector<PendingSample>& pendingSamples) {
+    juce::ValueTree kitTree(kitType);
+    kitTree.setProperty(Ids::version, stateVersion, nullptr);
+    kitTree.setProperty(Ids::name, kit.name, nullptr);
+
+    // Samples shared between pads are stored once
+    std::vector<const void*> storedSamples;
+    const auto addSample = [&](const void* key, auto&& makeTree) {
+        const auto it = std::find(storedSamples.begin(), storedSamples.end(), key);
+        if (it != storedSamples.end())
+            return static_cast<int>(std::distance(storedSamples.begin(), it));
+
+        storedSamples.push_back(key);
+        kitTree.appendChild(makeTree(), nullptr);
+        return static_cast<int>(storedSamples.size()) - 1;
+    };
+
+    const auto storeSample = [&](const std::shared_ptr<const Sample>& stored) {
+        const auto* encoded = encodeSample(stored);
+        if (encoded == nullptr)
+            return -1;
+
+        return addSample(stored.get(), [&] {
+            const auto& sample = *stored;
+
+            juce::ValueTree sampleTree(sampleType);
+            sampleTree.setProperty(Ids::name, sample.getName(), nullptr);
+            sampleTree.setProperty(Ids::sampleRate, sample.getSampleRate(), nullptr);
+            sampleTree.setProperty(Ids::numChannels, sample.getNumChannels(), nullptr);
+            sampleTree.setProperty(Ids::numFrames, sample.getNumFrames(), nullptr);
+            sampleTree.setProperty(Ids::format, static_cast<int>(sample.getFormat()), nullptr);
+            sampleTree.setProperty(Ids::rootNote, sample.getMetadata().rootNote, nullptr);
+            sampleTree.setProperty(Ids::loopStart, sample.getMetadata().loopStart, nullptr);
+            sampleTree.setProperty(Ids::loopEnd, sample.getMetadata().loopEnd, nullptr);
+            sampleTree.setProperty(Ids::encoding, encoded->encoding, nullptr);
+            sampleTree.setProperty(Ids::data, encoded->data, nullptr);
+            return sampleTree;
+        });
+    };
+
+    // A pad or layer still waiting for its sample saves the sample it is waiting for
+    const auto storePending = [&](auto&& isWaiting) {
+        const auto pending = std::find_if(pendingSamples.begin(), pendingSamples.end(), isWaiting);
+        return pending != pendingSamples.end() ? addSample(&*pending, [&] { return pending->encoded.createCopy(); }) : -1;
+    };
+
+    for (const auto& pad : kit.pads) {
+        int sampleIndex = -1;
+
+        if (pad.sample != nullptr) {
+            sampleIndex = storeSample(pad.sample);
+        } else {
+            sampleIndex = storePending([&pad](const PendingSample& candidate) {
+                return (candidate.pads & (1u << pad.id)) != 0;
+            });
+        }
+
+        const auto& settings = pad.settings;
+        juce::ValueTree padTree(padType);
+        padTree.setProperty(Ids::id, pad.id, nullptr);
+        padTree.setProperty(Ids::sample, sampleIndex, nullptr);
+        padTree.setProperty(Ids::midiNote, settings.midiNote, nullptr);
+        padTree.setProperty(Ids::chokeGroup, settings.chokeGroup, nullptr);
+        padTree.setProperty(Ids::volume, settings.volume, nullptr);
+        padTree.setProperty(Ids::attack, settings.attack, nullptr);
+        padTree.setProperty(Ids::release, settings.release, nullptr);
+        padTree.setProperty(Ids::start, settings.start, nullptr);
+        padTree.setProperty(Ids::end, settings.end, nullptr);
+        padTree.setProperty(Ids::velocityCrossfade, settings.velocityCrossfade, nullptr);
+        padTree.setProperty(Ids::syncBeats, settings.syncBeats, nullptr);
+        padTree.setProperty(Ids::reverse, settings.reverse, nullptr);
+        padTree.setProperty(Ids::normalize, settings.normalize, nullptr);
+        padTree.setProperty(Ids::fadeIn, settings.fadeIn, nullptr);
+        padTree.setProperty(Ids::fadeOut, settings.fadeOut, nullptr);
+
+        for (size_t i = 0; i < pad.layers.size(); ++i) {
+            const auto& layer = pad.layers[i];
+            const int layerIndex = static_cast<int>(i);
+            const int layerSample = layer.sample != nullptr
+                                  ? storeSample(layer.sample)
+                                  : storePending([&pad, layerIndex](const PendingSample& candidate) {
+                                        return std::any_of(candidate.layers.begin(), candidate.layers.end(), [&](const LayerSlot& slot) {
+                                            return slot.padId == pad.id && slot.layer == layerIndex;
+                                        });
+                                    });
+
+            juce::ValueTree layerTree(layerType);
+            layerTree.setProperty(Ids::sample, layerSample, nullptr);
+            layerTree.setProperty(Ids::loVelocity, layer.loVelocity, nullptr);
+            layerTree.setProperty(Ids::hiVelocity, layer.hiVelocity, nullptr);
+            layerTree.setProperty(Ids::roundRobin, layer.roundRobin, nullptr);
+            padTree.appendChild(layerTree, nullptr);
+        }
+
+        kitTree.appendChild(padTree, nullptr);
+    }
+
+    // Forget samples no kit uses any more. Only now, so those evicted since the last save find their encoding.
+    cache.erase(std::remove_if(cache.begin(), cache.end(), [](const CachedSample& cached) { return cached.sample.expired(); }),
+                cache.end());
+
+    return kitTree;
+}
+
+KitState::Restore KitState::load(const juce::ValueTree& kitTree) {
+    Restore restore;
+    restore.kit = std::make_shared<Kit>();
+    restore.kit->name = kitTree.getProperty(Ids::name).toString();
+
+    std::vector<PendingSample> samples;
+    for (const auto& child : kitTree) {
+        if (child.hasType(sampleType))
+            samples.push_back({ child, 0, {} });
+    }
+
+    const PadSettings defaults;
+    for (const auto& child : kitTree) {
+        if (!child.hasType(padType))
+            continue;
+
+        const int padId = child.getProperty(Ids::id, -1);
+        if (padId < 0 || padId >= Kit::numPads)
+            continue;
+
+        auto& pad = restore.kit->pads[static_cast<size_t>(padId)];
+        auto& settings = pad.settings;
+        settings.midiNote = child.getProperty(Ids::midiNote, defaults.midiNote);
+        settings.chokeGroup = child.getProperty(Ids::chokeGroup, defaults.chokeGroup);
+        settings.volume = child.getProperty(Ids::volume, defaults.volume);
+        settings.attack = child.getProperty(Ids::attack, defaults.attack);
+        settings.release = child.getProperty(Ids::release, defaults.release);
+        settings.start = child.getProperty(Ids::start, defaults.start);
+        settings.end = child.getProperty(Ids::end, defaults.end);
+        settings.velocityCrossfade = child.getProperty(Ids::velocityCrossfade, defaults.velocityCrossfade);
+        settings.syncBeats = child.getProperty(Ids::syncBeats, defaults.syncBeats);
+        settings.reverse = child.getProperty(Ids::reverse, defaults.reverse);
+        settings.normalize = child.getProperty(Ids::normalize, defaults.normalize);
+        settings.fadeIn = child.getProperty(Ids::fadeIn, defaults.fadeIn);
+        settings.fadeOut = child.getProperty(Ids::fadeOut, defaults.fadeOut);
+
+        const int sampleIndex = child.getProperty(Ids::sample, -1);
+        if (sampleIndex >= 0 && sampleIndex < static_cast<int>(samples.size()))
+            samples[static_cast<size_t>(sampleIndex)].pads |= 1u << padId;
+
+        // Layers keep their place with an empty sample until it is decoded
+        for (const auto& layerTree : child) {
+            if (!layerTree.hasType(layerType))
+                continue;
+
+            const int layerSample = layerTree.getProperty(Ids::sample, -1);
+            if (layerSample < 0 || layerSample >= static_cast<int>(samples.size()))
+                continue;
+
+            const PadLayer layerDefaults;
+            PadLayer layer;
+            layer.loVelocity = layerTree.getProperty(Ids::loVelocity, layerDefaults.loVelocity);
+            layer.hiVelocity = layerTree.getProperty(Ids::hiVelocity, layerDefaults.hiVelocity);
+            layer.roundRobin = layerTree.getProperty(Ids::roundRobin, layerDefaults.roundRobin);
+
+            samples[static_cast<size_t>(layerSample)].layers.push_back({ padId, static_cast<int>(pad.layers.size()) });
+            pad.layers.push_back(std::move(layer));
+        }
+    }
+
+    for (auto& sample : samples) {
+        if (sample.pads != 0 || !sample.layers.empty())
+            restore.pendingSamples.push_back(std::move(sample));
+    }
+
+    return restore;
+}
+
+std::shared_ptr<Sample> KitState::decodeSample(const juce::ValueTree& encoded) {
+    // Bound by reference, so the audio data isn't copied
+    const juce::var& dataValue = encoded.getProperty(Ids::data);
+    const auto* data = dataValue.getBinaryData();
+    const juce::String name = encoded.getProperty(Ids::name).toString();
+    const double sampleRate = encoded.getProperty(Ids::sampleRate, 0.0);
+    const int numChannels = encoded.getProperty(Ids::numChannels, 0);
+    const int numFrames = encoded.getProperty(Ids::numFrames, 0);
+    const int format = encoded.getProperty(Ids::format, -1);
+    const auto encoding = encoded.getProperty(Ids::encoding).toString();
+
+    if (data == nullptr || sampleRate <= 0.0 || numChannels <= 0 || numFrames <= 0
+        || format < static_cast<int>(SampleFormat::Float32) || format > static_cast<int>(SampleFormat::Int24))
+        return nullptr;
+
+    const auto sampleFormat = static_cast<SampleFormat>(format);
+    std::shared_ptr<Sample> sample;
+
+    if (encoding == rawEncoding) {
+        const size_t expectedSize = getBytesPerSample(sampleFormat) * static_cast<size_t>(numFrames) * static_cast<size_t>(numChannels);
+        if (data->getSize() != expectedSize)
+            return nullptr;
+
+        // The sample keeps its own copy of the block and plays from it directly
+        auto owner = std::make_shared<juce::MemoryBlock>(*data);
+        sample = Sample::createForExternalData(sampleFormat, numChannels, numFrames, sampleRate, name, owner->getData(), owner);
+    } else if (encoding == flacEncoding) {
+       #if JUCE_USE_FLAC
+        juce::FlacAudioFormat flac;
+        std::unique_ptr<juce::AudioFormatReader> reader(flac.createReaderFor(new juce::MemoryInputStream(*data, false), true));
+        if (reader == nullptr)
+            return nullptr;
+
+        sample = Sample::loadFromReader(*reader, name);
+       #endif
+    }
+
+    if (sample == nullptr || sample->getNumChannels() != numChannels || sample->getNumFrames() != numFrames)
+        return nullptr;
+
+    SampleMetadata metadata;
+    metadata.rootNote = encoded.getProperty(Ids::rootNote, metadata.rootNote);
+    metadata.loopStart = encoded.getProperty(Ids::loopStart, metadata.loopStart);
+    metadata.loopEnd = encoded.getProperty(Ids::loopEnd, metadata.loopEnd);
+    sample->setMetadata(metadata);
+
+    return sample;
+}
+
+} // namespace Aika
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "kit.hpp"
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Kit persistence for plugin state.
+ *
+ * A kit is stored as a KIT ValueTree holding one SAMPLE child per distinct
+ * sample and one PAD child per pad, with a LAYER child per velocity layer or
+ * round robin of a layered pad. Sample audio travels inside the tree as
+ * binary data: integer samples as FLAC at their native bit depth, float
+ * samples as raw planar data.
+ *
+ * Restoring is split in two so the host is never blocked on decoding:
+ * load() rebuilds the pad structure straight away, with samples left empty,
+ * and decodeSample() turns each stored sample back into audio on any thread.
+ */
+class KitState {
+public:
+    static const juce::Identifier kitType;
+
+    /**
+     * A layer of a pad, by index into Pad::layers
+     */
+    struct LayerSlot {
+        int padId = 0;
+        int layer = 0;
+    };
+
+    /**
+     * A stored sample that has not been decoded yet, and the pads and layers waiting for it
+     */
+    struct PendingSample {
+        juce::ValueTree encoded;        // SAMPLE tree, passed to decodeSample
+        juce::uint32 pads = 0;          // One bit per pad id
+        std::vector<LayerSlot> layers;
+
+        /**
+         * @return One bit per pad id waiting for this sample, as its sample or in a layer
+         */
+        juce::uint32 getWaitingPads() const noexcept {
+            juce::uint32 waiting = pads;
+            for (const auto& slot : layers)
+                waiting |= 1u << slot.padId;
+            return waiting;
+        }
+    };
+
+    /**
+     * The first phase of a restore
+     */
+    struct Restore {
+        std::shared_ptr<Kit> kit;                   // Pad settings and layers applied, samples still null
+        std::vector<PendingSample> pendingSamples;
+    };
+
+    KitState() = default;
+
+    /**
+     * Store a kit. Encoded sample data is cached per sample, so saving an
+     * unchanged kit again only copies bytes. Not thread safe.
+     *
+     * @param kit The kit to store
+     * @param pendingSamples Samples of an unfinished restore; pads and layers
+     *                       that are still empty but waiting for one keep it
+     * @return KIT tree
+     */
+    juce::ValueTree save(const Kit& kit, const std::vector<PendingSample>& pendingSamples);
+
+    /**
+     * First phase of a restore: the kit's structure, without any decoding
+     *
+     * @param kitTree KIT tree written by save
+     * @return The kit and the samples still to decode
+     */
+    static Restore load(const juce::ValueTree& kitTree);
+
+    /**
+     * Second phase of a restore. Safe to call from any thread.
+     *
+     * @param encoded SAMPLE tree from a PendingSample
+     * @return The decoded sample, or nullptr if the data is malformed
+     */
+    static std::shared_ptr<Sample> decodeSample(const juce::ValueTree& encoded);
+
+private:
+    struct CachedSample {
+        std::weak_ptr<const Sample> sample;
+        juce::uint64 audioId = 0;   // Evicting a sample keeps its audio id, and its encoding
+        juce::String encoding;
+        juce::var data;
+    };
+
+    const CachedSample* encodeSample(const std::shared_ptr<const Sample>& sample);
+
+    std::vector<CachedSample> cache;
+
+    JUCE_DECLARE_NON_COPYABLE(KitState)
+};
+
+} // namespace Aika
@@ -0,0 +1,231 @@
+#include "loopfinder.hpp"
+#include "core/dsp/fft/fft.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Aika {
+
+namespace {
+
+constexpr int envelopeHop = 256;        // Block size of the RMS envelope
+constexpr float sustainFloor = 0.1f;    // Sustain ends once the envelope drops 20 dB below its peak
+constexpr float minCorrelation = 0.3f;  // Ignore autocorrelation peaks below this
+constexpr int maxLengthCandidates = 8;  // Loop lengths tried per file
+constexpr int maxSeamsPerLength = 256;  // Zero crossings tried per loop length
+constexpr int seamHalfWidth = 32;       // Samples compared on each side of a seam
+
+// Normalised squared difference between the neighbourhoods of two seam points (0 = identical)
+float seamError(const float* x, int a, int b) {
+    double diff = 0.0;
+    double energy = 1.0e-12;
+    for (int k = -seamHalfWidth; k < seamHalfWidth; ++k) {
+        const double d = x[a + k] - x[b + k];
+        diff += d * d;
+        energy += x[a + k] * x[a + k] + x[b + k] * x[b + k];
+    }
+    return static_cast<float>(diff / energy);
+}
+
+// Mismatch of the first derivative across a seam (0 = identical)
+float slopeError(const float* x, int a, int b) {
+    const float slopeA = x[a] - x[a - 1];
+    const float slopeB = x[b] - x[b - 1];
+    return std::abs(slopeA - slopeB) / (std::abs(slopeA) + std::abs(slopeB) + 1.0e-9f);
+}
+
+} // namespace
+
+LoopFinder::LoopFinder() {
+    formatManager.registerBasicFormats();
+}
+
+LoopFinder::~LoopFinder() {
+    // Jobs touch the cache, so they must finish before members are destroyed
+    pool.removeAllJobs(true, -1);
+}
+
+LoopCandidate LoopFinder::findLoop(const float* x, int numSamples, double sampleRate, const Settings& settings) {
+    const int minLag = std::max(16, static_cast<int>(settings.minLoopSeconds * sampleRate));
+    const int maxLoop = static_cast<int>(settings.maxLoopSeconds * sampleRate);
+
+    const int numBlocks = numSamples / envelopeHop;
+    if (numBlocks < 4 || numSamples < minLag * 4)
+        return {};
+
+    // Locate the sustain portion from a coarse RMS envelope
+    std::vector<float> envelope(static_cast<size_t>(numBlocks));
+    for (int b = 0; b < numBlocks; ++b) {
+        const float* block = x + b * envelopeHop;
+        double sum = 0.0;
+        for (int i = 0; i < envelopeHop; ++i)
+            sum += block[i] * block[i];
+        envelope[static_cast<size_t>(b)] = static_cast<float>(std::sqrt(sum / envelopeHop));
+    }
+
+    const auto peakIt = std::max_element(envelope.begin(), envelope.end());
+    const int peakBlock = static_cast<int>(std::distance(envelope.begin(), peakIt));
+    const float peakLevel = *peakIt;
+    if (peakLevel <= 1.0e-6f)
+        return {};
+
+    int lastSustainBlock = numBlocks - 1;
+    while (lastSustainBlock > peakBlock && envelope[static_cast<size_t>(lastSustainBlock)] < peakLevel * sustainFloor)
+        --lastSustainBlock;
+
+    // Skip 50 ms past the attack peak, and keep seam windows inside the data
+    const int sustainStart = std::max(seamHalfWidth + 1, (peakBlock + 1) * envelopeHop + static_cast<int>(0.05 * sampleRate));
+    const int sustainEnd = std::min(numSamples - seamHalfWidth, (lastSustainBlock + 1) * envelopeHop);
+    const int sustainLength = sustainEnd - sustainStart;
+    if (sustainLength < minLag * 2)
+        return {};
+
+    // Normalised autocorrelation of the sustain portion, computed via FFT
+    const int window = std::min(sustainLength, maxLoop * 2);
+    const int maxLag = std::min(maxLoop, window / 2);
+    if (maxLag <= minLag + 1)
+        return {};
+
+    const int fftSize = juce::nextPowerOfTwo(window * 2);
+    DSP::RealFFT fft(fftSize);
+    float* timeData = fft.getTimeData();
+    std::copy(x + sustainStart, x + sustainStart + window, timeData);
+    std::fill(timeData + window, timeData + fftSize, 0.0f);
+
+    fft.forward();
+    auto* spectrum = fft.getSpectrum();
+    for (int bin = 0; bin < fft.getNumBins(); ++bin)
+        spectrum[bin] = std::norm(spectrum[bin]);
+    fft.inverse();
+
+    // Prefix sums of energy give each lag's overlap energy in O(1)
+    std::vector<double> energy(static_cast<size_t>(window) + 1, 0.0);
+    for (int i = 0; i < window; ++i)
+        energy[static_cast<size_t>(i) + 1] = energy[static_cast<size_t>(i)] + x[sustainStart + i] * x[sustainStart + i];
+
+    std::vector<float> correlation(static_cast<size_t>(maxLag) + 1, 0.0f);
+    for (int lag = minLag; lag <= maxLag; ++lag) {
+        const double head = energy[static_cast<size_t>(window - lag)];
+        const double tail = energy[static_cast<size_t>(window)] - energy[static_cast<size_t>(lag)];
+        const double denominator = std::sqrt(head * tail) * fftSize;
+        correlation[static_cast<size_t>(lag)] = denominator > 0.0 ? static_cast<float>(timeData[lag] / denominator) : 0.0f;
+    }
+
+    // Strongest local maxima are the candidate loop lengths
+    std::vector<std::pair<float, int>> lengths;
+    for (int lag = minLag + 1; lag < maxLag; ++lag) {
+        const float c = correlation[static_cast<size_t>(lag)];
+        if (c > minCorrelation && c > correlation[static_cast<size_t>(lag) - 1] && c >= correlation[static_cast<size_t>(lag) + 1])
+            lengths.emplace_back(c, lag);
+    }
+
+    const size_t numLengths = std::min(lengths.size(), static_cast<size_t>(maxLengthCandidates));
+    std::partial_sort(lengths.begin(), lengths.begin() + static_cast<std::ptrdiff_t>(numLengths), lengths.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    lengths.resize(numLengths);
+
+    // Seams may only sit on rising zero crossings
+    std::vector<int> crossings;
+    for (int i = sustainStart; i < sustainEnd; ++i) {
+        if (x[i - 1] < 0.0f && x[i] >= 0.0f)
+            crossings.push_back(i);
+    }
+    if (crossings.size() < 2)
+        return {};
+
+    LoopCandidate best;
+    float bestScore = -1.0f;
+
+    for (const auto& [lengthCorrelation, length] : lengths) {
+        const int maxSnap = std::max(4, length / 64);
+        auto endIt = std::lower_bound(crossings.begin(), crossings.end(), sustainStart + length);
+
+        // Walking forward from the earliest possible end favours early loops,
+        // which lets more of the sample be trimmed after the loop end
+        for (int tried = 0; endIt != crossings.end() && tried < maxSeamsPerLength; ++endIt, ++tried) {
+            const int end = *endIt;
+            const int target = end - length;
+
+            auto startIt = std::lower_bound(crossings.begin(), crossings.end(), target);
+            if (startIt == crossings.end() || (startIt != crossings.begin() && target - *std::prev(startIt) < *startIt - target))
+                startIt = std::prev(startIt);
+
+            const int start = *startIt;
+            if (std::abs(start - target) > maxSnap || end - start < minLag)
+                continue;
+
+            const float score = lengthCorrelation - 0.5f * seamError(x, start, end) - 0.25f * slopeError(x, start, end);
+            if (score > bestScore) {
+                bestScore = score;
+                best.start = start;
+                best.end = end;
+            }
+        }
+    }
+
+    best.confidence = juce::jlimit(0.0f, 1.0f, bestScore);
+    if (best.confidence < settings.minConfidence)
+        return { -1, -1, best.confidence };
+
+    return best;
+}
+
+std::optional<LoopCandidate> LoopFinder::getCachedLoop(const juce::File& file) {
+    const auto key = getCacheKey(file);
+
+    std::lock_guard<std::mutex> lock(cacheLock);
+    if (const auto it = cache.find(key); it != cache.end())
+        return it->second;
+
+    return std::nullopt;
+}
+
+void LoopFinder::requestAnalysis(const juce::File& file, std::function<void(const LoopCandidate&)> onComplete) {
+    const auto key = getCacheKey(file);
+
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        if (cache.count(key) > 0 || !pending.insert(key).second)
+            return;
+    }
+
+    pool.addJob([this, file, key, onComplete = std::move(onComplete)] {
+        const auto result = analyseFile(file);
+
+        {
+            std::lock_guard<std::mutex> lock(cacheLock);
+            cache[key] = result;
+            pending.erase(key);
+        }
+
+        if (onComplete)
+            onComplete(result);
+    });
+}
+
+juce::String LoopFinder::getCacheKey(const juce::File& file) {
+    return file.getFullPathName()
+         + ":" + juce::String(file.getLastModificationTime().toMilliseconds())
+         + ":" + juce::String(file.getSize());
+}
+
+LoopCandidate LoopFinder::analyseFile(const juce::File& file) {
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+        return {};
+
+    const int numSamples = static_cast<int>(std::min(reader->lengthInSamples,
+                                                     static_cast<juce::int64>(settings.maxAnalysisSeconds * reader->sampleRate)));
+
+    juce::AudioBuffer<float> buffer(static_cast<int>(reader->numChannels), numSamples);
+    reader->read(&buffer, 0, numSamples, 0, true, true);
+
+    // Mix down to mono; scaling doesn't matter as all scores are normalised
+    for (int channel = 1; channel < buffer.getNumChannels(); ++channel)
+        buffer.addFrom(0, 0, buffer, channel, 0, numSamples);
+
+    return findLoop(buffer.getReadPointer(0), numSamples, reader->sampleRate, settings);
+}
+
+} // namespace Aika
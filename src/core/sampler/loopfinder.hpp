@@ -0,0 +1,95 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Aika {
+
+/**
+ * A proposed sustain loop, in sample frames from the start of the file
+ */
+struct LoopCandidate {
+    juce::int64 start = -1;     // First frame of the loop
+    juce::int64 end = -1;       // One past the last frame; playback wraps from end - 1 to start
+    float confidence = 0.0f;    // 0.0 - 1.0, how seamless the loop is expected to be
+
+    bool isValid() const noexcept { return start >= 0 && end > start; }
+};
+
+/**
+ * Finds click-free sustain loops in samples that carry no loop metadata.
+ *
+ * Loop lengths are taken from peaks of the FFT autocorrelation of the
+ * sustain portion. Each length is then placed on a pair of rising zero
+ * crossings whose surroundings and slopes match, so the seam is inaudible.
+ * Files are analysed on a background thread and results are cached per file.
+ */
+class LoopFinder {
+public:
+    struct Settings {
+        double minLoopSeconds = 0.05;     // Shortest loop considered
+        double maxLoopSeconds = 1.0;      // Longest loop considered
+        double maxAnalysisSeconds = 30.0; // Only this much of each file is decoded
+        float minConfidence = 0.6f;       // Loops scoring below this are rejected
+    };
+
+    LoopFinder();
+    ~LoopFinder();
+
+    /**
+     * Search a mono signal for the best loop. Allocates scratch memory, so
+     * never call this from the audio thread.
+     *
+     * @param samples Mono sample data
+     * @param numSamples Number of samples
+     * @param sampleRate Sample rate in Hz
+     * @param settings Search limits
+     * @return The best loop found; invalid if none reached settings.minConfidence
+     */
+    static LoopCandidate findLoop(const float* samples, int numSamples, double sampleRate, const Settings& settings);
+
+    /**
+     * Look up a previous analysis of a file
+     *
+     * @param file The audio file
+     * @return The cached result (which may be an invalid candidate if no loop was found),
+     *         or nothing if the file has not been analysed yet
+     */
+    std::optional<LoopCandidate> getCachedLoop(const juce::File& file);
+
+    /**
+     * Queue a file for analysis on the background thread. Does nothing if the
+     * file is already cached or queued.
+     *
+     * @param file The audio file
+     * @param onComplete Optional callback, invoked on the background thread
+     */
+    void requestAnalysis(const juce::File& file, std::function<void(const LoopCandidate&)> onComplete = nullptr);
+
+private:
+    /**
+     * Build a cache key that changes whenever the file is modified
+     */
+    static juce::String getCacheKey(const juce::File& file);
+
+    /**
+     * Decode the start of a file to mono and run findLoop on it
+     */
+    LoopCandidate analyseFile(const juce::File& file);
+
+    Settings settings;
+    juce::AudioFormatManager formatManager; // Only used on the pool thread
+    juce::ThreadPool pool { 1 };
+
+    std::mutex cacheLock;
+    std::unordered_map<juce::String, LoopCandidate> cache;
+    std::unordered_set<juce::String> pending;
+
+    JUCE_DECLARE_NON_COPYABLE(LoopFinder)
+};
+
+} // namespace Aika
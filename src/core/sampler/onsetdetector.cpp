@@ -0,0 +1,220 @@
+#include "onsetdetector.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+namespace {
+
+constexpr float compression = 10.0f;  // log(1 + c|X|) magnitude compression
+constexpr int averageBefore = 8;      // Hops averaged before a candidate
+constexpr int averageAfter = 4;       // Hops averaged after a candidate
+constexpr int peakRadius = 3;         // A peak must be the maximum within this many hops
+constexpr float silenceLevel = 0.001f; // -60 dBFS; quieter audio ahead of the first onset is not sliced
+
+} // namespace
+
+OnsetDetector::OnsetDetector() : OnsetDetector(Settings()) {
+}
+
+OnsetDetector::OnsetDetector(const Settings& s)
+    : settings(s), fft(s.frameSize) {
+    window.resize(static_cast<size_t>(settings.frameSize));
+    for (int i = 0; i < settings.frameSize; ++i)
+        window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(2.0f * juce::MathConstants<float>::pi * i / settings.frameSize);
+
+    magnitudes.resize(static_cast<size_t>(fft.getNumBins()));
+    previousMagnitudes.resize(static_cast<size_t>(fft.getNumBins()));
+}
+
+OnsetDetector::~OnsetDetector() {
+}
+
+std::vector<int> OnsetDetector::detect(const Sample& sample) {
+    return detect(sample, 0, sample.getNumFrames());
+}
+
+void OnsetDetector::readMono(const Sample& stored, int startFrame, int numFrames) {
+    mixScratch.resize(static_cast<size_t>(numFrames));
+    channelScratch.resize(static_cast<size_t>(numFrames));
+
+    // An evicted sample is read back from disk rather than analysed as silence
+    const Sample* full = stored.loadFull();
+    const Sample& sample = full != nullptr ? *full : stored;
+
+    sample.readFrames(0, startFrame, numFrames, mixScratch.data());
+    for (int channel = 1; channel < sample.getNumChannels(); ++channel) {
+        sample.readFrames(channel, startFrame, numFrames, channelScratch.data());
+        juce::FloatVectorOperations::add(mixScratch.data(), channelScratch.data(), numFrames);
+    }
+}
+
+std::vector<int> OnsetDetector::detect(const Sample& sample, int startFrame, int numFrames) {
+    std::vector<int> onsets;
+
+    const int frameSize = settings.frameSize;
+    const int hopSize = settings.hopSize;
+    const int numChannels = sample.getNumChannels();
+    if (numFrames < frameSize || numChannels == 0)
+        return onsets;
+
+    const int numHops = (numFrames - frameSize) / hopSize + 1;
+    flux.assign(static_cast<size_t>(numHops), 0.0f);
+    std::fill(previousMagnitudes.begin(), previousMagnitudes.end(), 0.0f);
+
+    float* timeData = fft.getTimeData();
+    const auto* spectrum = fft.getSpectrum();
+    const int numBins = fft.getNumBins();
+    const float channelScale = 1.0f / static_cast<float>(numChannels);
+
+    // Onset function: positive change in log-magnitude spectrum per hop
+    for (int hop = 0; hop < numHops; ++hop) {
+        // Only one frame is decoded at a time, so analysis never holds a full-length copy
+        readMono(sample, startFrame + hop * hopSize, frameSize);
+        for (int i = 0; i < frameSize; ++i)
+            timeData[i] = mixScratch[static_cast<size_t>(i)] * window[static_cast<size_t>(i)] * channelScale;
+
+        fft.forward();
+
+        float sum = 0.0f;
+        for (int bin = 0; bin < numBins; ++bin) {
+            const float magnitude = std::log1p(compression * std::abs(spectrum[bin]));
+            sum += std::max(0.0f, magnitude - previousMagnitudes[static_cast<size_t>(bin)]);
+            magnitudes[static_cast<size_t>(bin)] = magnitude;
+        }
+
+        flux[static_cast<size_t>(hop)] = hop == 0 ? 0.0f : sum;
+        std::swap(magnitudes, previousMagnitudes);
+    }
+
+    const float maxFlux = *std::max_element(flux.begin(), flux.end());
+    if (maxFlux > 0.0f)
+        pickOnsets(sample, startFrame, numFrames, maxFlux, onsets);
+
+    // A hit right at the start has no earlier hop to rise above, so audio ahead
+    // of the first onset starts a slice of its own rather than being left out
+    const int firstOnset = onsets.empty() ? startFrame + numFrames : onsets.front();
+    if (firstOnset > startFrame && hasSignal(sample, startFrame, firstOnset))
+        onsets.insert(onsets.begin(), startFrame);
+
+    return onsets;
+}
+
+void OnsetDetector::pickOnsets(const Sample& sample, int startFrame, int numFrames, float maxFlux, std::vector<int>& onsets) {
+    const int frameSize = settings.frameSize;
+    const int hopSize = settings.hopSize;
+    const double sampleRate = sample.getSampleRate();
+    const int numHops = static_cast<int>(flux.size());
+
+    for (auto& value : flux)
+        value /= maxFlux;
+
+    // Peak picking against a moving average
+    const float delta = 0.02f + 0.3f * (1.0f - juce::jlimit(0.0f, 1.0f, settings.sensitivity));
+    const int minGap = std::max(1, static_cast<int>(settings.minInterOnsetSeconds * sampleRate / hopSize));
+    int lastOnsetHop = -minGap;
+
+    for (int hop = 1; hop < numHops; ++hop) {
+        const float value = flux[static_cast<size_t>(hop)];
+
+        const int peakStart = std::max(0, hop - peakRadius);
+        const int peakEnd = std::min(numHops - 1, hop + peakRadius);
+        if (*std::max_element(flux.begin() + peakStart, flux.begin() + peakEnd + 1) > value)
+            continue;
+
+        const int meanStart = std::max(0, hop - averageBefore);
+        const int meanEnd = std::min(numHops - 1, hop + averageAfter);
+        float mean = 0.0f;
+        for (int i = meanStart; i <= meanEnd; ++i)
+            mean += flux[static_cast<size_t>(i)];
+        mean /= static_cast<float>(meanEnd - meanStart + 1);
+
+        if (value < mean + delta || hop - lastOnsetHop < minGap)
+            continue;
+
+        lastOnsetHop = hop;
+
+        // The new transient sits in the newest hop of the frame
+        const int roughPosition = startFrame + hop * hopSize + frameSize - hopSize;
+        const int refined = refineOnset(sample, roughPosition, onsets.empty() ? startFrame : onsets.back() + 1, startFrame + numFrames);
+        onsets.push_back(refined);
+    }
+}
+
+bool OnsetDetector::hasSignal(const Sample& sample, int startFrame, int endFrame) {
+    const float level = silenceLevel * static_cast<float>(sample.getNumChannels());
+    for (int position = startFrame; position < endFrame; position += settings.frameSize) {
+        const int count = std::min(settings.frameSize, endFrame - position);
+        readMono(sample, position, count);
+
+        const auto range = juce::FloatVectorOperations::findMinAndMax(mixScratch.data(), count);
+        if (std::max(-range.getStart(), range.getEnd()) > level)
+            return true;
+    }
+    return false;
+}
+
+int OnsetDetector::refineOnset(const Sample& sample, int roughPosition, int rangeStart, int rangeEnd) {
+    const int searchStart = std::max(rangeStart, roughPosition - settings.frameSize);
+    const int searchEnd = std::min(rangeEnd, roughPosition + settings.hopSize);
+    if (searchEnd <= searchStart)
+        return std::max(rangeStart, std::min(roughPosition, rangeEnd - 1));
+
+    readMono(sample, searchStart, searchEnd - searchStart);
+    const auto x = [this, searchStart](int frame) { return mixScratch[static_cast<size_t>(frame - searchStart)]; };
+
+    // Loudest point of the transient
+    int peak = searchStart;
+    float peakLevel = 0.0f;
+    for (int i = searchStart; i < searchEnd; ++i) {
+        const float level = std::abs(x(i));
+        if (level > peakLevel) {
+            peakLevel = level;
+            peak = i;
+        }
+    }
+
+    // First point that rises clearly above the signal preceding the transient
+    const int backgroundEnd = std::min(peak, searchStart + 64);
+    float background = 0.0f;
+    for (int i = searchStart; i < backgroundEnd; ++i)
+        background = std::max(background, std::abs(x(i)));
+
+    const float floor = std::max(peakLevel * 0.1f, background * 2.0f);
+    int position = searchStart;
+    while (position < peak && std::abs(x(position)) <= floor)
+        ++position;
+
+    // Snap back to the nearest zero crossing so the slice starts without a click
+    const int snapLimit = std::max(searchStart, position - 64);
+    for (int i = position; i > snapLimit; --i) {
+        if ((x(i - 1) <= 0.0f && x(i) >= 0.0f) || (x(i - 1) >= 0.0f && x(i) <= 0.0f))
+            return i;
+    }
+
+    return position;
+}
+
+int OnsetDetector::sliceToPads(Kit& kit, const std::shared_ptr<const Sample>& sample, const std::vector<int>& onsets, int firstPad,
+                               int endFrame) {
+    if (sample == nullptr || firstPad < 0)
+        return 0;
+
+    const double sampleRate = sample->getSampleRate();
+    const int lastEnd = endFrame >= 0 ? std::min(endFrame, sample->getNumFrames()) : sample->getNumFrames();
+    int padIndex = firstPad;
+
+    for (size_t i = 0; i < onsets.size() && padIndex < Kit::numPads; ++i, ++padIndex) {
+        const int end = i + 1 < onsets.size() ? onsets[i + 1] : lastEnd;
+
+        auto& pad = kit.pads[static_cast<size_t>(padIndex)];
+        pad.sample = sample;
+        pad.layers.clear();
+        pad.settings.start = onsets[i] / sampleRate;
+        pad.settings.end = end / sampleRate;
+    }
+
+    return padIndex - firstPad;
+}
+
+} // namespace Aika
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "core/dsp/fft/fft.hpp"
+#include "kit.hpp"
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Spectral-flux onset detector used to slice drum loops onto pads.
+ *
+ * Each hop is windowed, transformed with fftw and log-compressed; the
+ * positive magnitude change between hops forms the onset function, which
+ * is peak-picked against a moving average. Onsets are then moved back to
+ * the start of the transient so slices begin cleanly.
+ */
+class OnsetDetector {
+public:
+    struct Settings {
+        int frameSize = 1024;
+        int hopSize = 256;
+        float sensitivity = 0.5f;             // 0.0 - 1.0, higher finds more onsets
+        double minInterOnsetSeconds = 0.05;   // Onsets closer than this are merged
+    };
+
+    /**
+     * Constructor using the default settings
+     */
+    OnsetDetector();
+
+    /**
+     * Constructor
+     * @param settings Analysis settings
+     */
+    explicit OnsetDetector(const Settings& settings);
+    ~OnsetDetector();
+
+    /**
+     * Find onsets in a range of a sample. All channels are analysed together.
+     *
+     * @param sample The sample to analyse
+     * @param startFrame First frame to analyse
+     * @param numFrames Number of frames to analyse
+     * @return Onset positions in frames, ascending; startFrame is one unless the audio before the first transient is silent
+     */
+    std::vector<int> detect(const Sample& sample, int startFrame, int numFrames);
+
+    /**
+     * Find onsets across a whole sample
+     *
+     * @param sample The sample to analyse
+     * @return Onset positions in frames, ascending
+     */
+    std::vector<int> detect(const Sample& sample);
+
+    /**
+     * Map slices onto consecutive pads. Every pad references the same sample,
+     * so slicing never copies audio; only each pad's start and end change.
+     * Layers on those pads are replaced by the slice.
+     *
+     * @param kit The kit to update
+     * @param sample The sliced sample
+     * @param onsets Slice start positions in frames, ascending
+     * @param firstPad Index of the pad that receives the first slice
+     * @param endFrame Where the last slice ends, or -1 for the end of the sample
+     * @return Number of pads assigned
+     */
+    static int sliceToPads(Kit& kit, const std::shared_ptr<const Sample>& sample, const std::vector<int>& onsets, int firstPad = 0,
+                           int endFrame = -1);
+
+private:
+    /**
+     * Move an onset back to where its transient starts, snapped to a zero crossing
+     */
+    int refineOnset(const Sample& sample, int roughPosition, int rangeStart, int rangeEnd);
+
+    /**
+     * Peak-pick the normalized onset function into onsets, each refined
+     */
+    void pickOnsets(const Sample& sample, int startFrame, int numFrames, float maxFlux, std::vector<int>& onsets);
+
+    /**
+     * @return True if any frame in the range is louder than silence
+     */
+    bool hasSignal(const Sample& sample, int startFrame, int endFrame);
+
+    /**
+     * Decode a range of all channels summed to mono into mixScratch
+     */
+    void readMono(const Sample& sample, int startFrame, int numFrames);
+
+    Settings settings;
+    DSP::RealFFT fft;
+    std::vector<float> window;
+    std::vector<float> magnitudes;
+    std::vector<float> previousMagnitudes;
+    std::vector<float> flux;
+    std::vector<float> mixScratch;
+    std::vector<float> channelScratch;
+
+    JUCE_DECLARE_NON_COPYABLE(OnsetDetector)
+};
+
+} // namespace Aika
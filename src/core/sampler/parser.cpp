@@ -1,7 +1,5 @@
 
 #include "parser.hpp"
-#include <regex>
-#include <array>
 
 namespace Aika {
 
@@ -51,8 +49,19 @@ Json::Value SampleParser::parseSampleFile(const std::string& filePath) {
     int rootNote = parseRootNoteFromFilename(filename.toStdString());
     if (rootNote >= 0) {
         result["rootNote"] = rootNote;
+        result["rootNoteSource"] = "filename";
     } else {
-        result["rootNote"] = 60; // Default to middle C if not found
+        // Fall back to estimating the pitch from a short window of audio
+        PitchEstimate pitch = pitchDetector.detect(*reader);
+        if (pitch.isValid() && pitch.confidence >= minPitchConfidence) {
+            result["rootNote"] = pitch.midiNote;
+            result["rootNoteSource"] = "pitch";
+            result["tuningCents"] = pitch.cents;
+            result["pitchConfidence"] = pitch.confidence;
+        } else {
+            result["rootNote"] = 60; // Default to middle C if not found
+            result["rootNoteSource"] = "default";
+        }
     }
 
     // Analyze audio content for loop points, etc.
@@ -60,7 +69,7 @@ Json::Value SampleParser::parseSampleFile(const std::string& filePath) {
     result["buffer"] = audioContent["buffer"];
     
     // Add loop information if available
-    detectLoopPoints(reader, result);
+    detectLoopPoints(file, reader, result);
     
     return result;
 }
@@ -80,7 +89,7 @@ Json::Value SampleParser::analyzeAudioContent(std::unique_ptr<juce::AudioFormatR
     return result;
 }
 
-void SampleParser::detectLoopPoints(std::unique_ptr<juce::AudioFormatReader>& audioFile, Json::Value& result) {
+void SampleParser::detectLoopPoints(const juce::File& file, std::unique_ptr<juce::AudioFormatReader>& audioFile, Json::Value& result) {
     result["hasLoop"] = false;
     
     // Check for loop point metadata
@@ -95,8 +104,26 @@ void SampleParser::detectLoopPoints(std::unique_ptr<juce::AudioFormatReader>& au
             result["hasLoop"] = true;
             result["loopStart"] = static_cast<Json::UInt64>(loopStart);
             result["loopEnd"] = static_cast<Json::UInt64>(loopEnd);
+            result["loopSource"] = "metadata";
+            return;
         }
     }
+    
+    // No usable metadata, fall back to a detected loop
+    if (auto cached = loopFinder->getCachedLoop(file)) {
+        if (cached->isValid() && cached->end <= audioFile->lengthInSamples) {
+            result["hasLoop"] = true;
+            result["loopStart"] = static_cast<Json::UInt64>(cached->start);
+            result["loopEnd"] = static_cast<Json::UInt64>(cached->end);
+            result["loopSource"] = "detected";
+            result["loopConfidence"] = cached->confidence;
+        }
+        return;
+    }
+    
+    // Not analysed yet; the result will be cached for the next parse
+    loopFinder->requestAnalysis(file);
+    result["loopAnalysisPending"] = true;
 }
 
 Json::Value SampleParser::audioBufferToJson(const juce::AudioBuffer<float>& buffer) {
@@ -120,51 +147,48 @@ Json::Value SampleParser::audioBufferToJson(const juce::AudioBuffer<float>& buff
 }
 
 int SampleParser::parseRootNoteFromFilename(const std::string& filename) {
-    static std::array<std::string, 12> noteNames = {
-        "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"
-    };
-    
-    // Try to match patterns like "C3", "A#4", etc.
-    std::regex notePattern("([A-G]#?)(-?[0-9])");
-    std::smatch match;
-    
-    if (std::regex_search(filename, match, notePattern) && match.size() > 2) {
-        std::string noteName = match[1].str();
-        int octave = std::stoi(match[2].str());
-        
-        // Find the note index (0-11)
-        auto noteIt = std::find(noteNames.begin(), noteNames.end(), noteName);
-        if (noteIt != noteNames.end()) {
-            int noteIndex = static_cast<int>(std::distance(noteNames.begin(), noteIt));
-            
-            // Calculate the MIDI note number (C4 = 60, middle C)
-            return (octave + 1) * 12 + noteIndex;
-        }
+    return FilenameScanner::scan(filename).rootNote;
+}
+
+Json::Value SampleParser::parseFilenameMetadata(const std::string& filename) {
+    return filenameInfoToJson(FilenameScanner::scan(filename));
+}
+
+Json::Value SampleParser::parseFilenameMetadataBatch(const std::vector<std::string>& filenames) {
+    std::vector<FilenameInfo> infos;
+    FilenameScanner::scanBatch(filenames, infos);
+
+    Json::Value result(Json::arrayValue);
+    for (const auto& info : infos) {
+        result.append(filenameInfoToJson(info));
     }
     
-    return -1; // Not found
+    return result;
 }
 
-Json::Value SampleParser::parseFilenameMetadata(const std::string& filename) {
-    Json::Value result;
+Json::Value SampleParser::filenameInfoToJson(const FilenameInfo& info) {
+    Json::Value result(Json::objectValue);
     
-    // Extract potential root note
-    int rootNote = parseRootNoteFromFilename(filename);
-    if (rootNote >= 0) {
-        result["rootNote"] = rootNote;
+    if (info.rootNote >= 0) {
+        result["rootNote"] = info.rootNote;
     }
     
-    // Try to extract velocity from patterns like "v100", "vel127", etc.
-    std::regex velocityPattern("v(?:el)?([0-9]{1,3})");
-    std::smatch velMatch;
-    
-    if (std::regex_search(filename, velMatch, velocityPattern) && velMatch.size() > 1) {
-        int velocity = std::stoi(velMatch[1].str());
-        if (velocity >= 0 && velocity <= 127) {
-            result["velocity"] = velocity;
+    if (info.velocity >= 0) {
+        result["velocity"] = info.velocity;
+        if (info.velocityLow != info.velocityHigh) {
+            result["velocityLow"] = info.velocityLow;
+            result["velocityHigh"] = info.velocityHigh;
         }
     }
     
+    if (info.roundRobin >= 0) {
+        result["roundRobin"] = info.roundRobin;
+    }
+    
+    if (info.articulation != Articulation::None) {
+        result["articulation"] = FilenameScanner::getArticulationName(info.articulation);
+    }
+    
     return result;
 }
 
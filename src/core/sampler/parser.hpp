@@ -3,6 +3,9 @@
 
 #include <JuceHeader.h>
 #include <json/json.h>
+#include "filenamescanner.hpp"
+#include "loopfinder.hpp"
+#include "pitchdetector.hpp"
 #include <memory>
 #include <string>
 #include <vector>
@@ -34,6 +37,14 @@ public:
      */
     Json::Value parseFilenameMetadata(const std::string& filename);
 
+    /**
+     * Parse metadata from many filenames at once (e.g. a whole library folder)
+     * 
+     * @param filenames The filenames to analyze
+     * @return JSON array with one metadata object per filename, in order
+     */
+    Json::Value parseFilenameMetadataBatch(const std::vector<std::string>& filenames);
+
 private:
     /**
      * Helper function to analyze the content of an audio file
@@ -44,12 +55,14 @@ private:
     Json::Value analyzeAudioContent(std::unique_ptr<juce::AudioFormatReader>& audioFile);
 
     /**
-     * Detect loop points in the audio if they exist
+     * Detect loop points in the audio. Loop metadata is used when present;
+     * otherwise a loop found by background analysis is reported once available.
      * 
+     * @param file The audio file, used as the analysis cache key
      * @param audioFile The audio format reader
      * @param result The JSON result to update with loop info
      */
-    void detectLoopPoints(std::unique_ptr<juce::AudioFormatReader>& audioFile, Json::Value& result);
+    void detectLoopPoints(const juce::File& file, std::unique_ptr<juce::AudioFormatReader>& audioFile, Json::Value& result);
 
     /**
      * Convert audio buffer to JSON-compatible format
@@ -67,7 +80,20 @@ private:
      */
     int parseRootNoteFromFilename(const std::string& filename);
 
+    /**
+     * Convert scanned filename metadata to the JSON shape used by parseFilenameMetadata
+     * 
+     * @param info The scanned metadata
+     * @return JSON object containing only the fields that were found
+     */
+    Json::Value filenameInfoToJson(const FilenameInfo& info);
+
     std::unique_ptr<juce::AudioFormatManager> formatManager;
+    juce::SharedResourcePointer<LoopFinder> loopFinder;
+    PitchDetector pitchDetector;
+
+    // Pitch estimates below this confidence fall back to the default root note
+    static constexpr float minPitchConfidence = 0.8f;
 };
 
 } // namespace Aika
@@ -0,0 +1,150 @@
+#include "pitchdetector.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+PitchDetector::PitchDetector(float minFreq, float maxFreq)
+    : minFrequency(minFreq), maxFrequency(maxFreq) {
+}
+
+PitchDetector::~PitchDetector() {
+}
+
+int PitchDetector::getWindowSize(double sampleRate) const {
+    const int maxLag = static_cast<int>(std::ceil(sampleRate / minFrequency));
+    return 2 * juce::nextPowerOfTwo(maxLag + 1);
+}
+
+void PitchDetector::prepare(int fftSize) {
+    if (fft != nullptr && fft->getSize() == fftSize)
+        return;
+
+    fft = std::make_unique<DSP::RealFFT>(fftSize);
+    headSpectrum.resize(static_cast<size_t>(fft->getNumBins()));
+    difference.resize(static_cast<size_t>(fftSize / 2));
+}
+
+PitchEstimate PitchDetector::detect(const float* x, int numSamples, double sampleRate) {
+    const int windowSize = std::min(getWindowSize(sampleRate), numSamples & ~1);
+    const int integration = windowSize / 2;
+    const int minLag = std::max(2, static_cast<int>(sampleRate / maxFrequency));
+    const int maxLag = std::min(static_cast<int>(std::ceil(sampleRate / minFrequency)), integration - 2);
+
+    if (maxLag <= minLag + 2)
+        return {};
+
+    // Silence has no pitch
+    double totalEnergy = 0.0;
+    for (int i = 0; i < windowSize; ++i)
+        totalEnergy += x[i] * x[i];
+    if (totalEnergy / windowSize < 1.0e-8)
+        return {};
+
+    const int fftSize = juce::nextPowerOfTwo(windowSize);
+    prepare(fftSize);
+
+    float* timeData = fft->getTimeData();
+    auto* spectrum = fft->getSpectrum();
+    const int numBins = fft->getNumBins();
+
+    // r(tau) = sum_{j < W} x[j] x[j + tau], as the cross-correlation of the head with the whole window
+    std::copy(x, x + integration, timeData);
+    std::fill(timeData + integration, timeData + fftSize, 0.0f);
+    fft->forward();
+    std::copy(spectrum, spectrum + numBins, headSpectrum.begin());
+
+    std::copy(x, x + windowSize, timeData);
+    std::fill(timeData + windowSize, timeData + fftSize, 0.0f);
+    fft->forward();
+    for (int bin = 0; bin < numBins; ++bin)
+        spectrum[bin] *= std::conj(headSpectrum[static_cast<size_t>(bin)]);
+    fft->inverse();
+
+    // d(tau) = E(0) + E(tau) - 2 r(tau), with E(tau) the energy of x[tau, tau + W)
+    const float scale = 1.0f / static_cast<float>(fftSize);
+    double headEnergy = 0.0;
+    for (int i = 0; i < integration; ++i)
+        headEnergy += x[i] * x[i];
+
+    // Cumulative mean normalised difference, in place
+    double laggedEnergy = headEnergy;
+    double runningSum = 0.0;
+    difference[0] = 1.0f;
+    for (int lag = 1; lag <= maxLag; ++lag) {
+        laggedEnergy += x[lag - 1 + integration] * x[lag - 1 + integration] - x[lag - 1] * x[lag - 1];
+        const double d = std::max(0.0, headEnergy + laggedEnergy - 2.0 * timeData[lag] * scale);
+        runningSum += d;
+        difference[static_cast<size_t>(lag)] = runningSum > 0.0 ? static_cast<float>(d * lag / runningSum) : 1.0f;
+    }
+
+    // First dip below the threshold, followed down to its minimum; else the global minimum
+    int bestLag = -1;
+    for (int lag = minLag; lag <= maxLag; ++lag) {
+        if (difference[static_cast<size_t>(lag)] < threshold) {
+            while (lag + 1 <= maxLag && difference[static_cast<size_t>(lag) + 1] < difference[static_cast<size_t>(lag)])
+                ++lag;
+            bestLag = lag;
+            break;
+        }
+    }
+
+    if (bestLag < 0) {
+        const auto first = difference.begin() + minLag;
+        bestLag = static_cast<int>(std::distance(difference.begin(), std::min_element(first, difference.begin() + maxLag + 1)));
+    }
+
+    // Parabolic interpolation for sub-sample lag accuracy
+    float refinedLag = static_cast<float>(bestLag);
+    if (bestLag > minLag && bestLag < maxLag) {
+        const float a = difference[static_cast<size_t>(bestLag) - 1];
+        const float b = difference[static_cast<size_t>(bestLag)];
+        const float c = difference[static_cast<size_t>(bestLag) + 1];
+        const float curvature = a - 2.0f * b + c;
+        if (curvature > 0.0f)
+            refinedLag += 0.5f * (a - c) / curvature;
+    }
+
+    PitchEstimate estimate;
+    estimate.frequency = static_cast<float>(sampleRate / refinedLag);
+    estimate.confidence = juce::jlimit(0.0f, 1.0f, 1.0f - difference[static_cast<size_t>(bestLag)]);
+
+    const float exactNote = 69.0f + 12.0f * std::log2(estimate.frequency / 440.0f);
+    const int nearestNote = static_cast<int>(std::lround(exactNote));
+    if (nearestNote < 0 || nearestNote > 127)
+        return {};
+
+    estimate.midiNote = nearestNote;
+    estimate.cents = (exactNote - static_cast<float>(nearestNote)) * 100.0f;
+    return estimate;
+}
+
+PitchEstimate PitchDetector::detect(juce::AudioFormatReader& reader) {
+    const double sampleRate = reader.sampleRate;
+    const int windowSize = getWindowSize(sampleRate);
+    const int attackSearch = static_cast<int>(0.3 * sampleRate);
+    const int numSamples = static_cast<int>(std::min(reader.lengthInSamples, static_cast<juce::int64>(attackSearch + windowSize)));
+
+    if (numSamples <= 0 || reader.numChannels == 0)
+        return {};
+
+    decodeBuffer.setSize(static_cast<int>(reader.numChannels), numSamples, false, false, true);
+    reader.read(&decodeBuffer, 0, numSamples, 0, true, true);
+
+    for (int channel = 1; channel < decodeBuffer.getNumChannels(); ++channel)
+        decodeBuffer.addFrom(0, 0, decodeBuffer, channel, 0, numSamples);
+
+    // Start just after the loudest point of the attack, where the tone has settled
+    const float* mono = decodeBuffer.getReadPointer(0);
+    const int searchEnd = std::min(attackSearch, numSamples);
+    int peakIndex = 0;
+    for (int i = 1; i < searchEnd; ++i) {
+        if (std::abs(mono[i]) > std::abs(mono[peakIndex]))
+            peakIndex = i;
+    }
+
+    const int start = std::max(0, std::min(peakIndex + static_cast<int>(0.02 * sampleRate), numSamples - windowSize));
+    return detect(mono + start, numSamples - start, sampleRate);
+}
+
+} // namespace Aika
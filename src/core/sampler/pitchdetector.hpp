@@ -0,0 +1,82 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "core/dsp/fft/fft.hpp"
+#include <memory>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Result of a pitch estimate
+ */
+struct PitchEstimate {
+    float frequency = 0.0f;   // Fundamental in Hz, 0 if none was found
+    int midiNote = -1;        // Nearest MIDI note, -1 if none was found
+    float cents = 0.0f;       // Offset from midiNote, -50 to +50
+    float confidence = 0.0f;  // 0.0 - 1.0, 1 - the YIN aperiodicity at the chosen lag
+
+    bool isValid() const noexcept { return midiNote >= 0; }
+};
+
+/**
+ * YIN fundamental-frequency estimator for a single short window.
+ *
+ * The difference function is derived from an FFT cross-correlation and
+ * running energies, so one estimate costs two forward FFTs and one inverse
+ * instead of the O(W^2) direct form. Scratch buffers are kept between calls,
+ * which makes it cheap to reuse one detector across a whole batch import.
+ */
+class PitchDetector {
+public:
+    /**
+     * Constructor
+     * @param minFrequency Lowest fundamental to detect, in Hz
+     * @param maxFrequency Highest fundamental to detect, in Hz
+     */
+    PitchDetector(float minFrequency = 30.0f, float maxFrequency = 4200.0f);
+    ~PitchDetector();
+
+    /**
+     * Number of samples detect() wants for a given sample rate
+     *
+     * @param sampleRate Sample rate in Hz
+     * @return Window length in samples
+     */
+    int getWindowSize(double sampleRate) const;
+
+    /**
+     * Estimate the pitch of a mono window
+     *
+     * @param samples Mono sample data
+     * @param numSamples Number of samples; getWindowSize() samples are used if available
+     * @param sampleRate Sample rate in Hz
+     * @return The estimate; invalid if the window is silent or too short
+     */
+    PitchEstimate detect(const float* samples, int numSamples, double sampleRate);
+
+    /**
+     * Decode a short window from the start of a file and estimate its pitch.
+     * The window is taken just after the loudest point of the attack.
+     *
+     * @param reader The audio format reader
+     * @return The estimate; invalid if no stable pitch was found
+     */
+    PitchEstimate detect(juce::AudioFormatReader& reader);
+
+private:
+    void prepare(int fftSize);
+
+    float minFrequency;
+    float maxFrequency;
+    float threshold = 0.15f; // YIN absolute threshold
+
+    std::unique_ptr<DSP::RealFFT> fft;
+    std::vector<std::complex<float>> headSpectrum;
+    std::vector<float> difference;
+    juce::AudioBuffer<float> decodeBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE(PitchDetector)
+};
+
+} // namespace Aika
@@ -0,0 +1,233 @@
+#include "sample.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace Aika {
+
+namespace {
+
+std::atomic<juce::uint64> nextAudioId { 1 };
+
+} // namespace
+
+Sample::Sample(SampleFormat storageFormat, int channels, int frames, double rate, const juce::String& sampleName,
+               const void* externalData, int headFrames)
+    : format(storageFormat),
+      numChannels(channels),
+      numFrames(frames),
+      sampleRate(rate),
+      name(sampleName),
+      storedFrames(headFrames >= 0 ? headFrames : frames),
+      bytesPerChannel(getBytesPerSample(storageFormat) * static_cast<size_t>(storedFrames)),
+      audioId(nextAudioId++) {
+    if (externalData != nullptr) {
+        storage = static_cast<const char*>(externalData);
+    } else {
+        data.allocate(bytesPerChannel * static_cast<size_t>(channels), false);
+        storage = data.get();
+    }
+}
+
+std::shared_ptr<Sample> Sample::createForExternalData(SampleFormat storageFormat, int channels, int frames, double rate,
+                                                      const juce::String& sampleName, const void* channelData,
+                                                      std::shared_ptr<const void> owner, bool isMapped) {
+    jassert(channelData != nullptr);
+
+    std::shared_ptr<Sample> sample(new Sample(storageFormat, channels, frames, rate, sampleName, channelData));
+    sample->storageOwner = std::move(owner);
+    sample->mapped = isMapped;
+    return sample;
+}
+
+std::shared_ptr<Sample> Sample::createHead(const Sample& source, int headFrames) {
+    jassert(headFrames > 0 && headFrames < source.numFrames);
+
+    auto spill = source.spillFile;
+    if (spill != nullptr) {
+        // Its frames are on disk already; the head can't be longer than the one they come from
+        headFrames = std::min(headFrames, source.storedFrames);
+    } else {
+        // Stored as is, so reading it back is a plain copy with nothing to decode
+        auto file = std::make_shared<juce::TemporaryFile>(".aikaspill");
+        {
+            juce::FileOutputStream stream(file->getFile());
+            if (!stream.openedOk())
+                return nullptr;
+
+            for (int channel = 0; channel < source.numChannels; ++channel)
+                if (!stream.write(source.getChannelData(channel), source.bytesPerChannel))
+                    return nullptr;
+
+            stream.flush();
+            if (stream.getStatus().failed())
+                return nullptr;
+        }
+        spill = std::move(file);
+    }
+
+    std::shared_ptr<Sample> head(new Sample(source.format, source.numChannels, source.numFrames, source.sampleRate,
+                                            source.name, nullptr, headFrames));
+    for (int channel = 0; channel < head->numChannels; ++channel)
+        std::memcpy(head->getChannelData(channel), source.getChannelData(channel), head->bytesPerChannel);
+
+    head->metadata = source.metadata;
+    head->audioId = source.audioId;
+    head->spillFile = std::move(spill);
+    head->lastPlayed.store(source.getLastPlayed(), std::memory_order_relaxed);
+    return head;
+}
+
+std::shared_ptr<Sample> Sample::createTrimmed(const Sample& source, int keepFrames) {
+    jassert(!source.isHead());
+    jassert(keepFrames > 0 && keepFrames < source.numFrames);
+
+    std::shared_ptr<Sample> trimmed(new Sample(source.format, source.numChannels, keepFrames, source.sampleRate, source.name));
+    for (int channel = 0; channel < trimmed->numChannels; ++channel)
+        std::memcpy(trimmed->getChannelData(channel), source.getChannelData(channel), trimmed->bytesPerChannel);
+
+    trimmed->metadata = source.metadata;
+    if (trimmed->metadata.loopEnd > keepFrames) {
+        trimmed->metadata.loopStart = -1;
+        trimmed->metadata.loopEnd = -1;
+    }
+    return trimmed;
+}
+
+const Sample* Sample::loadFull() const {
+    if (spillFile == nullptr)
+        return this;
+
+    const juce::ScopedLock lock(fullLock);
+    reloadRequested.store(false, std::memory_order_relaxed);
+    if (fullSample != nullptr)
+        return fullSample.get();
+
+    std::unique_ptr<Sample> loaded(new Sample(format, numChannels, numFrames, sampleRate, name));
+    juce::FileInputStream stream(spillFile->getFile());
+    if (!stream.openedOk() || stream.getTotalLength() != static_cast<juce::int64>(loaded->getSizeInBytes()))
+        return nullptr;
+
+    const auto channelBytes = static_cast<int>(loaded->bytesPerChannel);
+    for (int channel = 0; channel < numChannels; ++channel)
+        if (stream.read(loaded->getChannelData(channel), channelBytes) != channelBytes)
+            return nullptr;
+
+    loaded->metadata = metadata;
+    loaded->audioId = audioId;
+    fullSample = std::move(loaded);
+    full.store(fullSample.get(), std::memory_order_release);
+    return fullSample.get();
+}
+
+void Sample::markPlayed() const noexcept {
+    lastPlayed.store(std::max(1u, juce::Time::getMillisecondCounter()), std::memory_order_relaxed);
+    if (spillFile != nullptr && full.load(std::memory_order_relaxed) == nullptr)
+        reloadRequested.store(true, std::memory_order_relaxed);
+}
+
+Sample::Sample(const juce::AudioBuffer<float>& audio, double rate, const juce::String& sampleName)
+    : Sample(SampleFormat::Float32, audio.getNumChannels(), audio.getNumSamples(), rate, sampleName) {
+    for (int channel = 0; channel < numChannels; ++channel)
+        std::memcpy(getChannelData(channel), audio.getReadPointer(channel), bytesPerChannel);
+}
+
+std::shared_ptr<Sample> Sample::loadFromFile(juce::AudioFormatManager& formatManager, const juce::File& file, bool keepNativeFormat) {
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+
+    if (reader == nullptr)
+        return nullptr;
+
+    return loadFromReader(*reader, file.getFileNameWithoutExtension(), keepNativeFormat);
+}
+
+std::shared_ptr<Sample> Sample::loadFromReader(juce::AudioFormatReader& reader, const juce::String& sampleName, bool keepNativeFormat) {
+    if (reader.lengthInSamples <= 0 || reader.lengthInSamples > std::numeric_limits<int>::max() || reader.numChannels == 0)
+        return nullptr;
+
+    const SampleFormat storageFormat = keepNativeFormat ? chooseSampleFormat(reader.bitsPerSample, reader.usesFloatingPointData)
+                                                        : SampleFormat::Float32;
+    const int channels = static_cast<int>(reader.numChannels);
+    const int frames = static_cast<int>(reader.lengthInSamples);
+
+    std::shared_ptr<Sample> sample(new Sample(storageFormat, channels, frames, reader.sampleRate, sampleName));
+
+    // Decode in chunks so the float/int staging buffer stays small
+    constexpr int chunkFrames = 16384;
+    juce::AudioBuffer<float> floatChunk;
+    juce::HeapBlock<int> intChunk;
+    juce::HeapBlock<int*> intChannels(static_cast<size_t>(channels));
+
+    if (storageFormat == SampleFormat::Float32) {
+        floatChunk.setSize(channels, chunkFrames);
+    } else {
+        intChunk.allocate(static_cast<size_t>(channels) * chunkFrames, false);
+        for (int channel = 0; channel < channels; ++channel)
+            intChannels[channel] = intChunk.get() + static_cast<size_t>(channel) * chunkFrames;
+    }
+
+    const size_t bytesPerSample = getBytesPerSample(storageFormat);
+
+    for (int position = 0; position < frames; position += chunkFrames) {
+        const int numToRead = std::min(chunkFrames, frames - position);
+
+        if (storageFormat == SampleFormat::Float32) {
+            if (!reader.read(&floatChunk, 0, numToRead, position, true, true))
+                return nullptr;
+
+            for (int channel = 0; channel < channels; ++channel)
+                std::memcpy(sample->getChannelData(channel) + static_cast<size_t>(position) * bytesPerSample,
+                            floatChunk.getReadPointer(channel), static_cast<size_t>(numToRead) * bytesPerSample);
+        } else {
+            if (!reader.read(intChannels.get(), channels, position, numToRead, false))
+                return nullptr;
+
+            for (int channel = 0; channel < channels; ++channel)
+                convertFromInt32(storageFormat, intChannels[channel],
+                                 sample->getChannelData(channel) + static_cast<size_t>(position) * bytesPerSample, numToRead);
+        }
+    }
+
+    // Sustain loop from the file's sampler chunk, if present
+    if (reader.metadataValues.containsKey("Loop0Start") && reader.metadataValues.containsKey("Loop0End")) {
+        const auto loopStart = reader.metadataValues["Loop0Start"].getLargeIntValue();
+        const auto loopEnd = reader.metadataValues["Loop0End"].getLargeIntValue();
+
+        if (loopStart >= 0 && loopEnd > loopStart && loopEnd <= frames) {
+            sample->metadata.loopStart = static_cast<int>(loopStart);
+            sample->metadata.loopEnd = static_cast<int>(loopEnd);
+        }
+    }
+
+    return sample;
+}
+
+void Sample::readFrames(int channel, int startFrame, int frames, float* dest) const noexcept {
+    jassert(channel >= 0 && channel < numChannels);
+    jassert(startFrame >= 0 && startFrame + frames <= numFrames);
+
+    if (startFrame + frames > storedFrames) {
+        readPastHead(channel, startFrame, frames, dest);
+        return;
+    }
+
+    const char* source = getChannelData(channel) + static_cast<size_t>(startFrame) * getBytesPerSample(format);
+    convertToFloat(format, source, dest, frames);
+}
+
+void Sample::readPastHead(int channel, int startFrame, int frames, float* dest) const noexcept {
+    if (const Sample* loaded = full.load(std::memory_order_acquire)) {
+        loaded->readFrames(channel, startFrame, frames, dest);
+        return;
+    }
+
+    // Not back from disk yet: what the head has, then silence
+    const int available = juce::jlimit(0, frames, storedFrames - startFrame);
+    if (available > 0)
+        convertToFloat(format, getChannelData(channel) + static_cast<size_t>(startFrame) * getBytesPerSample(format), dest, available);
+    std::fill(dest + available, dest + frames, 0.0f);
+
+    reloadMissed.store(true, std::memory_order_relaxed);
+    reloadRequested.store(true, std::memory_order_relaxed);
+}
+
+} // namespace Aika
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "sampleformat.hpp"
+#include <atomic>
+#include <memory>
+
+namespace Aika {
+
+/**
+ * Tuning and loop information carried with a sample
+ */
+struct SampleMetadata {
+    int rootNote = 60;
+    int loopStart = -1;   // First frame of the sustain loop, -1 if none
+    int loopEnd = -1;     // One past the last frame of the loop, -1 if none
+
+    bool hasLoop() const noexcept { return loopStart >= 0 && loopEnd > loopStart; }
+};
+
+/**
+ * Decoded audio for one file. Immutable once loaded, so a single instance
+ * can be shared by any number of pads and voices via std::shared_ptr.
+ *
+ * Integer sources are kept at their native bit depth (16-bit, or packed
+ * 24-bit) instead of being widened to float, and are converted to float
+ * in blocks as voices read them.
+ *
+ * To save memory a sample can be evicted to a preload head (see createHead):
+ * a sample with the same audio but only its first frames in memory, the
+ * rest moved out to a temporary file and read back on demand.
+ */
+class Sample {
+public:
+    /**
+     * Constructor for audio that is already float, stored as Float32
+     * @param audio Decoded audio
+     * @param sampleRate Sample rate of the audio in Hz
+     * @param name Display name, usually the filename
+     */
+    Sample(const juce::AudioBuffer<float>& audio, double sampleRate, const juce::String& name);
+
+    /**
+     * Wrap sample data that lives in memory owned by someone else, such as a
+     * memory-mapped kit container. Nothing is copied or decoded.
+     *
+     * @param format Storage format of the data
+     * @param numChannels Number of channels
+     * @param numFrames Number of frames per channel
+     * @param sampleRate Sample rate in Hz
+     * @param name Display name
+     * @param channelData Planar channel data, channels stored back to back
+     * @param owner Kept alive for as long as the sample exists
+     * @param isMapped True if the data is a mapping of a file, which the OS pages in and out by itself
+     * @return The sample
+     */
+    static std::shared_ptr<Sample> createForExternalData(SampleFormat format, int numChannels, int numFrames, double sampleRate,
+                                                         const juce::String& name, const void* channelData,
+                                                         std::shared_ptr<const void> owner, bool isMapped = false);
+
+    /**
+     * Decode a whole audio file
+     *
+     * @param formatManager Format manager with the required formats registered
+     * @param file The audio file
+     * @param keepNativeFormat If true the storage format follows the file's bit depth,
+     *                         otherwise everything is stored as Float32
+     * @return The decoded sample, or nullptr if the file could not be read
+     */
+    static std::shared_ptr<Sample> loadFromFile(juce::AudioFormatManager& formatManager, const juce::File& file, bool keepNativeFormat = true);
+
+    /**
+     * Decode everything a reader provides
+     *
+     * @param reader The audio format reader
+     * @param name Display name
+     * @param keepNativeFormat See loadFromFile
+     * @return The decoded sample, or nullptr if the reader failed
+     */
+    static std::shared_ptr<Sample> loadFromReader(juce::AudioFormatReader& reader, const juce::String& name, bool keepNativeFormat = true);
+
+    /**
+     * Evict a sample to a preload head. The frames past the head are written
+     * to a temporary file, unless source is a head already and they are
+     * there; the file goes once the last head using it does.
+     *
+     * @param source Sample to evict
+     * @param headFrames Frames to keep in memory, fewer than source has
+     * @return The head, or nullptr if the file could not be written
+     */
+    static std::shared_ptr<Sample> createHead(const Sample& source, int headFrames);
+
+    /**
+     * Copy the start of a sample, dropping frames that will never be played,
+     * such as the tail after a loop that is never released. A loop that
+     * doesn't fit any more is dropped from the metadata.
+     *
+     * @param source Sample to copy; not a head
+     * @param keepFrames Frames to keep, fewer than source has
+     * @return The shorter sample
+     */
+    static std::shared_ptr<Sample> createTrimmed(const Sample& source, int keepFrames);
+
+    /**
+     * Convert a range of one channel to float. Allocation free, safe on the audio thread.
+     * Frames of a head that haven't been read back yet come out silent.
+     *
+     * @param channel Channel index
+     * @param startFrame First frame to read; must be within the sample
+     * @param numFrames Number of frames; startFrame + numFrames must not exceed getNumFrames()
+     * @param dest Destination for numFrames floats
+     */
+    void readFrames(int channel, int startFrame, int numFrames, float* dest) const noexcept;
+
+    int getNumChannels() const noexcept { return numChannels; }
+    int getNumFrames() const noexcept { return numFrames; }
+    double getSampleRate() const noexcept { return sampleRate; }
+    double getLengthSeconds() const noexcept { return numFrames / sampleRate; }
+    const juce::String& getName() const noexcept { return name; }
+    SampleFormat getFormat() const noexcept { return format; }
+
+    /**
+     * @param channel Channel index
+     * @return The stored data of one channel, in getFormat(); just the head's frames for a head
+     */
+    const void* getRawChannelData(int channel) const noexcept { return getChannelData(channel); }
+
+    /**
+     * @return Identifies the audio: a head and the sample it was made from share it
+     */
+    juce::uint64 getAudioId() const noexcept { return audioId; }
+
+    /**
+     * @return True if this is a preload head
+     */
+    bool isHead() const noexcept { return spillFile != nullptr; }
+
+    /**
+     * @return True if the data is a file mapped into memory, see createForExternalData
+     */
+    bool isMapped() const noexcept { return mapped; }
+
+    /**
+     * The sample with every frame in memory, without waiting. Safe on the audio thread.
+     *
+     * @return This sample; for a head, its frames read back from disk, or nullptr if they haven't been yet
+     */
+    const Sample* getFull() const noexcept { return spillFile == nullptr ? this : full.load(std::memory_order_acquire); }
+
+    /**
+     * The sample with every frame in memory, reading a head's frames back
+     * from disk if they aren't yet. Blocks, so call off the audio thread. Thread safe.
+     *
+     * @return This sample, or for a head its full sample; nullptr if the frames could not be read back
+     */
+    const Sample* loadFull() const;
+
+    /**
+     * Note that a voice started playing the sample. A head not read back yet
+     * asks for its frames. Allocation free, safe on the audio thread.
+     */
+    void markPlayed() const noexcept;
+
+    /**
+     * @return juce::Time::getMillisecondCounter() when the sample last started playing, 0 if never
+     */
+    juce::uint32 getLastPlayed() const noexcept { return lastPlayed.load(std::memory_order_relaxed); }
+
+    /**
+     * @return True if a head was played before its frames were read back
+     */
+    bool isReloadRequested() const noexcept { return reloadRequested.load(std::memory_order_relaxed); }
+
+    /**
+     * @return True if playback ran past the head before its frames were read back, since the last call
+     */
+    bool takeReloadMiss() const noexcept { return reloadMissed.exchange(false, std::memory_order_relaxed); }
+
+    const SampleMetadata& getMetadata() const noexcept { return metadata; }
+
+    /**
+     * Set tuning and loop information. Only call this before the sample is shared.
+     */
+    void setMetadata(const SampleMetadata& newMetadata) noexcept { metadata = newMetadata; }
+
+    /**
+     * @return Bytes of sample data held in memory; for a head, the head's
+     */
+    size_t getSizeInBytes() const noexcept { return bytesPerChannel * static_cast<size_t>(numChannels); }
+
+private:
+    Sample(SampleFormat format, int numChannels, int numFrames, double sampleRate, const juce::String& name,
+           const void* externalData = nullptr, int storedFrames = -1);
+
+    void readPastHead(int channel, int startFrame, int numFrames, float* dest) const noexcept;
+
+    char* getChannelData(int channel) noexcept { return data.get() + bytesPerChannel * static_cast<size_t>(channel); }
+    const char* getChannelData(int channel) const noexcept { return storage + bytesPerChannel * static_cast<size_t>(channel); }
+
+    SampleFormat format;
+    int numChannels;
+    int numFrames;
+    double sampleRate;
+    juce::String name;
+    int storedFrames;                        // Frames per channel in storage: numFrames, or a head's
+    size_t bytesPerChannel;
+    SampleMetadata metadata;
+    juce::uint64 audioId;
+    bool mapped = false;
+
+    juce::HeapBlock<char> data;              // Owned storage, empty for external data
+    const char* storage = nullptr;           // Points at data, or at the external data
+    std::shared_ptr<const void> storageOwner;
+
+    // A head's frames on disk, and the full sample once read back; it is set once and then kept
+    std::shared_ptr<const juce::TemporaryFile> spillFile;
+    mutable juce::CriticalSection fullLock;
+    mutable std::unique_ptr<const Sample> fullSample;   // Guarded by fullLock
+    mutable std::atomic<const Sample*> full { nullptr };
+
+    mutable std::atomic<juce::uint32> lastPlayed { 0 };
+    mutable std::atomic<bool> reloadRequested { false };
+    mutable std::atomic<bool> reloadMissed { false };
+
+    JUCE_DECLARE_NON_COPYABLE(Sample)
+};
+
+} // namespace Aika
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Aika {
+
+/**
+ * In-memory storage format of decoded sample data
+ */
+enum class SampleFormat : std::uint8_t {
+    Float32 = 0,  // 4 bytes per sample
+    Int16,        // 2 bytes per sample, little endian
+    Int24         // 3 bytes per sample, packed little endian
+};
+
+/**
+ * @param format A storage format
+ * @return Bytes used by one sample of one channel
+ */
+constexpr size_t getBytesPerSample(SampleFormat format) noexcept {
+    return format == SampleFormat::Int16 ? 2 : (format == SampleFormat::Int24 ? 3 : 4);
+}
+
+/**
+ * Choose the most compact format that holds a source losslessly
+ *
+ * @param bitsPerSample Bit depth reported by the source
+ * @param usesFloatingPointData True if the source stores floats
+ * @return The storage format
+ */
+SampleFormat chooseSampleFormat(unsigned int bitsPerSample, bool usesFloatingPointData) noexcept;
+
+/**
+ * Convert stored samples to float. Uses SSE2/SSSE3 or NEON where available.
+ * Safe to call on the audio thread.
+ *
+ * @param format Format of the source data
+ * @param source First source sample
+ * @param dest Destination floats
+ * @param numSamples Number of samples to convert
+ */
+void convertToFloat(SampleFormat format, const void* source, float* dest, int numSamples) noexcept;
+
+/**
+ * Convert left-justified 32-bit integers (as produced by AudioFormatReader::read)
+ * to a storage format
+ *
+ * @param format Destination format, Int16 or Int24
+ * @param source Left-justified integer samples
+ * @param dest Destination storage
+ * @param numSamples Number of samples to convert
+ */
+void convertFromInt32(SampleFormat format, const int* source, void* dest, int numSamples) noexcept;
+
+} // namespace Aika
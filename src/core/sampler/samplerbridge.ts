@@ -65,6 +65,14 @@ export class SampleParser implements Aika.SampleParser {
   parseFilenameMetadata(filename: string): Record<string, any> {
     return this.parser.parseFilenameMetadata(filename);
   }
+
+  /**
+   * Analyzes many filenames in one native call
+   * @param filenames The filenames to analyze
+   */
+  parseFilenameMetadataBatch(filenames: string[]): Record<string, any>[] {
+    return this.parser.parseFilenameMetadataBatch(filenames);
+  }
 }
 
 /**
@@ -0,0 +1,146 @@
+#include "samplestore.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Aika {
+
+std::vector<std::shared_ptr<const Sample>> SampleStore::getSamples(const Kit& kit) {
+    std::vector<std::shared_ptr<const Sample>> samples;
+    const auto add = [&samples](const std::shared_ptr<const Sample>& sample) {
+        if (sample != nullptr && std::find(samples.begin(), samples.end(), sample) == samples.end())
+            samples.push_back(sample);
+    };
+
+    for (const auto& pad : kit.pads) {
+        add(pad.sample);
+        for (const auto& layer : pad.layers)
+            add(layer.sample);
+    }
+    return samples;
+}
+
+size_t SampleStore::getResidentBytes(const Sample& sample) noexcept {
+    if (sample.isMapped())
+        return 0;
+
+    const Sample* full = sample.getFull();
+    return sample.getSizeInBytes() + (full != nullptr && full != &sample ? full->getSizeInBytes() : 0);
+}
+
+int SampleStore::getHeadFrames(const Sample& sample) noexcept {
+    return static_cast<int>(std::ceil(preloadSeconds * sample.getSampleRate()));
+}
+
+bool SampleStore::isEvictable(const Sample& sample, juce::uint32 now) noexcept {
+    // Samples barely longer than a head would save little for the disk reads they'd cost
+    if (sample.isMapped() || sample.getFull() == nullptr || sample.getNumFrames() < 2 * getHeadFrames(sample))
+        return false;
+
+    const auto lastPlayed = sample.getLastPlayed();
+    return lastPlayed == 0 || now - lastPlayed >= minIdleMilliseconds;
+}
+
+bool SampleStore::update(const Kit& kit, size_t derivedBytes) {
+    Stats current;
+    current.budgetBytes = budget.load();
+    current.reloadMisses = stats.reloadMisses;
+    current.derivedBytes = derivedBytes;
+    current.residentBytes = derivedBytes;
+    derived.store(derivedBytes);
+
+    const auto now = juce::Time::getMillisecondCounter();
+    bool hasWork = false;
+    bool hasEvictable = false;
+
+    for (const auto& sample : getSamples(kit)) {
+        if (sample->takeReloadMiss())
+            ++current.reloadMisses;
+        if (sample->isReloadRequested())
+            hasWork = true;
+        if (isEvictable(*sample, now))
+            hasEvictable = true;
+
+        if (sample->getFull() == nullptr)
+            ++current.evictedSamples;
+        else if (!sample->isMapped())
+            ++current.residentSamples;
+        current.residentBytes += getResidentBytes(*sample);
+    }
+
+    const bool isOverBudget = current.budgetBytes > 0 && current.residentBytes > current.budgetBytes;
+    if (hasEvictable && (isOverBudget || purgeRequested.load()))
+        hasWork = true;
+    else
+        purgeRequested.store(false);   // Nothing to purge
+
+    stats = current;
+    return hasWork;
+}
+
+SampleStore::Evictions SampleStore::process(const Kit& kit, const juce::ThreadPoolJob& job) {
+    const auto samples = getSamples(kit);
+    Evictions evictions;
+
+    // Reading back comes first: a voice may be about to run past its head
+    for (const auto& sample : samples) {
+        if (job.shouldExit())
+            return evictions;
+        if (sample->isReloadRequested())
+            sample->loadFull();
+    }
+
+    const bool purge = purgeRequested.exchange(false);
+    const size_t limit = budget.load();
+    const auto now = juce::Time::getMillisecondCounter();
+
+    size_t residentBytes = derived.load();
+    std::vector<std::shared_ptr<const Sample>> candidates;
+    for (const auto& sample : samples) {
+        residentBytes += getResidentBytes(*sample);
+        if (isEvictable(*sample, now))
+            candidates.push_back(sample);
+    }
+
+    // Least recently played first, which puts those never played ahead of the rest
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a->getLastPlayed() < b->getLastPlayed();
+    });
+
+    for (const auto& sample : candidates) {
+        const bool isOverBudget = limit > 0 && residentBytes > limit;
+        if (!isOverBudget && !(purge && sample->getLastPlayed() == 0))
+            break;
+        if (job.shouldExit())
+            break;
+
+        auto head = Sample::createHead(*sample, getHeadFrames(*sample));
+        if (head == nullptr)
+            continue;
+
+        residentBytes -= getResidentBytes(*sample) - getResidentBytes(*head);
+        evictions.emplace_back(sample, std::move(head));
+    }
+    return evictions;
+}
+
+bool SampleStore::replaceSamples(Kit& kit, const Evictions& evictions) {
+    bool replaced = false;
+    const auto replace = [&](std::shared_ptr<const Sample>& sample) {
+        for (const auto& eviction : evictions) {
+            if (sample != nullptr && sample == eviction.first) {
+                sample = eviction.second;
+                replaced = true;
+                return;
+            }
+        }
+    };
+
+    for (auto& pad : kit.pads) {
+        replace(pad.sample);
+        for (auto& layer : pad.layers)
+            replace(layer.sample);
+    }
+    return replaced;
+}
+
+} // namespace Aika
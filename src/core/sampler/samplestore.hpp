@@ -0,0 +1,107 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "kit.hpp"
+#include "sample.hpp"
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Aika {
+
+/**
+ * Keeps the samples of the kit playing within a memory budget.
+ *
+ * Over budget, samples not played for a while are evicted, least recently
+ * played first: all but a preload head goes out to disk (see
+ * Sample::createHead) and the kit plays the head instead. Playing a head
+ * reads the rest back in the background, normally well before a voice gets
+ * past the head; a voice that gets there first plays silence, and counts as
+ * a reload miss.
+ *
+ * Samples mapped from a kit container are left to the OS, which pages them
+ * in and out by itself, and don't count towards the budget. Derived samples
+ * rendered from the kit's (see DerivedSampleCache) do count, though only
+ * kit samples are evicted to make room for them.
+ */
+class SampleStore {
+public:
+    static constexpr double preloadSeconds = 0.5;
+    static constexpr juce::uint32 minIdleMilliseconds = 10000;   // Samples played since are never evicted
+
+    // Samples evicted, each with the head that replaces it in the kit
+    using Evictions = std::vector<std::pair<std::shared_ptr<const Sample>, std::shared_ptr<const Sample>>>;
+
+    struct Stats {
+        size_t budgetBytes = 0;     // 0 for no budget
+        size_t residentBytes = 0;   // Sample data of the kit in memory, mapped samples aside, derived samples included
+        size_t derivedBytes = 0;    // Derived samples the kit plays from
+        int residentSamples = 0;
+        int evictedSamples = 0;     // Heads whose frames are on disk
+        juce::uint32 reloadMisses = 0;
+    };
+
+    SampleStore() = default;
+
+    /**
+     * @param bytes Memory the kit's samples may use, 0 for no limit
+     */
+    void setBudget(size_t bytes) noexcept { budget.store(bytes); }
+    size_t getBudget() const noexcept { return budget.load(); }
+
+    /**
+     * Evict every sample that hasn't been played since it was loaded, budget
+     * or not, at the next process()
+     */
+    void purgeUnused() noexcept { purgeRequested.store(true); }
+
+    /**
+     * Take stock of the kit playing: count reload misses and update the
+     * stats. Cheap; call it periodically from the message thread.
+     *
+     * @param kit The kit playing
+     * @param derivedBytes Memory held by the derived samples the kit plays from
+     * @return True if process() has samples to read back or evict
+     */
+    bool update(const Kit& kit, size_t derivedBytes);
+
+    /**
+     * Read back the heads being played, then evict samples until the kit
+     * fits the budget. Reads and writes files, so call it from a background thread.
+     *
+     * @param kit The kit playing
+     * @param job The job running this, checked between samples
+     * @return The samples evicted; put their heads in the kit with replaceSamples()
+     */
+    Evictions process(const Kit& kit, const juce::ThreadPoolJob& job);
+
+    /**
+     * Swap evicted samples for their heads, on pads and in layers
+     *
+     * @param kit Kit to change
+     * @param evictions Samples evicted by process()
+     * @return True if the kit held any of them
+     */
+    static bool replaceSamples(Kit& kit, const Evictions& evictions);
+
+    /**
+     * @return Stats as of the last update(). Message thread.
+     */
+    const Stats& getStats() const noexcept { return stats; }
+
+private:
+    static std::vector<std::shared_ptr<const Sample>> getSamples(const Kit& kit);
+    static size_t getResidentBytes(const Sample& sample) noexcept;
+    static int getHeadFrames(const Sample& sample) noexcept;
+    static bool isEvictable(const Sample& sample, juce::uint32 now) noexcept;
+
+    std::atomic<size_t> budget { 0 };
+    std::atomic<size_t> derived { 0 };   // As of the last update()
+    std::atomic<bool> purgeRequested { false };
+    Stats stats;   // Message thread only
+
+    JUCE_DECLARE_NON_COPYABLE(SampleStore)
+};
+
+} // namespace Aika
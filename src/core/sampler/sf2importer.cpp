@@ -0,0 +1,345 @@
+#include "sf2importer.hpp"
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace Aika {
+
+namespace {
+
+// Generator operators used by the importer (SF2.01 section 8.1.2)
+enum Generator {
+    startAddrsOffset = 0,
+    endAddrsOffset = 1,
+    startloopAddrsOffset = 2,
+    endloopAddrsOffset = 3,
+    startAddrsCoarseOffset = 4,
+    endAddrsCoarseOffset = 12,
+    pan = 17,
+    attackVolEnv = 34,
+    releaseVolEnv = 38,
+    instrument = 41,
+    keyRange = 43,
+    velRange = 44,
+    startloopAddrsCoarseOffset = 45,
+    initialAttenuation = 48,
+    endloopAddrsCoarseOffset = 50,
+    coarseTune = 51,
+    fineTune = 52,
+    sampleID = 53,
+    sampleModes = 54,
+    scaleTuning = 56,
+    exclusiveClass = 57,
+    overridingRootKey = 58,
+    numGenerators = 61
+};
+
+constexpr size_t presetHeaderSize = 38;
+constexpr size_t instrumentHeaderSize = 22;
+constexpr size_t bagSize = 4;
+constexpr size_t generatorSize = 4;
+constexpr size_t sampleHeaderSize = 46;
+constexpr int fullRange = 127 << 8;   // Packed lo/hi range of 0 - 127
+
+using Generators = std::array<int, numGenerators>;
+
+struct Chunk {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    size_t getNumRecords(size_t recordSize) const noexcept { return size / recordSize; }
+    const char* getRecord(size_t index, size_t recordSize) const noexcept { return data + index * recordSize; }
+};
+
+juce::uint16 readU16(const char* p) noexcept { return juce::ByteOrder::littleEndianShort(p); }
+juce::uint32 readU32(const char* p) noexcept { return juce::ByteOrder::littleEndianInt(p); }
+
+int rangeLow(int packed) noexcept { return packed & 0xff; }
+int rangeHigh(int packed) noexcept { return (packed >> 8) & 0xff; }
+
+float timecentsToSeconds(int timecents) noexcept {
+    return timecents <= -12000 ? 0.0f : std::pow(2.0f, static_cast<float>(timecents) / 1200.0f);
+}
+
+bool isAdditiveAtPresetLevel(int generator) noexcept {
+    switch (generator) {
+        case startAddrsOffset: case endAddrsOffset: case startloopAddrsOffset: case endloopAddrsOffset:
+        case startAddrsCoarseOffset: case endAddrsCoarseOffset: case startloopAddrsCoarseOffset: case endloopAddrsCoarseOffset:
+        case instrument: case keyRange: case velRange: case sampleID: case sampleModes:
+        case exclusiveClass: case overridingRootKey:
+            return false;
+        default:
+            return true;
+    }
+}
+
+Generators getInstrumentDefaults() noexcept {
+    Generators defaults {};
+    defaults[keyRange] = fullRange;
+    defaults[velRange] = fullRange;
+    defaults[attackVolEnv] = -12000;
+    defaults[releaseVolEnv] = -12000;
+    defaults[scaleTuning] = 100;
+    defaults[overridingRootKey] = -1;
+    return defaults;
+}
+
+Generators getPresetDefaults() noexcept {
+    Generators defaults {};
+    defaults[keyRange] = fullRange;
+    defaults[velRange] = fullRange;
+    return defaults;
+}
+
+class SoundFont {
+public:
+    bool parse(const char* data, size_t size) {
+        if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "sfbk", 4) != 0)
+            return false;
+
+        const size_t riffEnd = std::min(size, static_cast<size_t>(readU32(data + 4)) + 8);
+        for (size_t pos = 12; pos + 8 <= riffEnd;) {
+            const size_t chunkSize = readU32(data + pos + 4);
+            const size_t body = pos + 8;
+            if (chunkSize > riffEnd - body)
+                return false;
+
+            if (std::memcmp(data + pos, "LIST", 4) == 0 && chunkSize >= 4)
+                parseList(data + body + 4, chunkSize - 4);
+
+            pos = body + chunkSize + (chunkSize & 1);
+        }
+
+        return smpl.size > 0
+            && phdr.getNumRecords(presetHeaderSize) >= 2 && phdr.size % presetHeaderSize == 0
+            && inst.getNumRecords(instrumentHeaderSize) >= 2 && inst.size % instrumentHeaderSize == 0
+            && pbag.size % bagSize == 0 && ibag.size % bagSize == 0
+            && pgen.size % generatorSize == 0 && igen.size % generatorSize == 0
+            && shdr.size % sampleHeaderSize == 0;
+    }
+
+    // The final record of phdr is the terminal "EOP" entry
+    int getNumPresets() const noexcept { return static_cast<int>(phdr.getNumRecords(presetHeaderSize)) - 1; }
+
+    juce::String getPresetName(int index) const {
+        const char* record = phdr.getRecord(static_cast<size_t>(index), presetHeaderSize);
+        return juce::String(record, strnlen(record, 20));
+    }
+
+    void buildPreset(int presetIndex, std::vector<Region>& regions) {
+        const char* header = phdr.getRecord(static_cast<size_t>(presetIndex), presetHeaderSize);
+        const size_t firstBag = readU16(header + 24);
+        const size_t lastBag = readU16(header + presetHeaderSize + 24);
+
+        Generators global = getPresetDefaults();
+        for (size_t bag = firstBag; bag < lastBag; ++bag) {
+            Generators zone = global;
+            if (!applyZone(pbag, pgen, bag, zone, instrument)) {
+                if (bag == firstBag)
+                    global = zone; // A leading zone without an instrument is the global zone
+                continue;
+            }
+
+            addInstrumentZones(static_cast<size_t>(zone[instrument]), zone, regions);
+        }
+    }
+
+    std::shared_ptr<juce::MemoryMappedFile> mapping;
+
+private:
+    void parseList(const char* list, size_t listSize) {
+        for (size_t pos = 0; pos + 8 <= listSize;) {
+            const size_t chunkSize = readU32(list + pos + 4);
+            const char* body = list + pos + 8;
+            if (chunkSize > listSize - pos - 8)
+                return;
+
+            const Chunk chunk { body, chunkSize };
+            const auto is = [&](const char* id) { return std::memcmp(list + pos, id, 4) == 0; };
+
+            if (is("smpl")) smpl = chunk;
+            else if (is("phdr")) phdr = chunk;
+            else if (is("pbag")) pbag = chunk;
+            else if (is("pgen")) pgen = chunk;
+            else if (is("inst")) inst = chunk;
+            else if (is("ibag")) ibag = chunk;
+            else if (is("igen")) igen = chunk;
+            else if (is("shdr")) shdr = chunk;
+
+            pos += 8 + chunkSize + (chunkSize & 1);
+        }
+    }
+
+    // Apply one zone's generators; returns true if the zone ends with the given terminal generator
+    bool applyZone(const Chunk& bags, const Chunk& generators, size_t bag, Generators& values, int terminal) const {
+        if (bag + 1 >= bags.getNumRecords(bagSize))
+            return false;
+
+        const size_t first = readU16(bags.getRecord(bag, bagSize));
+        const size_t last = std::min(static_cast<size_t>(readU16(bags.getRecord(bag + 1, bagSize))),
+                                     generators.getNumRecords(generatorSize));
+        bool hasTerminal = false;
+
+        for (size_t i = first; i < last; ++i) {
+            const char* record = generators.getRecord(i, generatorSize);
+            const auto operation = readU16(record);
+            if (operation >= numGenerators)
+                continue;
+
+            const auto amount = readU16(record + 2);
+            const bool isRange = operation == keyRange || operation == velRange;
+            values[operation] = isRange || operation == terminal ? amount : static_cast<juce::int16>(amount);
+            hasTerminal = operation == terminal;
+        }
+
+        return hasTerminal;
+    }
+
+    void addInstrumentZones(size_t instrumentIndex, const Generators& preset, std::vector<Region>& regions) {
+        if (instrumentIndex + 1 >= inst.getNumRecords(instrumentHeaderSize))
+            return;
+
+        const size_t firstBag = readU16(inst.getRecord(instrumentIndex, instrumentHeaderSize) + 20);
+        const size_t lastBag = readU16(inst.getRecord(instrumentIndex + 1, instrumentHeaderSize) + 20);
+
+        Generators global = getInstrumentDefaults();
+        for (size_t bag = firstBag; bag < lastBag; ++bag) {
+            Generators zone = global;
+            if (!applyZone(ibag, igen, bag, zone, sampleID)) {
+                if (bag == firstBag)
+                    global = zone;
+                continue;
+            }
+
+            // Preset values offset the instrument's, and ranges intersect
+            for (int generator = 0; generator < numGenerators; ++generator) {
+                if (isAdditiveAtPresetLevel(generator))
+                    zone[static_cast<size_t>(generator)] += preset[static_cast<size_t>(generator)];
+            }
+
+            addRegion(zone, preset, regions);
+        }
+    }
+
+    void addRegion(const Generators& zone, const Generators& preset, std::vector<Region>& regions) {
+        auto sample = getSample(static_cast<size_t>(zone[sampleID]));
+        if (sample == nullptr)
+            return;
+
+        Region region;
+        region.sample = sample;
+        region.loKey = std::max(rangeLow(zone[keyRange]), rangeLow(preset[keyRange]));
+        region.hiKey = std::min(rangeHigh(zone[keyRange]), rangeHigh(preset[keyRange]));
+        region.loVelocity = std::max(rangeLow(zone[velRange]), rangeLow(preset[velRange]));
+        region.hiVelocity = std::min(rangeHigh(zone[velRange]), rangeHigh(preset[velRange]));
+        if (region.loKey > region.hiKey || region.loVelocity > region.hiVelocity)
+            return;
+
+        const char* header = shdr.getRecord(static_cast<size_t>(zone[sampleID]), sampleHeaderSize);
+        const int start = static_cast<int>(readU32(header + 20));
+        const int originalPitch = static_cast<juce::uint8>(header[40]);
+        const int pitchCorrection = static_cast<juce::int8>(header[41]);
+        const int numFrames = sample->getNumFrames();
+
+        region.pitchKeycenter = zone[overridingRootKey] >= 0 ? zone[overridingRootKey]
+                              : (originalPitch <= 127 ? originalPitch : 60);
+        region.pitchKeytrack = static_cast<float>(zone[scaleTuning]);
+        region.tune = static_cast<float>(zone[coarseTune] * 100 + zone[fineTune] + pitchCorrection);
+
+        region.gain = juce::Decibels::decibelsToGain(-static_cast<float>(zone[initialAttenuation]) / 10.0f);
+        region.pan = juce::jlimit(-1.0f, 1.0f, static_cast<float>(zone[pan]) / 500.0f);
+
+        region.offset = juce::jlimit(0, numFrames, zone[startAddrsOffset] + zone[startAddrsCoarseOffset] * 32768);
+        region.end = juce::jlimit(region.offset, numFrames, numFrames + zone[endAddrsOffset] + zone[endAddrsCoarseOffset] * 32768);
+
+        const int loopStart = static_cast<int>(readU32(header + 28)) - start;
+        const int loopEnd = static_cast<int>(readU32(header + 32)) - start;
+        region.loopStart = juce::jlimit(region.offset, region.end,
+                                        loopStart + zone[startloopAddrsOffset] + zone[startloopAddrsCoarseOffset] * 32768);
+        region.loopEnd = juce::jlimit(region.loopStart, region.end,
+                                      loopEnd + zone[endloopAddrsOffset] + zone[endloopAddrsCoarseOffset] * 32768);
+
+        switch (zone[sampleModes] & 3) {
+            case 1: region.loopMode = Region::LoopMode::Continuous; break;
+            case 3: region.loopMode = Region::LoopMode::Sustain; break;
+            default: region.loopMode = Region::LoopMode::NoLoop; break;
+        }
+
+        region.attack = timecentsToSeconds(zone[attackVolEnv]);
+        region.release = timecentsToSeconds(zone[releaseVolEnv]);
+        region.exponentialRelease = true;   // SF2 envelopes are specified in dB
+        region.group = zone[exclusiveClass];
+        region.offBy = zone[exclusiveClass];
+
+        regions.push_back(std::move(region));
+    }
+
+    // One Sample per sample header, pointing straight into the mapped smpl chunk
+    std::shared_ptr<const Sample> getSample(size_t index) {
+        if (index + 1 >= shdr.getNumRecords(sampleHeaderSize))
+            return nullptr;
+
+        if (samples.empty())
+            samples.resize(shdr.getNumRecords(sampleHeaderSize));
+        if (samples[index] != nullptr)
+            return samples[index];
+
+        const char* header = shdr.getRecord(index, sampleHeaderSize);
+        const size_t start = readU32(header + 20);
+        const size_t end = readU32(header + 24);
+        const auto sampleRate = readU32(header + 36);
+        const auto sampleType = readU16(header + 44);
+        const size_t numSmplFrames = smpl.size / 2;
+
+        if ((sampleType & 0x8000) != 0 || start >= end || end > numSmplFrames || sampleRate == 0)
+            return nullptr; // ROM samples and broken headers
+
+        auto sample = Sample::createForExternalData(SampleFormat::Int16, 1, static_cast<int>(end - start),
+                                                    static_cast<double>(sampleRate),
+                                                    juce::String(header, strnlen(header, 20)),
+                                                    smpl.data + start * 2, mapping);
+        samples[index] = sample;
+        return sample;
+    }
+
+    Chunk smpl, phdr, pbag, pgen, inst, ibag, igen, shdr;
+    std::vector<std::shared_ptr<const Sample>> samples;
+};
+
+bool openSoundFont(const juce::File& file, SoundFont& soundFont) {
+    soundFont.mapping = std::make_shared<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    if (soundFont.mapping->getData() == nullptr)
+        return false;
+
+    return soundFont.parse(static_cast<const char*>(soundFont.mapping->getData()), soundFont.mapping->getSize());
+}
+
+} // namespace
+
+juce::StringArray Sf2Importer::getPresetNames(const juce::File& file) {
+    juce::StringArray names;
+    SoundFont soundFont;
+
+    if (openSoundFont(file, soundFont)) {
+        for (int i = 0; i < soundFont.getNumPresets(); ++i)
+            names.add(soundFont.getPresetName(i));
+    }
+
+    return names;
+}
+
+std::shared_ptr<Instrument> Sf2Importer::load(const juce::File& file, int presetIndex) {
+    SoundFont soundFont;
+    if (!openSoundFont(file, soundFont) || presetIndex < 0 || presetIndex >= soundFont.getNumPresets())
+        return nullptr;
+
+    std::vector<Region> regions;
+    soundFont.buildPreset(presetIndex, regions);
+
+    if (regions.empty())
+        return nullptr;
+
+    return std::make_shared<Instrument>(soundFont.getPresetName(presetIndex), std::move(regions));
+}
+
+} // namespace Aika
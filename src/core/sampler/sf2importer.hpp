@@ -0,0 +1,39 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "instrument.hpp"
+#include <memory>
+
+namespace Aika {
+
+/**
+ * Loads presets from SoundFont 2 files.
+ *
+ * The RIFF structure is read directly: fluidsynth resolves zones inside its
+ * own synthesis engine and doesn't expose them, and we need them as Regions
+ * for ours. Preset and instrument generators are combined as the SF2 spec
+ * describes (instrument values absolute, preset values additive, ranges
+ * intersected) into one flat Region per instrument zone.
+ *
+ * The file is memory mapped and the 16-bit sample data is played in place,
+ * so a large bank costs no decoding time. 24-bit (sm24) data is ignored.
+ */
+class Sf2Importer {
+public:
+    /**
+     * @param file The .sf2 file
+     * @return Names of the presets in file order, empty if the file is not a valid SoundFont
+     */
+    static juce::StringArray getPresetNames(const juce::File& file);
+
+    /**
+     * Load one preset
+     *
+     * @param file The .sf2 file
+     * @param presetIndex Index into getPresetNames()
+     * @return The instrument, or nullptr if the file or preset is invalid
+     */
+    static std::shared_ptr<Instrument> load(const juce::File& file, int presetIndex = 0);
+};
+
+} // namespace Aika
@@ -0,0 +1,406 @@
+#include "sfzimporter.hpp"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Aika {
+
+namespace {
+
+constexpr int maxIncludeDepth = 8;
+
+using Opcodes = std::map<std::string, std::string>;
+using Defines = std::vector<std::pair<std::string, std::string>>;
+
+bool isSpace(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool isOpcodeChar(char c) noexcept {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+std::string trim(const std::string& text) {
+    size_t first = 0;
+    size_t last = text.size();
+    while (first < last && isSpace(text[first]))
+        ++first;
+    while (last > first && isSpace(text[last - 1]))
+        --last;
+    return text.substr(first, last - first);
+}
+
+void stripComments(std::string& text) {
+    std::string result;
+    result.reserve(text.size());
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '/' && i + 1 < text.size() && text[i + 1] == '/') {
+            while (i < text.size() && text[i] != '\n')
+                ++i;
+            result += '\n';
+        } else if (text[i] == '/' && i + 1 < text.size() && text[i + 1] == '*') {
+            const auto close = text.find("*/", i + 2);
+            i = close == std::string::npos ? text.size() : close + 1;
+            result += ' ';
+        } else {
+            result += text[i];
+        }
+    }
+
+    text.swap(result);
+}
+
+void substituteDefines(std::string& line, const Defines& defines) {
+    if (line.find('$') == std::string::npos)
+        return;
+
+    // Longest names first, so $VAR doesn't clobber $VAR2
+    for (const auto& [name, value] : defines) {
+        for (size_t pos = line.find(name); pos != std::string::npos; pos = line.find(name, pos + value.size()))
+            line.replace(pos, name.size(), value);
+    }
+}
+
+// Expand #include and #define into one flat opcode stream
+void preprocess(const juce::File& file, const juce::File& root, Defines& defines, std::string& output, int depth) {
+    if (depth > maxIncludeDepth || !file.existsAsFile())
+        return;
+
+    std::string text = file.loadFileAsString().toStdString();
+    stripComments(text);
+
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = text.size();
+
+        std::string line = trim(text.substr(lineStart, lineEnd - lineStart));
+        lineStart = lineEnd + 1;
+
+        if (line.compare(0, 7, "#define") == 0) {
+            const auto nameStart = line.find('$');
+            if (nameStart == std::string::npos)
+                continue;
+
+            auto nameEnd = nameStart + 1;
+            while (nameEnd < line.size() && isOpcodeChar(line[nameEnd]))
+                ++nameEnd;
+
+            defines.emplace_back(line.substr(nameStart, nameEnd - nameStart), trim(line.substr(nameEnd)));
+            std::stable_sort(defines.begin(), defines.end(),
+                             [](const auto& a, const auto& b) { return a.first.size() > b.first.size(); });
+        } else if (line.compare(0, 8, "#include") == 0) {
+            const auto open = line.find('"');
+            const auto close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos)
+                continue;
+
+            std::string path = line.substr(open + 1, close - open - 1);
+            substituteDefines(path, defines);
+            std::replace(path.begin(), path.end(), '\\', '/');
+            preprocess(root.getChildFile(juce::String(path)), root, defines, output, depth + 1);
+        } else if (!line.empty()) {
+            substituteDefines(line, defines);
+            output += line;
+            output += '\n';
+        }
+    }
+}
+
+// Values may contain spaces (sample paths), so a value runs until the next "name=" or header
+size_t findValueEnd(const std::string& text, size_t pos) {
+    for (; pos < text.size(); ++pos) {
+        if (text[pos] == '<')
+            return pos;
+        if (!isSpace(text[pos]))
+            continue;
+
+        size_t next = pos;
+        while (next < text.size() && isSpace(text[next]))
+            ++next;
+        if (next == text.size() || text[next] == '<')
+            return pos;
+
+        size_t nameEnd = next;
+        while (nameEnd < text.size() && isOpcodeChar(text[nameEnd]))
+            ++nameEnd;
+        if (nameEnd > next && nameEnd < text.size() && text[nameEnd] == '=')
+            return pos;
+    }
+    return pos;
+}
+
+class RegionBuilder {
+public:
+    RegionBuilder(const juce::File& sfzFile, juce::AudioFormatManager& manager)
+        : root(sfzFile.getParentDirectory()), formatManager(manager) {
+    }
+
+    void build(const Opcodes& opcodes, const std::string& defaultPath, std::vector<Region>& regions) {
+        const auto find = [&opcodes](const char* name) -> const std::string* {
+            const auto it = opcodes.find(name);
+            return it != opcodes.end() ? &it->second : nullptr;
+        };
+        const auto getInt = [&find](const char* name, int fallback) {
+            const auto* value = find(name);
+            return value != nullptr ? juce::String(*value).getIntValue() : fallback;
+        };
+        const auto getFloat = [&find](const char* name, float fallback) {
+            const auto* value = find(name);
+            return value != nullptr ? juce::String(*value).getFloatValue() : fallback;
+        };
+        const auto getNote = [&find](const char* name, int fallback) {
+            const auto* value = find(name);
+            return value != nullptr ? SfzImporter::parseNote(*value, fallback) : fallback;
+        };
+
+        const auto* samplePath = find("sample");
+        if (samplePath == nullptr || samplePath->empty() || samplePath->front() == '*')
+            return; // Built-in generators like *sine aren't supported
+
+        if (const auto* trigger = find("trigger"); trigger != nullptr && *trigger != "attack")
+            return;
+
+        if (find("end") != nullptr && getInt("end", 0) < 0)
+            return; // end=-1 disables a region
+
+        std::string path = defaultPath + *samplePath;
+        std::replace(path.begin(), path.end(), '\\', '/');
+        auto sample = loadSample(root.getChildFile(juce::String(path)));
+        if (sample == nullptr)
+            return;
+
+        const int numFrames = sample->getNumFrames();
+        const auto& metadata = sample->getMetadata();
+
+        Region region;
+        region.sample = sample;
+
+        const int key = getNote("key", -1);
+        region.loKey = getNote("lokey", key >= 0 ? key : 0);
+        region.hiKey = getNote("hikey", key >= 0 ? key : 127);
+        region.loVelocity = getInt("lovel", 0);
+        region.hiVelocity = getInt("hivel", 127);
+
+        const auto* keycenter = find("pitch_keycenter");
+        region.pitchKeycenter = keycenter != nullptr && *keycenter == "sample"
+                              ? metadata.rootNote
+                              : getNote("pitch_keycenter", key >= 0 ? key : 60);
+        region.pitchKeytrack = getFloat("pitch_keytrack", 100.0f);
+        region.tune = static_cast<float>(getInt("transpose", 0)) * 100.0f + getFloat("tune", 0.0f);
+
+        region.gain = juce::Decibels::decibelsToGain(getFloat("volume", 0.0f))
+                    * getFloat("amplitude", 100.0f) / 100.0f;
+        region.pan = juce::jlimit(-1.0f, 1.0f, getFloat("pan", 0.0f) / 100.0f);
+
+        // SFZ end and loop_end are inclusive
+        region.offset = juce::jlimit(0, numFrames, getInt("offset", 0));
+        region.end = juce::jlimit(region.offset, numFrames, find("end") != nullptr ? getInt("end", 0) + 1 : numFrames);
+
+        region.loopStart = getInt("loop_start", getInt("loopstart", metadata.hasLoop() ? metadata.loopStart : 0));
+        region.loopEnd = find("loop_end") != nullptr || find("loopend") != nullptr
+                       ? getInt("loop_end", getInt("loopend", 0)) + 1
+                       : (metadata.hasLoop() ? metadata.loopEnd : 0);
+        region.loopStart = juce::jlimit(region.offset, region.end, region.loopStart);
+        region.loopEnd = juce::jlimit(region.loopStart, region.end, region.loopEnd);
+
+        const auto* loopMode = find("loop_mode");
+        if (loopMode == nullptr)
+            loopMode = find("loopmode");
+
+        if (loopMode == nullptr)
+            region.loopMode = metadata.hasLoop() ? Region::LoopMode::Continuous : Region::LoopMode::NoLoop;
+        else if (*loopMode == "one_shot")
+            region.loopMode = Region::LoopMode::OneShot;
+        else if (*loopMode == "loop_continuous")
+            region.loopMode = Region::LoopMode::Continuous;
+        else if (*loopMode == "loop_sustain")
+            region.loopMode = Region::LoopMode::Sustain;
+        else
+            region.loopMode = Region::LoopMode::NoLoop;
+
+        region.attack = std::max(0.0f, getFloat("ampeg_attack", 0.0f));
+        region.release = std::max(0.0f, getFloat("ampeg_release", 0.001f));
+
+        region.group = getInt("group", 0);
+        region.offBy = getInt("off_by", 0);
+        region.seqLength = std::max(1, getInt("seq_length", 1));
+        region.seqPosition = juce::jlimit(1, region.seqLength, getInt("seq_position", 1));
+
+        regions.push_back(std::move(region));
+    }
+
+private:
+    std::shared_ptr<const Sample> loadSample(const juce::File& file) {
+        const auto key = file.getFullPathName().toStdString();
+        if (const auto it = samples.find(key); it != samples.end())
+            return it->second;
+
+        // Failed loads are cached too, so a missing file is only tried once
+        std::shared_ptr<const Sample> sample = Sample::loadFromFile(formatManager, file);
+        samples.emplace(key, sample);
+        return sample;
+    }
+
+    juce::File root;
+    juce::AudioFormatManager& formatManager;
+    std::map<std::string, std::shared_ptr<const Sample>> samples;
+};
+
+/**
+ * Drop the frames of each sample that none of its regions can reach. A
+ * continuous loop never plays past its end, so a sustained sample that is
+ * only ever looped keeps just its attack and one loop in memory.
+ */
+void trimUnreachableFrames(std::vector<Region>& regions) {
+    std::map<const Sample*, int> lastFrames;
+    for (const auto& region : regions) {
+        const int reach = region.loopMode == Region::LoopMode::Continuous && region.isLooped()
+                        ? region.loopEnd
+                        : (region.end > 0 ? region.end : region.sample->getNumFrames());
+        auto& lastFrame = lastFrames[region.sample.get()];
+        lastFrame = std::max(lastFrame, reach);
+    }
+
+    std::map<const Sample*, std::shared_ptr<const Sample>> trimmed;
+    for (const auto& [sample, lastFrame] : lastFrames) {
+        if (lastFrame > 0 && lastFrame < sample->getNumFrames())
+            trimmed.emplace(sample, Sample::createTrimmed(*sample, lastFrame));
+    }
+
+    for (auto& region : regions) {
+        if (const auto it = trimmed.find(region.sample.get()); it != trimmed.end())
+            region.sample = it->second;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<Instrument> SfzImporter::load(const juce::File& file, juce::AudioFormatManager& formatManager) {
+    std::string text;
+    Defines defines;
+    preprocess(file, file.getParentDirectory(), defines, text, 0);
+
+    RegionBuilder builder(file, formatManager);
+    std::vector<Region> regions;
+
+    // Opcodes of each level of the header hierarchy; a header resets the levels below it
+    Opcodes control, global, master, group, region;
+    Opcodes* current = nullptr;
+    bool inRegion = false;
+
+    const auto flushRegion = [&] {
+        if (!inRegion)
+            return;
+
+        Opcodes merged = global;
+        for (const auto* level : { &master, &group, &region }) {
+            for (const auto& [name, value] : *level)
+                merged[name] = value;
+        }
+
+        const auto defaultPath = control.find("default_path");
+        builder.build(merged, defaultPath != control.end() ? defaultPath->second : std::string(), regions);
+        inRegion = false;
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        if (isSpace(text[pos])) {
+            ++pos;
+            continue;
+        }
+
+        if (text[pos] == '<') {
+            const auto close = text.find('>', pos);
+            if (close == std::string::npos)
+                break;
+
+            const std::string header = text.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+            flushRegion();
+
+            if (header == "control") {
+                current = &control;
+            } else if (header == "global") {
+                global.clear();
+                master.clear();
+                group.clear();
+                current = &global;
+            } else if (header == "master") {
+                master.clear();
+                group.clear();
+                current = &master;
+            } else if (header == "group") {
+                group.clear();
+                current = &group;
+            } else if (header == "region") {
+                region.clear();
+                current = &region;
+                inRegion = true;
+            } else {
+                current = nullptr; // <curve>, <effect> and friends
+            }
+            continue;
+        }
+
+        size_t nameEnd = pos;
+        while (nameEnd < text.size() && isOpcodeChar(text[nameEnd]))
+            ++nameEnd;
+
+        if (nameEnd == pos || nameEnd >= text.size() || text[nameEnd] != '=') {
+            // Not an opcode; skip the token
+            while (pos < text.size() && !isSpace(text[pos]) && text[pos] != '<')
+                ++pos;
+            continue;
+        }
+
+        const size_t valueEnd = findValueEnd(text, nameEnd + 1);
+        if (current != nullptr)
+            (*current)[text.substr(pos, nameEnd - pos)] = trim(text.substr(nameEnd + 1, valueEnd - nameEnd - 1));
+        pos = valueEnd;
+    }
+    flushRegion();
+
+    if (regions.empty())
+        return nullptr;
+
+    trimUnreachableFrames(regions);
+    return std::make_shared<Instrument>(file.getFileNameWithoutExtension(), std::move(regions));
+}
+
+int SfzImporter::parseNote(const juce::String& text, int fallback) {
+    const auto value = text.trim().toLowerCase().toStdString();
+    if (value.empty())
+        return fallback;
+
+    if (std::isdigit(static_cast<unsigned char>(value[0])) || value[0] == '-')
+        return juce::jlimit(-1, 127, juce::String(value).getIntValue());
+
+    static constexpr int semitones[] = { 9, 11, 0, 2, 4, 5, 7 }; // a - g
+    if (value[0] < 'a' || value[0] > 'g')
+        return fallback;
+
+    int note = semitones[value[0] - 'a'];
+    size_t pos = 1;
+    if (pos < value.size() && value[pos] == '#') {
+        ++note;
+        ++pos;
+    } else if (pos < value.size() && value[pos] == 'b') {
+        --note;
+        ++pos;
+    }
+
+    if (pos == value.size())
+        return fallback;
+
+    const int octave = juce::String(value.substr(pos)).getIntValue();
+    const int midiNote = (octave + 1) * 12 + note;
+    return midiNote >= 0 && midiNote <= 127 ? midiNote : fallback;
+}
+
+} // namespace Aika
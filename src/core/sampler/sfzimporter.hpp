@@ -0,0 +1,40 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "instrument.hpp"
+#include <memory>
+
+namespace Aika {
+
+/**
+ * Loads SFZ instruments.
+ *
+ * The <control>, <global>, <master>, <group> and <region> hierarchy is
+ * flattened while parsing, so every region leaves the importer as a
+ * self-contained Region. #define and #include are supported. Opcodes the
+ * engine has no use for (modulation, filters, effects) are ignored, as are
+ * regions triggered by anything other than note-on.
+ */
+class SfzImporter {
+public:
+    /**
+     * Parse an SFZ file and decode the samples it references. Each sample
+     * file is decoded once however many regions use it.
+     *
+     * @param file The .sfz file
+     * @param formatManager Format manager with the required formats registered
+     * @return The instrument, or nullptr if the file has no playable regions
+     */
+    static std::shared_ptr<Instrument> load(const juce::File& file, juce::AudioFormatManager& formatManager);
+
+    /**
+     * Parse an SFZ note value: a MIDI number or a name such as "c4", "f#3" or "eb5" (C4 = 60)
+     *
+     * @param text The opcode value
+     * @param fallback Returned if the value can't be parsed
+     * @return The MIDI note
+     */
+    static int parseNote(const juce::String& text, int fallback);
+};
+
+} // namespace Aika
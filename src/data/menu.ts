@@ -14,6 +14,8 @@ export const menuItems = [
         shortcut: "⌘O",
         submenu: [
           { title: "OSMP Project", shortcut: "Ctrl+O", action: "openOSMP" },
+          { title: "Kit (OSKIT)", action: "openKit" },
+          { title: "Instrument (SFZ, SF2)", action: "openInstrument" },
           { title: "SoundFont (SF2)", shortcut: "Ctrl+Shift+S", action: "openSF2" },
           { title: "Project XML", shortcut: "Ctrl+Shift+X", action: "openXML" },
           { title: "Kontakt (NKI)", shortcut: "Ctrl+Shift+N", action: "openNKI" },
@@ -24,6 +26,7 @@ export const menuItems = [
         shortcut: "⌘⇧S",
         submenu: [
           { title: "OSMP Project", shortcut: "Ctrl+S", action: "saveOSMP" },
+          { title: "Kit (OSKIT)", action: "saveKit" },
           { title: "SoundFont (SF2)", action: "saveSF2" },
           { title: "Project XML", action: "saveXML" },
           { title: "Kontakt (NKI)", action: "saveNKI" },
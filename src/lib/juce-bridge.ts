@@ -7,11 +7,12 @@ export interface JUCEMessage {
   parameter?: string;
   value?: number;
   enabled?: boolean;
+  beats?: number;
 }
 
 export interface JUCEAudioMessage {
   type: 'audio';
-  action: 'load' | 'play' | 'stop' | 'setParameter' | 'unload';
+  action: 'load' | 'play' | 'setParameter' | 'unload';
   padId: number;
   data: any;
 }
@@ -54,11 +55,45 @@ export interface JUCEAudioEngineSettings {
   dithering: boolean;
 }
 
+export interface LatencyMeasurement {
+  clickToAudioMs: number;    // Estimated time from the input event until its audio leaves the plugin
+  roundTripMs: number;       // Web view -> native -> web view
+  queuedToRenderMs: number;  // Native receipt until the audio block that played it
+  blockMs: number;           // Length of that block
+}
+
+// Sample memory, reported in the 'samples' field of 'performance' messages
+export interface SampleStoreStats {
+  budgetBytes: number;    // 0 for no budget
+  residentBytes: number;  // Sample data of the kit in memory, derived samples included
+  derivedBytes: number;   // Edited, synced and rate-converted renders the kit plays from
+  resident: number;       // Samples fully in memory
+  evicted: number;        // Samples down to their preload head, the rest on disk
+  reloadMisses: number;   // Times playback got past a head before the rest was read back
+}
+
+// Binary command protocol for performance events (see src/main/commandprotocol.hpp).
+// Commands issued in the same task are sent together as one packet.
+const COMMAND_PACKET_PREFIX = '!';
+const COMMAND_PROTOCOL_VERSION = 1;
+const CommandOpcode = {
+  noteOn: 0x01,
+  noteOff: 0x02,
+  controlChange: 0x03,
+  padTrigger: 0x04,
+  padRelease: 0x05,
+  latencyProbe: 0x10
+} as const;
+
 export class JUCEBridge {
   private static instance: JUCEBridge;
   private isInitialized: boolean = false;
   private messageQueue: JUCEMessage[] = [];
   private messageHandlers: Map<string, ((message: any) => void)[]> = new Map();
+  private pendingCommands: number[] = [];
+  private commandFlushScheduled: boolean = false;
+  private nextProbeId: number = 1;
+  private pendingProbes: Map<number, { clickMs: number; sentMs: number; resolve: (result: LatencyMeasurement | null) => void }> = new Map();
   private engineSettings: JUCEAudioEngineSettings = {
     bufferSize: 512,
     sampleRate: 48000,
@@ -73,6 +108,8 @@ export class JUCEBridge {
     if (typeof window !== 'undefined') {
       window.addEventListener('message', this.handleMessage.bind(this));
     }
+
+    this.on('latencyProbe', this.handleLatencyProbe.bind(this));
   }
 
   static getInstance(): JUCEBridge {
@@ -106,7 +143,12 @@ export class JUCEBridge {
         window.juceBridge.onmessage = (messageStr: string) => {
           try {
             const message = JSON.parse(messageStr);
-            this.dispatchMessage(message);
+            // Native side coalesces each display frame's events into one batch
+            if (message.type === 'batch' && Array.isArray(message.data)) {
+              message.data.forEach((batched: any) => this.dispatchMessage(batched));
+            } else {
+              this.dispatchMessage(message);
+            }
           } catch (error) {
             console.error('Error parsing message from JUCE:', error);
           }
@@ -200,22 +242,12 @@ export class JUCEBridge {
     });
   }
 
-  playSample(padId: number, noteInfo?: any) {
-    this.sendMessage({
-      type: 'audio',
-      action: 'play',
-      padId,
-      data: noteInfo || {}
-    });
+  playSample(padId: number, noteInfo?: { velocity?: number }) {
+    this.queueCommand(CommandOpcode.padTrigger, padId, noteInfo?.velocity ?? 127);
   }
 
-  stopSample(padId: number) {
-    this.sendMessage({
-      type: 'audio',
-      action: 'stop',
-      padId,
-      data: {}
-    });
+  releasePad(padId: number) {
+    this.queueCommand(CommandOpcode.padRelease, padId);
   }
 
   setSampleParameter(padId: number, parameter: string, value: number) {
@@ -228,6 +260,95 @@ export class JUCEBridge {
     });
   }
 
+  // Stretch a pad's sample to last this many beats at the host tempo; 0 plays it at its own speed
+  setPadSync(padId: number, beats: number) {
+    this.sendMessage({
+        type: 'padSync',
+        padId,
+        beats,
+        data: undefined
+    });
+  }
+
+  // Trim (seconds), reverse, normalize and fades (seconds) of a pad's sample. Rendered once in
+  // the background and shared between pads; fields left out keep their current values.
+  setPadEdits(padId: number, edits: { start?: number; end?: number; reverse?: boolean; normalize?: boolean; fadeIn?: number; fadeOut?: number }) {
+    this.sendMessage({ type: 'padEdit', padId, data: edits });
+  }
+
+  // Slice a pad's sample (its trimmed region) at detected onsets onto that pad and the ones
+  // after it. Sensitivity is 0 - 1, higher finds more onsets; 'padSliced' reports the pads assigned.
+  slicePad(padId: number, sensitivity = 0.5) {
+    this.sendMessage({ type: 'padSlice', padId, data: { sensitivity } });
+  }
+
+  // Load several samples onto one pad as velocity layers and round robins, arranged by their
+  // filenames. Without absolute paths the plugin asks with a native chooser. 'padLayersLoaded' reports the result.
+  loadPadLayers(padId: number, paths?: string[]) {
+    this.sendMessage({ type: 'padLayers', padId, data: { paths } });
+  }
+
+  // Open a .oskit kit container; without an absolute path the plugin asks with a native file
+  // chooser. 'kitOpened' reports the result. With a program (0 - 127) the kit is instead
+  // preloaded in the background for that MIDI program change, and nothing is reported.
+  openKit(path?: string, program?: number) {
+    this.sendMessage({ type: 'kit', action: 'open', data: { path, program } });
+  }
+
+  // Save the current kit as a .oskit container; 'kitSaved' reports the result
+  saveKit(path?: string) {
+    this.sendMessage({ type: 'kit', action: 'save', data: { path } });
+  }
+
+  // Layer an .sfz or .sf2 instrument over the kit, choosing the file natively without a path.
+  // Preset is the SF2 preset index. 'instrumentLoaded' reports the result.
+  loadInstrument(path?: string, preset = 0) {
+    this.sendMessage({ type: 'instrument', action: 'load', data: { path, preset } });
+  }
+
+  clearInstrument() {
+    this.sendMessage({ type: 'instrument', action: 'clear', data: {} });
+  }
+
+  // Convert pad samples to the host's sample rate when they load, rather than interpolating
+  // them as they play. On by default; saved with the plugin state.
+  setSampleRateConversion(enabled: boolean) {
+    this.sendMessage({ type: 'sampleRateConversion', enabled, data: undefined });
+  }
+
+  // Step sequencer, played natively from the host transport. Edits apply to the
+  // selected pattern unless one is given; 'sequencerPosition' messages report the playing step.
+  setSequencerStep(track: number, step: number, velocity: number, probability = 100, pattern?: number) {
+    this.sendMessage({ type: 'sequencer', action: 'setStep', data: { pattern, track, step, velocity, probability } });
+  }
+
+  setSequencerLength(steps: number, pattern?: number) {
+    this.sendMessage({ type: 'sequencer', action: 'setLength', data: { pattern, steps } });
+  }
+
+  setSequencerStepBeats(beats: number, pattern?: number) {
+    this.sendMessage({ type: 'sequencer', action: 'setStepBeats', data: { pattern, beats } });
+  }
+
+  // Delay of every second step as a fraction of a step, 0 - 0.5
+  setSequencerSwing(swing: number, pattern?: number) {
+    this.sendMessage({ type: 'sequencer', action: 'setSwing', data: { pattern, swing } });
+  }
+
+  clearSequencerPattern(pattern?: number) {
+    this.sendMessage({ type: 'sequencer', action: 'clear', data: { pattern } });
+  }
+
+  // Switches when the playing pattern next starts over
+  selectSequencerPattern(pattern: number) {
+    this.sendMessage({ type: 'sequencer', action: 'select', data: { pattern } });
+  }
+
+  // Answered with a 'sequencerPattern' message
+  requestSequencerPattern(pattern?: number) {
+    this.sendMessage({ type: 'sequencer', action: 'get', data: { pattern } });
+  }
+
   setEffectParameter(padId: number, effect: string, parameter: string, value: number, enabled?: boolean) {
     this.sendMessage({
         type: 'effect',
@@ -242,40 +363,82 @@ export class JUCEBridge {
   
   // MIDI-specific methods
   sendMIDINote(note: number, velocity: number, channel: number = 0) {
-    this.sendMessage({
-      type: 'midi',
-      action: 'noteOn',
-      data: {
-        note,
-        velocity,
-        channel
-      }
-    });
+    this.queueCommand(CommandOpcode.noteOn, channel, note, velocity);
   }
 
   releaseMIDINote(note: number, channel: number = 0) {
-    this.sendMessage({
-      type: 'midi',
-      action: 'noteOff',
-      data: {
-        note,
-        channel
-      }
-    });
+    this.queueCommand(CommandOpcode.noteOff, channel, note);
   }
 
   sendMIDIControlChange(controller: number, value: number, channel: number = 0) {
-    this.sendMessage({
-      type: 'midi',
-      action: 'controlChange',
-      data: {
-        controller,
-        value,
-        channel
+    this.queueCommand(CommandOpcode.controlChange, channel, controller, value);
+  }
+
+  // Time how long an input event takes to become audio. Call it from the same
+  // handler as the notes it should measure, so it travels in their packet.
+  measureLatency(eventTimeStamp?: number): Promise<LatencyMeasurement | null> {
+    return new Promise((resolve) => {
+      if (!this.isInitialized || !window.juceBridge) {
+        resolve(null);
+        return;
       }
+
+      const id = this.nextProbeId;
+      this.nextProbeId = (this.nextProbeId % 0xffffffff) + 1;
+
+      const sentMs = performance.now();
+      this.pendingProbes.set(id, { clickMs: eventTimeStamp ?? sentMs, sentMs, resolve });
+      this.queueCommand(CommandOpcode.latencyProbe, id & 0xff, (id >>> 8) & 0xff, (id >>> 16) & 0xff, (id >>> 24) & 0xff);
+
+      // Timeout after 2 seconds
+      setTimeout(() => {
+        if (this.pendingProbes.delete(id)) {
+          resolve(null);
+        }
+      }, 2000);
+    });
+  }
+
+  private handleLatencyProbe(message: any) {
+    const { id, queuedToRenderMs, blockMs, heldMs } = message.data;
+    const probe = this.pendingProbes.get(id);
+    if (!probe) return;
+    this.pendingProbes.delete(id);
+
+    // Transport each way is estimated as half the round trip the native side didn't account for
+    const roundTripMs = performance.now() - probe.sentMs;
+    const transportMs = Math.max(0, (roundTripMs - heldMs) / 2);
+
+    probe.resolve({
+      clickToAudioMs: (probe.sentMs - probe.clickMs) + transportMs + queuedToRenderMs + blockMs,
+      roundTripMs,
+      queuedToRenderMs,
+      blockMs
     });
   }
 
+  private queueCommand(opcode: number, ...payload: number[]) {
+    this.pendingCommands.push(opcode, ...payload.map(value => value & 0xff));
+
+    if (!this.commandFlushScheduled) {
+      this.commandFlushScheduled = true;
+      queueMicrotask(() => this.flushCommands());
+    }
+  }
+
+  private flushCommands() {
+    this.commandFlushScheduled = false;
+
+    const commands = this.pendingCommands;
+    this.pendingCommands = [];
+
+    // Performance events are dropped rather than queued: a late note is worse than none
+    if (commands.length === 0 || !this.isInitialized || !window.juceBridge) return;
+
+    const packet = String.fromCharCode(COMMAND_PROTOCOL_VERSION, ...commands);
+    window.juceBridge.sendMessage(COMMAND_PACKET_PREFIX + btoa(packet));
+  }
+
   getMIDIInputDevices(): Promise<string[]> {
     return new Promise((resolve) => {
       if (!this.isInitialized || !window.juceBridge) {
@@ -328,18 +491,92 @@ export class JUCEBridge {
     });
   }
 
-  // Audio analysis methods
-  requestAnalysis(type: 'spectrum' | 'waveform', padId?: number) {
+  // Audio analysis methods. While subscribed, the native side pushes
+  // 'analysis' frames for the pad (or the master output when padId is null)
+  // at a fixed rate; subscriptions are counted, so pair each call.
+  subscribeAnalysis(padId: number | null) {
+    this.sendMessage({
+      type: 'analysis',
+      action: 'subscribe',
+      data: {
+        padId
+      }
+    });
+  }
+
+  unsubscribeAnalysis(padId: number | null) {
     this.sendMessage({
       type: 'analysis',
-      action: 'request',
+      action: 'unsubscribe',
       data: {
-        analysisType: type,
         padId
       }
     });
   }
 
+  // Level metering. While subscribed, the native side pushes a 'meters'
+  // message every display frame with master and per-pad levels
+  subscribeMeters() {
+    this.sendMessage({
+      type: 'meters',
+      action: 'subscribe',
+      data: {}
+    });
+  }
+
+  unsubscribeMeters() {
+    this.sendMessage({
+      type: 'meters',
+      action: 'unsubscribe',
+      data: {}
+    });
+  }
+
+  // Memory budget for the kit's samples; 0 MB for none. Samples not played for a while
+  // are evicted least recently played first, down to a preload head read back on demand.
+  setSampleBudget(megabytes: number) {
+    this.sendMessage({
+      type: 'sampleStore',
+      action: 'setBudget',
+      data: { megabytes }
+    });
+  }
+
+  // Evict every sample not played since it was loaded, budget or not
+  purgeUnusedSamples() {
+    this.sendMessage({
+      type: 'sampleStore',
+      action: 'purgeUnused',
+      data: {}
+    });
+  }
+
+  // Hot-path tracing. Start clears what was recorded before; save writes a
+  // Chrome/Perfetto trace to the documents folder and answers with 'traceSaved'
+  startTrace() {
+    this.sendMessage({
+      type: 'trace',
+      action: 'start',
+      data: {}
+    });
+  }
+
+  stopTrace() {
+    this.sendMessage({
+      type: 'trace',
+      action: 'stop',
+      data: {}
+    });
+  }
+
+  saveTrace() {
+    this.sendMessage({
+      type: 'trace',
+      action: 'save',
+      data: {}
+    });
+  }
+
   // Add shutdown method
   shutdown(): Promise<boolean> {
     return new Promise((resolve) => {
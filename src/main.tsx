@@ -8,3 +8,13 @@ ReactDOM.createRoot(document.getElementById('root')!).render(
     <App />
   </React.StrictMode>,
 )
+
+// Report time-to-first-paint to the plugin: the second animation frame
+// runs after the first one has been painted
+requestAnimationFrame(() => requestAnimationFrame(() => {
+  window.juceBridge?.sendMessage(JSON.stringify({
+    type: 'system',
+    action: 'firstPaint',
+    data: { sincePageLoadMs: performance.now() }
+  }));
+}));
@@ -0,0 +1,136 @@
+/*
+  ==============================================================================
+
+    Compact binary commands from the web interface.
+
+  ==============================================================================
+*/
+
+#include "commandprotocol.hpp"
+#include "pluginprocessor.hpp"
+#include "core/platform/tracer.hpp"
+
+namespace
+{
+    using MidiEvent = OpenSamplerAudioProcessor::MidiEvent;
+
+    juce::uint8 toChannel(juce::uint8 value) { return static_cast<juce::uint8>(juce::jmin(15, static_cast<int>(value))); }
+    juce::uint8 toData(juce::uint8 value) { return static_cast<juce::uint8>(juce::jmin(127, static_cast<int>(value))); }
+
+    // A note-on with velocity 0 would be read as a note-off
+    juce::uint8 toVelocity(juce::uint8 value) { return static_cast<juce::uint8>(juce::jlimit(1, 127, static_cast<int>(value))); }
+
+    MidiEvent makeEvent(juce::uint8 status, juce::uint8 channel, juce::uint8 data1, juce::uint8 data2)
+    {
+        return { { static_cast<juce::uint8>(status | channel), data1, data2 }, 3 };
+    }
+
+    int getPadNote(const std::shared_ptr<const Aika::Kit>& kit, juce::uint8 padId)
+    {
+        if (kit == nullptr || padId >= Aika::Kit::numPads)
+            return -1;
+        return kit->pads[padId].settings.midiNote;
+    }
+}
+
+//==============================================================================
+CommandDispatcher::CommandDispatcher(OpenSamplerAudioProcessor& p)
+    : audioProcessor(p)
+{
+}
+
+bool CommandDispatcher::isCommandPacket(const juce::String& message)
+{
+    return message[0] == CommandProtocol::packetPrefix;
+}
+
+const std::array<CommandDispatcher::Command, 256>& CommandDispatcher::getCommandTable()
+{
+    static const auto table = []
+    {
+        using namespace CommandProtocol;
+        std::array<Command, 256> commands {};
+
+        commands[noteOn] = { 3, [](Batch& batch, const juce::uint8* p)
+        {
+            batch.events.push_back(makeEvent(0x90, toChannel(p[0]), toData(p[1]), toVelocity(p[2])));
+        } };
+
+        commands[noteOff] = { 2, [](Batch& batch, const juce::uint8* p)
+        {
+            batch.events.push_back(makeEvent(0x80, toChannel(p[0]), toData(p[1]), 0));
+        } };
+
+        commands[controlChange] = { 3, [](Batch& batch, const juce::uint8* p)
+        {
+            batch.events.push_back(makeEvent(0xb0, toChannel(p[0]), toData(p[1]), toData(p[2])));
+        } };
+
+        commands[padTrigger] = { 2, [](Batch& batch, const juce::uint8* p)
+        {
+            const int note = getPadNote(batch.kit, p[0]);
+            if (note >= 0)
+                batch.events.push_back(makeEvent(0x90, 0, static_cast<juce::uint8>(note), toVelocity(p[1])));
+        } };
+
+        commands[padRelease] = { 1, [](Batch& batch, const juce::uint8* p)
+        {
+            const int note = getPadNote(batch.kit, p[0]);
+            if (note >= 0)
+                batch.events.push_back(makeEvent(0x80, 0, static_cast<juce::uint8>(note), 0));
+        } };
+
+        commands[latencyProbe] = { 4, [](Batch& batch, const juce::uint8* p)
+        {
+            batch.probeId = juce::ByteOrder::littleEndianInt(p);
+        } };
+
+        return commands;
+    }();
+
+    return table;
+}
+
+bool CommandDispatcher::dispatch(const juce::String& packet)
+{
+    AIKA_TRACE_SCOPE("commandPacket");
+    decoded.reset();
+    if (!isCommandPacket(packet) || !juce::Base64::convertFromBase64(decoded, packet.substring(1)))
+    {
+        ++rejectedPackets;
+        return false;
+    }
+
+    const auto* data = static_cast<const juce::uint8*>(decoded.getData());
+    const size_t size = decoded.getDataSize();
+    if (size == 0 || data[0] != CommandProtocol::version)
+    {
+        ++rejectedPackets;
+        return false;
+    }
+
+    batch.events.clear();
+    batch.probeId = 0;
+    batch.kit = audioProcessor.getKit();
+
+    // Fixed payload sizes: one table lookup per command, and a truncated or
+    // unknown command rejects the whole packet before anything is applied
+    const auto& table = getCommandTable();
+    for (size_t offset = 1; offset < size;)
+    {
+        const auto& command = table[data[offset]];
+        if (command.handler == nullptr || offset + 1 + static_cast<size_t>(command.payloadSize) > size)
+        {
+            ++rejectedPackets;
+            return false;
+        }
+
+        command.handler(batch, data + offset + 1);
+        offset += 1 + static_cast<size_t>(command.payloadSize);
+    }
+
+    // A batch that doesn't fit in the queue is dropped whole
+    const bool queued = audioProcessor.sendMidiEvents(batch.events.data(), static_cast<int>(batch.events.size()), batch.probeId);
+    batch.kit.reset();
+    return queued;
+}
@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    Compact binary commands from the web interface.
+
+    Performance events (notes, pad hits, controllers) skip JSON entirely. The
+    web view sends a packet string made of packetPrefix followed by base64:
+
+        [version] [opcode payload] [opcode payload] ...
+
+    Each opcode has a fixed payload size, so a packet can carry any number of
+    commands (a chord, a burst of pad hits) and is decoded with one table
+    lookup per command. All events in a packet reach the audio thread in the
+    same block, through the processor's lock-free MIDI queue.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "pluginprocessor.hpp"
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace CommandProtocol
+{
+    constexpr juce::juce_wchar packetPrefix = '!';
+    constexpr juce::uint8 version = 1;
+
+    enum Opcode : juce::uint8
+    {
+        noteOn = 0x01,          // channel, note, velocity (0 - 127)
+        noteOff = 0x02,         // channel, note
+        controlChange = 0x03,   // channel, controller, value
+        padTrigger = 0x04,      // pad, velocity (0 - 127)
+        padRelease = 0x05,      // pad
+        latencyProbe = 0x10     // probe id (uint32, little endian)
+    };
+}
+
+//==============================================================================
+// Decodes command packets and hands their events to the processor as one batch. Message thread.
+class CommandDispatcher
+{
+public:
+    explicit CommandDispatcher(OpenSamplerAudioProcessor& processor);
+
+    // True if a script message is a command packet rather than JSON
+    static bool isCommandPacket(const juce::String& message);
+
+    // Decode and apply a packet; returns false if it is malformed or the MIDI queue is full,
+    // in which case nothing is applied
+    bool dispatch(const juce::String& packet);
+
+    juce::uint64 getNumRejectedPackets() const { return rejectedPackets; }
+
+private:
+    struct Batch
+    {
+        std::vector<OpenSamplerAudioProcessor::MidiEvent> events;
+        juce::uint32 probeId = 0;
+        std::shared_ptr<const Aika::Kit> kit;
+    };
+
+    using Handler = void (*)(Batch&, const juce::uint8* payload);
+
+    struct Command
+    {
+        int payloadSize = -1;    // -1 for unknown opcodes
+        Handler handler = nullptr;
+    };
+
+    static const std::array<Command, 256>& getCommandTable();
+
+    OpenSamplerAudioProcessor& audioProcessor;
+    juce::MemoryOutputStream decoded;
+    Batch batch;   // Reused, so its events keep their capacity
+    juce::uint64 rejectedPackets = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (CommandDispatcher)
+};
@@ -8,46 +8,105 @@
 
 #include "pluginprocessor.hpp"
 #include "plugineditor.hpp"
+#include "core/platform/tracer.hpp"
 #include <unordered_map>
 #include <json/json.h>
 
-namespace {
-    template <typename T>
-    std::unique_ptr<T> rawToUniquePtr(juce::InputSource* ptr) {
-        return std::unique_ptr<T>(static_cast<T*>(ptr));
+//==============================================================================
+// WebMessageQueue implementation
+
+void WebMessageQueue::push(const Json::Value& message, const juce::String& coalesceKey)
+{
+    const juce::ScopedLock sl(lock);
+
+    if (coalesceKey.isNotEmpty())
+    {
+        for (auto& entry : pending)
+        {
+            if (entry.key == coalesceKey)
+            {
+                entry.message = message;
+                ++coalesced;
+                return;
+            }
+        }
     }
+
+    if (pending.size() >= maxPendingMessages)
+    {
+        ++dropped;
+        return;
+    }
+
+    pending.push_back({ coalesceKey, message });
+}
+
+bool WebMessageQueue::popBatch(Json::Value& batch)
+{
+    std::vector<Pending> taken;
+    {
+        const juce::ScopedLock sl(lock);
+        if (pending.empty())
+            return false;
+
+        taken.swap(pending);
+        pending.reserve(taken.size());
+    }
+
+    batch = Json::Value(Json::arrayValue);
+    for (auto& entry : taken)
+        batch.append(std::move(entry.message));
+
+    sent += taken.size();
+    ++batches;
+    return true;
+}
+
+WebMessageQueue::Stats WebMessageQueue::getStats() const
+{
+    Stats stats;
+    stats.sent = sent.load();
+    stats.batches = batches.load();
+    stats.coalesced = coalesced.load();
+    stats.dropped = dropped.load();
+    return stats;
 }
 
 //==============================================================================
 // MIDIBridge implementation
 
-MIDIBridge::MIDIBridge(OpenSamplerAudioProcessor& p)
-    : audioProcessor(p)
+MIDIBridge::MIDIBridge(OpenSamplerAudioProcessor& p, WebMessageQueue& outboundMessages)
+    : audioProcessor(p), outbound(outboundMessages)
 {
-    // Set up MIDI message callback
-    midiCallback = [this](const juce::MidiMessage& message) {
-        if (!isProcessingMessage)
-        {
-            Json::Value jsonMessage = midiMessageToJson(message);
-            sendToWeb(jsonMessage);
-        }
-    };
-    
-    // Register callback with processor
-    audioProcessor.addMidiMessageListener(midiCallback);
+    // Activity queued while no editor was open is stale by now
+    OpenSamplerAudioProcessor::MidiActivity discarded[64];
+    while (audioProcessor.popMidiActivity(discarded, 64) > 0)
+    {
+    }
 }
 
-MIDIBridge::~MIDIBridge()
+void MIDIBridge::queueMidiActivity()
 {
-    // Unregister callback
-    audioProcessor.removeMidiMessageListener(midiCallback);
+    OpenSamplerAudioProcessor::MidiActivity events[64];
+    int numEvents;
+    while ((numEvents = audioProcessor.popMidiActivity(events, 64)) > 0)
+    {
+        for (int i = 0; i < numEvents; ++i)
+        {
+            const juce::MidiMessage message(events[i].status, events[i].data1, events[i].data2);
+
+            // Only the latest value of each controller matters to the UI
+            const auto coalesceKey = message.isController()
+                ? "cc:" + juce::String(message.getChannel()) + ":" + juce::String(message.getControllerNumber())
+                : juce::String();
+
+            sendToWeb(midiMessageToJson(message), coalesceKey);
+        }
+    }
 }
 
 void MIDIBridge::handleWebMessage(const juce::var& message)
 {
-    // Set flag to avoid recursive calls
-    isProcessingMessage = true;
-    
     // Parse the message type
     if (message.hasProperty("type") && message.hasProperty("action") && message.hasProperty("data"))
     {
@@ -106,9 +165,6 @@ void MIDIBridge::handleWebMessage(const juce::var& message)
             }
         }
     }
-    
-    // Reset flag
-    isProcessingMessage = false;
 }
 
 Json::Value MIDIBridge::midiMessageToJson(const juce::MidiMessage& message)
@@ -140,24 +196,17 @@ Json::Value MIDIBridge::midiMessageToJson(const juce::MidiMessage& message)
     return jsonMessage;
 }
 
-void MIDIBridge::sendToWeb(const Json::Value& data)
+void MIDIBridge::sendToWeb(const Json::Value& data, const juce::String& coalesceKey)
 {
-    Json::FastWriter writer;
-    juce::String jsonString = writer.write(data);
-    
-    // Get reference to editor for sending the message
-    if (auto* editor = dynamic_cast<OpenSamplerAudioProcessorEditor*>(audioProcessor.getActiveEditor()))
-    {
-        editor->sendMessageToWebView(jsonString);
-    }
+    outbound.push(data, coalesceKey);
 }
 
 //==============================================================================
 OpenSamplerAudioProcessorEditor::OpenSamplerAudioProcessorEditor(OpenSamplerAudioProcessor& p)
-    : AudioProcessorEditor(&p), audioProcessor(p)
+    : AudioProcessorEditor(&p), audioProcessor(p), commandDispatcher(p), openedAtMs(juce::Time::getMillisecondCounterHiRes())
 {
     // Create MIDI bridge
-    midiBridge = std::make_unique<MIDIBridge>(p);
+    midiBridge = std::make_unique<MIDIBridge>(p, outboundMessages);
     
     // Add web component
     addAndMakeVisible(webComponent);
@@ -165,12 +214,23 @@ OpenSamplerAudioProcessorEditor::OpenSamplerAudioProcessorEditor(OpenSamplerAudi
     
     // Set initial size
     setSize(1024, 768);
+
+    startTimerHz(displayRateHz);
 }
 
 OpenSamplerAudioProcessorEditor::~OpenSamplerAudioProcessorEditor()
 {
     // Clean up
+    stopTimer();
     midiBridge = nullptr;
+
+    auto& analyser = audioProcessor.getAnalyser();
+    for (int index = 0; index < Aika::Analyser::numTaps; ++index)
+    {
+        for (int i = 0; i < analysisSubscriptions[(size_t) index]; ++i)
+            analyser.setSubscribed(index - 1, false);
+    }
+    audioProcessor.setTruePeakMetering(false);
 }
 
 void OpenSamplerAudioProcessorEditor::paint(juce::Graphics& g)
@@ -190,24 +250,25 @@ OpenSamplerAudioProcessorEditor::getResource(const juce::String& url) {
                                 ? juce::String{"index.html"}
                                 : url.fromFirstOccurrenceOf("/", false, false);
 
-    static auto streamZip = juce::MemoryInputStream(
-        juce::MemoryBlock(BinaryData::app_zip, BinaryData::app_zipSize),
-        true);
+    const auto asset = getAssetCache().find(urlToRetrive);
+    if (!asset)
+        return std::nullopt;
 
-    static juce::ZipFile archive{streamZip};
+    double unset = 0.0;
+    firstResourceMs.compare_exchange_strong(unset, juce::Time::getMillisecondCounterHiRes() - openedAtMs);
 
-    if (auto* entry = archive.getEntry(urlToRetrive)) {
-        auto entryStream = rawToUniquePtr(archive.createStreamForEntry(*entry));
-        std::vector<std::byte> result((size_t)entryStream->getTotalLength());
-        entryStream->setPosition(0);
-        entryStream->read(result.data(), result.size());
+    // The web view API takes ownership of a vector, so this is the one copy left
+    std::vector<std::byte> result(asset->data, asset->data + asset->size);
+    auto mime = getMimeForExtension(
+        urlToRetrive.fromLastOccurrenceOf(".", false, false).toLowerCase());
+    return juce::WebBrowserComponent::Resource{std::move(result),
+                                               std::move(mime)};
+}
 
-        auto mime = getMimeForExtension(
-            entry->filename.fromLastOccurrenceOf(".", false, false).toLowerCase());
-        return juce::WebBrowserComponent::Resource{std::move(result),
-                                                 std::move(mime)};
-    }
-    return std::nullopt;
+Aika::AssetCache& OpenSamplerAudioProcessorEditor::getAssetCache() {
+    // Indexed once per process and shared by every editor
+    static Aika::AssetCache cache(BinaryData::app_zip, static_cast<size_t>(BinaryData::app_zipSize));
+    return cache;
 }
 
 const char* OpenSamplerAudioProcessorEditor::getMimeForExtension(
@@ -235,8 +296,154 @@ const char* OpenSamplerAudioProcessorEditor::getMimeForExtension(
     return "";
 }
 
+void OpenSamplerAudioProcessorEditor::handleScriptMessage(const juce::String& message)
+{
+    AIKA_TRACE_THREAD("Message");
+    AIKA_TRACE_SCOPE("webMessage");
+
+    // Notes and pad hits come as binary packets and skip JSON parsing entirely
+    if (CommandDispatcher::isCommandPacket(message))
+        commandDispatcher.dispatch(message);
+    else
+        handleWebMessage(juce::JSON::parse(message));
+}
+
 void OpenSamplerAudioProcessorEditor::handleWebMessage(const juce::var& message)
 {
+    if (message["type"].toString() == "analysis")
+    {
+        handleAnalysisMessage(message["action"].toString(), message["data"]);
+        return;
+    }
+
+    if (message["type"].toString() == "parameter")
+    {
+        // Pad mixer parameters go through the host so they can be automated
+        audioProcessor.setPadParameter(static_cast<int>(message["padId"]),
+                                       message["parameter"].toString(),
+                                       static_cast<float>(static_cast<double>(message["value"])));
+        return;
+    }
+
+    if (message["type"].toString() == "padSync")
+    {
+        // Length in beats at the host tempo; 0 turns sync off
+        audioProcessor.setPadSync(static_cast<int>(message["padId"]), static_cast<double>(message["beats"]));
+        return;
+    }
+
+    if (message["type"].toString() == "padEdit")
+    {
+        // Trim, reverse, normalize and fades; fields left out keep their current values
+        const int padId = message["padId"];
+        const auto kit = audioProcessor.getKit();
+        if (padId < 0 || padId >= Aika::Kit::numPads)
+            return;
+
+        const auto& data = message["data"];
+        auto edits = kit->pads[(size_t) padId].settings;
+        edits.start = data.getProperty("start", edits.start);
+        edits.end = data.getProperty("end", edits.end);
+        edits.reverse = data.getProperty("reverse", edits.reverse);
+        edits.normalize = data.getProperty("normalize", edits.normalize);
+        edits.fadeIn = data.getProperty("fadeIn", edits.fadeIn);
+        edits.fadeOut = data.getProperty("fadeOut", edits.fadeOut);
+        audioProcessor.setPadEdits(padId, edits);
+        return;
+    }
+
+    if (message["type"].toString() == "padSlice")
+    {
+        // Slices go onto the pad and the ones after it; the reply says how many pads were assigned
+        const int padId = message["padId"];
+        Json::Value reply;
+        reply["type"] = "padSliced";
+        reply["data"]["padId"] = padId;
+        reply["data"]["numPads"] = audioProcessor.slicePadToPads(padId, static_cast<float>(message["data"].getProperty("sensitivity", 0.5)));
+        queueWebMessage(reply);
+        return;
+    }
+
+    if (message["type"].toString() == "padLayers")
+    {
+        // Several files on one pad; velocity ranges and round robins come from their names
+        const int padId = message["padId"];
+        if (padId < 0 || padId >= Aika::Kit::numPads)
+            return;
+
+        chooseFiles(message["data"]["paths"], "Load Pad Layers", audioProcessor.getAudioFormatWildcard(),
+                    juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles | juce::FileBrowserComponent::canSelectMultipleItems,
+                    [this, padId](const juce::Array<juce::File>& files)
+                    {
+                        Json::Value reply;
+                        reply["type"] = "padLayersLoaded";
+                        reply["data"]["padId"] = padId;
+                        reply["data"]["loaded"] = audioProcessor.loadPadLayers(padId, files);
+                        queueWebMessage(reply);
+                    });
+        return;
+    }
+
+    if (message["type"].toString() == "sampleRateConversion")
+    {
+        audioProcessor.setSampleRateConversion(message["enabled"]);
+        return;
+    }
+
+    if (message["type"].toString() == "sampleStore")
+    {
+        // Budget in megabytes, 0 for none; "purgeUnused" evicts every sample not played yet
+        auto& sampleStore = audioProcessor.getSampleStore();
+        if (message["action"].toString() == "setBudget")
+            sampleStore.setBudget((size_t) (juce::jmax(0.0, static_cast<double>(message["data"]["megabytes"])) * 1024.0 * 1024.0));
+        else if (message["action"].toString() == "purgeUnused")
+            sampleStore.purgeUnused();
+        return;
+    }
+
+    if (message["type"].toString() == "sequencer")
+    {
+        handleSequencerMessage(message["action"].toString(), message["data"]);
+        return;
+    }
+
+    if (message["type"].toString() == "meters")
+    {
+        if (message["action"].toString() == "subscribe")
+            ++meterSubscriptions;
+        else if (message["action"].toString() == "unsubscribe")
+            meterSubscriptions = juce::jmax(0, meterSubscriptions - 1);
+        audioProcessor.setTruePeakMetering(meterSubscriptions > 0);
+        return;
+    }
+
+    if (message["type"].toString() == "trace")
+    {
+        handleTraceMessage(message["action"].toString());
+        return;
+    }
+
+    if (message["type"].toString() == "kit")
+    {
+        handleKitMessage(message["action"].toString(), message["data"]);
+        return;
+    }
+
+    if (message["type"].toString() == "instrument")
+    {
+        handleInstrumentMessage(message["action"].toString(), message["data"]);
+        return;
+    }
+
+    if (message["type"].toString() == "system" && message["action"].toString() == "firstPaint")
+    {
+        firstPaintMs = juce::Time::getMillisecondCounterHiRes() - openedAtMs;
+        const auto stats = getAssetCache().getStats();
+        DBG("Editor first paint after " << firstPaintMs << " ms (first resource " << firstResourceMs.load()
+            << " ms, " << (int) stats.inflations << " assets inflated in " << stats.inflateMs << " ms)");
+        return;
+    }
+
     if (midiBridge)
     {
         midiBridge->handleWebMessage(message);
@@ -245,6 +452,388 @@ void OpenSamplerAudioProcessorEditor::handleWebMessage(const juce::var& message)
 
 void OpenSamplerAudioProcessorEditor::sendMessageToWebView(const juce::String& jsonMessage)
 {
-    // Send message to the web view
-    webComponent.evaluateJavaScript("window.juceBridge.onmessage('" + jsonMessage.replace("'", "\\'") + "');");
+    // Pass the JSON as a properly escaped string literal; quotes, backslashes
+    // and newlines in the payload would otherwise break the script
+    const auto literal = Json::valueToQuotedString(jsonMessage.toRawUTF8());
+    webComponent.evaluateJavaScript("window.juceBridge.onmessage(" + juce::String(literal) + ");");
+}
+
+void OpenSamplerAudioProcessorEditor::queueWebMessage(const Json::Value& message, const juce::String& coalesceKey)
+{
+    outboundMessages.push(message, coalesceKey);
+}
+
+void OpenSamplerAudioProcessorEditor::handleTraceMessage(const juce::String& action)
+{
+    if (action == "start")
+    {
+        Aika::Tracer::clear();
+        Aika::Tracer::setEnabled(true);
+    }
+    else if (action == "stop")
+    {
+        Aika::Tracer::setEnabled(false);
+    }
+    else if (action == "save")
+    {
+        // Recording carries on if it was running; the file holds what the rings have kept
+        const auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                              .getNonexistentChildFile("OpenSampler Trace " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H%M%S"), ".json");
+
+        Json::Value message;
+        message["type"] = "traceSaved";
+        message["data"]["saved"] = Aika::Tracer::saveChromeTrace(file);
+        message["data"]["path"] = file.getFullPathName().toStdString();
+        outboundMessages.push(message);
+    }
+}
+
+void OpenSamplerAudioProcessorEditor::handleKitMessage(const juce::String& action, const juce::var& data)
+{
+    if (action == "open")
+    {
+        // With a program (0 - 127) the kit is preloaded in the background for
+        // that program change; otherwise it replaces the current kit
+        const int program = data.getProperty("program", -1);
+        chooseFiles(data["path"], "Open Kit", "*.oskit", juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                    [this, program](const juce::Array<juce::File>& files)
+                    {
+                        if (program >= 0 && program < Aika::SamplerEngine::numPrograms)
+                        {
+                            audioProcessor.loadKitContainerAsync(files[0], program);
+                            return;
+                        }
+
+                        Json::Value message;
+                        message["type"] = "kitOpened";
+                        message["data"]["path"] = files[0].getFullPathName().toStdString();
+                        message["data"]["loaded"] = audioProcessor.loadKitContainer(files[0]);
+                        queueWebMessage(message);
+                    });
+    }
+    else if (action == "save")
+    {
+        chooseFiles(data["path"], "Save Kit", "*.oskit",
+                    juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting,
+                    [this](const juce::Array<juce::File>& files)
+                    {
+                        const auto file = files[0].withFileExtension("oskit");
+
+                        Json::Value message;
+                        message["type"] = "kitSaved";
+                        message["data"]["path"] = file.getFullPathName().toStdString();
+                        message["data"]["saved"] = audioProcessor.saveKitContainer(file);
+                        queueWebMessage(message);
+                    });
+    }
+}
+
+void OpenSamplerAudioProcessorEditor::handleInstrumentMessage(const juce::String& action, const juce::var& data)
+{
+    if (action == "load")
+    {
+        // Samples are decoded and regions compiled before this returns
+        const int preset = data.getProperty("preset", 0);
+        chooseFiles(data["path"], "Load Instrument", "*.sfz;*.sf2", juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                    [this, preset](const juce::Array<juce::File>& files)
+                    {
+                        Json::Value message;
+                        message["type"] = "instrumentLoaded";
+                        message["data"]["path"] = files[0].getFullPathName().toStdString();
+                        message["data"]["loaded"] = audioProcessor.loadInstrument(files[0], juce::jmax(0, preset));
+                        queueWebMessage(message);
+                    });
+    }
+    else if (action == "clear")
+    {
+        audioProcessor.clearInstrument();
+    }
+}
+
+void OpenSamplerAudioProcessorEditor::chooseFiles(const juce::var& paths, const juce::String& title, const juce::String& patterns,
+                                                  int chooserFlags, std::function<void(const juce::Array<juce::File>&)> onChosen)
+{
+    juce::Array<juce::File> files;
+    if (auto* array = paths.getArray())
+    {
+        for (const auto& path : *array)
+            if (juce::File::isAbsolutePath(path.toString()))
+                files.add(juce::File(path.toString()));
+    }
+    else if (juce::File::isAbsolutePath(paths.toString()))
+    {
+        files.add(juce::File(paths.toString()));
+    }
+
+    if (!files.isEmpty())
+    {
+        onChosen(files);
+        return;
+    }
+
+    fileChooser = std::make_unique<juce::FileChooser>(title, juce::File(), patterns);
+    fileChooser->launchAsync(chooserFlags, [onChosen = std::move(onChosen)](const juce::FileChooser& chooser)
+    {
+        const auto results = chooser.getResults();
+        if (!results.isEmpty() && results[0] != juce::File())
+            onChosen(results);
+    });
+}
+
+void OpenSamplerAudioProcessorEditor::handleAnalysisMessage(const juce::String& action, const juce::var& data)
+{
+    // A missing or null padId means the master output
+    const auto padId = data["padId"];
+    const int tap = padId.isVoid() || padId.isUndefined() ? Aika::Analyser::masterTap : static_cast<int>(padId);
+    if (tap < Aika::Analyser::masterTap || tap >= Aika::Kit::numPads)
+        return;
+
+    auto& count = analysisSubscriptions[(size_t) (tap + 1)];
+    if (action == "subscribe")
+    {
+        ++count;
+        audioProcessor.getAnalyser().setSubscribed(tap, true);
+    }
+    else if (action == "unsubscribe" && count > 0)
+    {
+        --count;
+        audioProcessor.getAnalyser().setSubscribed(tap, false);
+    }
+}
+
+void OpenSamplerAudioProcessorEditor::queueAnalysisFrames()
+{
+    auto& analyser = audioProcessor.getAnalyser();
+    Aika::Analyser::Frame frame;
+
+    for (int index = 0; index < Aika::Analyser::numTaps; ++index)
+    {
+        const int tap = index - 1;
+        if (analysisSubscriptions[(size_t) index] == 0
+            || !analyser.getLatestFrame(tap, analysisSequences[(size_t) index], frame))
+            continue;
+
+        analysisSequences[(size_t) index] = frame.sequence;
+
+        // Frames travel as base64 bytes rather than JSON number arrays,
+        // and only the newest frame of each kind is kept per display frame
+        const auto queueFrame = [&](const char* analysisType, const char* encoding, const void* bytes, size_t numBytes)
+        {
+            Json::Value message;
+            message["type"] = "analysis";
+            message["padId"] = tap == Aika::Analyser::masterTap ? Json::Value() : Json::Value(tap);
+            message["analysisType"] = analysisType;
+            message["encoding"] = encoding;
+            message["data"] = juce::Base64::toBase64(bytes, numBytes).toStdString();
+            outboundMessages.push(message, "analysis:" + juce::String(tap) + ":" + analysisType);
+        };
+
+        queueFrame("spectrum", "u8db", frame.spectrum.data(), frame.spectrum.size());
+        queueFrame("waveform", "s8", frame.waveform.data(), frame.waveform.size());
+    }
+}
+
+void OpenSamplerAudioProcessorEditor::queueMeterLevels()
+{
+    if (meterSubscriptions == 0)
+        return;
+
+    // Linear gain; peaks are the highest since the previous frame
+    const auto toJson = [](const Aika::LevelMeter::Reading& reading)
+    {
+        Json::Value level;
+        for (int channel = 0; channel < Aika::LevelMeter::numChannels; ++channel)
+        {
+            level["peak"].append(reading.peak[(size_t) channel]);
+            level["rms"].append(reading.rms[(size_t) channel]);
+        }
+        level["truePeak"] = reading.truePeak;
+        return level;
+    };
+
+    Json::Value message;
+    message["type"] = "meters";
+    message["data"]["master"] = toJson(audioProcessor.getMasterMeter().read());
+    for (int padId = 0; padId < Aika::Kit::numPads; ++padId)
+        message["data"]["pads"].append(toJson(audioProcessor.getPadMeter(padId).read()));
+
+    outboundMessages.push(message, "meters");
+}
+
+void OpenSamplerAudioProcessorEditor::queuePerformanceSummary()
+{
+    if (++performanceFrames < displayRateHz / performanceRateHz)
+        return;
+
+    performanceFrames = 0;
+    const auto reading = audioProcessor.getLoadMonitor().read();
+
+    Json::Value message;
+    message["type"] = "performance";
+    message["data"]["load"] = reading.load;
+    message["data"]["peakLoad"] = reading.peakLoad;
+    message["data"]["xruns"] = reading.xruns;
+    message["data"]["tracing"] = Aika::Tracer::isEnabled();
+
+    const auto& sampleStats = audioProcessor.getSampleStore().getStats();
+    message["data"]["samples"]["budgetBytes"] = (Json::UInt64) sampleStats.budgetBytes;
+    message["data"]["samples"]["residentBytes"] = (Json::UInt64) sampleStats.residentBytes;
+    message["data"]["samples"]["derivedBytes"] = (Json::UInt64) sampleStats.derivedBytes;
+    message["data"]["samples"]["resident"] = sampleStats.residentSamples;
+    message["data"]["samples"]["evicted"] = sampleStats.evictedSamples;
+    message["data"]["samples"]["reloadMisses"] = sampleStats.reloadMisses;
+    outboundMessages.push(message, "performance");
+}
+
+void OpenSamplerAudioProcessorEditor::queueKitLoadingState()
+{
+    const auto loadingPads = audioProcessor.getLoadingPads();
+    if (loadingPads == queuedLoadingPads)
+        return;
+
+    queuedLoadingPads = loadingPads;
+
+    Json::Value message;
+    message["type"] = "kitLoading";
+    message["data"]["pads"] = Json::Value(Json::arrayValue);
+    for (int padId = 0; padId < Aika::Kit::numPads; ++padId)
+        if ((loadingPads & (1u << padId)) != 0)
+            message["data"]["pads"].append(padId);
+
+    outboundMessages.push(message, "kitLoading");
+}
+
+void OpenSamplerAudioProcessorEditor::handleSequencerMessage(const juce::String& action, const juce::var& data)
+{
+    auto& sequencer = audioProcessor.getSequencer();
+    const int pattern = data.hasProperty("pattern") ? static_cast<int>(data["pattern"]) : sequencer.getSelectedPattern();
+
+    if (action == "setStep")
+    {
+        const int probability = data.hasProperty("probability") ? static_cast<int>(data["probability"]) : 100;
+        sequencer.setStep(pattern, data["track"], data["step"], data["velocity"], probability);
+    }
+    else if (action == "setLength")
+        sequencer.setLength(pattern, data["steps"]);
+    else if (action == "setStepBeats")
+        sequencer.setStepBeats(pattern, data["beats"]);
+    else if (action == "setSwing")
+        sequencer.setSwing(pattern, static_cast<float>(static_cast<double>(data["swing"])));
+    else if (action == "clear")
+        sequencer.clearPattern(pattern);
+    else if (action == "select")
+        sequencer.selectPattern(pattern);
+    else if (action == "get")
+        queueSequencerPattern(pattern);
+}
+
+void OpenSamplerAudioProcessorEditor::queueSequencerPattern(int pattern)
+{
+    auto& sequencer = audioProcessor.getSequencer();
+    if (pattern < 0 || pattern >= Aika::StepSequencer::numPatterns)
+        return;
+
+    const auto contents = sequencer.getPattern(pattern);
+
+    // One array per track of [velocity, probability] pairs, numSteps long
+    Json::Value message;
+    message["type"] = "sequencerPattern";
+    message["data"]["pattern"] = pattern;
+    message["data"]["selected"] = sequencer.getSelectedPattern();
+    message["data"]["numSteps"] = contents.numSteps;
+    message["data"]["stepBeats"] = contents.stepBeats;
+    message["data"]["swing"] = contents.swing;
+    message["data"]["tracks"] = Json::Value(Json::arrayValue);
+    for (const auto& track : contents.tracks)
+    {
+        Json::Value steps(Json::arrayValue);
+        for (int step = 0; step < contents.numSteps; ++step)
+        {
+            Json::Value value(Json::arrayValue);
+            value.append(track[(size_t) step].velocity);
+            value.append(track[(size_t) step].probability);
+            steps.append(value);
+        }
+        message["data"]["tracks"].append(steps);
+    }
+
+    outboundMessages.push(message, "sequencerPattern:" + juce::String(pattern));
+}
+
+void OpenSamplerAudioProcessorEditor::queueSequencerPosition()
+{
+    const auto& sequencer = audioProcessor.getSequencer();
+    const int pattern = sequencer.getPlayingPattern();
+    const int step = sequencer.getPlayingStep();
+    if (pattern == queuedSequencerPattern && step == queuedSequencerStep)
+        return;
+
+    queuedSequencerPattern = pattern;
+    queuedSequencerStep = step;
+
+    Json::Value message;
+    message["type"] = "sequencerPosition";
+    message["data"]["pattern"] = pattern;
+    message["data"]["step"] = step;
+    outboundMessages.push(message, "sequencerPosition");
+}
+
+void OpenSamplerAudioProcessorEditor::sendLatencyProbeResult()
+{
+    OpenSamplerAudioProcessor::LatencyProbe probe;
+    if (!audioProcessor.popLatencyProbe(probe))
+        return;
+
+    // Sent right away rather than batched, so the web view can subtract
+    // heldMs from its round trip to estimate the transport delay
+    Json::Value message;
+    message["type"] = "latencyProbe";
+    message["data"]["id"] = probe.id;
+    message["data"]["queuedToRenderMs"] = probe.renderedMs - probe.queuedMs;
+    message["data"]["blockMs"] = probe.blockMs;
+    message["data"]["heldMs"] = juce::Time::getMillisecondCounterHiRes() - probe.queuedMs;
+
+    Json::StreamWriterBuilder writerBuilder;
+    writerBuilder["indentation"] = "";
+    sendMessageToWebView(juce::String(Json::writeString(writerBuilder, message)));
+}
+
+void OpenSamplerAudioProcessorEditor::timerCallback()
+{
+    AIKA_TRACE_THREAD("Message");
+    AIKA_TRACE_SCOPE("webFlush");
+
+    sendLatencyProbeResult();
+    if (midiBridge)
+        midiBridge->queueMidiActivity();
+    queueAnalysisFrames();
+    queueMeterLevels();
+    queuePerformanceSummary();
+    queueKitLoadingState();
+    queueSequencerPosition();
+
+    // Backpressure: while the web view is behind, leave messages queued so they coalesce
+    if (batchesInFlight >= maxBatchesInFlight)
+        return;
+
+    Json::Value batch;
+    if (!outboundMessages.popBatch(batch))
+        return;
+
+    Json::Value payload;
+    payload["type"] = "batch";
+    payload["data"] = std::move(batch);
+
+    Json::StreamWriterBuilder writerBuilder;
+    writerBuilder["indentation"] = "";
+    const auto literal = Json::valueToQuotedString(Json::writeString(writerBuilder, payload).c_str());
+
+    ++batchesInFlight;
+    juce::Component::SafePointer<OpenSamplerAudioProcessorEditor> safeThis(this);
+    webComponent.evaluateJavaScript("window.juceBridge.onmessage(" + juce::String(literal) + ");",
+                                    [safeThis](juce::WebBrowserComponent::EvaluationResult)
+                                    {
+                                        if (safeThis != nullptr)
+                                            --safeThis->batchesInFlight;
+                                    });
 }
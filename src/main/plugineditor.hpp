@@ -10,6 +10,10 @@
 
 #include <JuceHeader.h>
 #include "pluginprocessor.hpp"
+#include "commandprotocol.hpp"
+#include "core/guiloader/assetcache.hpp"
+#include <array>
+#include <atomic>
 #include <functional>
 #include <vector>
 #include <memory>
@@ -27,31 +31,70 @@ struct SinglePageBrowser : juce::WebBrowserComponent {
     }
 };
 
+// Outbound queue to the web interface. Messages can be pushed from any thread;
+// the editor drains them once per display frame and sends a single batch.
+class WebMessageQueue
+{
+public:
+    static constexpr size_t maxPendingMessages = 256;
+
+    struct Stats
+    {
+        juce::uint64 sent = 0;       // Messages delivered in a batch
+        juce::uint64 batches = 0;    // evaluateJavaScript calls
+        juce::uint64 coalesced = 0;  // Messages replaced by a newer one with the same key
+        juce::uint64 dropped = 0;    // Messages discarded because the queue was full
+    };
+
+    // A message with a coalesce key replaces any pending message with the same key,
+    // so e.g. a controller sweep only delivers its latest value each frame
+    void push(const Json::Value& message, const juce::String& coalesceKey = {});
+
+    // Move everything pending into a JSON array; returns false if nothing was pending
+    bool popBatch(Json::Value& batch);
+
+    Stats getStats() const;
+
+private:
+    struct Pending
+    {
+        juce::String key;
+        Json::Value message;
+    };
+
+    std::vector<Pending> pending;
+    juce::CriticalSection lock;
+
+    std::atomic<juce::uint64> sent { 0 };
+    std::atomic<juce::uint64> batches { 0 };
+    std::atomic<juce::uint64> coalesced { 0 };
+    std::atomic<juce::uint64> dropped { 0 };
+};
+
 // MIDI Bridge to handle communication between JUCE and the web interface
 class MIDIBridge
 {
 public:
-    MIDIBridge(OpenSamplerAudioProcessor& processor);
-    ~MIDIBridge();
+    MIDIBridge(OpenSamplerAudioProcessor& processor, WebMessageQueue& outboundMessages);
     
     // Handle messages from the web interface
     void handleWebMessage(const juce::var& message);
+
+    // Queue the MIDI the processor played since the last call. Message thread.
+    void queueMidiActivity();
     
 private:
     // Convert MIDI message to JSON
     Json::Value midiMessageToJson(const juce::MidiMessage& message);
     
-    // Send message to web interface
-    void sendToWeb(const Json::Value& data);
-    
-    // MIDI message callback
-    std::function<void(const juce::MidiMessage&)> midiCallback;
+    // Queue a message for the web interface
+    void sendToWeb(const Json::Value& data, const juce::String& coalesceKey = {});
     
     // Reference to the processor
     OpenSamplerAudioProcessor& audioProcessor;
-    
-    // Flag to avoid recursive calls
-    bool isProcessingMessage = false;
+
+    // Outbound queue owned by the editor
+    WebMessageQueue& outbound;
     
     friend class OpenSamplerAudioProcessorEditor;
 };
@@ -59,7 +102,8 @@ private:
 //==============================================================================
 /**
 */
-class OpenSamplerAudioProcessorEditor  : public juce::AudioProcessorEditor
+class OpenSamplerAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                         private juce::Timer
 {
 public:
     OpenSamplerAudioProcessorEditor (OpenSamplerAudioProcessor&);
@@ -76,17 +120,86 @@ public:
         return controlParameterIndexReceiver.getControlParameterIndex();
     }
     
-    // Handle messages from the web interface
+    // Handle messages from the web interface: binary command packets or JSON
+    void handleScriptMessage(const juce::String& message);
     void handleWebMessage(const juce::var& message);
     
-    // Send message to the web interface
+    // Send message to the web interface immediately
     void sendMessageToWebView(const juce::String& jsonMessage);
 
+    // Queue a message for the next display frame; safe from any thread
+    void queueWebMessage(const Json::Value& message, const juce::String& coalesceKey = {});
+
+    WebMessageQueue::Stats getWebMessageStats() const { return outboundMessages.getStats(); }
+
+    // Milliseconds from editor construction until the first asset was served
+    // and until the page reported its first paint; 0 until they happen
+    struct LoadTimings
+    {
+        double firstResourceMs = 0.0;
+        double firstPaintMs = 0.0;
+    };
+
+    LoadTimings getLoadTimings() const { return { firstResourceMs.load(), firstPaintMs }; }
+
+    // Web UI bundle, shared by every editor in the process
+    static Aika::AssetCache& getAssetCache();
+
 private:
+    // Display-rate flush of the outbound queue
+    void timerCallback() override;
+
+    // Subscribe or unsubscribe the web view from a pad's or the master's analysis
+    void handleAnalysisMessage(const juce::String& action, const juce::var& data);
+
+    // Queue any analysis frames computed since the last display frame
+    void queueAnalysisFrames();
+
+    // Queue current master and pad levels while the web view shows meters
+    void queueMeterLevels();
+
+    // Queue the audio callback's load, xrun count and sample memory a few times a second
+    void queuePerformanceSummary();
+
+    // Start, stop or save a Chrome trace of the hot paths; see Aika::Tracer
+    void handleTraceMessage(const juce::String& action);
+
+    // Open a kit container, or save the current kit as one
+    void handleKitMessage(const juce::String& action, const juce::var& data);
+
+    // Layer an SFZ or SF2 instrument over the kit, or remove it
+    void handleInstrumentMessage(const juce::String& action, const juce::var& data);
+
+    // Use the absolute path(s) the web view sent, or ask with a native file
+    // chooser; onChosen is only called if there is at least one file
+    void chooseFiles(const juce::var& paths, const juce::String& title, const juce::String& patterns,
+                     int chooserFlags, std::function<void(const juce::Array<juce::File>&)> onChosen);
+
+    // Queue the set of pads still waiting for restored samples when it changes
+    void queueKitLoadingState();
+
+    // Edit the step sequencer's patterns, or send one back to the web view
+    void handleSequencerMessage(const juce::String& action, const juce::var& data);
+    void queueSequencerPattern(int pattern);
+
+    // Queue the step being played when it changes
+    void queueSequencerPosition();
+
+    // Answer a latency probe as soon as the audio thread has rendered it
+    void sendLatencyProbeResult();
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     OpenSamplerAudioProcessor& audioProcessor;
 
+    // Performance events from the web view
+    CommandDispatcher commandDispatcher;
+
+    // Time-to-first-paint instrumentation
+    const double openedAtMs;
+    std::atomic<double> firstResourceMs { 0.0 };  // Resources may be served off the message thread
+    double firstPaintMs = 0.0;
+
     //==============================================================================
     juce::WebControlParameterIndexReceiver controlParameterIndexReceiver;
 
@@ -112,9 +225,48 @@ private:
                 [this](const auto& url) { return getResource(url); },
                 juce::URL{"http://localhost:5173/"}.getOrigin())
             .withScriptMessageCallback(
-                [this](const juce::String& message) { this->handleWebMessage(juce::JSON::parse(message)); },
+                [this](const juce::String& message) { this->handleScriptMessage(message); },
                 "juceBridge")};
 
+    // Bind the relays to the processor's parameters; declared after the web
+    // component so they are destroyed before it
+    juce::WebSliderParameterAttachment gainAttachment{
+        *audioProcessor.getParameters().getParameter("gain"), gainRelay, nullptr};
+    juce::WebSliderParameterAttachment panAttachment{
+        *audioProcessor.getParameters().getParameter("panAngle"), panRelay, nullptr};
+    juce::WebComboBoxParameterAttachment panRuleAttachment{
+        *audioProcessor.getParameters().getParameter("panRule"), panRuleRelay, nullptr};
+    juce::WebToggleButtonParameterAttachment bypassAttachment{
+        *audioProcessor.getParameters().getParameter("bypass"), bypassRelay, nullptr};
+
+    // Outbound messages, sent once per frame; a frame is skipped while the
+    // web view is still evaluating earlier batches, and the queue coalesces meanwhile
+    static constexpr int displayRateHz = 60;
+    static constexpr int maxBatchesInFlight = 2;
+    WebMessageQueue outboundMessages;
+    int batchesInFlight = 0;
+
+    // Analysis subscriptions held by the web view, released with the editor
+    std::array<int, Aika::Analyser::numTaps> analysisSubscriptions {};
+    std::array<juce::uint32, Aika::Analyser::numTaps> analysisSequences {};
+
+    // Number of meter views open in the web view
+    int meterSubscriptions = 0;
+
+    // Display frames since the last performance summary
+    static constexpr int performanceRateHz = 4;
+    int performanceFrames = 0;
+
+    // Loading pads as last queued to the web view
+    juce::uint32 queuedLoadingPads = 0;
+
+    // Sequencer position as last queued to the web view
+    int queuedSequencerPattern = -1;
+    int queuedSequencerStep = -1;
+
+    // Native chooser opened for the web view; destroying it drops its callback
+    std::unique_ptr<juce::FileChooser> fileChooser;
+
     // MIDI Bridge
     std::unique_ptr<MIDIBridge> midiBridge;
     
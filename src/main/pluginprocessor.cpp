@@ -8,6 +8,130 @@
 
 #include "pluginprocessor.hpp"
 #include "plugineditor.hpp"
+#include "core/sampler/kitcontainer.hpp"
+#include "core/sampler/onsetdetector.hpp"
+#include "core/sampler/sfzimporter.hpp"
+#include "core/sampler/sf2importer.hpp"
+#include "core/dsp/timestretch/timestretch.hpp"
+#include "core/platform/realtimechecker.hpp"
+#include "core/platform/tracer.hpp"
+
+namespace
+{
+    // Same choices, in the same order, as Aika::DSP::PanRule
+    const juce::StringArray panRuleNames { "linear", "balanced", "sin3dB", "sin4p5dB", "sin6dB", "squareRoot3dB", "squareRoot4p5dB" };
+}
+
+//==============================================================================
+// Decodes the samples of a restored kit one by one, handing each to the processor as it is ready
+class OpenSamplerAudioProcessor::SampleRestoreJob : public juce::ThreadPoolJob
+{
+public:
+    SampleRestoreJob (OpenSamplerAudioProcessor& p, std::vector<Aika::KitState::PendingSample> samplesToDecode)
+        : juce::ThreadPoolJob ("Sample restore"), processor (p), samples (std::move (samplesToDecode))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        AIKA_TRACE_THREAD("Loader");
+        AIKA_TRACE_SCOPE("restoreSamples");
+
+        for (const auto& pending : samples)
+        {
+            if (shouldExit())
+                break;
+
+            processor.applyRestoredSample(pending.encoded, Aika::KitState::decodeSample(pending.encoded));
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+    OpenSamplerAudioProcessor& processor;
+    const std::vector<Aika::KitState::PendingSample> samples;
+};
+
+//==============================================================================
+// Opens a kit container off the message thread and hands the kit to the engine
+class OpenSamplerAudioProcessor::KitLoadJob : public juce::ThreadPoolJob
+{
+public:
+    KitLoadJob (OpenSamplerAudioProcessor& p, const juce::File& fileToLoad, int programNumber)
+        : juce::ThreadPoolJob ("Kit load"), processor (p), file (fileToLoad), program (programNumber)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        AIKA_TRACE_THREAD("Loader");
+        AIKA_TRACE_SCOPE("loadKit");
+
+        auto container = Aika::KitContainer::open(file);
+        if (container == nullptr || shouldExit())
+            return jobHasFinished;
+
+        auto kit = container->createKit();
+        if (program < 0)
+            processor.replaceKit(std::move(kit));
+        else
+            processor.samplerEngine.setProgramKit(program, std::move(kit));
+
+        return jobHasFinished;
+    }
+
+private:
+    OpenSamplerAudioProcessor& processor;
+    const juce::File file;
+    const int program;
+};
+
+//==============================================================================
+// Renders edited and tempo-synced pads, handing the results to the engine together
+class OpenSamplerAudioProcessor::PadRenderJob : public juce::ThreadPoolJob
+{
+public:
+    explicit PadRenderJob (OpenSamplerAudioProcessor& p)
+        : juce::ThreadPoolJob ("Pad render"), processor (p)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        AIKA_TRACE_THREAD("Loader");
+        AIKA_TRACE_SCOPE("padRender");
+
+        processor.renderDerivedSamples (*this);
+        return jobHasFinished;
+    }
+
+private:
+    OpenSamplerAudioProcessor& processor;
+};
+
+//==============================================================================
+// Reads evicted samples back when played, and evicts idle ones over the memory budget
+class OpenSamplerAudioProcessor::SampleStoreJob : public juce::ThreadPoolJob
+{
+public:
+    explicit SampleStoreJob (OpenSamplerAudioProcessor& p)
+        : juce::ThreadPoolJob ("Sample store"), processor (p)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        AIKA_TRACE_THREAD("Loader");
+        AIKA_TRACE_SCOPE("sampleStore");
+
+        processor.processSampleStore (*this);
+        return jobHasFinished;
+    }
+
+private:
+    OpenSamplerAudioProcessor& processor;
+};
 
 //==============================================================================
 OpenSamplerAudioProcessor::OpenSamplerAudioProcessor()
@@ -19,9 +143,28 @@ OpenSamplerAudioProcessor::OpenSamplerAudioProcessor()
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
-                       )
+                       ),
+#else
+     :
 #endif
+      parameters (*this, nullptr, "PARAMETERS", createParameterLayout())
 {
+    gainParameter = parameters.getRawParameterValue("gain");
+    panParameter = parameters.getRawParameterValue("panAngle");
+    panRuleParameter = parameters.getRawParameterValue("panRule");
+    bypassParameter = parameters.getRawParameterValue("bypass");
+
+    for (int padId = 0; padId < Aika::Kit::numPads; ++padId)
+    {
+        padVolumeParameters[(size_t) padId] = parameters.getRawParameterValue(getPadParameterId(padId, "Volume"));
+        padPanParameters[(size_t) padId] = parameters.getRawParameterValue(getPadParameterId(padId, "Pan"));
+    }
+
+    formatManager.registerBasicFormats();
+    samplerEngine.setAnalyser(&analyser);
+    padRenderJob = std::make_unique<PadRenderJob>(*this);
+    sampleStoreJob = std::make_unique<SampleStoreJob>(*this);
+    
     // Start the timer that checks for pending MIDI messages
     startTimer(10); // Check every 10ms
 }
@@ -29,6 +172,12 @@ OpenSamplerAudioProcessor::OpenSamplerAudioProcessor()
 OpenSamplerAudioProcessor::~OpenSamplerAudioProcessor()
 {
     stopTimer();
+    cancelSampleRestore();
+    loaderPool->pool.removeJob(padRenderJob.get(), true, -1);
+    loaderPool->pool.removeJob(sampleStoreJob.get(), true, -1);
+
+    for (auto& job : kitLoadJobs)
+        loaderPool->pool.removeJob(job.get(), true, -1);
     
     // Clean up MIDI input
     if (midiInput != nullptr)
@@ -102,18 +251,23 @@ void OpenSamplerAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    samplerEngine.prepare(sampleRate, samplesPerBlock);
+    outputRate = sampleRate;
+    analyser.prepare(sampleRate);
+    for (auto& gain : outputGains)
+        gain.prepare(sampleRate);
+    masterMeter.prepare(sampleRate);
+    loadMonitor.prepare(sampleRate);
     
-    // Clear any pending MIDI messages
-    juce::ScopedLock lock(midiMessageLock);
-    pendingMidiMessages.clear();
+    // Clear any pending MIDI messages; the audio thread, their only reader, isn't running
+    midiEventFifo.finishedRead(midiEventFifo.getNumReady());
 }
 
 void OpenSamplerAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
-    juce::ScopedLock lock(midiMessageLock);
-    pendingMidiMessages.clear();
+    midiEventFifo.finishedRead(midiEventFifo.getNumReady());
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -144,7 +298,25 @@ bool OpenSamplerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 
 void OpenSamplerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    Aika::ScopedRealtimeRegion realtimeRegion;
+    const Aika::LoadMonitor::ScopedBlock loadScope(loadMonitor, buffer.getNumSamples());
+    AIKA_TRACE_THREAD("Audio");
+    AIKA_TRACE_SCOPE("processBlock");
     juce::ScopedNoDenormals noDenormals;
+
+    // The step sequencer follows the host transport; tempo-synced pads are rendered to its tempo in the background
+    Aika::StepSequencer::Transport transport;
+    if (auto* playHead = getPlayHead())
+    {
+        if (const auto position = playHead->getPosition())
+        {
+            hostTempo = position->getBpm().orFallback(0.0);
+            transport.isPlaying = position->getIsPlaying() && position->getPpqPosition().hasValue();
+            transport.ppqPosition = position->getPpqPosition().orFallback(0.0);
+            transport.bpm = hostTempo;
+        }
+    }
+
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -155,39 +327,224 @@ void OpenSamplerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
 
     // Add any pending MIDI messages from external sources to the buffer
     {
-        juce::ScopedLock lock(midiMessageLock);
-        midiMessages.addEvents(pendingMidiMessages, 0, buffer.getNumSamples(), 0);
-        pendingMidiMessages.clear();
+        AIKA_TRACE_SCOPE("midiIngest");
+
+        // Take the probe first: the batch it marks was queued before its id was stored
+        const auto probeId = pendingProbeId.exchange(0);
+
+        int start1, size1, start2, size2;
+        midiEventFifo.prepareToRead(midiEventFifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1 + size2; ++i)
+        {
+            const auto& event = midiEventQueue[(size_t) (i < size1 ? start1 + i : start2 + i - size1)];
+            midiMessages.addEvent(event.data, event.size, 0);
+        }
+        midiEventFifo.finishedRead(size1 + size2);
+
+        if (probeId != 0)
+        {
+            completedProbeQueuedMs = pendingProbeQueuedMs.load();
+            completedProbeRenderedMs = juce::Time::getMillisecondCounterHiRes();
+            completedProbeBlockMs = 1000.0 * buffer.getNumSamples() / getSampleRate();
+            completedProbeId = probeId;
+        }
+    }
+
+    // Sequenced steps join the incoming events, so listeners see them too
+    {
+        std::array<int, Aika::Kit::numPads> padNotes;
+        samplerEngine.getPadNotes(padNotes);
+        sequencer.process(transport, buffer.getNumSamples(), getSampleRate(), padNotes, midiMessages);
     }
 
-    // Process incoming MIDI messages to notify listeners
+    // Queue the notes and controllers played for the web interface, which converts them on its own timer
     if (!midiMessages.isEmpty())
     {
-        juce::ScopedLock listenersLock(midiListenersLock);
-        
-        if (midiMessageListeners.size() > 0)
+        AIKA_TRACE_SCOPE("midiActivity");
+        for (const auto metadata : midiMessages)
         {
-            juce::MidiBuffer::Iterator it(midiMessages);
-            juce::MidiMessage message;
-            int samplePosition;
-
-            while (it.getNextEvent(message, samplePosition))
-            {
-                for (auto& listener : midiMessageListeners)
-                {
-                    if (listener != nullptr)
-                        listener(message);
-                }
-            }
+            const juce::uint8 status = metadata.numBytes == 3 ? metadata.data[0] : 0;
+            const juce::uint8 type = status & 0xf0;
+            if (type != 0x80 && type != 0x90 && type != 0xb0)
+                continue;
+
+            int start1, size1, start2, size2;
+            midiActivityFifo.prepareToWrite(1, start1, size1, start2, size2);
+            if (size1 == 0)
+                break;
+
+            midiActivity[(size_t) start1] = { status, metadata.data[1], metadata.data[2] };
+            midiActivityFifo.finishedWrite(1);
         }
     }
 
-    // Audio processing code here (left unchanged)
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    // Render the kit
+    updatePadGains();
+    samplerEngine.process(buffer, midiMessages);
+    applyOutputStage(buffer);
+
+    AIKA_TRACE_SCOPE("masterAnalysis");
+    masterMeter.process(buffer, 0, buffer.getNumSamples());
+    analyser.pushMaster(buffer, 0, buffer.getNumSamples());
+}
+
+#if AIKA_CLAP
+//==============================================================================
+bool OpenSamplerAudioProcessor::supportsDirectEvent(uint16_t spaceId, uint16_t type)
+{
+    if (spaceId != CLAP_CORE_EVENT_SPACE_ID)
+        return false;
+
+    return type == CLAP_EVENT_NOTE_ON || type == CLAP_EVENT_NOTE_OFF
+        || type == CLAP_EVENT_NOTE_CHOKE || type == CLAP_EVENT_NOTE_EXPRESSION;
+}
+
+void OpenSamplerAudioProcessor::handleDirectEvent(const clap_event_header_t* event, int sampleOffset)
+{
+    // Called on the audio thread ahead of the processBlock the event falls in
+    using NoteEvent = Aika::SamplerEngine::NoteEvent;
+    NoteEvent noteEvent;
+    noteEvent.sampleOffset = sampleOffset;
+
+    if (event->type == CLAP_EVENT_NOTE_EXPRESSION)
     {
-        auto* channelData = buffer.getWritePointer (channel);
-        // ..process audio data..
+        const auto* expression = reinterpret_cast<const clap_event_note_expression_t*>(event);
+        if (expression->expression_id == CLAP_NOTE_EXPRESSION_VOLUME)
+            noteEvent.expression = NoteEvent::Expression::Volume;
+        else if (expression->expression_id == CLAP_NOTE_EXPRESSION_PAN)
+            noteEvent.expression = NoteEvent::Expression::Pan;
+        else if (expression->expression_id == CLAP_NOTE_EXPRESSION_TUNING)
+            noteEvent.expression = NoteEvent::Expression::Tuning;
+        else
+            return;
+
+        noteEvent.type = NoteEvent::Type::Expression;
+        noteEvent.noteId = expression->note_id;
+        noteEvent.key = expression->key;
+        noteEvent.value = (float) expression->value;
+    }
+    else
+    {
+        const auto* note = reinterpret_cast<const clap_event_note_t*>(event);
+        noteEvent.type = event->type == CLAP_EVENT_NOTE_ON  ? NoteEvent::Type::NoteOn
+                       : event->type == CLAP_EVENT_NOTE_OFF ? NoteEvent::Type::NoteOff
+                                                            : NoteEvent::Type::Choke;
+        noteEvent.noteId = note->note_id;
+        noteEvent.key = note->key;
+        noteEvent.velocity = (float) juce::jlimit(0.0, 1.0, note->velocity);
     }
+
+    samplerEngine.addNoteEvent(noteEvent);
+}
+
+bool OpenSamplerAudioProcessor::voiceInfoGet(clap_voice_info* info)
+{
+    info->voice_count = Aika::SamplerEngine::maxVoices;
+    info->voice_capacity = Aika::SamplerEngine::maxVoices;
+    info->flags = CLAP_VOICE_INFO_SUPPORTS_OVERLAPPING_NOTES;
+    return true;
+}
+#endif
+
+//==============================================================================
+juce::AudioProcessorValueTreeState::ParameterLayout OpenSamplerAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID { "gain", 1 }, "Gain",
+        juce::NormalisableRange<float> (-48.0f, 12.0f, 0.1f), 0.0f,
+        juce::AudioParameterFloatAttributes().withLabel("dB")));
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID { "panAngle", 1 }, "Pan",
+        juce::NormalisableRange<float> (-100.0f, 100.0f, 1.0f), 0.0f));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID { "panRule", 1 }, "Pan Rule", panRuleNames, static_cast<int>(Aika::DSP::PanRule::Balanced)));
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID { "bypass", 1 }, "Bypass", false));
+
+    for (int padId = 0; padId < Aika::Kit::numPads; ++padId)
+    {
+        const auto padName = "Pad " + juce::String(padId + 1);
+        layout.add(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID { getPadParameterId(padId, "Volume"), 1 }, padName + " Volume",
+            juce::NormalisableRange<float> (0.0f, 1.0f), 1.0f));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID { getPadParameterId(padId, "Pan"), 1 }, padName + " Pan",
+            juce::NormalisableRange<float> (-1.0f, 1.0f), 0.0f));
+    }
+
+    return layout;
+}
+
+juce::String OpenSamplerAudioProcessor::getPadParameterId(int padId, const juce::String& name)
+{
+    return "pad" + juce::String(padId + 1) + name;
+}
+
+juce::AudioProcessorParameter* OpenSamplerAudioProcessor::getBypassParameter() const
+{
+    return parameters.getParameter("bypass");
+}
+
+bool OpenSamplerAudioProcessor::setPadParameter(int padId, const juce::String& name, float value)
+{
+    if (padId < 0 || padId >= Aika::Kit::numPads)
+        return false;
+
+    auto* parameter = parameters.getParameter(getPadParameterId(padId, name.substring(0, 1).toUpperCase() + name.substring(1)));
+    if (parameter == nullptr)
+        return false;
+
+    parameter->beginChangeGesture();
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    parameter->endChangeGesture();
+    return true;
+}
+
+void OpenSamplerAudioProcessor::updatePadGains()
+{
+    const auto rule = static_cast<Aika::DSP::PanRule>(static_cast<int>(panRuleParameter->load()));
+
+    for (int padId = 0; padId < Aika::Kit::numPads; ++padId)
+    {
+        const float volume = padVolumeParameters[(size_t) padId]->load();
+        const auto [left, right] = Aika::DSP::getPanGains(rule, padPanParameters[(size_t) padId]->load());
+        samplerEngine.setPadGains(padId, volume * left, volume * right);
+    }
+}
+
+void OpenSamplerAudioProcessor::applyOutputStage(juce::AudioBuffer<float>& buffer)
+{
+    AIKA_TRACE_SCOPE("outputStage");
+
+    // Bypass ramps the output to silence rather than cutting it
+    const float gain = bypassParameter->load() >= 0.5f ? 0.0f : juce::Decibels::decibelsToGain(gainParameter->load(), -48.0f);
+    const auto rule = static_cast<Aika::DSP::PanRule>(static_cast<int>(panRuleParameter->load()));
+    const auto [left, right] = Aika::DSP::getPanGains(rule, panParameter->load() / 100.0f);
+
+    float* const* channels = buffer.getArrayOfWritePointers();
+    const int numSamples = buffer.getNumSamples();
+
+    if (buffer.getNumChannels() >= 2)
+    {
+        outputGains[0].setTarget(gain * left);
+        outputGains[1].setTarget(gain * right);
+        outputGains[0].process(channels, 1, numSamples);
+        outputGains[1].process(channels + 1, 1, numSamples);
+    }
+    else if (buffer.getNumChannels() == 1)
+    {
+        outputGains[0].setTarget(gain);
+        outputGains[0].process(channels, 1, numSamples);
+    }
+}
+
+void OpenSamplerAudioProcessor::setTruePeakMetering(bool enabled)
+{
+    masterMeter.setTruePeakEnabled(enabled);
+    for (int padId = 0; padId < Aika::Kit::numPads; ++padId)
+        samplerEngine.getPadMeter(padId).setTruePeakEnabled(enabled);
 }
 
 //==============================================================================
@@ -210,6 +567,20 @@ void OpenSamplerAudioProcessor::getStateInformation (juce::MemoryBlock& destData
     // Store the last MIDI input device ID
     if (lastMidiInputId.isNotEmpty())
         state.setProperty("lastMidiInputId", lastMidiInputId, nullptr);
+
+    state.setProperty("convertSampleRates", convertSampleRates.load(), nullptr);
+    state.setProperty("sampleBudget", (juce::int64) sampleStore.getBudget(), nullptr);
+
+    // Store parameter values
+    state.appendChild(parameters.copyState(), nullptr);
+
+    // Store the kit, sample data included. Pads still being restored keep their saved samples.
+    {
+        juce::ScopedLock lock(kitEditLock);
+        state.appendChild(kitState.save(*samplerEngine.getKit(), pendingSamples), nullptr);
+    }
+
+    state.appendChild(sequencer.save(), nullptr);
     
     juce::MemoryOutputStream stream(destData, true);
     state.writeToStream(stream);
@@ -228,7 +599,105 @@ void OpenSamplerAudioProcessor::setStateInformation (const void* data, int sizeI
             juce::String savedInputId = state.getProperty("lastMidiInputId");
             setMidiInput(savedInputId);
         }
+
+        setSampleRateConversion(state.getProperty("convertSampleRates", true));
+        sampleStore.setBudget((size_t) juce::jmax((juce::int64) 0, (juce::int64) state.getProperty("sampleBudget", 0)));
+
+        // Restore parameter values
+        auto parameterState = state.getChildWithName(parameters.state.getType());
+        if (parameterState.isValid())
+            parameters.replaceState(parameterState);
+
+        // Restore the kit; states saved before kits were stored leave it as it is
+        auto kitTree = state.getChildWithName(Aika::KitState::kitType);
+        if (kitTree.isValid())
+            restoreKit(kitTree);
+
+        // Patterns; older states have none and leave the sequencer as it is
+        auto sequencerTree = state.getChildWithName(Aika::StepSequencer::sequencerType);
+        if (sequencerTree.isValid())
+            sequencer.load(sequencerTree);
+    }
+}
+
+void OpenSamplerAudioProcessor::restoreKit(const juce::ValueTree& kitTree)
+{
+    cancelSampleRestore();
+
+    // Pads and their settings take effect now; samples follow as they are decoded
+    auto restore = Aika::KitState::load(kitTree);
+    {
+        juce::ScopedLock lock(kitEditLock);
+        pendingSamples = restore.pendingSamples;
+
+        juce::uint32 pads = 0;
+        for (const auto& pending : pendingSamples)
+            pads |= pending.getWaitingPads();
+        loadingPads = pads;
+
+        samplerEngine.setKit(std::move(restore.kit));
+    }
+
+    if (restore.pendingSamples.empty())
+        return;
+
+    restoreJob = std::make_unique<SampleRestoreJob>(*this, std::move(restore.pendingSamples));
+    loaderPool->pool.addJob(restoreJob.get(), false);
+}
+
+void OpenSamplerAudioProcessor::applyRestoredSample(const juce::ValueTree& encoded, std::shared_ptr<const Aika::Sample> sample)
+{
+    juce::ScopedLock lock(kitEditLock);
+
+    // Gone if the kit was replaced since this restore started
+    const auto pending = std::find_if(pendingSamples.begin(), pendingSamples.end(),
+                                      [&encoded](const Aika::KitState::PendingSample& candidate) { return candidate.encoded == encoded; });
+    if (pending == pendingSamples.end())
+        return;
+
+    // Pads given another sample in the meantime keep it
+    const juce::uint32 stillLoading = loadingPads.load();
+    const juce::uint32 pads = pending->pads & stillLoading;
+    const juce::uint32 waitingPads = pending->getWaitingPads() & stillLoading;
+    const auto layers = std::move(pending->layers);
+    pendingSamples.erase(pending);
+
+    if (sample != nullptr && waitingPads != 0)
+    {
+        auto newKit = std::make_shared<Aika::Kit>(*samplerEngine.getKit());
+        for (auto& pad : newKit->pads)
+            if ((pads & (1u << pad.id)) != 0)
+                pad.sample = sample;
+
+        for (const auto& slot : layers)
+        {
+            auto& pad = newKit->pads[(size_t) slot.padId];
+            if ((waitingPads & (1u << slot.padId)) != 0 && slot.layer < (int) pad.layers.size())
+                pad.layers[(size_t) slot.layer].sample = sample;
+        }
+
+        samplerEngine.setKit(std::move(newKit));
+    }
+
+    // A pad is done once nothing it waits for is left; one that fails to decode stays empty
+    juce::uint32 waiting = 0;
+    for (const auto& remaining : pendingSamples)
+        waiting |= remaining.getWaitingPads();
+    loadingPads &= waiting;
+}
+
+void OpenSamplerAudioProcessor::cancelSampleRestore()
+{
+    // Must not hold kitEditLock here: the job takes it to apply each sample
+    if (restoreJob != nullptr)
+    {
+        loaderPool->pool.removeJob(restoreJob.get(), true, -1);
+        restoreJob.reset();
     }
+
+    juce::ScopedLock lock(kitEditLock);
+    pendingSamples.clear();
+    loadingPads = 0;
 }
 
 //==============================================================================
@@ -267,57 +736,418 @@ juce::StringArray OpenSamplerAudioProcessor::getMidiInputDevices()
 
 void OpenSamplerAudioProcessor::handleIncomingMidiMessage(juce::MidiInput* source, const juce::MidiMessage& message)
 {
-    // Add message to the buffer to be processed in the audio thread
-    juce::ScopedLock lock(midiMessageLock);
-    pendingMidiMessages.addEvent(message, 0);
+    AIKA_TRACE_THREAD("MIDI Input");
+    AIKA_TRACE_SCOPE("midiInput");
+
+    // Queue the message to be processed in the audio thread
+    queueMidiEvent(message);
 }
 
 // Handle MIDI events from the web interface
 void OpenSamplerAudioProcessor::sendMidiNoteOn(int channel, int noteNumber, float velocity)
 {
-    auto message = juce::MidiMessage::noteOn(channel + 1, noteNumber, velocity);
-    juce::ScopedLock lock(midiMessageLock);
-    pendingMidiMessages.addEvent(message, 0);
+    queueMidiEvent(juce::MidiMessage::noteOn(channel + 1, noteNumber, velocity));
 }
 
 void OpenSamplerAudioProcessor::sendMidiNoteOff(int channel, int noteNumber)
 {
-    auto message = juce::MidiMessage::noteOff(channel + 1, noteNumber);
-    juce::ScopedLock lock(midiMessageLock);
-    pendingMidiMessages.addEvent(message, 0);
+    queueMidiEvent(juce::MidiMessage::noteOff(channel + 1, noteNumber));
 }
 
 void OpenSamplerAudioProcessor::sendMidiControlChange(int channel, int controllerNumber, int value)
 {
-    auto message = juce::MidiMessage::controllerEvent(channel + 1, controllerNumber, value);
-    juce::ScopedLock lock(midiMessageLock);
-    pendingMidiMessages.addEvent(message, 0);
+    queueMidiEvent(juce::MidiMessage::controllerEvent(channel + 1, controllerNumber, value));
+}
+
+// getEvent fills in the next event, or returns false to skip it
+template <typename Function>
+bool OpenSamplerAudioProcessor::queueMidiEvents(int numEvents, Function&& getEvent)
+{
+    const juce::SpinLock::ScopedLockType lock(midiWriteLock);
+    if (midiEventFifo.getFreeSpace() < numEvents)
+        return false;
+
+    int start1, size1, start2, size2;
+    midiEventFifo.prepareToWrite(numEvents, start1, size1, start2, size2);
+
+    int numWritten = 0;
+    for (int i = 0; i < numEvents; ++i)
+    {
+        const int index = numWritten < size1 ? start1 + numWritten : start2 + numWritten - size1;
+        if (getEvent(midiEventQueue[(size_t) index]))
+            ++numWritten;
+    }
+
+    midiEventFifo.finishedWrite(numWritten);
+    return true;
+}
+
+bool OpenSamplerAudioProcessor::queueMidiEvent(const juce::MidiMessage& message)
+{
+    return queueMidiEvents(1, [&message](MidiEvent& event)
+    {
+        if (message.getRawDataSize() > 3)
+            return false;
+
+        std::copy(message.getRawData(), message.getRawData() + message.getRawDataSize(), event.data);
+        event.size = (juce::uint8) message.getRawDataSize();
+        return true;
+    });
+}
+
+bool OpenSamplerAudioProcessor::sendMidiEvents(const MidiEvent* events, int numEvents, juce::uint32 probeId)
+{
+    AIKA_TRACE_SCOPE("queueMidiEvents");
+    if (probeId != 0)
+        pendingProbeQueuedMs = juce::Time::getMillisecondCounterHiRes();
+
+    const bool queued = queueMidiEvents(numEvents, [&events](MidiEvent& event)
+    {
+        event = *events++;
+        return true;
+    });
+
+    if (queued && probeId != 0)
+        pendingProbeId = probeId;
+
+    return queued;
+}
+
+bool OpenSamplerAudioProcessor::popLatencyProbe(LatencyProbe& probe)
+{
+    probe.id = completedProbeId.exchange(0);
+    if (probe.id == 0)
+        return false;
+
+    probe.queuedMs = completedProbeQueuedMs.load();
+    probe.renderedMs = completedProbeRenderedMs.load();
+    probe.blockMs = completedProbeBlockMs.load();
+    return true;
 }
 
 // Listener management for passing MIDI events to the web interface
-void OpenSamplerAudioProcessor::addMidiMessageListener(std::function<void(const juce::MidiMessage&)> callback)
+int OpenSamplerAudioProcessor::popMidiActivity(MidiActivity* destination, int maxEvents)
+{
+    int start1, size1, start2, size2;
+    midiActivityFifo.prepareToRead(maxEvents, start1, size1, start2, size2);
+    std::copy(midiActivity.begin() + start1, midiActivity.begin() + start1 + size1, destination);
+    std::copy(midiActivity.begin() + start2, midiActivity.begin() + start2 + size2, destination + size1);
+    midiActivityFifo.finishedRead(size1 + size2);
+    return size1 + size2;
+}
+
+//==============================================================================
+// Kit management
+
+bool OpenSamplerAudioProcessor::loadPadSample(int padId, const juce::File& file)
+{
+    if (padId < 0 || padId >= Aika::Kit::numPads)
+        return false;
+
+    // Integer files stay at their native bit depth in memory
+    auto sample = Aika::Sample::loadFromFile(formatManager, file);
+    if (sample == nullptr)
+        return false;
+
+    juce::ScopedLock lock(kitEditLock);
+    auto newKit = std::make_shared<Aika::Kit>(*samplerEngine.getKit());
+    auto& pad = newKit->pads[static_cast<size_t>(padId)];
+    pad.sample = std::move(sample);
+    pad.layers.clear();
+    pad.settings.start = 0.0;
+    pad.settings.end = 0.0;
+
+    // A sample still being restored no longer belongs on this pad
+    loadingPads &= ~(1u << padId);
+
+    samplerEngine.setKit(std::move(newKit));
+    return true;
+}
+
+bool OpenSamplerAudioProcessor::loadPadLayers(int padId, const juce::Array<juce::File>& files)
+{
+    if (padId < 0 || padId >= Aika::Kit::numPads)
+        return false;
+
+    std::vector<std::shared_ptr<const Aika::Sample>> samples;
+    for (const auto& file : files)
+        if (auto sample = Aika::Sample::loadFromFile(formatManager, file))
+            samples.push_back(std::move(sample));
+
+    if (samples.empty())
+        return false;
+
+    // Velocity ranges and round-robin order come from the filenames
+    juce::ScopedLock lock(kitEditLock);
+    auto newKit = std::make_shared<Aika::Kit>(*samplerEngine.getKit());
+    auto& pad = newKit->pads[(size_t) padId];
+    pad.setLayers(Aika::createPadLayers(samples));
+    pad.settings.start = 0.0;
+    pad.settings.end = 0.0;
+
+    loadingPads &= ~(1u << padId);
+
+    samplerEngine.setKit(std::move(newKit));
+    return true;
+}
+
+std::shared_ptr<const Aika::Kit> OpenSamplerAudioProcessor::getKit() const
+{
+    return samplerEngine.getKit();
+}
+
+bool OpenSamplerAudioProcessor::loadKitContainer(const juce::File& file)
 {
-    juce::ScopedLock lock(midiListenersLock);
-    midiMessageListeners.add(callback);
+    // Samples reference the mapped file directly, so nothing is decoded here
+    auto container = Aika::KitContainer::open(file);
+    if (container == nullptr)
+        return false;
+
+    replaceKit(container->createKit());
+    return true;
 }
 
-void OpenSamplerAudioProcessor::removeMidiMessageListener(std::function<void(const juce::MidiMessage&)> callback)
+void OpenSamplerAudioProcessor::loadKitContainerAsync(const juce::File& file, int program)
 {
-    juce::ScopedLock lock(midiListenersLock);
-    // Note: This might not work perfectly as it compares function objects.
-    // For a more robust solution, consider using a registration ID system.
-    for (int i = midiMessageListeners.size() - 1; i >= 0; i--)
+    jassert(program < Aika::SamplerEngine::numPrograms);
+
+    // Forget jobs that have finished
+    kitLoadJobs.erase(std::remove_if(kitLoadJobs.begin(), kitLoadJobs.end(),
+                                     [this](const std::unique_ptr<KitLoadJob>& job) { return !loaderPool->pool.contains(job.get()); }),
+                      kitLoadJobs.end());
+
+    kitLoadJobs.push_back(std::make_unique<KitLoadJob>(*this, file, program));
+    loaderPool->pool.addJob(kitLoadJobs.back().get(), false);
+}
+
+void OpenSamplerAudioProcessor::replaceKit(std::shared_ptr<const Aika::Kit> newKit)
+{
+    // Samples still being restored belong to the kit being replaced; an
+    // unfinished restore job finds nothing left to apply them to
+    juce::ScopedLock lock(kitEditLock);
+    pendingSamples.clear();
+    loadingPads = 0;
+    samplerEngine.setKit(std::move(newKit));
+}
+
+bool OpenSamplerAudioProcessor::saveKitContainer(const juce::File& file) const
+{
+    return Aika::KitContainer::write(*samplerEngine.getKit(), file);
+}
+
+bool OpenSamplerAudioProcessor::loadInstrument(const juce::File& file, int presetIndex)
+{
+    // Regions are compiled into the note/velocity lookup table here, off the audio thread
+    std::shared_ptr<Aika::Instrument> instrument;
+
+    if (file.hasFileExtension("sfz"))
+        instrument = Aika::SfzImporter::load(file, formatManager);
+    else if (file.hasFileExtension("sf2"))
+        instrument = Aika::Sf2Importer::load(file, presetIndex);
+
+    if (instrument == nullptr)
+        return false;
+
+    samplerEngine.setInstrument(std::move(instrument));
+    return true;
+}
+
+void OpenSamplerAudioProcessor::clearInstrument()
+{
+    samplerEngine.setInstrument(nullptr);
+}
+
+void OpenSamplerAudioProcessor::timerCallback()
+{
+    // Replaced kits are freed here, once their last voice has ended
+    samplerEngine.collectGarbage();
+    updateDerivedSamples();
+    updateSampleStore();
+    sequencer.flush();
+}
+
+//==============================================================================
+// Pad edits, tempo sync and sample rate conversion
+
+bool OpenSamplerAudioProcessor::setPadSync(int padId, double beats)
+{
+    if (padId < 0 || padId >= Aika::Kit::numPads || beats < 0.0)
+        return false;
+
+    juce::ScopedLock lock(kitEditLock);
+    auto newKit = std::make_shared<Aika::Kit>(*samplerEngine.getKit());
+    newKit->pads[(size_t) padId].settings.syncBeats = beats;
+    samplerEngine.setKit(std::move(newKit));
+    return true;
+}
+
+bool OpenSamplerAudioProcessor::setPadEdits(int padId, const Aika::PadSettings& edits)
+{
+    if (padId < 0 || padId >= Aika::Kit::numPads)
+        return false;
+
+    juce::ScopedLock lock(kitEditLock);
+    auto newKit = std::make_shared<Aika::Kit>(*samplerEngine.getKit());
+    auto& settings = newKit->pads[(size_t) padId].settings;
+    settings.start = juce::jmax(0.0, edits.start);
+    settings.end = edits.end > settings.start ? edits.end : 0.0;
+    settings.reverse = edits.reverse;
+    settings.normalize = edits.normalize;
+    settings.fadeIn = juce::jmax(0.0, edits.fadeIn);
+    settings.fadeOut = juce::jmax(0.0, edits.fadeOut);
+    samplerEngine.setKit(std::move(newKit));
+    return true;
+}
+
+int OpenSamplerAudioProcessor::slicePadToPads(int padId, float sensitivity)
+{
+    if (padId < 0 || padId >= Aika::Kit::numPads)
+        return 0;
+
+    // Onsets are found outside kitEditLock; the slices then go onto the kit as it is by then
+    const auto kit = samplerEngine.getKit();
+    const auto& source = kit->pads[(size_t) padId];
+    const auto sample = source.sample;
+    if (sample == nullptr || !source.layers.empty())
+        return 0;
+
+    // An evicted sample is read back in full for the analysis
+    const auto* full = sample->loadFull();
+    if (full == nullptr)
+        return 0;
+
+    const double rate = sample->getSampleRate();
+    const int numFrames = sample->getNumFrames();
+    const int startFrame = juce::jlimit(0, numFrames, (int) (source.settings.start * rate));
+    const int endFrame = source.settings.end > source.settings.start
+                             ? juce::jlimit(startFrame, numFrames, (int) (source.settings.end * rate))
+                             : numFrames;
+
+    Aika::OnsetDetector::Settings settings;
+    settings.sensitivity = juce::jlimit(0.0f, 1.0f, sensitivity);
+    Aika::OnsetDetector detector(settings);
+    const auto onsets = detector.detect(*full, startFrame, endFrame - startFrame);
+    if (onsets.empty())
+        return 0;
+
+    juce::ScopedLock lock(kitEditLock);
+    auto newKit = std::make_shared<Aika::Kit>(*samplerEngine.getKit());
+    const int numSlices = Aika::OnsetDetector::sliceToPads(*newKit, sample, onsets, padId, endFrame);
+
+    // Samples still being restored no longer belong on the sliced pads
+    for (int i = padId; i < padId + numSlices; ++i)
+        loadingPads &= ~(1u << i);
+
+    samplerEngine.setKit(std::move(newKit));
+    return numSlices;
+}
+
+void OpenSamplerAudioProcessor::setSampleRateConversion(bool enabled)
+{
+    // Picked up by the next timer tick, which renders or drops the converted samples
+    convertSampleRates = enabled;
+}
+
+double OpenSamplerAudioProcessor::getRenderRate() const
+{
+    return convertSampleRates.load() ? outputRate.load() : 0.0;
+}
+
+void OpenSamplerAudioProcessor::updateDerivedSamples()
+{
+    // Re-render lazily: only once the tempo, output rate or the kit has changed, and
+    // never while a render is under way; the next tick catches anything that changed meanwhile
+    const double tempo = std::round(hostTempo.load() * 100.0) / 100.0;
+    const double rate = getRenderRate();
+    const auto kit = samplerEngine.getKit();
+    if ((tempo == renderedTempo && rate == renderedRate && kit == renderedKit.lock())
+        || loaderPool->pool.contains(padRenderJob.get()))
+        return;
+
+    renderedTempo = tempo;
+    renderedRate = rate;
+    renderedKit = kit;
+
+    const auto isDerived = [tempo, rate](const Aika::Pad& pad, const Aika::Sample& sample) {
+        return !Aika::SampleTransform::forPad(pad, sample, tempo, rate).isPlainRegion();
+    };
+    const bool hasDerivedPads = std::any_of(kit->pads.begin(), kit->pads.end(), [&isDerived](const Aika::Pad& pad) {
+        if (pad.layers.empty())
+            return pad.sample != nullptr && isDerived(pad, *pad.sample);
+        return std::any_of(pad.layers.begin(), pad.layers.end(), [&](const Aika::PadLayer& layer) {
+            return layer.sample != nullptr && isDerived(pad, *layer.sample);
+        });
+    });
+    if (hasDerivedPads || hasDerivedSamples)
+        loaderPool->pool.addJob(padRenderJob.get(), false);
+}
+
+void OpenSamplerAudioProcessor::renderDerivedSamples(const juce::ThreadPoolJob& job)
+{
+    const auto kit = samplerEngine.getKit();
+    const double tempo = std::round(hostTempo.load() * 100.0) / 100.0;
+    const double rate = getRenderRate();
+    Aika::SamplerEngine::DerivedSamples derived;
+    bool hasDerived = false;
+
+    // Samples with nothing to render play straight from the pad
+    const auto derive = [&](const Aika::Pad& pad, const std::shared_ptr<const Aika::Sample>& sample) -> std::shared_ptr<const Aika::Sample>
+    {
+        if (sample == nullptr)
+            return nullptr;
+
+        const auto transform = Aika::SampleTransform::forPad(pad, *sample, tempo, rate);
+        if (transform.isPlainRegion() || transform.endFrame - transform.startFrame < 2)
+            return nullptr;
+
+        hasDerived = true;
+        return derivedSampleCache.get(sample, transform);
+    };
+
+    for (const auto& pad : kit->pads)
     {
-        // This is approximate as comparing function objects is implementation-dependent
-        if (midiMessageListeners.getReference(i) == callback)
-            midiMessageListeners.remove(i);
+        if (job.shouldExit())
+            return;
+
+        auto& derivedPad = derived[(size_t) pad.id];
+        if (pad.layers.empty())
+        {
+            derivedPad.sample = derive(pad, pad.sample);
+            continue;
+        }
+
+        derivedPad.layers.reserve(pad.layers.size());
+        for (const auto& layer : pad.layers)
+            derivedPad.layers.push_back(derive(pad, layer.sample));
+        if (std::all_of(derivedPad.layers.begin(), derivedPad.layers.end(), [](const auto& sample) { return sample == nullptr; }))
+            derivedPad.layers.clear();
     }
+
+    // Refused if the kit changed meanwhile; the timer then starts over for the new one
+    samplerEngine.setDerivedSamples(kit, std::move(derived));
+    hasDerivedSamples = hasDerived;
 }
 
-void OpenSamplerAudioProcessor::timerCallback()
+//==============================================================================
+// Sample memory budget
+
+void OpenSamplerAudioProcessor::updateSampleStore()
 {
-    // This is called periodically to check for any pending tasks
-    // For example, updating UI with MIDI activity
+    if (sampleStore.update(*samplerEngine.getKit(), samplerEngine.getDerivedBytes()) && !loaderPool->pool.contains(sampleStoreJob.get()))
+        loaderPool->pool.addJob(sampleStoreJob.get(), false);
+}
+
+void OpenSamplerAudioProcessor::processSampleStore(const juce::ThreadPoolJob& job)
+{
+    const auto evictions = sampleStore.process(*samplerEngine.getKit(), job);
+    if (evictions.empty())
+        return;
+
+    // The kit may have changed while samples were written out; heads replace whichever are still in it
+    juce::ScopedLock lock(kitEditLock);
+    auto newKit = std::make_shared<Aika::Kit>(*samplerEngine.getKit());
+    if (Aika::SampleStore::replaceSamples(*newKit, evictions))
+        samplerEngine.setKit(std::move(newKit));
 }
 
 //==============================================================================
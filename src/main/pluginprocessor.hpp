@@ -9,11 +9,26 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "core/audioengine/engine.hpp"
+#include "core/audioengine/analyser.hpp"
+#include "core/audioengine/loadmonitor.hpp"
+#include "core/audioengine/sequencer.hpp"
+#include "core/sampler/kitstate.hpp"
+#include "core/sampler/derivedsamplecache.hpp"
+#include "core/sampler/samplestore.hpp"
+#include <array>
+
+#if AIKA_CLAP
+ #include <clap-juce-extensions/clap-juce-extensions.h>
+#endif
 
 //==============================================================================
 /**
 */
 class OpenSamplerAudioProcessor : public juce::AudioProcessor,
+                                #if AIKA_CLAP
+                                 public clap_juce_extensions::clap_juce_audio_processor_capabilities,
+                                #endif
                                  private juce::MidiInputCallback,
                                  private juce::Timer
 {
@@ -32,6 +47,27 @@ public:
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
 
+   #if AIKA_CLAP
+    //==============================================================================
+    // CLAP note events go straight to the engine with their note ids, so hosts can
+    // end, choke and modulate single voices (volume, pan and tuning expressions)
+    bool supportsDirectEvent(uint16_t spaceId, uint16_t type) override;
+    void handleDirectEvent(const clap_event_header_t* event, int sampleOffset) override;
+    bool supportsVoiceInfo() override { return true; }
+    bool voiceInfoGet(clap_voice_info* info) override;
+   #endif
+
+    //==============================================================================
+    // Host parameters: output gain, pan, pan rule and bypass, plus volume and pan per pad
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    static juce::String getPadParameterId(int padId, const juce::String& name);
+
+    juce::AudioProcessorValueTreeState& getParameters() { return parameters; }
+    juce::AudioProcessorParameter* getBypassParameter() const override;
+
+    // Set a pad parameter from the web interface ("volume" 0 - 1 or "pan" -1 - 1), notifying the host
+    bool setPadParameter(int padId, const juce::String& name, float value);
+
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -65,24 +101,213 @@ public:
     void sendMidiNoteOn(int channel, int noteNumber, float velocity);
     void sendMidiNoteOff(int channel, int noteNumber);
     void sendMidiControlChange(int channel, int controllerNumber, int value);
+
+    // A MIDI message of up to three bytes, queued for the audio thread. Longer
+    // messages (sysex) are not queued, as nothing in the engine reads them.
+    struct MidiEvent
+    {
+        juce::uint8 data[3] {};
+        juce::uint8 size = 0;
+    };
+
+    // Queue a batch of events for the next block. The audio thread takes them
+    // without locking; they all arrive in the same block, or none are queued if
+    // the queue is full. A non-zero probeId marks the batch so its path to the
+    // audio thread can be timed.
+    bool sendMidiEvents(const MidiEvent* events, int numEvents, juce::uint32 probeId = 0);
+
+    // Timing of a marked batch, in Time::getMillisecondCounterHiRes() milliseconds
+    struct LatencyProbe
+    {
+        juce::uint32 id = 0;
+        double queuedMs = 0.0;     // When the batch was queued
+        double renderedMs = 0.0;   // When the block that plays it started rendering
+        double blockMs = 0.0;      // Duration of that block, before which it can't be heard
+    };
+
+    // Take the most recently rendered probe, if one completed since the last call
+    bool popLatencyProbe(LatencyProbe& probe);
     
-    // Message passing to the web interface
-    void addMidiMessageListener(std::function<void(const juce::MidiMessage&)> callback);
-    void removeMidiMessageListener(std::function<void(const juce::MidiMessage&)> callback);
+    // Notes and controllers the audio thread played, for the web interface to show. They
+    // are queued without locking or allocating, and dropped while nothing takes them.
+    struct MidiActivity
+    {
+        juce::uint8 status = 0;
+        juce::uint8 data1 = 0;
+        juce::uint8 data2 = 0;
+    };
+
+    // Take queued activity, oldest first; returns the number of events copied. Message thread.
+    int popMidiActivity(MidiActivity* destination, int maxEvents);
+
+    //==============================================================================
+    // Kit management
+    bool loadPadSample(int padId, const juce::File& file);
+
+    // Load several samples onto one pad as velocity layers and round robins, arranged by their filenames
+    bool loadPadLayers(int padId, const juce::Array<juce::File>& files);
+
+    // File patterns of every audio format the pads can load, for file choosers
+    juce::String getAudioFormatWildcard() const { return formatManager.getWildcardForAllFormats(); }
+    std::shared_ptr<const Aika::Kit> getKit() const;
+    bool loadKitContainer(const juce::File& file);
+
+    // Load a kit container on a background thread. With program -1 it replaces the
+    // kit when ready; otherwise it is preloaded for that MIDI program change (0 - 127).
+    void loadKitContainerAsync(const juce::File& file, int program = -1);
+    bool saveKitContainer(const juce::File& file) const;
+    bool loadInstrument(const juce::File& file, int presetIndex = 0);
+    void clearInstrument();
+
+    // Sync a pad's region to the host tempo, as a length in beats; 0 plays it at its own speed
+    bool setPadSync(int padId, double beats);
+
+    // Set a pad's trim (start, end), reverse, normalize and fades from edits; its other settings stay
+    bool setPadEdits(int padId, const Aika::PadSettings& edits);
+
+    // Slice the region of a pad's sample at its onsets onto that pad and the ones after it.
+    // Sensitivity is 0 - 1, higher finds more onsets; returns the number of pads assigned.
+    int slicePadToPads(int padId, float sensitivity);
+
+    // Convert pad samples to the output rate in the background, so voices play them without
+    // interpolating unless pitched; off, they are interpolated to the output rate as they play
+    void setSampleRateConversion(bool enabled);
+    bool getSampleRateConversion() const { return convertSampleRates.load(); }
+
+    // Pads whose samples are still being restored from a saved state, one bit per pad id
+    juce::uint32 getLoadingPads() const { return loadingPads.load(); }
+
+    //==============================================================================
+    // Spectrum and waveform analysis for the UI
+    Aika::Analyser& getAnalyser() { return analyser; }
+
+    // Levels for the UI, read at its own rate
+    Aika::LevelMeter& getMasterMeter() { return masterMeter; }
+    Aika::LevelMeter& getPadMeter(int padId) { return samplerEngine.getPadMeter(padId); }
+
+    // Only pay for true-peak measurement while levels are shown
+    void setTruePeakMetering(bool enabled);
+
+    // Audio callback load and overruns for the UI
+    Aika::LoadMonitor& getLoadMonitor() { return loadMonitor; }
+
+    // Patterns played from the host transport; edit from any thread but the audio thread
+    Aika::StepSequencer& getSequencer() { return sequencer; }
+
+    // Memory budget of the kit's samples; stats and settings for the UI, on the message thread
+    Aika::SampleStore& getSampleStore() { return sampleStore; }
 
 private:
     // Timer callback
     void timerCallback() override;
+
+    // Swap in a whole new kit, abandoning any unfinished restore
+    class KitLoadJob;
+    void replaceKit(std::shared_ptr<const Aika::Kit> newKit);
+
+    // Second phase of a state restore; see Aika::KitState
+    class SampleRestoreJob;
+    void restoreKit(const juce::ValueTree& kitTree);
+    void applyRestoredSample(const juce::ValueTree& encoded, std::shared_ptr<const Aika::Sample> sample);
+    void cancelSampleRestore();
+
+    // Edited, tempo-synced and rate-converted pads play renders of their regions, see Aika::DerivedSampleCache
+    class PadRenderJob;
+    double getRenderRate() const;   // Rate pads are converted to, 0 to leave them at their own
+    void updateDerivedSamples();
+    void renderDerivedSamples(const juce::ThreadPoolJob& job);
+
+    // Samples are read back and evicted on the loader pool, see Aika::SampleStore
+    class SampleStoreJob;
+    void updateSampleStore();
+    void processSampleStore(const juce::ThreadPoolJob& job);
+
+    // Pass this block's parameter values on as smoothing targets
+    void updatePadGains();
+    void applyOutputStage(juce::AudioBuffer<float>& buffer);
     
     //==============================================================================
     // MIDI device management
     juce::MidiInput* midiInput = nullptr;
     juce::String lastMidiInputId;
-    juce::MidiBuffer pendingMidiMessages;
-    juce::CriticalSection midiMessageLock;
+
+    // Events for the audio thread, from the MIDI input, the web interface and the
+    // command protocol. The audio thread is the only reader; the writers take
+    // midiWriteLock between themselves, which the audio thread never touches.
+    bool queueMidiEvent(const juce::MidiMessage& message);
+    template <typename Function>
+    bool queueMidiEvents(int numEvents, Function&& getEvent);
+
+    static constexpr int midiEventQueueSize = 1024;
+    juce::AbstractFifo midiEventFifo { midiEventQueueSize };
+    std::array<MidiEvent, midiEventQueueSize> midiEventQueue;
+    juce::SpinLock midiWriteLock;
+
+    // Latency probes, one in flight at a time. Each id is stored after the
+    // fields it publishes and taken before they are read.
+    std::atomic<juce::uint32> pendingProbeId { 0 };      // Stored after its batch is queued
+    std::atomic<double> pendingProbeQueuedMs { 0.0 };
+    std::atomic<juce::uint32> completedProbeId { 0 };
+    std::atomic<double> completedProbeQueuedMs { 0.0 };
+    std::atomic<double> completedProbeRenderedMs { 0.0 };
+    std::atomic<double> completedProbeBlockMs { 0.0 };
+    
+    static constexpr int midiActivitySize = 1024;
+    juce::AbstractFifo midiActivityFifo { midiActivitySize };
+    std::array<MidiActivity, midiActivitySize> midiActivity;
     
-    juce::Array<std::function<void(const juce::MidiMessage&)>> midiMessageListeners;
-    juce::CriticalSection midiListenersLock;
+    //==============================================================================
+    // Sampler
+    juce::AudioFormatManager formatManager;
+    Aika::Analyser analyser;
+    Aika::LevelMeter masterMeter;
+    Aika::LoadMonitor loadMonitor;
+    Aika::SamplerEngine samplerEngine;
+    Aika::StepSequencer sequencer;
+
+    //==============================================================================
+    // Kit loading and persistence. Kits are loaded and samples decoded on a
+    // thread pool shared by every instance in the process, so a project with
+    // many instances restores without starting threads per instance or
+    // blocking the host.
+    struct LoaderPool
+    {
+        juce::ThreadPool pool { juce::jmax(1, juce::SystemStats::getNumCpus() / 2), 0, juce::Thread::Priority::low };
+    };
+
+    Aika::KitState kitState;                                   // Guarded by kitEditLock
+    juce::CriticalSection kitEditLock;                          // Serializes changes that copy and replace the kit
+    std::vector<Aika::KitState::PendingSample> pendingSamples;  // Guarded by kitEditLock
+    std::atomic<juce::uint32> loadingPads { 0 };
+    juce::SharedResourcePointer<LoaderPool> loaderPool;
+    std::unique_ptr<SampleRestoreJob> restoreJob;
+    std::vector<std::unique_ptr<KitLoadJob>> kitLoadJobs;      // Message thread only
+
+    //==============================================================================
+    // Derived samples, rendered on the loader pool whenever the host tempo, output rate or the kit changes
+    std::atomic<double> hostTempo { 0.0 };          // BPM from the play head, 0 if the host gives none
+    std::atomic<double> outputRate { 0.0 };         // Rate from prepareToPlay, 0 before it is known
+    std::atomic<bool> convertSampleRates { true };
+    Aika::DerivedSampleCache derivedSampleCache;
+    std::unique_ptr<PadRenderJob> padRenderJob;
+    double renderedTempo = 0.0;                      // Message thread only
+    double renderedRate = 0.0;                       // Message thread only
+    std::weak_ptr<const Aika::Kit> renderedKit;      // Message thread only
+    std::atomic<bool> hasDerivedSamples { false };   // The engine holds renders that may need dropping
+
+    Aika::SampleStore sampleStore;
+    std::unique_ptr<SampleStoreJob> sampleStoreJob;
     
+    //==============================================================================
+    // Parameters; the audio thread only reads the raw atomics
+    juce::AudioProcessorValueTreeState parameters;
+    std::atomic<float>* gainParameter = nullptr;      // dB
+    std::atomic<float>* panParameter = nullptr;       // -100 - 100
+    std::atomic<float>* panRuleParameter = nullptr;   // Index into Aika::DSP::PanRule
+    std::atomic<float>* bypassParameter = nullptr;
+    std::array<std::atomic<float>*, Aika::Kit::numPads> padVolumeParameters {};
+    std::array<std::atomic<float>*, Aika::Kit::numPads> padPanParameters {};
+    std::array<Aika::DSP::SmoothedGain, 2> outputGains;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OpenSamplerAudioProcessor)
 };